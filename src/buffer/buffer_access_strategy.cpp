@@ -0,0 +1,20 @@
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/buffer_pool_manager.h"
+
+std::atomic<uint32_t> BufferAccessStrategy::next_id_{1};
+
+BufferAccessStrategy::BufferAccessStrategy(BufferPoolManager *buffer_pool_manager, size_t ring_size)
+    : buffer_pool_manager_(buffer_pool_manager), ring_size_(ring_size < 2 ? 2 : ring_size) {
+  // 0 means "not read in by a strategy", skip it on wrap around
+  do {
+    id_ = next_id_++;
+  } while (id_ == 0);
+}
+
+void BufferAccessStrategy::AddPage(page_id_t page_id) {
+  ring_.push_back(page_id);
+  if (ring_.size() <= ring_size_) return;
+  page_id_t old_page_id = ring_.front();
+  ring_.pop_front();
+  buffer_pool_manager_->RecyclePage(old_page_id, id_);
+}
@@ -1,141 +1,266 @@
 #include "buffer/buffer_pool_manager.h"
+
+#include <algorithm>
+
 #include "common/config.h"
 #include "glog/logging.h"
 #include "page/bitmap_page.h"
 
+thread_local Transaction *BufferPoolManager::cur_txn_ = nullptr;
+thread_local page_id_t BufferPoolManager::smo_end_page_ = INVALID_PAGE_ID;
 
-BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager)
+BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager,
+                                     REPLACER_TYPE replacer_type)
     : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
   pages_ = new Page[pool_size_];
-  latch_.lock();
-  if(CUR_REPLACER_TYPE == LRU)
-    replacer_ = new LRUReplacer(pool_size_);
-  else if(CUR_REPLACER_TYPE == LRU == CLOCK)
-    replacer_ = new ClockReplacer(pool_size_);
-  for (size_t i = 0; i < pool_size_; i++) {
-    free_list_.emplace_back(i);      
+  // a page can only use the frames of its own shard, so shards are kept large enough that one filling up
+  // while others have free frames is unlikely. a small pool is a single shard
+  num_shards_ = std::max<size_t>(1, std::min<size_t>(BUFFER_POOL_SHARD_NUM, pool_size_ / BUFFER_POOL_SHARD_MIN_FRAMES));
+  shards_ = new Shard[num_shards_];
+  size_t frame_begin = 0;
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard &shard = shards_[i];
+    shard.pool_size_ = pool_size_ / num_shards_ + (i < pool_size_ % num_shards_ ? 1 : 0);
+    shard.pages_ = pages_ + frame_begin;
+    shard.frames_ = new FrameMeta[shard.pool_size_];
+    shard.access_seqs_ = new std::atomic<uint64_t>[shard.pool_size_ * REPLACER_K]();
+    shard.page_table_ = new ConcurrentPageTable(shard.pool_size_);
+    frame_begin += shard.pool_size_;
+    if(replacer_type == LRU)
+      shard.replacer_ = new LRUReplacer(shard.pool_size_);
+    else if(replacer_type == CLOCK)
+      shard.replacer_ = new ClockReplacer(shard.pool_size_);
+    else if(replacer_type == LRU_K)
+      shard.replacer_ = new LRUKReplacer(shard.pool_size_, REPLACER_K);
+    for (size_t j = 0; j < shard.pool_size_; j++) {
+      shard.pages_[j].pin_count_ = FRAME_RESERVED;
+      shard.free_list_.emplace_back(j);
+    }
   }
-  hit_num = 0;
-  miss_num = 0;
-  latch_.unlock();
+  log_changes_ = true;
+  read_ahead_stop_ = false;
+  if (ENABLE_READ_AHEAD) read_ahead_thread_ = std::thread(&BufferPoolManager::ReadAheadWorker, this);
+  bg_writer_stop_ = false;
+  if (ENABLE_BG_WRITER) bg_writer_thread_ = std::thread(&BufferPoolManager::BackgroundWriter, this);
 }
 
 BufferPoolManager::~BufferPoolManager() {
-  latch_.lock();
+  if (read_ahead_thread_.joinable()) {
+    {
+      std::scoped_lock<std::mutex> lock(read_ahead_latch_);
+      read_ahead_stop_ = true;
+    }
+    read_ahead_cv_.notify_all();
+    read_ahead_thread_.join();
+  }
+  if (bg_writer_thread_.joinable()) {
+    {
+      std::scoped_lock<std::mutex> lock(bg_writer_latch_);
+      bg_writer_stop_ = true;
+    }
+    bg_writer_cv_.notify_all();
+    bg_writer_thread_.join();
+  }
   FlushAll();
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard &shard = shards_[i];
+    for (size_t j = 0; j < shard.pool_size_; j++) delete shard.frames_[j].old_data_;
+    delete[] shard.frames_;
+    delete[] shard.access_seqs_;
+    delete shard.page_table_;
+    delete shard.replacer_;
+  }
+  delete[] shards_;
   delete[] pages_;
-  delete replacer_;
-  latch_.unlock();
 }
 
-bool BufferPoolManager::FlushAll() {
-  latch_.lock();
-  for (auto page : page_table_) {
-    if (pages_[page.second].is_dirty_)
-      if (!FlushPage(page.first)) return false;
+bool BufferPoolManager::FlushAll() { return FlushDirtyPages(INVALID_LSN); }
+
+bool BufferPoolManager::FlushOldPages(lsn_t lsn) { return FlushDirtyPages(lsn); }
+
+bool BufferPoolManager::FlushDirtyPages(lsn_t rec_lsn_before) {
+  // 1. pin the dirty frames of all shards, the pins keep them in place without holding any shard latch
+  std::vector<std::pair<Shard *, frame_id_t>> frames;
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard &shard = shards_[i];
+    for (size_t j = 0; j < shard.pool_size_; j++) {
+      Page *p = shard.pages_ + j;
+      if (!p->is_dirty_) continue;
+      if (rec_lsn_before != INVALID_LSN) {
+        lsn_t rec_lsn = shard.frames_[j].rec_lsn_;
+        if (rec_lsn == INVALID_LSN || rec_lsn >= rec_lsn_before) continue;
+      }
+      if (!TryPin(p)) continue;
+      if (p->page_id_ == INVALID_PAGE_ID || !p->is_dirty_) {
+        UnpinFrame(shard, j, false);
+        continue;
+      }
+      frames.emplace_back(&shard, j);
+    }
   }
-  latch_.unlock();
-  return true;
+  // 2. take their images. Marked writing back, FlushPage and the background writer stay off them until they land
+  std::vector<PageData> images(frames.size());
+  std::vector<std::pair<page_id_t, const char *>> pages;
+  pages.reserve(frames.size());
+  for (size_t i = 0; i < frames.size(); i++) {
+    Shard &shard = *frames[i].first;
+    frame_id_t fid = frames[i].second;
+    Page *p = shard.pages_ + fid;
+    bool expected = false;
+    while (!shard.frames_[fid].writing_back_.compare_exchange_weak(expected, true)) {
+      expected = false;
+      std::this_thread::yield();
+    }
+    p->RLatch();
+    p->is_dirty_ = false;
+    HandOverRecLSN(shard.frames_[fid]);
+    memcpy(images[i].data_, p->data_, PAGE_SIZE);
+    p->RUnlatch();
+    pages.emplace_back(p->page_id_, images[i].data_);
+  }
+  // 3. write them in disk order, adjacent pages together
+  lsn_t max_lsn = INVALID_LSN;
+  for (auto &page : pages) max_lsn = std::max(max_lsn, MACH_READ_FROM(lsn_t, page.second + Page::OFFSET_LSN));
+  bool log_ok = !USING_LOG || log_manager_ == nullptr || log_manager_->WaitForFlushed(max_lsn) == DB_SUCCESS;
+  if (log_ok) disk_manager_->WritePages(pages);
+  for (auto &frame : frames) {
+    FrameMeta &meta = frame.first->frames_[frame.second];
+    // not written, the pages stay dirty for a later round
+    if (!log_ok) {
+      frame.first->pages_[frame.second].is_dirty_ = true;
+      meta.rec_lsn_ = meta.write_rec_lsn_.load();
+    }
+    meta.write_rec_lsn_ = INVALID_LSN;
+    meta.writing_back_ = false;
+    UnpinFrame(*frame.first, frame.second, false);
+  }
+  return log_ok;
 }
 
-Page *BufferPoolManager::FetchPage(page_id_t page_id, bool to_write) {
-  latch_.lock();
-  // the page is free ,you cannot fetch it!
-  if (IsPageFree(page_id)) 
-  {
-    latch_.unlock();
-    return nullptr;
+bool BufferPoolManager::TryPin(Page *p) {
+  int pin = p->pin_count_.load(std::memory_order_relaxed);
+  while (pin != FRAME_RESERVED) {
+    if (p->pin_count_.compare_exchange_weak(pin, pin + 1, std::memory_order_acquire)) return true;
   }
-  // 1.     Search the page table for the requested page (P).
-  // 1.1    If P exists, pin it and return it immediately.
-  frame_id_t fid;
-  auto it = page_table_.find(page_id);
-  bool is_free_frame = false;
-  if (it != page_table_.end()) {
-    frame_id_t fid = it->second;
+  return false;
+}
 
-    replacer_->Pin(fid);
-    Page *r = pages_ + fid;
-    ASSERT(r->page_id_ == page_id, "Inconsistent map!");
-    r->pin_count_ += 1;
-    hit_num++;
+void BufferPoolManager::WaitWriteBack(Shard &shard, frame_id_t fid) {
+  while (shard.frames_[fid].writing_back_.load(std::memory_order_acquire)) std::this_thread::yield();
+}
 
-    if(USING_LOG && to_write)
-    {
-      is_new_map_[page_id]=false;
-      if(is_new_map_.size()>1)
-      {
-        //cout<<"map size >= 2 after fetch page "<<r->page_id_<<", size = "<<is_new_map_.size()<<endl;
-        //ASSERT(false, "stop1");
-      }
+bool BufferPoolManager::WriteLogAhead(const char *page_data) {
+  if (!USING_LOG || log_manager_ == nullptr) return true;
+  return log_manager_->WaitForFlushed(MACH_READ_FROM(lsn_t, page_data + Page::OFFSET_LSN)) == DB_SUCCESS;
+}
 
-      char old_data[PAGE_SIZE];
-      memcpy(old_data, r->GetData(), PAGE_SIZE);
-      old_data_map_[page_id] = old_data;
+void BufferPoolManager::HandOverRecLSN(FrameMeta &meta) {
+  // in this order, a concurrent GetDirtyPageTable sees the rec lsn in at least one of them
+  meta.write_rec_lsn_ = meta.rec_lsn_.load();
+  meta.rec_lsn_ = INVALID_LSN;
+}
+
+void BufferPoolManager::GetDirtyPageTable(DirtyPageTable *dpt) {
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard &shard = shards_[i];
+    for (size_t j = 0; j < shard.pool_size_; j++) {
+      FrameMeta &meta = shard.frames_[j];
+      lsn_t rec_lsn = meta.rec_lsn_;
+      lsn_t write_rec_lsn = meta.write_rec_lsn_;
+      if (write_rec_lsn != INVALID_LSN && (rec_lsn == INVALID_LSN || write_rec_lsn < rec_lsn)) rec_lsn = write_rec_lsn;
+      if (rec_lsn == INVALID_LSN) continue;
+      // the page id and lsn are only informative, they may be read while the frame changes
+      Page &p = shard.pages_[j];
+      dpt->AddRecord(p.page_id_, MACH_READ_FROM(lsn_t, p.data_ + Page::OFFSET_LSN), rec_lsn);
     }
-    //latch accouding to write intention
-    if(to_write)
-    {
-      r->WLatch();
+  }
+}
+
+void BufferPoolManager::UnpinFrame(Shard &shard, frame_id_t fid, bool count_access) {
+  Page &p = shard.pages_[fid];
+  int pin = p.pin_count_.load(std::memory_order_relaxed);
+  while (pin > 0 && !p.pin_count_.compare_exchange_weak(pin, pin - 1, std::memory_order_release)) {
+  }
+  if (count_access) CountAccess(shard, fid);
+}
+
+void BufferPoolManager::CountAccess(Shard &shard, frame_id_t fid) {
+  // the n-th pending access keeps its sequence number in slot n % K, the slots hold the last K of them.
+  // a sync between the two steps sees the slot before the store, the access is replayed a little early then
+  uint64_t seq = shard.access_clock_.fetch_add(1, std::memory_order_relaxed) + 1;
+  int n = shard.frames_[fid].accesses_.fetch_add(1, std::memory_order_release);
+  shard.access_seqs_[fid * REPLACER_K + n % REPLACER_K].store(seq, std::memory_order_relaxed);
+}
+
+void BufferPoolManager::SyncReplacer(Shard &shard) {
+  shard.replay_.clear();
+  for (size_t i = 0; i < shard.pool_size_; i++) {
+    int accesses = shard.frames_[i].accesses_.exchange(0, std::memory_order_acquire);
+    if (accesses == 0) continue;
+    if (shard.pages_[i].pin_count_ != 0) {
+      // still in use, report the accesses when it is released
+      shard.frames_[i].accesses_.fetch_add(accesses, std::memory_order_relaxed);
+      continue;
     }
-    else
-    {
-      r->RLatch();
+    // up to K accesses for history based replacers
+    for (size_t j = 0; j < std::min<size_t>(accesses, REPLACER_K); j++) {
+      shard.replay_.emplace_back(shard.access_seqs_[i * REPLACER_K + j].load(std::memory_order_relaxed), i);
     }
- 
-    latch_.unlock();
-    return r;
   }
-  miss_num++;
-  // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
-  if (!free_list_.empty()) {
-    fid = free_list_.back();
-    free_list_.pop_back();
-    is_free_frame = true;
-  } else {
-    miss_num++;
-    if (!replacer_->Victim(&fid)) {
-      latch_.unlock();  
-      return nullptr;
-    }
+  std::sort(shard.replay_.begin(), shard.replay_.end());
+  // re-insert at each access, so that a frame counts as used at its last one
+  for (auto &access : shard.replay_) {
+    shard.replacer_->Pin(access.second);
+    shard.replacer_->Unpin(access.second);
   }
+}
 
-  Page *p = pages_ + fid;
-  //        Note that pages are always found from the free list first.
-  // 2.     If R is dirty, write it back to the disk.
-
-  // 3.     Delete R from the page table and insert P.
-  if (!is_free_frame) {
+bool BufferPoolManager::FindFreeFrame(Shard &shard, frame_id_t *fid) {
+  if (!shard.free_list_.empty()) {
+    *fid = shard.free_list_.back();
+    shard.free_list_.pop_back();
+    return true;
+  }
+  SyncReplacer(shard);
+  while (shard.replacer_->Victim(fid)) {
+    Page *p = shard.pages_ + *fid;
+    // the frame may have been pinned lock-free since it was unpinned, then it is not a victim.
+    // It comes back to the replacer through accesses_ once it is released.
+    // An internal pin does not count as an access, so leave one pending to bring the frame back in any case.
+    int expected = 0;
+    if (!p->pin_count_.compare_exchange_strong(expected, FRAME_RESERVED)) {
+      shard.frames_[*fid].accesses_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    // If R is dirty, write it back to the disk, then delete R from the page table.
+    // The background writer should have done it, wake it up as it falls behind.
     page_id_t old_pid = p->page_id_;
     ASSERT(old_pid != INVALID_PAGE_ID, "invalid page id");
+    WaitWriteBack(shard, *fid);
     p->WLatch();
-    if (p->is_dirty_) disk_manager_->WritePage(old_pid, p->data_);
+    if (p->is_dirty_) {
+      // it can not be written before its log, leave it and try the next victim
+      if (!WriteLogAhead(p->data_)) {
+        p->WUnlatch();
+        p->pin_count_ = 0;
+        shard.frames_[*fid].accesses_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      disk_manager_->WritePage(old_pid, p->data_);
+      if (bg_writer_thread_.joinable()) bg_writer_cv_.notify_one();
+    }
+    shard.frames_[*fid].rec_lsn_ = INVALID_LSN;
     p->WUnlatch();
-    it = page_table_.find(old_pid);
-    page_table_.erase(it);
+    shard.page_table_->Remove(old_pid);
+    p->page_id_ = INVALID_PAGE_ID;
+    shard.frames_[*fid].accesses_ = 0;
+    return true;
   }
-  p->WLatch();
-  page_table_[page_id] = fid;
-  // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  p->pin_count_ = 1;
-  p->is_dirty_ = 0;
-  p->page_id_ = page_id;
-  disk_manager_->ReadPage(page_id, p->data_);
-  p->WUnlatch();
-
-  if(USING_LOG && to_write)
-  {
-    is_new_map_[page_id] = false;
-    if(is_new_map_.size()>1)
-    {
-      //cout<<"map size >= 2 after fetch page "<<p->page_id_<<", size = "<<is_new_map_.size()<<endl;
-      //ASSERT(false, "stop2");
-    }
+  return false;
+}
 
-    char old_data[PAGE_SIZE];
-    memcpy(old_data, p->GetData(), PAGE_SIZE);
-    old_data_map_[page_id] = old_data;
-  }
+void BufferPoolManager::LatchPage(Shard &shard, frame_id_t fid, bool to_write, bool is_new) {
+  Page *p = shard.pages_ + fid;
   //latch accouding to write intention
   if(to_write)
   {
@@ -146,79 +271,148 @@ Page *BufferPoolManager::FetchPage(page_id_t page_id, bool to_write) {
     p->RLatch();
   }
 
-  latch_.unlock();
-  return p;
+  if(USING_LOG && to_write)
+  {
+    FrameMeta &meta = shard.frames_[fid];
+    if (meta.old_data_ == nullptr) meta.old_data_ = new PageData();
+    if(is_new)
+      memset(meta.old_data_->data_, 0, PAGE_SIZE);
+    else
+      memcpy(meta.old_data_->data_, p->GetData(), PAGE_SIZE);
+    meta.is_new_ = is_new;
+    meta.has_old_ = true;
+  }
 }
 
-Page *BufferPoolManager::NewPage(page_id_t &page_id) {
-  latch_.lock();
-
-  // 0.   Make sure you call AllocatePage!
-  // 1.   If all the pages in the buffer pool are pinned, return nullptr.
-  if (free_list_.size() == 0 && page_table_.size() == 0) 
-  {
-    latch_.unlock();
-    return nullptr;
+void BufferPoolManager::OnHit(Shard &shard, frame_id_t fid, BufferAccessStrategy *strategy) {
+  FrameMeta &meta = shard.frames_[fid];
+  uint32_t ring_id = meta.ring_id_.load(std::memory_order_relaxed);
+  // a page used outside its ring is not recycled by the scan that read it in
+  if (ring_id != 0 && (strategy == nullptr || ring_id != strategy->GetId())) {
+    meta.ring_id_ = 0;
+    ring_id = 0;
+  }
+  // a prefetched page joins the ring of its scan on first use, just like a page the scan read itself
+  if (meta.prefetched_.load(std::memory_order_relaxed) && meta.prefetched_.exchange(false) && ring_id != 0) {
+    strategy->AddPage(shard.pages_[fid].page_id_);
   }
-  // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
+}
+
+Page *BufferPoolManager::FetchPage(page_id_t page_id, bool to_write, BufferAccessStrategy *strategy) {
+  Shard &shard = GetShard(page_id);
+  // 1.     Search the page table for the requested page (P).
+  // 1.1    If P exists, pin it and return it immediately. No latch is taken on this path:
+  //        the mapping found is validated after pinning, since the frame may have been replaced in between.
   frame_id_t fid;
-  bool is_free_frame = false;
-  miss_num++;
-  if (!free_list_.empty()) {
-    fid = free_list_.back();
-    free_list_.pop_back();
-    is_free_frame = true;
-  } else {
-    if (!replacer_->Victim(&fid)) {
-      latch_.unlock();
-      return nullptr;
+  if (shard.page_table_->Find(page_id, &fid)) {
+    Page *r = shard.pages_ + fid;
+    if (TryPin(r)) {
+      if (r->page_id_ == page_id) {
+        shard.hit_num_++;
+        OnHit(shard, fid, strategy);
+        LatchPage(shard, fid, to_write, false);
+        return r;
+      }
+      UnpinFrame(shard, fid);
     }
   }
 
-  Page *p = pages_ + fid;
-  // 3.   Update P's metadata, zero out memory and add P to the page table.
+  // the page is free ,you cannot fetch it!
+  if (IsPageFree(page_id)) 
+  {
+    return nullptr;
+  }
+  shard.latch_.lock();
+  // 1.2    Search again under the shard latch, the lock-free lookup may miss a page being moved or loaded.
+  //        A reserved frame in the page table is being read in by read-ahead, wait for it outside the latch.
+  while (shard.page_table_->Find(page_id, &fid) && shard.pages_[fid].pin_count_ == FRAME_RESERVED) {
+    shard.latch_.unlock();
+    std::this_thread::yield();
+    shard.latch_.lock();
+  }
+  if (shard.page_table_->Find(page_id, &fid)) {
+    Page *r = shard.pages_ + fid;
+    ASSERT(r->page_id_ == page_id, "Inconsistent map!");
+    r->pin_count_++;
+    shard.hit_num_++;
+    // the pin keeps the frame in place, so the page latch is taken outside the shard latch
+    shard.latch_.unlock();
+    OnHit(shard, fid, strategy);
+    LatchPage(shard, fid, to_write, false);
+    return r;
+  }
+  shard.miss_num_++;
+  // 1.3    If P does not exist, find a replacement page (R) from either the free list or the replacer.
   //        Note that pages are always found from the free list first.
-  // 2.     If R is dirty, write it back to the disk.
+  if (!FindFreeFrame(shard, &fid)) {
+    shard.latch_.unlock();  
+    return nullptr;
+  }
 
-  // 3.     Delete R from the page table and insert P.
-  page_id_t newpage = disk_manager_->AllocatePage();
-  if (!is_free_frame) {
-    page_id_t old_pid = p->page_id_;
-    ASSERT(old_pid != INVALID_PAGE_ID, "invalid page id");
-    p->WLatch();
-    if (p->is_dirty_) disk_manager_->WritePage(old_pid, p->data_);
-    p->WUnlatch();
-    auto it = page_table_.find(old_pid);
-    page_table_.erase(it);
+  // 2.     Update P's metadata, read in the page content from disk.
+  Page *p = shard.pages_ + fid;
+  p->WLatch();
+  p->is_dirty_ = 0;
+  p->page_id_ = page_id;
+  disk_manager_->ReadPage(page_id, p->data_);
+  p->WUnlatch();
+  // 3.     Insert P to the page table, then publish it by pinning, and return a pointer to P.
+  shard.frames_[fid].ring_id_ = strategy ? strategy->GetId() : 0;
+  shard.frames_[fid].prefetched_ = false;
+  shard.page_table_->Insert(page_id, fid);
+  p->pin_count_.store(1, std::memory_order_release);
+
+  shard.latch_.unlock();
+  if (strategy != nullptr) strategy->AddPage(page_id);
+  LatchPage(shard, fid, to_write, false);
+  return p;
+}
+
+Page *BufferPoolManager::NewPage(page_id_t &page_id, AllocationHint *hint) {
+  // 0.   Make sure you call AllocatePage!
+  //      The page id decides which shard the page belongs to, so allocate it first.
+  page_id_t newpage = AllocatePage(hint);
+  Page *p = InstallNewPage(newpage);
+  // 3.   Set the page ID output parameter. Return a pointer to P.
+  if (p != nullptr) page_id = newpage;
+  return p;
+}
+
+Page *BufferPoolManager::NewPageAt(page_id_t page_id) {
+  if (!disk_manager_->AllocatePageAt(page_id)) return nullptr;
+  return InstallNewPage(page_id);
+}
+
+Page *BufferPoolManager::InstallNewPage(page_id_t newpage) {
+  Shard &shard = GetShard(newpage);
+  shard.latch_.lock();
+
+  // 1.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
+  //      If all the pages in the shard are pinned, return nullptr.
+  frame_id_t fid;
+  shard.miss_num_++;
+  if (!FindFreeFrame(shard, &fid)) {
+    shard.latch_.unlock();
+    DeallocatePage(newpage);
+    return nullptr;
   }
+
+  // 2.   Update P's metadata, zero out memory and add P to the page table.
+  Page *p = shard.pages_ + fid;
   p->WLatch();
-  p->pin_count_ = 1;
   p->is_dirty_ = 1;
   p->page_id_ = newpage;
   p->ResetMemory();
-  page_table_[newpage] = fid;
-  // 4.   Set the page ID output parameter. Return a pointer to P.
-  page_id = newpage;
   p->WUnlatch();
+  shard.frames_[fid].ring_id_ = 0;
+  shard.frames_[fid].prefetched_ = false;
+  shard.page_table_->Insert(newpage, fid);
+  p->pin_count_.store(1, std::memory_order_release);
   // ASSERT(page_id != 0,"Newing page 0");
 
-  if(USING_LOG)
-  {
-    is_new_map_[page_id] = true;
-    if(is_new_map_.size()>1)
-    {
-      //cout<<"map size >= 2 after new page "<<p->page_id_<<", size = "<<is_new_map_.size()<<endl;
-      //ASSERT(false, "stop3");
-    }
-    
-    char old_data[PAGE_SIZE];
-    memset(old_data, 0, PAGE_SIZE);
-    old_data_map_[page_id] = old_data;
-  }
+  shard.latch_.unlock();
   //new page has the intention to be written
-  p->WLatch();
-
-  latch_.unlock();
+  LatchPage(shard, fid, true, true);
   return p;
 }
 
@@ -226,164 +420,434 @@ bool BufferPoolManager::DeletePage(page_id_t page_id) {
   // 0.   Make sure you call DeallocatePage!
   // 1.   Search the page table for the requested page (P).
   // 1.   If P does not exist, return false.
-  latch_.lock();
-  auto it = page_table_.find(page_id);
-  if (it == page_table_.end()) {
+  Shard &shard = GetShard(page_id);
+  shard.latch_.lock();
+  frame_id_t fid;
+  if (!shard.page_table_->Find(page_id, &fid)) {
+    // bring the page in first (its content is needed by the delete log), without holding the shard latch
+    shard.latch_.unlock();
     Page *p = FetchPage(page_id, false);
     if(p==nullptr)
     {
-      latch_.unlock();
       return false;
     }
-    //disk_manager_->DeAllocatePage(page_id);
-    //return true;
     UnpinPage(page_id, false);
+    shard.latch_.lock();
+    if (!shard.page_table_->Find(page_id, &fid)) {
+      shard.latch_.unlock();
+      return false;
+    }
   }
-  it = page_table_.find(page_id);
-  ASSERT(it!=page_table_.end(), "not fetched!");
 
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
-  frame_id_t fid = it->second;
-  if (pages_[fid].pin_count_) {
-    ASSERT(0, "Delete page failed!");
-    latch_.unlock();
-    return false;
+  //      Internal pins (background writer, a lock-free fetch that raced with a replacement) and a read-ahead read
+  //      in flight are short, wait for them.
+  auto &p = shard.pages_[fid];
+  int expected = 0;
+  for (int retry = 0; !p.pin_count_.compare_exchange_strong(expected, FRAME_RESERVED); retry++) {
+    if (retry == MAX_DELETE_RETRY) {
+      ASSERT(0, "Delete page failed!");
+      shard.latch_.unlock();
+      return false;
+    }
+    shard.latch_.unlock();
+    std::this_thread::yield();
+    shard.latch_.lock();
+    if (!shard.page_table_->Find(page_id, &fid)) {
+      shard.latch_.unlock();
+      return false;
+    }
+    expected = 0;
   }
 
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
-  auto &p = pages_[fid];
+  WaitWriteBack(shard, fid);
   p.WLatch();
-  page_table_.erase(it);
-  disk_manager_->DeAllocatePage(p.page_id_);
-  p.pin_count_ = 0;
+  shard.page_table_->Remove(page_id);
+  DeallocatePage(page_id);
   p.is_dirty_ = 0;
   p.page_id_ = INVALID_PAGE_ID;
+  shard.frames_[fid].rec_lsn_ = INVALID_LSN;
   p.WUnlatch();
-  replacer_->Pin(fid);
-  free_list_.emplace_back(fid);
+  shard.replacer_->Remove(fid);
+  shard.frames_[fid].accesses_ = 0;
+  shard.free_list_.emplace_back(fid);
 
   //4. add log record
-  if(USING_LOG)
+  if(USING_LOG && log_changes_)
   {
     txn_id_t tid = cur_txn_==nullptr?INVALID_TXN_ID:cur_txn_->GetTid();
-    LogRecord* append_rec = new LogRecord(DELETE, log_manager_->GetMaxLSN()+1, tid, page_id, 
+    LogRecord* append_rec = new LogRecord(DELETE, INVALID_LSN, tid, page_id, 
         p.GetData(), nullptr, INVALID_EXTENT_ID, nullptr, nullptr);
     log_manager_->AddRecord(append_rec);
+    delete append_rec;
   }
 
-  latch_.unlock();
+  shard.latch_.unlock();
   return true;
 }
 
 bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty, bool sure) {
-  latch_.lock();
+  Shard &shard = GetShard(page_id);
   //std::cout<<"Unpin "<<page_id<<std::endl;
-  auto it = page_table_.find(page_id);
-  if (it == page_table_.end()) 
-  {
-    latch_.unlock();
-    return false;
+  // the caller holds a pin, so the mapping is stable and can be looked up lock-free
+  frame_id_t fid;
+  if (!shard.page_table_->Find(page_id, &fid) || shard.pages_[fid].page_id_ != page_id) {
+    std::scoped_lock<std::recursive_mutex> lock(shard.latch_);
+    if (!shard.page_table_->Find(page_id, &fid)) 
+    {
+      return false;
+    }
   }
-  frame_id_t fid = it->second;
-  Page &p = pages_[fid];
-  p.is_dirty_ |= is_dirty;
-  if (p.pin_count_) p.pin_count_--;
-  if (p.pin_count_ == 0) replacer_->Unpin(fid);
+  Page &p = shard.pages_[fid];
+  FrameMeta &meta = shard.frames_[fid];
+  if (is_dirty) p.is_dirty_ = true;
+  // a change redone from the log, the page lsn is the lsn of its record
+  if (USING_LOG && !log_changes_ && is_dirty && meta.rec_lsn_ == INVALID_LSN) meta.rec_lsn_ = p.GetLSN();
   
   //add log record
-  if(USING_LOG && is_dirty)
+  //a page written back unchanged gets no record, so that its lsn does not move past records not yet redone
+  //the old image is only valid while the frame is w-latched, check that before comparing against it
+  if(USING_LOG && log_changes_ && is_dirty) ASSERT(meta.has_old_, "Unpin not matched!");
+  if(USING_LOG && log_changes_ && is_dirty && (meta.is_new_ || memcmp(meta.old_data_->data_, p.GetData(), PAGE_SIZE) != 0))
   {
-    ASSERT(is_new_map_.find(page_id)!=is_new_map_.end(), "Unpin not matched!");
-    bool is_new_top = is_new_map_[page_id];
-    is_new_map_.erase(page_id);
-
-    ASSERT(old_data_map_.find(page_id)!=old_data_map_.end(), "Unpin not matched!");
-    char *old_data = old_data_map_[page_id].data_;
-    old_data_map_.erase(page_id);
-
     txn_id_t tid = cur_txn_==nullptr?INVALID_TXN_ID:cur_txn_->GetTid();
-    LogRecordType type = (is_new_top)?NEW:WRITE;
-    LogRecord* append_rec = new LogRecord(type, log_manager_->GetMaxLSN()+1, tid, page_id, 
-        old_data, p.GetData(), INVALID_EXTENT_ID, nullptr, nullptr);
-    log_manager_->AddRecord(append_rec);
+    // set before the record gets its lsn, so that a checkpoint that misses it also misses the record
+    if (meta.rec_lsn_ == INVALID_LSN) meta.rec_lsn_ = log_manager_->GetMaxLSN() + 1;
+    if (meta.is_new_ || log_manager_->NeedFullImage(page_id)) {
+      LogRecordType type = (meta.is_new_)?NEW:WRITE;
+      LogRecord* append_rec = new LogRecord(type, INVALID_LSN, tid, page_id, 
+          meta.old_data_->data_, p.GetData(), INVALID_EXTENT_ID, nullptr, nullptr);
+      p.SetLSN(log_manager_->AddRecord(append_rec));
+      delete append_rec;
+    } else {
+      // only the changed byte ranges
+      LogRecord* append_rec = new LogRecord(INVALID_LSN, tid, WRITE_DELTA);
+      append_rec->SetPid(page_id);
+      if (append_rec->SetDelta(meta.old_data_->data_, p.GetData())) p.SetLSN(log_manager_->AddRecord(append_rec));
+      delete append_rec;
+    }
+  }
+
+  //the structure modification ends with its last page, while the page is still latched
+  if (smo_end_page_ == page_id) {
+    smo_end_page_ = INVALID_PAGE_ID;
+    LogStructureChange(SMO_END);
   }
 
   //unlatch according to is_dirty. if not sure (variable for is_dirty), do wunlatch as well
   if(is_dirty || !sure)
   {
+    meta.has_old_ = false;
     p.WUnlatch();
   }
   else
   {
     p.RUnlatch();
   }
-  latch_.unlock();
+  UnpinFrame(shard, fid);
   return true;
 }
 
+void BufferPoolManager::BeginStructureChange() { LogStructureChange(SMO_BEGIN); }
+
+void BufferPoolManager::EndStructureChange(page_id_t last_page_id) {
+  if (last_page_id != INVALID_PAGE_ID) {
+    smo_end_page_ = last_page_id;
+    return;
+  }
+  LogStructureChange(SMO_END);
+}
+
+void BufferPoolManager::LogStructureChange(LogRecordType type) {
+  if (!USING_LOG || !log_changes_) return;
+  txn_id_t tid = cur_txn_ == nullptr ? INVALID_TXN_ID : cur_txn_->GetTid();
+  LogRecord rec(INVALID_LSN, tid, type);
+  log_manager_->AddRecord(&rec);
+}
+
 bool BufferPoolManager::FlushPage(page_id_t page_id) {
-  latch_.lock();
-  auto it = page_table_.find(page_id);
-  if (it == page_table_.end()) 
+  Shard &shard = GetShard(page_id);
+  std::scoped_lock<std::recursive_mutex> lock(shard.latch_);
+  frame_id_t fid;
+  if (!shard.page_table_->Find(page_id, &fid)) 
   {
-    latch_.unlock();
     return false;
   }
-  frame_id_t fid = it->second;
-  Page &p = pages_[fid];
+  Page &p = shard.pages_[fid];
+  // still being read in by read-ahead, nothing to write
+  if (p.pin_count_ == FRAME_RESERVED) return true;
+  // a background write of an older image must land before this one
+  WaitWriteBack(shard, fid);
+  if (!WriteLogAhead(p.data_)) return false;
   p.is_dirty_ = 0;
   disk_manager_->WritePage(page_id, p.data_);
-  latch_.unlock();
+  shard.frames_[fid].rec_lsn_ = INVALID_LSN;
   return true;
 }
 
-page_id_t BufferPoolManager::AllocatePage() {
-  latch_.lock();
-  int next_page_id = disk_manager_->AllocatePage();
-  latch_.unlock();
-  return next_page_id;
+void BufferPoolManager::RecyclePage(page_id_t page_id, uint32_t ring_id) {
+  Shard &shard = GetShard(page_id);
+  std::scoped_lock<std::recursive_mutex> lock(shard.latch_);
+  frame_id_t fid;
+  if (!shard.page_table_->Find(page_id, &fid) || shard.frames_[fid].ring_id_ != ring_id) return;
+  Page *p = shard.pages_ + fid;
+  int expected = 0;
+  if (!p->pin_count_.compare_exchange_strong(expected, FRAME_RESERVED)) return;
+  WaitWriteBack(shard, fid);
+  p->WLatch();
+  if (p->is_dirty_) {
+    // left in the pool if it can not be written before its log
+    if (!WriteLogAhead(p->data_)) {
+      p->WUnlatch();
+      p->pin_count_ = 0;
+      return;
+    }
+    disk_manager_->WritePage(page_id, p->data_);
+  }
+  p->is_dirty_ = 0;
+  shard.frames_[fid].rec_lsn_ = INVALID_LSN;
+  p->WUnlatch();
+  shard.page_table_->Remove(page_id);
+  p->page_id_ = INVALID_PAGE_ID;
+  shard.frames_[fid].accesses_ = 0;
+  shard.frames_[fid].ring_id_ = 0;
+  shard.frames_[fid].prefetched_ = false;
+  shard.replacer_->Remove(fid);
+  // the free list is used first, so the scan's next read lands in this frame
+  shard.free_list_.emplace_back(fid);
+}
+
+bool BufferPoolManager::WriteBackFrame(PageIOQueue *io_queue, Shard &shard, frame_id_t fid, PageData *image) {
+  Page *p = shard.pages_ + fid;
+  FrameMeta &meta = shard.frames_[fid];
+  // only unpinned frames: a pinned one is probably being modified and will be dirtied again
+  if (!p->is_dirty_ || p->pin_count_ != 0 || meta.writing_back_ || !TryPin(p)) return false;
+  // the pin keeps the page in place while its image is taken
+  meta.writing_back_ = true;
+  page_id_t page_id = p->page_id_;
+  if (page_id == INVALID_PAGE_ID || !p->is_dirty_) {
+    meta.writing_back_ = false;
+    UnpinFrame(shard, fid, false);
+    return false;
+  }
+  // writers set the dirty flag before releasing the write latch, so clearing it under the read latch loses nothing
+  p->RLatch();
+  p->is_dirty_ = false;
+  HandOverRecLSN(meta);
+  memcpy(image->data_, p->data_, PAGE_SIZE);
+  p->RUnlatch();
+  // from now on the frame may be replaced, but not before the write lands (see WaitWriteBack)
+  UnpinFrame(shard, fid, false);
+  if (!WriteLogAhead(image->data_)) {
+    p->is_dirty_ = true;
+    meta.rec_lsn_ = meta.write_rec_lsn_.load();
+    meta.write_rec_lsn_ = INVALID_LSN;
+    meta.writing_back_ = false;
+    return false;
+  }
+  disk_manager_->WritePageAsync(io_queue, page_id, image->data_, [&shard, fid](bool ok) {
+    FrameMeta &meta = shard.frames_[fid];
+    // keep the page dirty if the write failed, eviction or a later round will retry. The changes in the image are
+    // older than any made since, so their rec lsn covers both
+    if (!ok) {
+      shard.pages_[fid].is_dirty_ = true;
+      meta.rec_lsn_ = meta.write_rec_lsn_.load();
+    }
+    meta.write_rec_lsn_ = INVALID_LSN;
+    meta.writing_back_ = false;
+  });
+  return true;
+}
+
+void BufferPoolManager::BackgroundWriter() {
+  const size_t dirty_target = static_cast<size_t>(pool_size_ * BG_WRITER_DIRTY_RATIO);
+  std::vector<size_t> clock_hands(num_shards_, 0);
+  PageIOQueue *io_queue = disk_manager_->CreateIOQueue();
+  std::vector<PageData> images(BG_WRITER_MAX_PAGES);
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(bg_writer_latch_);
+      bg_writer_cv_.wait_for(lock, std::chrono::milliseconds(BG_WRITER_INTERVAL_MS));
+      if (bg_writer_stop_) break;
+    }
+    size_t dirty = 0;
+    for (size_t i = 0; i < num_shards_; i++) {
+      for (size_t j = 0; j < shards_[i].pool_size_; j++) dirty += shards_[i].pages_[j].is_dirty_;
+    }
+    if (dirty <= dirty_target) continue;
+    // trickle: write at most BG_WRITER_MAX_PAGES per round, spread over the shards with one clock hand each
+    size_t to_write = std::min<size_t>(dirty - dirty_target, BG_WRITER_MAX_PAGES);
+    size_t written = 0;
+    for (size_t i = 0; i < num_shards_ && written < to_write; i++) {
+      Shard &shard = shards_[i];
+      size_t quota = (to_write - written) / (num_shards_ - i) + 1;
+      for (size_t n = 0; n < shard.pool_size_ && quota > 0 && written < to_write; n++) {
+        size_t fid = clock_hands[i];
+        clock_hands[i] = (fid + 1) % shard.pool_size_;
+        if (WriteBackFrame(io_queue, shard, fid, &images[written])) {
+          written++;
+          quota--;
+        }
+      }
+    }
+    // the images are reused by the next round
+    io_queue->WaitAll();
+  }
+  delete io_queue;
+}
+
+void BufferPoolManager::Prefetch(page_id_t start_page_id, NextPageFn next_page_fn, size_t count, uint32_t ring_id) {
+  if (!read_ahead_thread_.joinable() || start_page_id == INVALID_PAGE_ID) return;
+  {
+    std::scoped_lock<std::mutex> lock(read_ahead_latch_);
+    // the reader is behind anyway, a late prefetch would only compete with the scan
+    if (read_ahead_queue_.size() >= MAX_PREFETCH_REQUESTS) return;
+    read_ahead_queue_.push_back({start_page_id, next_page_fn, count, ring_id});
+  }
+  read_ahead_cv_.notify_one();
+}
+
+void BufferPoolManager::ReadAheadWorker() {
+  PageIOQueue *io_queue = disk_manager_->CreateIOQueue();
+  std::vector<PrefetchRequest> chains;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(read_ahead_latch_);
+      read_ahead_cv_.wait(lock, [this, &chains] {
+        return read_ahead_stop_ || !read_ahead_queue_.empty() || !chains.empty();
+      });
+      if (read_ahead_stop_) break;
+      while (!read_ahead_queue_.empty() && chains.size() < MAX_PREFETCH_REQUESTS) {
+        chains.push_back(read_ahead_queue_.front());
+        read_ahead_queue_.pop_front();
+      }
+    }
+    // one page of every chain per round, the callbacks point into chains so it must not change until WaitAll
+    for (auto &chain : chains) PrefetchPage(io_queue, &chain);
+    io_queue->WaitAll();
+    chains.erase(std::remove_if(chains.begin(), chains.end(),
+                                [](const PrefetchRequest &chain) {
+                                  return chain.count_ == 0 || chain.start_page_id_ == INVALID_PAGE_ID;
+                                }),
+                 chains.end());
+  }
+  delete io_queue;
+}
+
+void BufferPoolManager::PrefetchPage(PageIOQueue *io_queue, PrefetchRequest *chain) {
+  while (chain->count_ > 0 && chain->start_page_id_ != INVALID_PAGE_ID) {
+    page_id_t page_id = chain->start_page_id_;
+    chain->count_--;
+    if (IsPageFree(page_id)) break;
+    Shard &shard = GetShard(page_id);
+    std::scoped_lock<std::recursive_mutex> lock(shard.latch_);
+    frame_id_t fid;
+    if (shard.page_table_->Find(page_id, &fid)) {
+      // being read in by another chain, that one goes on from here
+      if (shard.pages_[fid].pin_count_ == FRAME_RESERVED) break;
+      // a cached page cannot be replaced while the shard latch is held, just follow the chain
+      chain->start_page_id_ = chain->next_page_fn_(shard.pages_[fid].data_);
+      continue;
+    }
+    // leave the shard's frames to the foreground, the chain goes on in the next round
+    if (shard.prefetching_ >= std::max<size_t>(1, shard.pool_size_ / PREFETCH_SHARD_RATIO)) {
+      chain->count_++;
+      return;
+    }
+    if (!FindFreeFrame(shard, &fid)) break;
+    shard.prefetching_++;
+    Page *p = shard.pages_ + fid;
+    p->is_dirty_ = 0;
+    p->page_id_ = page_id;
+    FrameMeta &meta = shard.frames_[fid];
+    meta.ring_id_ = chain->ring_id_;
+    meta.prefetched_ = true;
+    shard.page_table_->Insert(page_id, fid);
+    // the next page is known once the read completes
+    chain->start_page_id_ = INVALID_PAGE_ID;
+    disk_manager_->ReadPageAsync(io_queue, page_id, p->data_,
+                                 [this, &shard, fid, chain](bool ok) { FinishPrefetch(shard, fid, ok, chain); });
+    return;
+  }
+  chain->start_page_id_ = INVALID_PAGE_ID;
+}
+
+void BufferPoolManager::FinishPrefetch(Shard &shard, frame_id_t fid, bool ok, PrefetchRequest *chain) {
+  Page *p = shard.pages_ + fid;
+  FrameMeta &meta = shard.frames_[fid];
+  std::scoped_lock<std::recursive_mutex> lock(shard.latch_);
+  shard.prefetching_--;
+  if (!ok) {
+    shard.page_table_->Remove(p->page_id_);
+    p->page_id_ = INVALID_PAGE_ID;
+    meta.ring_id_ = 0;
+    meta.prefetched_ = false;
+    shard.free_list_.emplace_back(fid);
+    chain->start_page_id_ = INVALID_PAGE_ID;
+    return;
+  }
+  // nobody can pin the frame yet, so the page is read without its latch
+  chain->start_page_id_ = chain->next_page_fn_(p->data_);
+  // not pinned, the pending access puts the frame into the replacer
+  meta.accesses_ = 0;
+  CountAccess(shard, fid);
+  p->pin_count_.store(0, std::memory_order_release);
+}
+
+page_id_t BufferPoolManager::AllocatePage(AllocationHint *hint) {
+  return disk_manager_->AllocatePage(hint);
 }
 
 void BufferPoolManager::DeallocatePage(page_id_t page_id) { 
-  latch_.lock();
   disk_manager_->DeAllocatePage(page_id); 
-  latch_.unlock();
 }
 
 bool BufferPoolManager::IsPageFree(page_id_t page_id) { 
-  latch_.lock();
-  bool ret = disk_manager_->IsPageFree(page_id); 
-  latch_.unlock();
-  return ret;
+  return disk_manager_->IsPageFree(page_id); 
 }
 
 // Only used for debug
 bool BufferPoolManager::CheckAllUnpinned() {
-  latch_.lock();
   bool res = true;
-  for (size_t i = 0; i < pool_size_; i++) {
-    if (pages_[i].pin_count_ != 0) {
-      res = false;
-      LOG(ERROR) << "frame " << i << " page " << pages_[i].page_id_ << " pin count:" << pages_[i].pin_count_ << endl;
-      //ASSERT(false ,"unpin error");
+  for (size_t i = 0; i < num_shards_; i++) {
+    Shard &shard = shards_[i];
+    for (size_t j = 0; j < shard.pool_size_; j++) {
+      // the background writer pins a frame only while copying it, that pin goes away by itself
+      if (shard.pages_[j].pin_count_ > 0 && !shard.frames_[j].writing_back_) {
+        res = false;
+        LOG(ERROR) << "shard " << i << " frame " << j << " page " << shard.pages_[j].page_id_ 
+                   << " pin count:" << shard.pages_[j].pin_count_ << endl;
+        //ASSERT(false ,"unpin error");
+      }
     }
   }
-  latch_.unlock();
   return res;
 }
 
+int BufferPoolManager::GetStackSize() {
+  int size = 0;
+  for (size_t i = 0; i < num_shards_; i++) {
+    for (size_t j = 0; j < shards_[i].pool_size_; j++) size += shards_[i].frames_[j].has_old_;
+  }
+  return size;
+}
+
 void BufferPoolManager::ResetCounter() {
-  latch_.lock();
-  hit_num = 0;
-  miss_num = 0;
-  latch_.unlock();
+  for (size_t i = 0; i < num_shards_; i++) {
+    shards_[i].hit_num_ = 0;
+    shards_[i].miss_num_ = 0;
+  }
 }
 
 double BufferPoolManager::get_hit_rate() {
-  latch_.lock();
-  if (hit_num + miss_num == 0) return 0;
-  double hit_rate = (double)(hit_num) / (hit_num + miss_num);
-  std::cout << "hit = " << hit_num << "  total = " << miss_num + hit_num << "  hit rate = " << hit_rate << endl;
-  latch_.unlock();
+  int hit = 0, miss = 0;
+  for (size_t i = 0; i < num_shards_; i++) {
+    hit += shards_[i].hit_num_;
+    miss += shards_[i].miss_num_;
+  }
+  if (hit + miss == 0) return 0;
+  double hit_rate = (double)(hit) / (hit + miss);
+  std::cout << "hit = " << hit << "  total = " << miss + hit << "  hit rate = " << hit_rate << endl;
   return hit_rate;
 }
@@ -0,0 +1,64 @@
+#include "buffer/concurrent_page_table.h"
+#include "common/macros.h"
+
+ConcurrentPageTable::ConcurrentPageTable(size_t max_entries) : size_(0) {
+  // keep the load factor under 1/2 so that probe sequences stay short
+  capacity_ = 1;
+  while (capacity_ < 2 * max_entries) capacity_ <<= 1;
+  mask_ = capacity_ - 1;
+  slots_ = new std::atomic<uint64_t>[capacity_];
+  for (size_t i = 0; i < capacity_; i++) slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+}
+
+ConcurrentPageTable::~ConcurrentPageTable() { delete[] slots_; }
+
+bool ConcurrentPageTable::Find(page_id_t page_id, frame_id_t *frame_id) const {
+  size_t i = Hash(page_id);
+  for (size_t n = 0; n < capacity_; n++, i = (i + 1) & mask_) {
+    uint64_t slot = slots_[i].load(std::memory_order_acquire);
+    if (slot == EMPTY_SLOT) return false;
+    if (PageOf(slot) == page_id) {
+      *frame_id = FrameOf(slot);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ConcurrentPageTable::Insert(page_id_t page_id, frame_id_t frame_id) {
+  ASSERT(size_ < capacity_ / 2, "Page table overflow.");
+  size_t i = Hash(page_id);
+  while (slots_[i].load(std::memory_order_relaxed) != EMPTY_SLOT) {
+    ASSERT(PageOf(slots_[i].load(std::memory_order_relaxed)) != page_id, "Page already mapped.");
+    i = (i + 1) & mask_;
+  }
+  slots_[i].store(Pack(page_id, frame_id), std::memory_order_release);
+  size_++;
+}
+
+bool ConcurrentPageTable::Remove(page_id_t page_id) {
+  size_t i = Hash(page_id);
+  while (true) {
+    uint64_t slot = slots_[i].load(std::memory_order_relaxed);
+    if (slot == EMPTY_SLOT) return false;
+    if (PageOf(slot) == page_id) break;
+    i = (i + 1) & mask_;
+  }
+  // backward shift: move every following entry whose home slot is not in (i, j] into the hole.
+  // The entry is copied before its old slot is cleared, so readers see it twice rather than never, except for a
+  // reader that already passed the hole, which gets a (harmless) false miss.
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask_;
+    uint64_t slot = slots_[j].load(std::memory_order_relaxed);
+    if (slot == EMPTY_SLOT) break;
+    size_t k = Hash(PageOf(slot));
+    bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+    if (stays) continue;
+    slots_[i].store(slot, std::memory_order_release);
+    i = j;
+  }
+  slots_[i].store(EMPTY_SLOT, std::memory_order_release);
+  size_--;
+  return true;
+}
@@ -0,0 +1,67 @@
+#include "buffer/lru_k_replacer.h"
+#include <cstring>
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k)
+    : num_frames_(num_pages), k_(k == 0 ? 1 : k), num_present_(0), current_ts_(0) {
+  present_ = new bool[num_frames_];
+  history_size_ = new size_t[num_frames_];
+  history_ = new uint64_t[num_frames_ * k_];
+  memset(present_, 0, sizeof(bool) * num_frames_);
+  memset(history_size_, 0, sizeof(size_t) * num_frames_);
+  memset(history_, 0, sizeof(uint64_t) * num_frames_ * k_);
+}
+
+LRUKReplacer::~LRUKReplacer() {
+  delete[] present_;
+  delete[] history_size_;
+  delete[] history_;
+}
+
+bool LRUKReplacer::Victim(frame_id_t *frame_id) {
+  if (!num_present_) return false;
+  frame_id_t victim = -1;
+  bool victim_inf = false;
+  uint64_t victim_ts = UINT64_MAX;
+  for (size_t i = 0; i < num_frames_; i++) {
+    if (!present_[i]) continue;
+    // the oldest remembered access is the K-th most recent one, or the first one if less than K
+    bool inf = history_size_[i] < k_;
+    uint64_t ts = history_size_[i] ? history_[i * k_ + history_size_[i] - 1] : 0;
+    if (victim == -1 || (inf && !victim_inf) || (inf == victim_inf && ts < victim_ts)) {
+      victim = i;
+      victim_inf = inf;
+      victim_ts = ts;
+    }
+  }
+  *frame_id = victim;
+  present_[victim] = false;
+  history_size_[victim] = 0;
+  num_present_--;
+  return true;
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  if (present_[frame_id]) {
+    present_[frame_id] = false;
+    num_present_--;
+  }
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  // record the access, dropping the oldest one if k are remembered
+  uint64_t *h = history_ + frame_id * k_;
+  size_t n = history_size_[frame_id] < k_ ? history_size_[frame_id] + 1 : k_;
+  memmove(h + 1, h, sizeof(uint64_t) * (n - 1));
+  h[0] = ++current_ts_;
+  history_size_[frame_id] = n;
+  if (present_[frame_id]) return;
+  num_present_++;
+  present_[frame_id] = true;
+}
+
+void LRUKReplacer::Remove(frame_id_t frame_id) {
+  Pin(frame_id);
+  history_size_[frame_id] = 0;
+}
+
+size_t LRUKReplacer::Size() { return num_present_; }
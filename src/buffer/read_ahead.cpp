@@ -0,0 +1,29 @@
+#include "buffer/read_ahead.h"
+#include "buffer/buffer_pool_manager.h"
+
+ReadAhead::ReadAhead(BufferPoolManager *buffer_pool_manager, NextPageFn next_page_fn, uint32_t ring_id)
+    : buffer_pool_manager_(buffer_pool_manager),
+      next_page_fn_(next_page_fn),
+      ring_id_(ring_id),
+      expected_page_id_(INVALID_PAGE_ID),
+      sequential_(0),
+      window_(READ_AHEAD_MIN_PAGES),
+      remaining_(0) {}
+
+void ReadAhead::OnPage(page_id_t page_id, page_id_t next_page_id) {
+  if (page_id == expected_page_id_) {
+    sequential_++;
+    if (remaining_ > 0) remaining_--;
+  } else {
+    // jumped somewhere else, start detecting again
+    sequential_ = 0;
+    window_ = READ_AHEAD_MIN_PAGES;
+    remaining_ = 0;
+  }
+  expected_page_id_ = next_page_id;
+  if (!ENABLE_READ_AHEAD || next_page_id == INVALID_PAGE_ID || sequential_ < READ_AHEAD_TRIGGER) return;
+  if (remaining_ > window_ / 2) return;
+  buffer_pool_manager_->Prefetch(next_page_id, next_page_fn_, window_, ring_id_);
+  remaining_ = window_;
+  window_ = std::min<size_t>(window_ * 2, READ_AHEAD_MAX_PAGES);
+}
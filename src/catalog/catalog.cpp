@@ -3,11 +3,13 @@
 #include <cstdint>
 #include "common/config.h"
 #include "common/dberr.h"
+#include "page/index_roots_page.h"
 #include "storage/table_iterator.h"
 
 void CatalogMeta::SerializeTo(char *buf) const {
   uint32_t *buf_int = reinterpret_cast<uint32_t *>(buf);
   *(buf_int++) = CATALOG_METADATA_MAGIC_NUM;
+  buf_int++;  // page lsn, left to the buffer pool
   *(buf_int++) = table_meta_pages_.size();
 
   *(buf_int++) = index_meta_pages_.size();
@@ -25,6 +27,7 @@ void CatalogMeta::SerializeTo(char *buf) const {
 CatalogMeta *CatalogMeta::DeserializeFrom(char *buf, MemHeap *heap) {
   uint32_t *buf_int = reinterpret_cast<uint32_t *>(buf);
   if (*(buf_int++) != CATALOG_METADATA_MAGIC_NUM) {return nullptr;}
+  buf_int++;  // page lsn
   CatalogMeta *res = new (heap->Allocate(sizeof(CatalogMeta)))(CatalogMeta);
   uint32_t num_table = *(buf_int++);
   uint32_t num_index = *(buf_int++);
@@ -42,7 +45,7 @@ CatalogMeta *CatalogMeta::DeserializeFrom(char *buf, MemHeap *heap) {
 }
 
 uint32_t CatalogMeta::GetSerializedSize() const {
-  uint32_t sz_magic = sizeof(CATALOG_METADATA_MAGIC_NUM);
+  uint32_t sz_magic = sizeof(CATALOG_METADATA_MAGIC_NUM) + sizeof(lsn_t);
   uint32_t sz_tablemap = table_meta_pages_.size() * (sizeof(page_id_t) + sizeof(table_id_t));
   uint32_t sz_indexmap = index_meta_pages_.size() * (sizeof(index_id_t) + sizeof(page_id_t));
   return sz_magic + sz_indexmap + sz_tablemap + 2 * sizeof(uint32_t);
@@ -50,10 +53,10 @@ uint32_t CatalogMeta::GetSerializedSize() const {
 
 CatalogMeta::CatalogMeta() {}
 CatalogManager::CatalogManager(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager,
-
-                               LogManager *log_manager, bool init) 
+                               VersionManager *version_manager, LogManager *log_manager, bool init)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
+      version_manager_(version_manager),
       log_manager_(log_manager),
       heap_(new UsedHeap()) {
   latch_.lock();
@@ -61,6 +64,14 @@ CatalogManager::CatalogManager(BufferPoolManager *buffer_pool_manager, LockManag
   Page *p;
   if (init) {
     catalog_meta_ = CatalogMeta::NewInstance(heap_);
+  } else if (USING_LOG) {
+    // checkpoints are fuzzy, the pages on disk are consistent only after recovery, which loads the catalog then
+    // (LoadFromBuffer)
+    catalog_meta_ = CatalogMeta::NewInstance(heap_);
+    next_table_id_ = 0;
+    next_index_id_ = 0;
+    latch_.unlock();
+    return;
   } else {
     p = buffer_pool_manager->FetchPage(CATALOG_META_PAGE_ID, false);
     if (p == nullptr) 
@@ -127,6 +138,16 @@ dberr_t CatalogManager::CreateTable(const string &table_name, TableSchema *schem
   // 1. Check if the table already exists.
   auto it = table_names_.find(table_name);
   if (it != table_names_.end()) {latch_.unlock(); return DB_TABLE_ALREADY_EXIST;}
+  for (auto &dropped : dropped_tables_) {
+    if (dropped.second.first->GetTableName() == table_name) {latch_.unlock(); return DB_TABLE_ALREADY_EXIST;}
+  }
+  // locked before the other sessions can find it, they do not use it before the transaction commits. a rollback
+  // drops it
+  table_id_t tid = next_table_id_;
+  if (txn != nullptr && lock_manager_ != nullptr && !lock_manager_->LockTable(txn, tid, LockMode::EXCLUSIVE)) {
+    latch_.unlock();
+    return DB_FAILED;
+  }
   // 2. Allocate table meta page.
   page_id_t meta_page_id;
   page_id_t first_page_id;
@@ -141,7 +162,8 @@ dberr_t CatalogManager::CreateTable(const string &table_name, TableSchema *schem
   // 3. create table heap
   buffer_pool_manager_->UnpinPage(first_page_id, true);
   Schema *table_schema = Schema::DeepCopySchema(schema, heap_);
-  TableHeap *table_heap = TableHeap::Create(buffer_pool_manager_, first_page_id, table_schema, log_manager_, lock_manager_, heap_);
+  TableHeap *table_heap = TableHeap::Create(buffer_pool_manager_, first_page_id, table_schema, log_manager_, lock_manager_,
+                                            version_manager_, heap_);
 
   if (table_heap == nullptr) {
     buffer_pool_manager_->DeletePage(meta_page_id);
@@ -149,8 +171,6 @@ dberr_t CatalogManager::CreateTable(const string &table_name, TableSchema *schem
     return DB_FAILED;
   }
   // 4. create table meta data.
-  table_id_t tid = next_table_id_;
-
   TableMetadata *table_meta = TableMetadata::Create(tid, table_name, table_heap->GetFirstPageId(), 0,
                                                     Schema::DeepCopySchema(schema, heap_), heap_);
                                                     
@@ -178,6 +198,12 @@ dberr_t CatalogManager::CreateTable(const string &table_name, TableSchema *schem
 
   // 6 .store result
   table_info = tinfo;
+  if (txn != nullptr) {
+    WriteRecord write{WriteRecord::Type::CREATE_TABLE};
+    write.table_ = first_page_id;
+    write.object_id_ = tid;
+    AddWrite(txn, std::move(write));
+  }
 
   FlushCatalogMetaPage();//flush to buffer
   latch_.unlock();
@@ -185,28 +211,53 @@ dberr_t CatalogManager::CreateTable(const string &table_name, TableSchema *schem
 }
 
 dberr_t CatalogManager::GetTable(const string &table_name, TableInfo *&table_info) {
-  latch_.lock();
+  latch_.lock_shared();
   auto it = table_names_.find(table_name);
-  if (it == table_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
+  if (it == table_names_.end()) {latch_.unlock_shared(); return DB_TABLE_NOT_EXIST;}
   auto it2 = tables_.find(it->second);
-  if (it2 == tables_.end()) {latch_.unlock(); return DB_FAILED;}
+  if (it2 == tables_.end()) {latch_.unlock_shared(); return DB_FAILED;}
   table_info = it2->second;
-  latch_.unlock();
+  latch_.unlock_shared();
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::GetTable(const table_id_t table_id, TableInfo *&table_info) {
+  latch_.lock_shared();
+  auto it = tables_.find(table_id);
+  if (it == tables_.end()) {latch_.unlock_shared(); return DB_TABLE_NOT_EXIST;}
+  table_info = it->second;
+  latch_.unlock_shared();
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::GetTableId(const string &table_name, table_id_t &table_id) {
+  latch_.lock_shared();
+  auto it = table_names_.find(table_name);
+  if (it == table_names_.end()) {latch_.unlock_shared(); return DB_TABLE_NOT_EXIST;}
+  table_id = it->second;
+  latch_.unlock_shared();
   return DB_SUCCESS;
 }
 
 dberr_t CatalogManager::GetTables(vector<TableInfo *> &tables) {
-  latch_.lock();
+  latch_.lock_shared();
   for (auto it1 = table_names_.begin(); it1 != table_names_.end(); it1++) {
     auto it2 = tables_.find(it1->second);
     if (it2 == tables_.end()) {
       ASSERT(0, "Table name map inconsistent with table id map.");
-      latch_.unlock();
+      latch_.unlock_shared();
       return DB_FAILED;
     }
     tables.push_back(it2->second);
   }
-  latch_.unlock();
+  latch_.unlock_shared();
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::GetTableNames(vector<string> &table_names) {
+  latch_.lock_shared();
+  for (auto &it : table_names_) table_names.push_back(it.first);
+  latch_.unlock_shared();
   return DB_SUCCESS;
 }
 
@@ -218,6 +269,13 @@ dberr_t CatalogManager::CreateIndex(const std::string &table_name, const string
   auto imap = index_names_.find(table_name);
   if (imap == index_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
   if (imap->second.find(index_name) != imap->second.end()) {latch_.unlock(); return DB_INDEX_ALREADY_EXIST;}
+  for (auto &dropped : dropped_indexes_) {
+    IndexInfo *info = dropped.second.first;
+    if (info->GetTableInfo()->GetTableName() == table_name && info->GetIndexName() == index_name) {
+      latch_.unlock();
+      return DB_INDEX_ALREADY_EXIST;
+    }
+  }
 
   // 1. Allocate index meta page
   page_id_t index_meta_pageid;
@@ -255,6 +313,12 @@ dberr_t CatalogManager::CreateIndex(const std::string &table_name, const string
   index_names_[table_name][index_name] = iid;
   indexes_[iid] = iinfo;
   next_index_id_ += 1;
+  if (txn != nullptr) {
+    WriteRecord write{WriteRecord::Type::CREATE_INDEX};
+    write.table_ = tinfo->GetTableHeap()->GetFirstPageId();
+    write.object_id_ = iid;
+    AddWrite(txn, std::move(write));
+  }
 
   FlushCatalogMetaPage();//flush to buffer
   latch_.unlock();
@@ -263,40 +327,39 @@ dberr_t CatalogManager::CreateIndex(const std::string &table_name, const string
 
 dberr_t CatalogManager::GetIndex(const std::string &table_name, const std::string &index_name,
                                  IndexInfo *&index_info) {
-  latch_.lock();
+  latch_.lock_shared();
   auto it1 = index_names_.find(table_name);
-  if (it1 == index_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
+  if (it1 == index_names_.end()) {latch_.unlock_shared(); return DB_TABLE_NOT_EXIST;}
   auto it2 = it1->second.find(index_name);
-  if (it2 == it1->second.end()) {latch_.unlock(); return DB_INDEX_NOT_FOUND;}
+  if (it2 == it1->second.end()) {latch_.unlock_shared(); return DB_INDEX_NOT_FOUND;}
   auto it3 = indexes_.find(it2->second);
-  if (it3 == indexes_.end()) {latch_.unlock(); return DB_FAILED;}  // index name map inconsistent with index id map
+  if (it3 == indexes_.end()) {latch_.unlock_shared(); return DB_FAILED;}  // index name map inconsistent with index id map
   index_info = it3->second;
-  latch_.unlock();
+  latch_.unlock_shared();
   return DB_SUCCESS;
 }
 
 dberr_t CatalogManager::GetTableIndexes(const std::string &table_name, std::vector<IndexInfo *> &indexes) {
-  latch_.lock();
+  latch_.lock_shared();
   indexes.clear();
   auto it1 = index_names_.find(table_name);
-  if (it1 == index_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
+  if (it1 == index_names_.end()) {latch_.unlock_shared(); return DB_TABLE_NOT_EXIST;}
   for (auto it2 = it1->second.begin(); it2 != it1->second.end(); it2++) {
     auto it3 = indexes_.find(it2->second);
-    if (it3 == indexes_.end()) {latch_.unlock(); return DB_FAILED;}  // index name map inconsistent with index id map
+    if (it3 == indexes_.end()) {latch_.unlock_shared(); return DB_FAILED;}  // index name map inconsistent with index id map
     indexes.push_back(it3->second);
   }
-  latch_.unlock();
+  latch_.unlock_shared();
   return DB_SUCCESS;
 }
 
-dberr_t CatalogManager::DropTable(const string &table_name) {
+dberr_t CatalogManager::DropTable(const string &table_name, Transaction *txn) {
   latch_.lock();
   // 1. check if the table exists.
   auto it1 = table_names_.find(table_name);
   if (it1 == table_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
-  auto it2 = tables_.find(it1->second);
-  if (it2 == tables_.end()) {latch_.unlock(); return DB_FAILED;} // name map inconsistent with id map
   table_id_t tid = it1->second;
+  if (tables_.find(tid) == tables_.end()) {latch_.unlock(); return DB_FAILED;} // name map inconsistent with id map
 
   // 2. drop all indexes on this table
   auto it3 = index_names_.find(table_name);
@@ -307,135 +370,217 @@ dberr_t CatalogManager::DropTable(const string &table_name) {
       drop_index_names.push_back(it4->first);
     }
     for (string drop_index_name : drop_index_names) {
-      dberr_t err = DropIndex(table_name, drop_index_name);
+      dberr_t err = RemoveIndex(table_name, drop_index_name, txn);
       if (err != DB_SUCCESS) {latch_.unlock(); return err;}
     }
+    // 2.1 and then drop the entry on index name map
+    index_names_.erase(table_name);
   }
 
-  // 2.1 and then drop the entry on index name map
-  index_names_.erase(it3);
-
-  // 3.drop this table
-  // 3.1 drop all table pages on the table heap
-  TableInfo *tinfo = it2->second;
-  tinfo->~TableInfo();
-  ASSERT(tinfo, "Invaid table info ");
-  tinfo->GetTableHeap()->FreeHeap();
-  heap_->Free(tinfo);
-  auto &tmap = catalog_meta_->table_meta_pages_;
-  auto it5 = tmap.find(tid);
-  if (it5 == tmap.end()) {latch_.unlock(); return DB_FAILED;}
-  page_id_t tmeta_pid = it5->second;
-  if (!buffer_pool_manager_->DeletePage(tmeta_pid)) {latch_.unlock(); return DB_FAILED;}
-  // 4. update catalog meta
-  tmap.erase(it5);
-  table_names_.erase(it1);
-  tables_.erase(it2);
+  // 3. drop this table, its pages are freed at commit if a transaction drops it
+  TableInfo *tinfo;
+  page_id_t tmeta_pid;
+  dberr_t err = DetachTable(tid, tinfo, tmeta_pid);
+  if (err != DB_SUCCESS) {latch_.unlock(); return err;}
+  if (txn == nullptr) {
+    FreeTable(tinfo, tmeta_pid);
+  } else {
+    dropped_tables_[tid] = std::make_pair(tinfo, tmeta_pid);
+    WriteRecord write{WriteRecord::Type::DROP_TABLE};
+    write.table_ = tinfo->GetTableHeap()->GetFirstPageId();
+    write.object_id_ = tid;
+    write.meta_page_ = tmeta_pid;
+    AddWrite(txn, std::move(write));
+  }
 
   FlushCatalogMetaPage();//flush to buffer
   latch_.unlock();
   return DB_SUCCESS;
 }
 
-dberr_t CatalogManager::DropIndex(const string &table_name, const string &index_name) {
+dberr_t CatalogManager::DropIndex(const string &table_name, const string &index_name, Transaction *txn) {
   latch_.lock();
+  dberr_t err = RemoveIndex(table_name, index_name, txn);
+  if (err == DB_SUCCESS) FlushCatalogMetaPage();  // flush to buffer
+  latch_.unlock();
+  return err;
+}
+
+dberr_t CatalogManager::RemoveIndex(const string &table_name, const string &index_name, Transaction *txn) {
   // 1. check if index exist
   auto it1 = index_names_.find(table_name);
-  if (it1 == index_names_.end()) {latch_.unlock(); return DB_TABLE_NOT_EXIST;}
+  if (it1 == index_names_.end()) return DB_TABLE_NOT_EXIST;
   auto it2 = it1->second.find(index_name);
-  if (it2 == it1->second.end()) {latch_.unlock(); return DB_INDEX_NOT_FOUND;}
+  if (it2 == it1->second.end()) return DB_INDEX_NOT_FOUND;
   index_id_t iid = it2->second;
-  auto it3 = indexes_.find(iid);
-  if (it3 == indexes_.end()) {latch_.unlock(); return DB_FAILED;}
-  IndexInfo *info = it3->second;
-  ASSERT(info, "Invalid index info");
-
-  // 2. drop the whole index
-  info->GetIndex()->Destroy();
-  info->~IndexInfo();
-  heap_->Free(info);
-  // 3. drop index meta data
+
+  // 2. drop the index, its pages are freed at commit if a transaction drops it
+  IndexInfo *info;
+  page_id_t imeta_pid;
+  dberr_t err = DetachIndex(iid, info, imeta_pid);
+  if (err != DB_SUCCESS) return err;
+  if (txn == nullptr) {
+    FreeIndex(info, imeta_pid);
+  } else {
+    dropped_indexes_[iid] = std::make_pair(info, imeta_pid);
+    WriteRecord write{WriteRecord::Type::DROP_INDEX};
+    write.table_ = info->GetTableInfo()->GetTableHeap()->GetFirstPageId();
+    write.object_id_ = iid;
+    write.meta_page_ = imeta_pid;
+    AddWrite(txn, std::move(write));
+  }
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::DetachTable(const table_id_t table_id, TableInfo *&table_info, page_id_t &meta_page_id) {
+  auto it1 = tables_.find(table_id);
+  if (it1 == tables_.end()) return DB_TABLE_NOT_EXIST;
+  auto &tmap = catalog_meta_->table_meta_pages_;
+  auto it2 = tmap.find(table_id);
+  if (it2 == tmap.end()) return DB_FAILED;
+  table_info = it1->second;
+  ASSERT(table_info, "Invaid table info ");
+  meta_page_id = it2->second;
+  table_names_.erase(table_info->GetTableName());
+  tables_.erase(it1);
+  tmap.erase(it2);
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::DetachIndex(const index_id_t index_id, IndexInfo *&index_info, page_id_t &meta_page_id) {
+  auto it1 = indexes_.find(index_id);
+  if (it1 == indexes_.end()) return DB_INDEX_NOT_FOUND;
   auto &imap = catalog_meta_->index_meta_pages_;
-  auto it4 = imap.find(iid);
-  if (it4 == imap.end()) {latch_.unlock(); return DB_FAILED;}
-  page_id_t imeta_pid = it4->second;
-  //buffer_pool_manager_->UnpinPage(imeta_pid, false);
-  if (!buffer_pool_manager_->DeletePage(imeta_pid)) {latch_.unlock(); return DB_FAILED;}
-  // 4. update catalog meta data
-  imap.erase(it4);
-  it1->second.erase(it2);
-  indexes_.erase(it3);
+  auto it2 = imap.find(index_id);
+  if (it2 == imap.end()) return DB_FAILED;
+  index_info = it1->second;
+  ASSERT(index_info, "Invalid index info");
+  meta_page_id = it2->second;
+  auto names = index_names_.find(index_info->GetTableInfo()->GetTableName());
+  if (names != index_names_.end()) names->second.erase(index_info->GetIndexName());
+  indexes_.erase(it1);
+  imap.erase(it2);
+  return DB_SUCCESS;
+}
 
-  FlushCatalogMetaPage();//flush to buffer
-  latch_.unlock();
+dberr_t CatalogManager::AttachTable(const table_id_t table_id, const page_id_t meta_page_id) {
+  auto dropped = dropped_tables_.find(table_id);
+  if (dropped != dropped_tables_.end()) {
+    TableInfo *tinfo = dropped->second.first;
+    table_names_[tinfo->GetTableName()] = table_id;
+    tables_[table_id] = tinfo;
+    index_names_[tinfo->GetTableName()] = {};
+    dropped_tables_.erase(dropped);
+  } else {
+    dberr_t err = LoadTable(table_id, meta_page_id);
+    if (err != DB_SUCCESS) return err;
+  }
+  catalog_meta_->table_meta_pages_[table_id] = meta_page_id;
+  if (next_table_id_ <= table_id) next_table_id_ = table_id + 1;
+  return DB_SUCCESS;
+}
+
+dberr_t CatalogManager::AttachIndex(const index_id_t index_id, const page_id_t meta_page_id) {
+  auto dropped = dropped_indexes_.find(index_id);
+  if (dropped != dropped_indexes_.end()) {
+    IndexInfo *info = dropped->second.first;
+    index_names_[info->GetTableInfo()->GetTableName()][info->GetIndexName()] = index_id;
+    indexes_[index_id] = info;
+    dropped_indexes_.erase(dropped);
+  } else {
+    dberr_t err = LoadIndex(index_id, meta_page_id);
+    if (err != DB_SUCCESS) return err;
+  }
+  catalog_meta_->index_meta_pages_[index_id] = meta_page_id;
+  if (next_index_id_ <= index_id) next_index_id_ = index_id + 1;
   return DB_SUCCESS;
 }
 
+void CatalogManager::FreeTable(TableInfo *table_info, const page_id_t meta_page_id) {
+  // drop all table pages on the table heap
+  table_info->GetTableHeap()->FreeHeap();
+  table_info->~TableInfo();
+  heap_->Free(table_info);
+  buffer_pool_manager_->DeletePage(meta_page_id);
+}
+
+void CatalogManager::FreeIndex(IndexInfo *index_info, const page_id_t meta_page_id) {
+  // drop the whole index
+  index_info->GetIndex()->Destroy();
+  index_info->~IndexInfo();
+  heap_->Free(index_info);
+  buffer_pool_manager_->DeletePage(meta_page_id);
+}
+
+void CatalogManager::AddWrite(Transaction *txn, WriteRecord write) {
+  if (log_manager_ != nullptr)
+    log_manager_->AddWrite(txn, std::move(write));
+  else
+    txn->AddWrite(std::move(write));
+}
+
+void CatalogManager::Compensate(Transaction *txn, const WriteRecord &write) {
+  if (log_manager_ != nullptr && write.lsn_ != INVALID_LSN) log_manager_->AddCompensation(txn, write.lsn_);
+}
+
+TableInfo *CatalogManager::GetTableByHeap(page_id_t first_page_id) {
+  for (auto &it : tables_) {
+    if (it.second->GetTableHeap()->GetFirstPageId() == first_page_id) return it.second;
+  }
+  return nullptr;
+}
+
 dberr_t CatalogManager::FlushCatalogMetaPage() {
-  latch_.lock();
   Page *p = buffer_pool_manager_->FetchPage(CATALOG_META_PAGE_ID, true);
   catalog_meta_->SerializeTo(p->GetData());
-  if (!buffer_pool_manager_->UnpinPage(CATALOG_META_PAGE_ID, true)) {latch_.unlock(); return DB_FAILED;}
-  latch_.unlock();
+  if (!buffer_pool_manager_->UnpinPage(CATALOG_META_PAGE_ID, true)) return DB_FAILED;
   return DB_SUCCESS;
 }
 
 dberr_t CatalogManager::LoadTable(const table_id_t table_id, const page_id_t page_id) {
-  latch_.lock();
   // loading a table is nothing more than loading the table info and adding it to the maps
   Page *p_tmeta = buffer_pool_manager_->FetchPage(page_id, false);
-  if (p_tmeta == nullptr) {latch_.unlock(); return DB_FAILED;}
+  if (p_tmeta == nullptr) return DB_FAILED;
   TableMetadata *tmeta;
   TableInfo *tinfo = TableInfo::Create(heap_);
   TableMetadata::DeserializeFrom(p_tmeta->GetData(), tmeta, tinfo->GetMemHeap());
   buffer_pool_manager_->UnpinPage(page_id, false);
-  if (tmeta == nullptr) {latch_.unlock(); return DB_FAILED;}
-  if (tinfo == nullptr) {latch_.unlock(); return DB_FAILED;}
+  if (tmeta == nullptr) return DB_FAILED;
+  if (tinfo == nullptr) return DB_FAILED;
   Schema *scm = Schema::DeepCopySchema(tmeta->GetSchema(), tinfo->GetMemHeap());
   TableHeap *theap =
-      TableHeap::Create(buffer_pool_manager_, tmeta->GetFirstPageId(), scm, log_manager_, lock_manager_, tinfo->GetMemHeap());
-  if (theap == nullptr) {latch_.unlock(); return DB_FAILED;}
+      TableHeap::Create(buffer_pool_manager_, tmeta->GetFirstPageId(), scm, log_manager_, lock_manager_,
+                        version_manager_, tinfo->GetMemHeap());
+  if (theap == nullptr) return DB_FAILED;
   tinfo->Init(tmeta, theap);
   table_names_[tinfo->GetTableName()] = tinfo->GetTableId();
   tables_[tinfo->GetTableId()] = tinfo;
 
   auto it = index_names_.find(tinfo->GetTableName());
   if (it == index_names_.end()) index_names_[tinfo->GetTableName()] = {};
-  latch_.unlock(); 
   return DB_SUCCESS;
 }
 
 dberr_t CatalogManager::LoadIndex(const index_id_t index_id, const page_id_t page_id) {
-  latch_.lock();
   // much the same as loadTable
   Page *p_meta = buffer_pool_manager_->FetchPage(page_id, false);
-  if (p_meta == nullptr) {latch_.unlock(); return DB_FAILED;}
+  if (p_meta == nullptr) return DB_FAILED;
   IndexMetadata *meta;
   IndexInfo *info = IndexInfo::Create(heap_);
   IndexMetadata::DeserializeFrom(p_meta->GetData(), meta, info->GetMemHeap());
   buffer_pool_manager_->UnpinPage(page_id, false);
-  if (meta == nullptr) {latch_.unlock(); return DB_FAILED;}
-  if (info == nullptr) {latch_.unlock(); return DB_FAILED;}
+  if (meta == nullptr) return DB_FAILED;
+  if (info == nullptr) return DB_FAILED;
   table_id_t tid = meta->GetTableId();
   if (tables_.find(tid) == tables_.end()) return DB_FAILED;
   TableInfo *tinfo = tables_[tid];
-  if (!tinfo) {latch_.unlock(); return DB_FAILED;}
+  if (!tinfo) return DB_FAILED;
   info->Init(meta, tinfo, buffer_pool_manager_);
   string tname = tinfo->GetTableName();
   string iname = info->GetIndexName();
   if (index_names_.find(tname) == index_names_.end()) index_names_[tname] = {};
   index_names_[tname][iname] = index_id;
   indexes_[index_id] = info;
-  latch_.unlock(); 
-  return DB_SUCCESS;
-}
-
-dberr_t CatalogManager::GetTable(const table_id_t table_id, TableInfo *&table_info) {
-  latch_.lock();
-  auto it2 = tables_.find(table_id);
-  if (it2 == tables_.end()) {latch_.unlock(); return DB_FAILED;}  // name map inconsistent with id map
-  table_info = it2->second;
-  latch_.unlock(); 
   return DB_SUCCESS;
 }
 
@@ -449,20 +594,34 @@ dberr_t CatalogManager::SetRowNum(table_id_t tid, uint32_t row_num)
     return DB_FAILED;
   }
   tables_[tid]->SetRowNum(row_num);
+  dberr_t res = FlushTableMetaPage(tid);
+  latch_.unlock(); 
+  return res;
+}
 
-  //write table meta page
-  Page* table_meta_page;
-  page_id_t table_meta_page_id = catalog_meta_->table_meta_pages_[tid];
-  if (!(table_meta_page = buffer_pool_manager_->FetchPage(table_meta_page_id, true))) {latch_.unlock(); return DB_FAILED;}
-  tables_[tid]->table_meta_->SerializeTo(table_meta_page->GetData());
-  buffer_pool_manager_->UnpinPage(table_meta_page_id, true);
-  if (tables_[tid]->table_meta_ == nullptr) {
-    tables_[tid]->table_heap_->FreeHeap();
-    buffer_pool_manager_->DeletePage(table_meta_page_id);
+dberr_t CatalogManager::AdjustRowNum(table_id_t tid, int32_t delta)
+{
+  latch_.lock();
+  //read and write the row number under the same latch, a concurrent change is not lost
+  if(tables_.find(tid)==tables_.end())
+  {
     latch_.unlock(); 
     return DB_FAILED;
   }
+  tables_[tid]->SetRowNum(tables_[tid]->GerRowNum() + delta);
+  dberr_t res = FlushTableMetaPage(tid);
   latch_.unlock(); 
+  return res;
+}
+
+dberr_t CatalogManager::FlushTableMetaPage(const table_id_t table_id)
+{
+  //write table meta page
+  Page* table_meta_page;
+  page_id_t table_meta_page_id = catalog_meta_->table_meta_pages_[table_id];
+  if (!(table_meta_page = buffer_pool_manager_->FetchPage(table_meta_page_id, true))) return DB_FAILED;
+  tables_[table_id]->table_meta_->SerializeTo(table_meta_page->GetData());
+  buffer_pool_manager_->UnpinPage(table_meta_page_id, true);
   return DB_SUCCESS;
 }
 
@@ -499,6 +658,170 @@ dberr_t CatalogManager::LoadFromBuffer()
     LoadIndex(it->first, it->second);
     if (next_index_id_ <= it->first) next_index_id_ = it->first + 1;
   }
+  // an index dropped by a transaction that committed just before a crash may not have been freed, its root is still
+  // kept. the new indexes do not take its id, they would find its tree
+  p = buffer_pool_manager_->FetchPage(INDEX_ROOTS_PAGE_ID, false);
+  if (p != nullptr) {
+    index_id_t max_index_id;
+    if (reinterpret_cast<IndexRootsPage *>(p->GetData())->GetMaxIndexId(&max_index_id) && next_index_id_ <= max_index_id)
+      next_index_id_ = max_index_id + 1;
+    buffer_pool_manager_->UnpinPage(INDEX_ROOTS_PAGE_ID, false);
+  }
   latch_.unlock();  
   return DB_SUCCESS;
-}
\ No newline at end of file
+}
+
+// the key of the row in the index, with the row id of the row
+static Row IndexKey(IndexInfo *iinfo, const Row &row, MemHeap *heap) {
+  vector<Field> key_fields;
+  for (uint32_t i = 0; i < iinfo->GetIndexKeySchema()->GetColumnCount(); i++) {
+    key_fields.push_back(*row.GetField(iinfo->GetIndexKeySchema()->GetColumn(i)->GetTableInd()));
+  }
+  Row key(key_fields, heap);
+  key.SetRowId(row.GetRowId());
+  return key;
+}
+
+void CatalogManager::CommitWrites(Transaction *txn, const std::unordered_set<page_id_t> *freed) {
+  for (auto &write : txn->GetWrites()) {
+    switch (write.type_) {
+      case WriteRecord::Type::DELETE: {
+        latch_.lock_shared();
+        TableInfo *tinfo = GetTableByHeap(write.table_);
+        latch_.unlock_shared();
+        // not found if the transaction dropped the table, it is freed as a whole
+        if (tinfo != nullptr) tinfo->GetTableHeap()->ApplyDelete(write.rid_, txn);
+        break;
+      }
+      case WriteRecord::Type::DROP_TABLE: {
+        latch_.lock();
+        auto dropped = dropped_tables_.find(write.object_id_);
+        if (dropped != dropped_tables_.end()) {
+          FreeTable(dropped->second.first, dropped->second.second);
+          dropped_tables_.erase(dropped);
+        } else if (freed != nullptr) {
+          // at recovery the table is not loaded, what is left of it is found from its pages
+          TableHeap::FreePages(buffer_pool_manager_, write.table_, freed);
+          if (freed->count(write.meta_page_) == 0) buffer_pool_manager_->DeletePage(write.meta_page_);
+        }
+        latch_.unlock();
+        break;
+      }
+      case WriteRecord::Type::DROP_INDEX: {
+        latch_.lock();
+        auto dropped = dropped_indexes_.find(write.object_id_);
+        if (dropped != dropped_indexes_.end()) {
+          FreeIndex(dropped->second.first, dropped->second.second);
+          dropped_indexes_.erase(dropped);
+        } else if (freed != nullptr) {
+          // the pages keep their key size, the tree is destroyed without its schema
+          BPlusTree tree(write.object_id_, buffer_pool_manager_, IndexKeyComparator(nullptr), 0, 0, 0);
+          tree.Destroy(freed);
+          if (freed->count(write.meta_page_) == 0) buffer_pool_manager_->DeletePage(write.meta_page_);
+        }
+        latch_.unlock();
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  txn->ClearWrites();
+}
+
+// the tuples are still locked by the transaction, the index entries are found by their keys (all indexes are unique).
+// undone from the newest write back, each finds the tuple and the catalog as the write left them. what is already
+// undone is skipped
+void CatalogManager::RollbackWrites(Transaction *txn) {
+  SimpleMemHeap heap;
+  vector<WriteRecord> &writes = txn->GetWrites();
+  for (auto write = writes.rbegin(); write != writes.rend(); write++) {
+    if (write->type_ == WriteRecord::Type::CREATE_TABLE || write->type_ == WriteRecord::Type::DROP_TABLE ||
+        write->type_ == WriteRecord::Type::CREATE_INDEX || write->type_ == WriteRecord::Type::DROP_INDEX) {
+      latch_.lock();
+      switch (write->type_) {
+        case WriteRecord::Type::CREATE_TABLE: {
+          auto it = tables_.find(write->object_id_);
+          if (it != tables_.end()) {
+            string table_name = it->second->GetTableName();
+            // its indexes were created after it, they are gone by now
+            index_names_.erase(table_name);
+            TableInfo *tinfo;
+            page_id_t tmeta_pid;
+            if (DetachTable(write->object_id_, tinfo, tmeta_pid) == DB_SUCCESS) FreeTable(tinfo, tmeta_pid);
+          }
+          break;
+        }
+        case WriteRecord::Type::DROP_TABLE:
+          if (tables_.find(write->object_id_) == tables_.end()) AttachTable(write->object_id_, write->meta_page_);
+          break;
+        case WriteRecord::Type::CREATE_INDEX: {
+          IndexInfo *info;
+          page_id_t imeta_pid;
+          if (DetachIndex(write->object_id_, info, imeta_pid) == DB_SUCCESS) FreeIndex(info, imeta_pid);
+          break;
+        }
+        case WriteRecord::Type::DROP_INDEX:
+          if (indexes_.find(write->object_id_) == indexes_.end()) AttachIndex(write->object_id_, write->meta_page_);
+          break;
+        default:
+          break;
+      }
+      FlushCatalogMetaPage();
+      latch_.unlock();
+      Compensate(txn, *write);
+      continue;
+    }
+    latch_.lock_shared();
+    TableInfo *tinfo = GetTableByHeap(write->table_);
+    latch_.unlock_shared();
+    if (tinfo == nullptr) continue;
+    TableHeap *table_heap = tinfo->GetTableHeap();
+    vector<IndexInfo *> iinfos;
+    GetTableIndexes(tinfo->GetTableName(), iinfos);
+    Row row(write->rid_, &heap);
+    switch (write->type_) {
+      case WriteRecord::Type::INSERT:
+        if (!table_heap->GetTuple(&row, nullptr)) break;
+        for (auto iinfo : iinfos) {
+          Row key = IndexKey(iinfo, row, &heap);
+          iinfo->GetIndex()->RemoveEntry(key, key.GetRowId(), txn);
+        }
+        table_heap->ApplyDelete(write->rid_, txn);
+        AdjustRowNum(tinfo->GetTableId(), -1);
+        break;
+      case WriteRecord::Type::DELETE:
+        table_heap->RollbackDelete(write->rid_, txn);
+        if (table_heap->GetTuple(&row, nullptr)) {
+          for (auto iinfo : iinfos) {
+            Row key = IndexKey(iinfo, row, &heap);
+            iinfo->GetIndex()->InsertEntry(key, key.GetRowId(), txn);
+          }
+        }
+        AdjustRowNum(tinfo->GetTableId(), 1);
+        break;
+      case WriteRecord::Type::UPDATE: {
+        if (!table_heap->GetTuple(&row, nullptr)) break;
+        Row old_row(write->rid_, &heap);
+        old_row.DeserializeFrom(write->image_.data(), tinfo->GetSchema());
+        table_heap->RollbackUpdate(old_row, txn);  // may move the tuple
+        for (auto iinfo : iinfos) {
+          Row key = IndexKey(iinfo, row, &heap);
+          Row old_key = IndexKey(iinfo, old_row, &heap);
+          bool key_changed = !(old_key.GetRowId() == key.GetRowId());
+          for (uint32_t i = 0; i < key.GetFieldCount() && !key_changed; i++) {
+            if (key.GetField(i)->CompareEquals(*old_key.GetField(i)) != CmpBool::kTrue) key_changed = true;
+          }
+          if (!key_changed) continue;
+          iinfo->GetIndex()->RemoveEntry(key, key.GetRowId(), txn);
+          iinfo->GetIndex()->InsertEntry(old_key, old_key.GetRowId(), txn);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    Compensate(txn, *write);
+  }
+  txn->ClearWrites();
+}
@@ -11,6 +11,7 @@ IndexMetadata *IndexMetadata::Create(const index_id_t index_id, const string &in
 uint32_t IndexMetadata::SerializeTo(char *buf) const {
   uint32_t *ibuf = reinterpret_cast<uint32_t *>(buf);
   *(ibuf++) = INDEX_METADATA_MAGIC_NUM;
+  ibuf++;  // page lsn, left to the buffer pool
   *(ibuf++) = index_id_;
   char *cbuf = reinterpret_cast<char *>(ibuf);
   for (size_t i = 0; i < index_name_.size(); i++) *(cbuf++) = index_name_[i];
@@ -24,7 +25,7 @@ uint32_t IndexMetadata::SerializeTo(char *buf) const {
 }
 
 uint32_t IndexMetadata::GetSerializedSize() const {
-  uint32_t sz_magic = sizeof(INDEX_METADATA_MAGIC_NUM);
+  uint32_t sz_magic = sizeof(INDEX_METADATA_MAGIC_NUM) + sizeof(lsn_t);
   uint32_t sz_indexid = sizeof(index_id_);
   uint32_t sz_name = index_name_.length() + 1;
   uint32_t sz_tableid = sizeof(table_id_);
@@ -36,6 +37,7 @@ uint32_t IndexMetadata::DeserializeFrom(char *buf, IndexMetadata *&index_meta, M
   uint32_t *ibuf = reinterpret_cast<uint32_t *>(buf);
   if (*(ibuf++) != INDEX_METADATA_MAGIC_NUM) return 0;
   // this is a valid index meta data
+  ibuf++;  // page lsn
   index_id_t index_id_ = *(ibuf++);
   char *cbuf = reinterpret_cast<char *>(ibuf);
   string index_name_(cbuf);
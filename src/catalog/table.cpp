@@ -4,6 +4,7 @@
 uint32_t TableMetadata::SerializeTo(char *buf) const {
   uint32_t *ibuf = reinterpret_cast<uint32_t *>(buf);
   *(ibuf++) = TABLE_METADATA_MAGIC_NUM;
+  ibuf++;  // page lsn, left to the buffer pool
   *(ibuf++) = table_id_;
   char *cbuf = reinterpret_cast<char *>(ibuf);
   for (size_t i = 0; i < table_name_.size(); i++) *(cbuf++) = table_name_[i];
@@ -17,7 +18,7 @@ uint32_t TableMetadata::SerializeTo(char *buf) const {
 }
 
 uint32_t TableMetadata::GetSerializedSize() const {
-  return sizeof(TABLE_METADATA_MAGIC_NUM) + sizeof(table_id_) + table_name_.size() + 1 + sizeof(row_num_) + sizeof(root_page_id_) +
+  return sizeof(TABLE_METADATA_MAGIC_NUM) + sizeof(lsn_t) + sizeof(table_id_) + table_name_.size() + 1 + sizeof(row_num_) + sizeof(root_page_id_) +
          schema_->GetSerializedSize();
 }
 
@@ -28,6 +29,7 @@ uint32_t TableMetadata::DeserializeFrom(char *buf, TableMetadata *&table_meta, M
   uint32_t *ibuf = reinterpret_cast<uint32_t *>(buf);
   if (*(ibuf++) != TABLE_METADATA_MAGIC_NUM) return 0;
   // else this is a valid table meta page
+  ibuf++;  // page lsn
 
   table_id_t table_id_ = *(ibuf++);
   char *cbuf = reinterpret_cast<char *>(ibuf);
@@ -0,0 +1,162 @@
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "common/config.h"
+#include "server/protocol.h"
+
+using namespace std;
+
+//client [socket path]: run the statements typed, or piped into stdin, on a JetSQL server
+//piped statements are sent without waiting for the responses, which are printed in order as they come
+int Connect(const char* socket_path);
+bool ReadStatement(string& statement);
+bool IsQuit(const string& statement);
+void PrintResponse(ResponseStatus status, const string& output);
+void SystemCommand(const string& cmd);
+
+int main(int argc, char** argv)
+{
+  const char* socket_path = argc > 1 ? argv[1] : SERVER_SOCKET_FILENAME;
+  int fd = Connect(socket_path);
+  if (fd < 0)
+    return 1;
+
+  bool interactive = isatty(STDIN_FILENO);
+  thread receiver;
+  if (!interactive)
+  {
+    receiver = thread([fd] {
+      ResponseStatus status;
+      string output;
+      while (RecvResponse(fd, &status, &output))
+        PrintResponse(status, output);
+    });
+  }
+  else
+    cout << "\nWelcome to use JetSQL! (server: " << socket_path << ")" << endl;
+
+  string statement;
+  while (true)
+  {
+    if (interactive)
+      cout << "\nJetSQL > " << flush;
+    if (!ReadStatement(statement))
+      break;
+    if (statement[0] == '-')
+    {
+      SystemCommand(statement);
+      continue;
+    }
+    auto stm_start = chrono::steady_clock::now();
+    if (!SendFrame(fd, statement))
+    {
+      cout << "[Exception]: Connection to the server closed!" << endl;
+      break;
+    }
+    if (interactive)
+    {
+      ResponseStatus status;
+      string output;
+      if (!RecvResponse(fd, &status, &output))
+      {
+        cout << "[Exception]: Connection to the server closed!" << endl;
+        break;
+      }
+      chrono::duration<double> run_time = chrono::steady_clock::now() - stm_start;
+      cout << output;
+      if (status == ResponseStatus::SUCCESS)
+        printf("[Success]: (run time: %.3f sec)\n", run_time.count());
+      else
+        printf("[Failure]: SQL statement executed failed!\n");
+    }
+    if (IsQuit(statement))
+      break;
+  }
+
+  //the server answers what was sent, then sees the end of the session
+  shutdown(fd, SHUT_WR);
+  if (receiver.joinable())
+    receiver.join();
+  close(fd);
+  if (interactive)
+    printf("\n[Quit]: Thanks for using JetSQL, bye!\n");
+  return 0;
+}
+
+int Connect(const char* socket_path)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path))
+  {
+    cout << "[Exception]: Socket path \"" << socket_path << "\" is too long!" << endl;
+    return -1;
+  }
+  strcpy(addr.sun_path, socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    cout << "[Exception]: Can not connect to the server at \"" << socket_path << "\": " << strerror(errno) << endl;
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool ReadStatement(string& statement)
+{
+  //up to the next ';', without the blanks before it. false at the end of input
+  if (!getline(cin, statement, ';'))
+    return false;
+  size_t start = statement.find_first_not_of(" \t\r\n");
+  if (start == string::npos)
+    return ReadStatement(statement);
+  statement = statement.substr(start) + ";";
+  return !cin.eof();
+}
+
+bool IsQuit(const string& statement)
+{
+  string word;
+  for (char ch : statement)
+  {
+    if (ch == ';' || isspace(ch))
+      break;
+    word.push_back(tolower(ch));
+  }
+  return word == "quit";
+}
+
+void PrintResponse(ResponseStatus status, const string& output)
+{
+  cout << output;
+  if (status == ResponseStatus::SUCCESS)
+    printf("[Success]\n");
+  else
+    printf("[Failure]: SQL statement executed failed!\n");
+  fflush(stdout);
+}
+
+void SystemCommand(const string& cmd)
+{
+  if (cmd == "-clear;")
+    system("clear");
+  else if (cmd == "-help;")
+  {
+    cout << "SQL command: Surpport basic SQL. Please refer to ReadMe.md" << endl;
+    cout << "System command (begin with '-', end with ';'): \n"
+      "-clear; : clear the screen\n"
+      "-help; : check help message\n" << endl;
+  }
+  else
+    cout << "[Error]: Unknown system command \"" + cmd + "\" !" << endl;
+}
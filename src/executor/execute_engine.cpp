@@ -7,13 +7,16 @@ extern int row_des_count;
 std::unordered_map<std::string, Thread_Share> global_SharedMap; //thread-shared diskMgr, BPMgr, logMgr for dbs
 std::recursive_mutex global_parsetree_latch;
 std::recursive_mutex global_shared_latch;
-std::recursive_mutex global_exe_latch;
+std::atomic<uint32_t> ExecuteEngine::session_num_(0);
 
 //#define ENABLE_EXECUTE_DEBUG
 ExecuteEngine::ExecuteEngine(string engine_meta_file_name, int thread_id) {
   // get existed database from meta file
 
   thread_id_ = thread_id;
+  // counted under the shared latch, a database is not dropped while another session is opened (see DropDatabase)
+  std::scoped_lock<std::recursive_mutex> shared_lock(global_shared_latch);
+  session_num_++;
   engine_meta_file_name_ = engine_meta_file_name;
   engine_meta_io_.open(engine_meta_file_name_, std::ios::in);
   if (!engine_meta_io_.is_open()) {
@@ -50,10 +53,21 @@ dberr_t ExecuteEngine::Execute(pSyntaxNode ast, ExecuteContext *context) {
   if (ast == nullptr) {
     return DB_FAILED;
   }
-  if(USING_EXE_LATCH  && ast->type_!=kNodeExecFile)
-    global_exe_latch.lock();
+  //the sessions keep their statements apart by the table and row locks of their transactions. without a lock manager
+  //the statements on the database take its statement latch instead: the reads together, the others alone
+  bool on_database = ast->type_!=kNodeCreateDB && ast->type_!=kNodeDropDB && ast->type_!=kNodeShowDB
+    && ast->type_!=kNodeUseDB && ast->type_!=kNodeExecFile && ast->type_!=kNodeQuit;
+  std::shared_lock<std::shared_mutex> read_latch;
+  std::unique_lock<std::shared_mutex> write_latch;
+  if(on_database && current_db_ != "" && dbs_[current_db_]->lock_mgr_ == nullptr)
+  {
+    if(ast->type_==kNodeSelect || ast->type_==kNodeShowTables || ast->type_==kNodeShowIndexes)
+      read_latch = std::shared_lock<std::shared_mutex>(*dbs_[current_db_]->stmt_latch_);
+    else
+      write_latch = std::unique_lock<std::shared_mutex>(*dbs_[current_db_]->stmt_latch_);
+  }
 
-  if(current_db_ != "")
+  if(current_db_ != "" && session_num_ == 1)
   {
     dbs_[current_db_]->bpm_->CheckAllUnpinned();
     //txn = dbs_[current_db_]->txn_mgr_->Begin();
@@ -130,15 +144,49 @@ dberr_t ExecuteEngine::Execute(pSyntaxNode ast, ExecuteContext *context) {
     default:
       break;
   }
-  
-  if(USING_LOG && is_single_transaction)
-    ExecuteTrxCommit(ast, context);
-  
-  if(USING_EXE_LATCH && ast->type_!=kNodeExecFile)
-    global_exe_latch.unlock();
+
+  if(context->txn_ != nullptr && context->txn_->GetState() == TransactionState::ABORTED)
+  {
+    //chosen as a deadlock victim while waiting for a lock
+    context->output_ += "[Error]: Deadlock detected, transaction rolled back!\n";
+    ExecuteTrxRollback(ast, context);
+    ret = DB_FAILED;
+  }
+  else if(USING_LOG && is_single_transaction)
+    ret = ExecuteTrxCommit(ast, context);
   return ret;
 }
 
+void ExecuteEngine::EndSession(ExecuteContext *context) {
+  if (context->txn_ == nullptr) return;
+  ExecuteTrxRollback(nullptr, context);
+}
+
+pSyntaxNode ParseStatement(const char *sql, std::string *error) {
+  std::scoped_lock<std::recursive_mutex> lock(global_parsetree_latch);
+  // create buffer for sql input
+  YY_BUFFER_STATE bp = yy_scan_string(sql);
+  if (bp == nullptr) {
+    LOG(ERROR) << "Failed to create yy buffer state." << std::endl;
+    exit(1);
+  }
+  yy_switch_to_buffer(bp);
+  MinisqlParserInit();
+  yyparse();
+
+  pSyntaxNode root_node = nullptr;
+  if (MinisqlParserGetError())
+    *error = MinisqlParserGetErrorMessage();
+  else
+    root_node = CopySyntaxTree(MinisqlGetParserRootNode());
+
+  // clean memory after parse
+  MinisqlParserFinish();
+  yy_delete_buffer(bp);
+  yylex_destroy();
+  return root_node;
+}
+
 //--------------------------------Database----------------------------------------------------
 dberr_t ExecuteEngine::ExecuteCreateDatabase(pSyntaxNode ast, ExecuteContext *context) {
 #ifdef ENABLE_EXECUTE_DEBUG
@@ -146,7 +194,10 @@ dberr_t ExecuteEngine::ExecuteCreateDatabase(pSyntaxNode ast, ExecuteContext *co
 #endif
   // step 1: check if the database already exist
   string db_name = ast->child_->val_;
-  if (dbs_.find(db_name) != dbs_.end())  // database already exists
+  global_shared_latch.lock();
+  bool is_shared = global_SharedMap.find(db_name) != global_SharedMap.end();  // created by another session
+  global_shared_latch.unlock();
+  if (dbs_.find(db_name) != dbs_.end() || is_shared)  // database already exists
   {
     context->output_ += "[Error]: Database \"" + db_name + "\" already exists!\n";
     return DB_FAILED;
@@ -172,7 +223,7 @@ dberr_t ExecuteEngine::ExecuteCreateDatabase(pSyntaxNode ast, ExecuteContext *co
     context->output_ += "[Exception]: Page flushed failed!\n";
     return DB_FAILED;
   }
-  if(!new_engine->disk_mgr_->FlushAllMeta())
+  if(!new_engine->disk_mgr_->FlushAllMeta() || !new_engine->disk_mgr_->Sync())
   {
     context->output_ += "[Exception]: Disk meta flushed failed!\n";
     return DB_FAILED;
@@ -200,12 +251,16 @@ dberr_t ExecuteEngine::ExecuteDropDatabase(pSyntaxNode ast, ExecuteContext *cont
     context->output_ += "[Error]: Database \"" + db_name + "\" not exists!\n";
     return DB_FAILED;
   }
+  // the other sessions share its components and run their statements without a latch, they must be gone
+  std::scoped_lock<std::recursive_mutex> shared_lock(global_shared_latch);
+  if (session_num_ > 1) {
+    context->output_ += "[Error]: Database \"" + db_name + "\" is used by other sessions!\n";
+    return DB_FAILED;
+  }
 
   // step 2: update the executor database engine array
   string db_file_name = dbs_.find(db_name)->second->db_file_name_;
-  string db_log_file_name;
-  if(USING_LOG)
-    db_log_file_name = dbs_.find(db_name)->second->log_mgr_->GetLogFileName();
+  LogManager *db_log_mgr = dbs_.find(db_name)->second->log_mgr_;
   delete dbs_.find(db_name)->second;
   dbs_.erase(db_name);
   if (db_name == current_db_) current_db_ = "";
@@ -217,8 +272,8 @@ dberr_t ExecuteEngine::ExecuteDropDatabase(pSyntaxNode ast, ExecuteContext *cont
     return DB_FAILED;
   }
   if(USING_LOG)
-    if (remove(db_log_file_name.c_str()) != 0) {
-      context->output_ += "[Exception]: Database log \"" + db_log_file_name + "\" removed failed!\n";
+    if (!db_log_mgr->RemoveFiles()) {
+      context->output_ += "[Exception]: Database log \"" + db_log_mgr->GetLogFileName() + "\" removed failed!\n";
       return DB_FAILED;
     }
 
@@ -236,13 +291,13 @@ dberr_t ExecuteEngine::ExecuteDropDatabase(pSyntaxNode ast, ExecuteContext *cont
   engine_meta_io_.close();
 
   //step5: delete shared_sources when .db file is removed
-  global_shared_latch.lock();
+  delete global_SharedMap[db_name].txnMgr_;
   delete global_SharedMap[db_name].cataMgr_;
   delete global_SharedMap[db_name].BPMgr_;
   delete global_SharedMap[db_name].diskMgr_;
   delete global_SharedMap[db_name].logMgr_;
+  delete global_SharedMap[db_name].stmtLatch_;
   global_SharedMap.erase(db_name);
-  global_shared_latch.unlock();
 
   return DB_SUCCESS;
 }
@@ -270,12 +325,19 @@ dberr_t ExecuteEngine::ExecuteUseDatabase(pSyntaxNode ast, ExecuteContext *conte
 #ifdef ENABLE_EXECUTE_DEBUG
   LOG(INFO) << "ExecuteUseDatabase" << std::endl;
 #endif
-  // step 1: check existence
+  // step 1: check existence, a database created by another session is opened here as well
   string db_name = ast->child_->val_;
-  if (dbs_.find(db_name) == dbs_.end())  // database not exists
+  if (dbs_.find(db_name) == dbs_.end())
   {
-    context->output_ += "[Error]: Database \"" + db_name + "\" not exists!\n";
-    return DB_FAILED;
+    global_shared_latch.lock();
+    bool is_shared = global_SharedMap.find(db_name) != global_SharedMap.end();
+    global_shared_latch.unlock();
+    if (!is_shared)  // database not exists
+    {
+      context->output_ += "[Error]: Database \"" + db_name + "\" not exists!\n";
+      return DB_FAILED;
+    }
+    dbs_.insert(make_pair(db_name, new DBStorageEngine(db_name, false)));
   }
 
   // step 2: alter current_db
@@ -293,8 +355,15 @@ dberr_t ExecuteEngine::ExecuteShowTables(pSyntaxNode ast, ExecuteContext *contex
     context->output_ += "[Error]: No database used!\n";
     return DB_FAILED;
   }
+  // each table is locked, it is not dropped while it is shown
+  vector<string> table_names;
+  dbs_[current_db_]->catalog_mgr_->GetTableNames(table_names);
   vector<TableInfo *> tables;
-  dbs_[current_db_]->catalog_mgr_->GetTables(tables);
+  for (auto &table_name : table_names) {
+    TableInfo *tinfo;
+    if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_SHARED)) return DB_FAILED;
+    tables.push_back(tinfo);
+  }
   if (tables.empty()) {
     context->output_ += "No table in database \"" + current_db_ + "\" yet!\n";
     return DB_SUCCESS;
@@ -402,7 +471,10 @@ dberr_t ExecuteEngine::ExecuteCreateTable(pSyntaxNode ast, ExecuteContext *conte
   TableInfo *tinfo;  // not uesed?
 
   // step 3: create the table using catalog
-  dberr_t ret = dbs_[current_db_]->catalog_mgr_->CreateTable(table_name, schema.get(), nullptr, tinfo);
+  dberr_t ret = dbs_[current_db_]->catalog_mgr_->CreateTable(table_name, schema.get(), context->txn_, tinfo);
+  if (ret == DB_TABLE_ALREADY_EXIST)  // dropped by a running transaction
+    context->output_ += "[Error]: Table \"" + table_name + "\" already exists!\n";
+  if (ret != DB_SUCCESS) return ret;
 
   // step 4: create index on primary key if exists
   if (ast != nullptr) {
@@ -461,8 +533,9 @@ dberr_t ExecuteEngine::ExecuteDropTable(pSyntaxNode ast, ExecuteContext *context
     context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
     return DB_TABLE_NOT_EXIST;
   }
+  if (!LockTable(context, table_name, tinfo_1, LockMode::EXCLUSIVE)) return DB_FAILED;
 
-  return dbs_[current_db_]->catalog_mgr_->DropTable(table_name);
+  return dbs_[current_db_]->catalog_mgr_->DropTable(table_name, context->txn_);
 }
 
 //--------------------------------Index---------------------------------------------------
@@ -475,8 +548,15 @@ dberr_t ExecuteEngine::ExecuteShowIndexes(pSyntaxNode ast, ExecuteContext *conte
     context->output_ += "[Error]: No database used!\n";
     return DB_FAILED;
   }
+  // each table is locked, it is not dropped while it is shown
+  vector<string> table_names;
+  dbs_[current_db_]->catalog_mgr_->GetTableNames(table_names);
   vector<TableInfo *> tables;
-  dbs_[current_db_]->catalog_mgr_->GetTables(tables);
+  for (auto &table_name : table_names) {
+    TableInfo *tinfo;
+    if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_SHARED)) return DB_FAILED;
+    tables.push_back(tinfo);
+  }
   if (tables.empty()) {
     context->output_ += "No table in database \"" + current_db_ + "\" yet!\n";
     return DB_SUCCESS;
@@ -527,13 +607,16 @@ dberr_t ExecuteEngine::ExecuteCreateIndex(pSyntaxNode ast, ExecuteContext *conte
     key = key->next_;
   }
 
-  // step 4: check table and index existence
-  IndexInfo *iinfo;
-  dberr_t res = dbs_[current_db_]->catalog_mgr_->GetIndex(table_name, index_name, iinfo);
-  if (res == DB_TABLE_NOT_EXIST) {
+  // step 4: check table and index existence, the table is locked before its indexes are looked at
+  TableInfo *tinfo;
+  if (dbs_[current_db_]->catalog_mgr_->GetTable(table_name, tinfo) != DB_SUCCESS) {
     context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
     return DB_TABLE_NOT_EXIST;
-  } else if (res == DB_SUCCESS) {
+  }
+  if (!LockTable(context, table_name, tinfo, LockMode::EXCLUSIVE)) return DB_FAILED;
+  IndexInfo *iinfo;
+  dberr_t res = dbs_[current_db_]->catalog_mgr_->GetIndex(table_name, index_name, iinfo);
+  if (res == DB_SUCCESS) {
     context->output_ += "[Error]: Index \"" + index_name + "\" on \"" + table_name + "\" already exists!\n";
     return DB_INDEX_ALREADY_EXIST;
   }
@@ -568,8 +651,6 @@ dberr_t ExecuteEngine::ExecuteCreateIndex(pSyntaxNode ast, ExecuteContext *conte
   }
 
   // step 6: check the unique constraint
-  TableInfo *tinfo;
-  dbs_[current_db_]->catalog_mgr_->GetTable(table_name, tinfo);
   if (index_keys.size() > 1)  // not implement multiple uniqueness check, so no multiple non-primary index
   {
     if (!LATER_INDEX_AVAILABLE) {
@@ -610,7 +691,7 @@ dberr_t ExecuteEngine::ExecuteCreateIndex(pSyntaxNode ast, ExecuteContext *conte
   // step 8: Initialization:
   // after create a nex index on a table, we have to insert initial entries into the index if the table is not empty!
   TableHeap *table_heap = tinfo->GetTableHeap();
-  for (auto it = table_heap->Begin(); it != table_heap->End(); it++) {
+  for (auto it = table_heap->Begin(nullptr, false, heap_); it != table_heap->End(); it++) {
     Row row = *it;
     // generate the inserted key
     vector<Field> key_fields;
@@ -655,10 +736,14 @@ dberr_t ExecuteEngine::ExecuteDropIndex(pSyntaxNode ast, ExecuteContext *context
 
   // step 3: traverse every table and drop index of that name
   // if there are multiple indexes of the same name on different tables, only drop the one on the first tuple!
-  vector<TableInfo *> tables;
-  dbs_[current_db_]->catalog_mgr_->GetTables(tables);
-  for (vector<TableInfo *>::iterator it = tables.begin(); it != tables.end(); it++) {
-    if (dbs_[current_db_]->catalog_mgr_->DropIndex((*it)->GetTableName(), index_name) == DB_SUCCESS) {
+  vector<string> table_names;
+  dbs_[current_db_]->catalog_mgr_->GetTableNames(table_names);
+  for (auto &table_name : table_names) {
+    IndexInfo *iinfo;
+    if (dbs_[current_db_]->catalog_mgr_->GetIndex(table_name, index_name, iinfo) != DB_SUCCESS) continue;
+    TableInfo *tinfo;
+    if (!LockTable(context, table_name, tinfo, LockMode::EXCLUSIVE)) return DB_FAILED;
+    if (dbs_[current_db_]->catalog_mgr_->DropIndex(table_name, index_name, context->txn_) == DB_SUCCESS) {
       // continue;  //if this holds, drop every index of that name
       return DB_SUCCESS;
     }
@@ -686,11 +771,14 @@ dberr_t ExecuteEngine::ExecuteSelect(pSyntaxNode ast, ExecuteContext *context) {
   }
   else
   {
+    if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_SHARED)) return DB_FAILED;
     vector<IndexInfo *> iinfos;
     dbs_[current_db_]->catalog_mgr_->GetTableIndexes(table_name, iinfos);
     // step 2: do the row selection
     vector<Row> rows;
-    if (SelectTuples(ast->child_->next_->next_, context, tinfo, iinfos, &rows) != DB_SUCCESS)  // critical function
+    // read in the snapshot of the transaction, without waiting for the writers
+    if (SelectTuples(ast->child_->next_->next_, context, tinfo, iinfos, &rows, context->txn_ != nullptr) !=
+        DB_SUCCESS)  // critical function
     {
       context->output_ += "[Exception]: Tuple selected failed!\n";
       return DB_FAILED;
@@ -837,6 +925,7 @@ dberr_t ExecuteEngine::ExecuteInsert(pSyntaxNode ast, ExecuteContext *context) {
     context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
     return DB_TABLE_NOT_EXIST;
   }
+  if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_EXCLUSIVE)) return DB_FAILED;
 
   // step 2: generate the inserted row
   Schema *sch = tinfo->GetSchema();  // get schema
@@ -889,6 +978,7 @@ dberr_t ExecuteEngine::ExecuteInsert(pSyntaxNode ast, ExecuteContext *context) {
   iinfos.clear();
   if (tinfo->GetTableHeap()->InsertTuple(row, context->txn_))  // insert the tuple, rowId has been set
   {
+    dbs_[current_db_]->catalog_mgr_->AdjustRowNum(tinfo->GetTableId(), 1);
     // update index(do not forget!)
     dbs_[current_db_]->catalog_mgr_->GetTableIndexes(table_name, iinfos);
     for (vector<IndexInfo *>::iterator it = iinfos.begin(); it != iinfos.end();
@@ -910,7 +1000,6 @@ dberr_t ExecuteEngine::ExecuteInsert(pSyntaxNode ast, ExecuteContext *context) {
         return DB_FAILED;
       }
     }
-    dbs_[current_db_]->catalog_mgr_->SetRowNum(tinfo->GetTableId(), tinfo->GerRowNum() + 1);
     return DB_SUCCESS;
   }
   context->output_ += "[Exception]: Insert failed!\n";
@@ -932,50 +1021,59 @@ dberr_t ExecuteEngine::ExecuteDelete(pSyntaxNode ast, ExecuteContext *context) {
     context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
     return DB_TABLE_NOT_EXIST;
   }
+  if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_EXCLUSIVE)) return DB_FAILED;
   vector<IndexInfo *> iinfos;
   dbs_[current_db_]->catalog_mgr_->GetTableIndexes(table_name, iinfos);
 
-  // step 2: do the row selection
+  // step 2: do the row selection. the deletes go through the ring of the scan, the pages it read stay in it
   vector<Row> rows;
-  if (SelectTuples(ast->child_->next_, context, tinfo, iinfos, &rows) != DB_SUCCESS)  // critical function
+  std::shared_ptr<BufferAccessStrategy> strategy = tinfo->GetTableHeap()->MakeScanStrategy();
+  if (SelectTuples(ast->child_->next_, context, tinfo, iinfos, &rows, false, strategy) != DB_SUCCESS)  // critical function
   {
     context->output_ += "[Exception]: Tuple selected failed!\n";
     return DB_FAILED;
   }
 
-  // step 3: delete the rows
+  // step 3: delete the rows, the row number of the table is adjusted once for all of them
+  int32_t deleted = 0;
+  dberr_t res = DB_SUCCESS;
   for (auto &row : rows) {
-    if (tinfo->GetTableHeap()->MarkDelete(row.GetRowId(), context->txn_))  // mark delete the tuple, rowId has been set
+    if (!tinfo->GetTableHeap()->MarkDelete(row.GetRowId(), context->txn_, strategy.get()))  // mark delete the tuple, rowId has been set
     {
-      // update index(do not forget!)
-      for (vector<IndexInfo *>::iterator it = iinfos.begin(); it != iinfos.end();
-           it++)  // traverse every index on the table
-      {
-        // do remove entry
-        vector<Field> key_fields;
-        for (uint32_t i = 0; i < (*it)->GetIndexKeySchema()->GetColumnCount(); i++) {
-          key_fields.push_back(*row.GetField((*it)->GetIndexKeySchema()->GetColumn(i)->GetTableInd()));
-        }
-        Row key(key_fields, heap_);
-        key.SetRowId(row.GetRowId());  // key rowId is the same as the inserted row
+      context->output_ += "[Exception]: Mark delete tuple failed!\n";
+      res = DB_FAILED;
+      break;
+    }
+    deleted++;
+    // update index(do not forget!)
+    for (vector<IndexInfo *>::iterator it = iinfos.begin(); it != iinfos.end();
+         it++)  // traverse every index on the table
+    {
+      // do remove entry
+      vector<Field> key_fields;
+      for (uint32_t i = 0; i < (*it)->GetIndexKeySchema()->GetColumnCount(); i++) {
+        key_fields.push_back(*row.GetField((*it)->GetIndexKeySchema()->GetColumn(i)->GetTableInd()));
+      }
+      Row key(key_fields, heap_);
+      key.SetRowId(row.GetRowId());  // key rowId is the same as the inserted row
 
-        if ((*it)->GetIndex()->RemoveEntry(key, key.GetRowId(), context->txn_) != DB_SUCCESS) {
-          context->output_ += "[Exception]: Remove entry of index \"" + (*it)->GetIndexName() + "\" failed while doing deletion!\n";
-          return DB_FAILED;
-        }
+      if ((*it)->GetIndex()->RemoveEntry(key, key.GetRowId(), context->txn_) != DB_SUCCESS) {
+        context->output_ += "[Exception]: Remove entry of index \"" + (*it)->GetIndexName() + "\" failed while doing deletion!\n";
+        res = DB_FAILED;
+        break;
       }
-    } else {
-      context->output_ += "[Exception]: Mark delete tuple failed!\n";
-      return DB_FAILED;
     }
-    tinfo->GetTableHeap()->ApplyDelete(row.GetRowId(), context->txn_);
-    dbs_[current_db_]->catalog_mgr_->SetRowNum(tinfo->GetTableId(), tinfo->GerRowNum() - 1);
+    if (res != DB_SUCCESS) break;
+    // a transaction keeps the tuple until it commits, a rollback only clears the mark
+    if (context->txn_ == nullptr) tinfo->GetTableHeap()->ApplyDelete(row.GetRowId(), context->txn_, strategy.get());
     // if apply delete failed
     // {
     //   context.out_put_ += "Error: Apply delete tuple failed!\n";
     //   return DB_FAILED;
     // }
   }
+  if (deleted > 0) dbs_[current_db_]->catalog_mgr_->AdjustRowNum(tinfo->GetTableId(), -deleted);
+  if (res != DB_SUCCESS) return res;
   context->output_ += "(" + to_string(rows.size()) + " rows deleted)\n";
   return DB_SUCCESS;
 }
@@ -995,6 +1093,7 @@ dberr_t ExecuteEngine::ExecuteUpdate(pSyntaxNode ast, ExecuteContext *context) {
     context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
     return DB_TABLE_NOT_EXIST;
   }
+  if (!LockTable(context, table_name, tinfo, LockMode::INTENTION_EXCLUSIVE)) return DB_FAILED;
   Schema *sch = tinfo->GetSchema();
   vector<IndexInfo *> iinfos;
   dbs_[current_db_]->catalog_mgr_->GetTableIndexes(table_name, iinfos);
@@ -1105,13 +1204,17 @@ dberr_t ExecuteEngine::ExecuteUpdate(pSyntaxNode ast, ExecuteContext *context) {
       }
       Row old_key(old_key_fields, heap_);
       old_key.SetRowId(old_row.GetRowId());
-      if (((*it)->GetIndex()->RemoveEntry(old_key, old_key.GetRowId(), context->txn_)) != DB_SUCCESS) {
-        context->output_ += "[Exception]: Remove index failed while doing update (may exist duplicate keys)!\n";
-        return DB_FAILED;
-      }
       vector<Field> new_key_fields;
+      bool key_changed = false;
       for (uint32_t i = 0; i < (*it)->GetIndexKeySchema()->GetColumnCount(); i++) {
         new_key_fields.push_back(*new_row.GetField((*it)->GetIndexKeySchema()->GetColumn(i)->GetTableInd()));
+        if (new_key_fields.back().CompareEquals(old_key_fields[i]) != CmpBool::kTrue) key_changed = true;
+      }
+      // the entry is left in place, lookups by other sessions never miss it
+      if (!key_changed && new_row.GetRowId() == old_row.GetRowId()) continue;
+      if (((*it)->GetIndex()->RemoveEntry(old_key, old_key.GetRowId(), context->txn_)) != DB_SUCCESS) {
+        context->output_ += "[Exception]: Remove index failed while doing update (may exist duplicate keys)!\n";
+        return DB_FAILED;
       }
       Row new_key(new_key_fields, heap_);
       new_key.SetRowId(new_row.GetRowId());
@@ -1178,9 +1281,16 @@ dberr_t ExecuteEngine::ExecuteTrxCommit(pSyntaxNode ast, ExecuteContext *context
     context->output_ += "[Error]: No running transaction to commit!\n";
     return DB_FAILED;
   }
-  dbs_[current_db_]->txn_mgr_->Commit(context->txn_);
+  // the changes after the commit are logged after it, so they are applied even if its durability is not known
+  CatalogManager *catalog_mgr = dbs_[current_db_]->catalog_mgr_;
+  dberr_t ret = dbs_[current_db_]->txn_mgr_->Commit(context->txn_,
+                                                    [catalog_mgr](Transaction *txn) { catalog_mgr->CommitWrites(txn); });
   context->txn_ = nullptr;
   dbs_[current_db_]->bpm_->SetTxn(context->txn_);
+  if (ret != DB_SUCCESS) {
+    context->output_ += "[Error]: Failed to write the log, the commit may be lost!\n";
+    return DB_FAILED;
+  }
   return DB_SUCCESS;
 }
 
@@ -1202,8 +1312,8 @@ dberr_t ExecuteEngine::ExecuteTrxRollback(pSyntaxNode ast, ExecuteContext *conte
     context->output_ += "[Error]: No running transaction to rollback!\n";
     return DB_FAILED;
   }
+  dbs_[current_db_]->catalog_mgr_->RollbackWrites(context->txn_);
   dbs_[current_db_]->txn_mgr_->Abort(context->txn_);
-  dbs_[current_db_]->catalog_mgr_->LoadFromBuffer();//reload after rollback
   context->txn_ = nullptr;
   dbs_[current_db_]->bpm_->SetTxn(context->txn_);
   return DB_SUCCESS;
@@ -1338,7 +1448,8 @@ dberr_t ExecuteEngine::ExecuteQuit(pSyntaxNode ast, ExecuteContext *context) {
 // rows: receive the result
 dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteContext *context, TableInfo *tinfo,
                                     vector<IndexInfo *> iinfos,
-                                    vector<Row> *rows)  // select the rows according to the condition node
+                                    vector<Row> *rows, bool snapshot,
+                                    std::shared_ptr<BufferAccessStrategy> strategy)  // select the rows according to the condition node
 {
   // step 1: exclude exceptions and get the table heap
   ASSERT(tinfo != nullptr, "Null for select");
@@ -1349,7 +1460,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
   // step 2: do selection (no condition, single condition, multiple condition)
   if (cond_root_ast == nullptr)  // no condition(return all tuples)
   {
-    for (auto it = table_heap->Begin(); it != table_heap->End(); it++)  // traverse tuples
+    for (auto it = table_heap->Begin(context->txn_, snapshot, heap_, strategy); it != table_heap->End(); it++)  // traverse tuples
     {
       rows->emplace_back(*it);
     }
@@ -1363,7 +1474,9 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
     }
 
     // check if there is an index to use (btree index / hash index with equal condition)
+    // the rows are read after the index is traversed, waiting for the lock of a row lets other sessions change it
     bool use_index = false;
+    vector<RowId> select_rids;
     string comp_str(cond_root_ast->child_->val_);
     for (auto iinfo : iinfos) {
       // only use single key index for query optimization now
@@ -1376,7 +1489,6 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
         // no consider for null insertion for index column now!
 
         Row key(fields, heap_);
-        vector<RowId> select_rid;
 
         if(DEFAULT_INDEX_TYPE == BPTREE)
         {  
@@ -1391,17 +1503,13 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
             if (correct_target == ind->GetEndIterator()) break;  // no equal index for the entry
             if(!correct_target.IsNull())
             {
-              Row row((*correct_target).value, heap_);
-              table_heap->GetTuple(&row, context->txn_);
-              rows->emplace_back(row);
+              select_rids.push_back((*correct_target).value);
             }
           } else if (comp_str == "<>") {
             for (auto it = ind->GetBeginIterator(); it != ind->GetEndIterator(); ++it)  // return all but not target
             {
-              Row row((*it).value, heap_);
-              table_heap->GetTuple(&row, context->txn_);
               if (it != correct_target && !it.IsNull()) //can be better
-                rows->emplace_back(row);
+                select_rids.push_back((*it).value);
             }
           } else if (comp_str == ">") {
             auto it = ls_target;
@@ -1410,9 +1518,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
             for (; it != ind->GetEndIterator(); ++it)  // return all larger than target
             {
               if (it == ls_target || it.IsNull()) continue;
-              Row row((*it).value, heap_);
-              table_heap->GetTuple(&row, context->txn_);
-              rows->emplace_back(row);
+              select_rids.push_back((*it).value);
             }
           } else if (comp_str == ">=") {
             auto it = ls_target;
@@ -1422,9 +1528,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
             {
               if (it != ls_target || correct_target != ind->GetEndIterator() || it.IsNull())  // skip the first iterator if not equal
               {
-                Row row((*it).value, heap_);
-                table_heap->GetTuple(&row, context->txn_);
-                rows->emplace_back(row);
+                select_rids.push_back((*it).value);
               }
             }
           } else if (comp_str == "<") {
@@ -1441,18 +1545,14 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
                 {
                   if(!it.IsNull())
                   {
-                    Row row((*it).value, heap_);
-                    table_heap->GetTuple(&row, context->txn_);
-                    rows->emplace_back(row);
+                    select_rids.push_back((*it).value);
                   }
                   break;
                 }
               }
               if(!it.IsNull())
               {
-                Row row((*it).value, heap_);
-                table_heap->GetTuple(&row, context->txn_);
-                rows->emplace_back(row);
+                select_rids.push_back((*it).value);
               }
             }
           } else if (comp_str == "<=") {
@@ -1463,9 +1563,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
               if (it == ind->GetEndIterator()) break;
               if(!it.IsNull())
               {
-                Row row((*it).value, heap_);
-                table_heap->GetTuple(&row, context->txn_);
-                rows->emplace_back(row);
+                select_rids.push_back((*it).value);
               }
               if (it == ls_target) break;
             }
@@ -1475,9 +1573,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
               return DB_FAILED;
             }
             if (correct_target != ind->GetEndIterator()) {
-              Row row((*correct_target).value, heap_);
-              table_heap->GetTuple(&row, context->txn_);
-              rows->emplace_back(row);
+              select_rids.push_back((*correct_target).value);
             }
           } else if (comp_str == "not") {
             if (cond_root_ast->child_->child_->next_->type_ != kNodeNull) {
@@ -1486,9 +1582,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
             }
             for (auto it = ind->GetBeginIterator(); it != ind->GetEndIterator(); ++it)  // return all but not target
             {
-              Row row((*it).value, heap_);
-              table_heap->GetTuple(&row, context->txn_);
-              if (it != correct_target) rows->emplace_back(row);
+              if (it != correct_target) select_rids.push_back((*it).value);
             }
           } else
             ASSERT(false, "Invalid comparator!");
@@ -1503,19 +1597,24 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
           //hash index can only be used for equal condition
           vector<RowId> results;
           ind->ScanKey(key, results, context->txn_);
-          for(int i=0;i<results.size();i++)//size = 1 if unique
-          {
-            Row row(results[i], heap_);
-            table_heap->GetTuple(&row, context->txn_);
-            rows->emplace_back(row);
-          }
+          select_rids.insert(select_rids.end(), results.begin(), results.end());//size = 1 if unique
           break;
         }
       }
     }
+    for (auto &rid : select_rids) {
+      Row row(rid, heap_);
+      if (!snapshot) {
+        if (table_heap->GetTuple(&row, context->txn_)) rows->emplace_back(row);
+      } else if (table_heap->GetVisibleTuple(&row, context->txn_) &&
+                 RowSatisfyCondition(row, cond_root_ast, tinfo, context)) {
+        // the version in the snapshot may not have the key found in the index
+        rows->emplace_back(row);
+      }
+    }
     // no available index on single condition column, traverse and examine
     if (!use_index) {
-      for (auto it = table_heap->Begin(); it != table_heap->End(); it++)  // traverse tuples
+      for (auto it = table_heap->Begin(context->txn_, snapshot, heap_, strategy); it != table_heap->End(); it++)  // traverse tuples
       {
         // check the comparasion
         // Row row = *it;
@@ -1527,7 +1626,7 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
   {
     // file scan now, without possible optimization
     context->output_ += "[Note]: Multiple conditions!\n";
-    for (auto it = table_heap->Begin(); it != table_heap->End(); it++)  // traverse tuples
+    for (auto it = table_heap->Begin(context->txn_, snapshot, heap_, strategy); it != table_heap->End(); it++)  // traverse tuples
     {
       // check the comparasion
       // Row row = *it;
@@ -1536,9 +1635,41 @@ dberr_t ExecuteEngine::SelectTuples(const pSyntaxNode cond_root_ast, ExecuteCont
     }
   } else
     ASSERT(false, "Unknown select condition!");
+
+  // step 3: the tuples changed since the snapshot may be missed by the scan or the index, check their versions
+  vector<RowId> versioned_rids;
+  if (snapshot) versioned_rids = table_heap->GetVersionedRows();
+  if (!versioned_rids.empty()) {
+    std::unordered_set<int64_t> selected;
+    for (auto &row : *rows) selected.insert(row.GetRowId().Get());
+    for (auto &rid : versioned_rids) {
+      if (selected.count(rid.Get()) != 0) continue;
+      Row row(rid, heap_);
+      if (table_heap->GetVisibleTuple(&row, context->txn_) &&
+          (cond_root_ast == nullptr || RowSatisfyCondition(row, cond_root_ast, tinfo, context)))
+        rows->emplace_back(row);
+    }
+  }
   return DB_SUCCESS;
 }
 
+bool ExecuteEngine::LockTable(ExecuteContext *context, const string &table_name, TableInfo *&tinfo, LockMode mode) {
+  CatalogManager *catalog_mgr = dbs_[current_db_]->catalog_mgr_;
+  LockManager *lock_mgr = dbs_[current_db_]->lock_mgr_;
+  // locked by its id before the table info is used: a table dropped by another session is freed once that one
+  // commits, it is looked up again under the lock
+  table_id_t table_id;
+  while (catalog_mgr->GetTableId(table_name, table_id) == DB_SUCCESS) {
+    if (lock_mgr != nullptr && context->txn_ != nullptr && !lock_mgr->LockTable(context->txn_, table_id, mode)) {
+      context->output_ += "[Error]: Can not lock table \"" + table_name + "\"!\n";
+      return false;
+    }
+    if (catalog_mgr->GetTable(table_id, tinfo) == DB_SUCCESS) return true;
+  }
+  context->output_ += "[Error]: Table \"" + table_name + "\" not exists!\n";
+  return false;
+}
+
 // single comparison function, return true if comparision pass
 // f: the field
 // p_comp:the comparator (=, !=, >, <, <=, >=, is, not)
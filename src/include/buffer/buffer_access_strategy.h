@@ -0,0 +1,43 @@
+#ifndef MINISQL_BUFFER_ACCESS_STRATEGY_H
+#define MINISQL_BUFFER_ACCESS_STRATEGY_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include "common/config.h"
+
+class BufferPoolManager;
+
+/**
+ * BufferAccessStrategy gives a large sequential scan a small private ring of frames.
+ * Pages read in on behalf of the strategy are remembered in a ring. Once the ring is full, the oldest page is
+ * handed back to the buffer pool, which frees its frame so the next read of the scan reuses it.
+ * A page that somebody else touched meanwhile is left alone, so the scan keeps at most ring_size frames of the pool
+ * and never pushes out the working set of other sessions.
+ * Pages that were already cached when the scan reached them are not part of the ring.
+ */
+class BufferAccessStrategy {
+ public:
+  explicit BufferAccessStrategy(BufferPoolManager *buffer_pool_manager, size_t ring_size);
+
+  ~BufferAccessStrategy() = default;
+
+  /** @return the id marking frames read in by this strategy, never 0 */
+  inline uint32_t GetId() const { return id_; }
+
+  /**
+   * Called by the buffer pool after it read a page in on behalf of this strategy.
+   * Recycles the oldest page of the ring when the ring is full.
+   */
+  void AddPage(page_id_t page_id);
+
+ private:
+  static std::atomic<uint32_t> next_id_;
+
+  BufferPoolManager *buffer_pool_manager_;
+  uint32_t id_;
+  size_t ring_size_;
+  std::deque<page_id_t> ring_;
+};
+
+#endif  // MINISQL_BUFFER_ACCESS_STRATEGY_H
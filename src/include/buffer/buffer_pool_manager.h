@@ -1,11 +1,21 @@
 #ifndef MINISQL_BUFFER_POOL_MANAGER_H
 #define MINISQL_BUFFER_POOL_MANAGER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <list>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/concurrent_page_table.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/read_ahead.h"
 #include "buffer/clock_replacer.h"
 #include "common/config.h"
 #include "page/disk_file_meta_page.h"
@@ -19,19 +29,44 @@ class PageData;
 
 class BufferPoolManager {
  public:
-  explicit BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager);
+  explicit BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager,
+                             REPLACER_TYPE replacer_type = CUR_REPLACER_TYPE);
 
   ~BufferPoolManager();
 
-  Page *FetchPage(page_id_t page_id, bool to_write);
+  /**
+   * Fetch a page and latch it according to to_write.
+   * With a strategy, a page read in from disk is put in the strategy's ring instead of staying in the pool.
+   */
+  Page *FetchPage(page_id_t page_id, bool to_write, BufferAccessStrategy *strategy = nullptr);
 
   bool UnpinPage(page_id_t page_id, bool is_dirty, bool sure = true);
 
   bool FlushPage(page_id_t page_id);
 
+  /**
+   * Write all dirty pages back. Their images are collected first and written sorted by disk position,
+   * so that adjacent pages go out as one large write.
+   */
   bool FlushAll();
 
-  Page *NewPage(page_id_t &page_id);
+  /**
+   * Write back the dirty pages with changes older than lsn, like FlushAll. Checkpoints use it so that redo does not
+   * have to start far back for pages that stay dirty.
+   */
+  bool FlushOldPages(lsn_t lsn);
+
+  /**
+   * Allocate a page and bring it into the pool pinned and write latched.
+   * @param hint keeps the pages of a table heap or index physically together (see AllocationHint), may be nullptr
+   */
+  Page *NewPage(page_id_t &page_id, AllocationHint *hint = nullptr);
+
+  /**
+   * Allocate the given page, which must be free, and bring it into the pool pinned and write latched. Recovery uses it
+   * to redo or undo the allocation of a logged page under the same page id.
+   */
+  Page *NewPageAt(page_id_t page_id);
 
   bool DeletePage(page_id_t page_id);
 
@@ -39,22 +74,208 @@ class BufferPoolManager {
 
   bool CheckAllUnpinned();
 
+  /**
+   * Give the frame of a page back to the free list, if it was read in by the strategy ring_id and nobody else
+   * touched it since. Called by BufferAccessStrategy when the page leaves its ring.
+   */
+  void RecyclePage(page_id_t page_id, uint32_t ring_id);
+
+  inline size_t GetPoolSize() const { return pool_size_; }
+
+  /**
+   * Asynchronously read up to count pages of a page chain into the pool, starting at start_page_id.
+   * Cached pages are skipped, next_page_fn finds the following page. Requests beyond the queue limit are dropped.
+   * @param ring_id id of the access strategy of the scan (0 if none), the prefetched pages join its ring
+   */
+  void Prefetch(page_id_t start_page_id, NextPageFn next_page_fn, size_t count, uint32_t ring_id);
+
   // add my hit rate check function
   double get_hit_rate();
   void ResetCounter();
 
   void SetTxn(Transaction* txn) {cur_txn_ = txn; disk_manager_->SetTxn(txn);}
 
-  int GetStackSize()
-  {
-    return is_new_map_.size();
-  }
+  /**
+   * A structure modification of an index (a split or a merge) changes several pages, which are only consistent
+   * together. Its page records are logged between a SMO_BEGIN and a SMO_END record of the session, recovery undoes
+   * the records of a modification cut off by a crash.
+   */
+  void BeginStructureChange();
+
+  /**
+   * End the structure modification of the session. With a page id, the end is logged when the session unpins that
+   * page, the last one it latches, before the page is unlatched: nobody else changes the pages of the modification
+   * before its end is in the log.
+   */
+  void EndStructureChange(page_id_t last_page_id = INVALID_PAGE_ID);
+
+  /**
+   * Collect the dirty pages with their rec lsns for a fuzzy checkpoint, without blocking the pages.
+   * Pages dirtied by records from the log's next lsn at the call on may be missed, see DirtyPageTable.
+   */
+  void GetDirtyPageTable(DirtyPageTable *dpt);
+
+  // redo replays records that are in the log already, the pages it changes are not logged again
+  void SetLogChanges(bool log_changes) {log_changes_ = log_changes;}
+
+  int GetStackSize();
 
  private:
+  /**
+   * Per frame bookkeeping besides the Page itself.
+   */
+  struct FrameMeta {
+    std::atomic<int> accesses_{0};        // unpins not reported to the replacer yet
+    std::atomic<uint32_t> ring_id_{0};    // id of the strategy that read the page in, 0 if none or touched by others
+    std::atomic<bool> prefetched_{false}; // read in by read-ahead and not fetched yet
+    std::atomic<bool> writing_back_{false}; // a background write of the page is in flight
+    // log bookkeeping, only touched by the thread holding the page write latch
+    bool is_new_{false};                  // whether the page is newed, for deciding log type while unpin
+    bool has_old_{false};                 // whether old_data_ holds the image taken at fetch/new
+    PageData *old_data_{nullptr};         // old data recorded when fetch/new, for writing log while unpin
+    // for the dirty page table of checkpoints: the first record that may not be on disk yet, for the changes since
+    // the page was last written, and for those in the image being written back
+    std::atomic<lsn_t> rec_lsn_{INVALID_LSN};
+    std::atomic<lsn_t> write_rec_lsn_{INVALID_LSN};
+  };
+
+  /**
+   * A shard owns a contiguous slice of the frames. A page always lives in the shard selected by its page id,
+   * so threads touching pages of different shards never contend on the same latch.
+   * Frame ids inside a shard are local to the shard (0 ~ pool_size_-1).
+   *
+   * A cached page is found and pinned without any latch: the page table is lock-free and pin counts are atomic.
+   * The shard latch is only taken on a miss and when a frame changes its page.
+   * A frame whose pin count is FRAME_RESERVED is free or being (re)loaded and cannot be pinned lock-free.
+   * It is only in the page table while read-ahead reads its page in.
+   * The replacer is not updated on the hit/unpin path. Unpins are only counted per frame, with the sequence numbers
+   * of the last REPLACER_K of them, and are replayed into the replacer in that order right before a victim is
+   * chosen; a victim that got pinned meanwhile is skipped.
+   */
+  struct alignas(64) Shard {
+    size_t pool_size_;                                      // number of frames owned by this shard
+    Page *pages_;                                           // first frame of this shard (points into pages_)
+    FrameMeta *frames_;                                     // bookkeeping of the frames
+    ConcurrentPageTable *page_table_;                       // to keep track of pages
+    Replacer *replacer_;                                    // to find an unpinned page for replacement
+    std::list<frame_id_t> free_list_;                       // to find a free page for replacement
+    std::recursive_mutex latch_;                            // to protect free list, replacer and page table writes
+    std::atomic<uint64_t> *access_seqs_;                    // of the last REPLACER_K unpins of each frame, frame major
+    std::atomic<uint64_t> access_clock_{0};                 // orders the unpins of the shard
+    std::vector<std::pair<uint64_t, frame_id_t>> replay_;   // the accesses SyncReplacer replays, under latch_
+    std::atomic<int> hit_num_{0};
+    std::atomic<int> miss_num_{0};
+    size_t prefetching_{0};                                 // frames reserved by read-ahead reads in flight
+  };
+
+  static constexpr int FRAME_RESERVED = -1;
+
+  inline Shard &GetShard(page_id_t page_id) { return shards_[page_id % num_shards_]; }
+
+  /** Increase the pin count unless the frame is reserved. */
+  static bool TryPin(Page *p);
+
+  /**
+   * Wait for the background write of a frame in flight, if any. Called before the frame is replaced or its page is
+   * written again, so that an older image cannot land later or be read back in.
+   */
+  static void WaitWriteBack(Shard &shard, frame_id_t fid);
+
+  /**
+   * The WAL rule: before an image of a page is written back, the log must be durable up to the page LSN, the LSN of
+   * the record of its last change (added when it was unpinned). False if the log could not be written, the image
+   * must not be written then.
+   */
+  bool WriteLogAhead(const char *page_data);
+
+  // FlushAll (rec_lsn_before == INVALID_LSN) and FlushOldPages
+  bool FlushDirtyPages(lsn_t rec_lsn_before);
+
+  /**
+   * The page's image is about to be written back: its rec lsn moves to the write in flight.
+   * Called with the page latched, when the dirty flag is cleared.
+   */
+  void HandOverRecLSN(FrameMeta &meta);
+
+  /**
+   * Decrease the pin count and count the access for the replacer.
+   * Internal pins (background writer) pass count_access = false so they do not look like a use of the page.
+   */
+  static void UnpinFrame(Shard &shard, frame_id_t fid, bool count_access = true);
+
+  /** Count an access of the frame for the replacer, with its sequence number in the shard. Lock-free. */
+  static void CountAccess(Shard &shard, frame_id_t fid);
+
+  /** Replay the pending unpins into the replacer in the order they happened. The shard latch must be held. */
+  static void SyncReplacer(Shard &shard);
+
+  /**
+   * Pick a frame from the free list first, then from the replacer. The shard latch must be held.
+   * A victim frame is written back if dirty and removed from the page table.
+   * The returned frame is reserved (pin count FRAME_RESERVED).
+   */
+  bool FindFreeFrame(Shard &shard, frame_id_t *fid);
+
+  /**
+   * Take the page latch according to write intention, and record the old image for logging.
+   * Called without the shard latch held, the pin keeps the frame from being replaced.
+   */
+  void LatchPage(Shard &shard, frame_id_t fid, bool to_write, bool is_new);
+
+  /** Bookkeeping of a fetch that found the page cached: ring tag and first use of a prefetched page. */
+  void OnHit(Shard &shard, frame_id_t fid, BufferAccessStrategy *strategy);
+
+  /**
+   * Background writer thread: keeps the dirty frames under BG_WRITER_DIRTY_RATIO of the pool.
+   * The pages of a round are written as one batch on its own io queue.
+   */
+  void BackgroundWriter();
+
+  /**
+   * Queue the write back of a dirty, unpinned frame without evicting it. The frame is pinned and read latched while
+   * its image is copied to image, and the disk write happens on the copy without any latch or pin.
+   * The frame is marked writing back until the completion callback runs.
+   * @return true if a write was queued
+   */
+  bool WriteBackFrame(PageIOQueue *io_queue, Shard &shard, frame_id_t fid, PageData *image);
+
+  struct PrefetchRequest {
+    page_id_t start_page_id_;  // next page of the chain to read
+    NextPageFn next_page_fn_;
+    size_t count_;             // pages of the chain still to read
+    uint32_t ring_id_;
+  };
+
+  /**
+   * Read-ahead thread: serves the Prefetch requests. The queued chains advance together, one page each per round,
+   * so the reads of different chains are in flight at the same time.
+   */
+  void ReadAheadWorker();
+
+  /**
+   * Advance a chain through its cached pages and queue the read of the first page that is not cached, without
+   * pinning it. The frame is in the page table but reserved until the read completes, so nobody else reads the page
+   * in meanwhile; a fetch finding it waits. The completion (FinishPrefetch) publishes the frame and sets the next
+   * page of the chain.
+   */
+  void PrefetchPage(PageIOQueue *io_queue, PrefetchRequest *chain);
+
+  void FinishPrefetch(Shard &shard, frame_id_t fid, bool ok, PrefetchRequest *chain);
+
+  static constexpr size_t MAX_PREFETCH_REQUESTS = 16;
+  static constexpr size_t PREFETCH_SHARD_RATIO = 8;  // read-ahead reserves 1/PREFETCH_SHARD_RATIO of a shard at most
+  static constexpr int MAX_DELETE_RETRY = 1000;
+
   /**
    * Allocate new page (operations like create index/table) For now just keep an increasing counter
    */
-  page_id_t AllocatePage();
+  page_id_t AllocatePage(AllocationHint *hint = nullptr);
+
+  /** Log a SMO_BEGIN or SMO_END record for the session. */
+  void LogStructureChange(LogRecordType type);
+
+  /** Bring a page just allocated into a frame, zeroed, pinned and write latched. Deallocates it on failure. */
+  Page *InstallNewPage(page_id_t page_id);
 
   /**
    * Deallocate page (operations like drop index/table) Need bitmap in header page for tracking pages
@@ -64,25 +285,28 @@ class BufferPoolManager {
  private:
   size_t pool_size_;                                      // number of pages in buffer pool
   Page *pages_;                                           // array of pages(buffer pool)
-  //Page *disk_bitmap_pages_;
-  //Page *disk_meta_page;
+
+  size_t num_shards_;                                     // number of shards
+  Shard *shards_;                                         // array of shards
 
   DiskManager *disk_manager_;                             // pointer to the disk manager.
   
   LogManager *log_manager_;                               // pointer to the log manager(added)
 
-  std::unordered_map<page_id_t, frame_id_t> page_table_;  // to keep track of pages
-  Replacer *replacer_;                                    // to find an unpinned page for replacement
-  std::list<frame_id_t> free_list_;                       // to find a free page for replacement
-  std::recursive_mutex latch_;                                 // to protect shared data structure
-
-  Transaction * cur_txn_;//currenct transaction that occupies the buffer pool 
+  static thread_local Transaction * cur_txn_;//transaction of the calling session, sessions interleave while waiting for locks
+  static thread_local page_id_t smo_end_page_;            // the structure modification of the session ends with its unpin
+  bool log_changes_;                                      // false while redoing
 
-  unordered_map<page_id_t, PageData> old_data_map_; //record old data when fetch/new, for writing log while unpin
-  unordered_map<page_id_t, bool> is_new_map_; //whether a page is be newed, for deciding log type while unpin
+  std::thread read_ahead_thread_;                         // background reader of Prefetch requests
+  std::mutex read_ahead_latch_;                           // to protect the request queue
+  std::condition_variable read_ahead_cv_;
+  std::deque<PrefetchRequest> read_ahead_queue_;
+  bool read_ahead_stop_;
 
-  int hit_num;
-  int miss_num;
+  std::thread bg_writer_thread_;                          // background writer of dirty frames
+  std::mutex bg_writer_latch_;
+  std::condition_variable bg_writer_cv_;                  // woken when a miss had to write a dirty victim
+  bool bg_writer_stop_;
 };
 
 #endif  // MINISQL_BUFFER_POOL_MANAGER_H
@@ -0,0 +1,56 @@
+#ifndef MINISQL_CONCURRENT_PAGE_TABLE_H
+#define MINISQL_CONCURRENT_PAGE_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include "common/config.h"
+
+/**
+ * ConcurrentPageTable maps page id to frame id for one buffer pool shard.
+ * It is an open addressing (linear probing) table of 64-bit atomic slots, each slot packing (page_id, frame_id).
+ * Lookups are lock-free. Insert and Remove must be serialized by the caller (the shard latch).
+ * Remove shifts following entries backward instead of leaving tombstones, so a concurrent lookup may miss an entry
+ * that is being moved. A miss is therefore only a hint, and the caller must retry under the shard latch.
+ * A hit is always a mapping that existed at some moment, the caller validates it against the frame.
+ */
+class ConcurrentPageTable {
+ public:
+  /**
+   * @param max_entries the maximum number of pages mapped at the same time (frames of the shard)
+   */
+  explicit ConcurrentPageTable(size_t max_entries);
+
+  ~ConcurrentPageTable();
+
+  /** Lock-free lookup. @return true and set frame_id if page_id is found */
+  bool Find(page_id_t page_id, frame_id_t *frame_id) const;
+
+  /** Insert a mapping. page_id must not be in the table. Caller holds the shard latch. */
+  void Insert(page_id_t page_id, frame_id_t frame_id);
+
+  /** Remove a mapping. Caller holds the shard latch. @return false if page_id is not found */
+  bool Remove(page_id_t page_id);
+
+  /** @return the number of mapped pages */
+  size_t Size() const { return size_; }
+
+ private:
+  static constexpr uint64_t EMPTY_SLOT = ~static_cast<uint64_t>(0);
+
+  static inline uint64_t Pack(page_id_t page_id, frame_id_t frame_id) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(page_id)) << 32) | static_cast<uint32_t>(frame_id);
+  }
+  static inline page_id_t PageOf(uint64_t slot) { return static_cast<page_id_t>(slot >> 32); }
+  static inline frame_id_t FrameOf(uint64_t slot) { return static_cast<frame_id_t>(slot & 0xffffffffULL); }
+
+  inline size_t Hash(page_id_t page_id) const {
+    return (static_cast<uint32_t>(page_id) * 2654435761U) & mask_;
+  }
+
+  size_t capacity_;
+  size_t mask_;
+  size_t size_;
+  std::atomic<uint64_t> *slots_;
+};
+
+#endif  // MINISQL_CONCURRENT_PAGE_TABLE_H
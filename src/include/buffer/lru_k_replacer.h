@@ -0,0 +1,50 @@
+#ifndef MINISQL_LRU_K_REPLACER_H
+#define MINISQL_LRU_K_REPLACER_H
+
+#include <cstdint>
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy.
+ * The victim is the frame whose K-th most recent access is the oldest (largest backward K-distance).
+ * Frames with less than K recorded accesses have infinite K-distance and are evicted first,
+ * ordered by their earliest recorded access. A page touched once by a full scan therefore
+ * never pushes out a page that is accessed repeatedly.
+ * An access is recorded each time a frame is unpinned. The history of a frame is dropped when it is victimized.
+ */
+class LRUKReplacer : public Replacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_pages the maximum number of pages the LRUKReplacer will be required to store
+   * @param k number of accesses remembered per frame
+   */
+  explicit LRUKReplacer(size_t num_pages, size_t k);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  bool Victim(frame_id_t *frame_id) override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  size_t Size() override;
+
+ private:
+  size_t num_frames_;
+  size_t k_;
+  size_t num_present_;
+  uint64_t current_ts_;     // logical clock, increased by every recorded access
+  bool *present_;           // whether the frame can be victimized
+  size_t *history_size_;    // number of recorded accesses of each frame (at most k)
+  uint64_t *history_;       // k timestamps per frame, most recent first
+};
+
+#endif  // MINISQL_LRU_K_REPLACER_H
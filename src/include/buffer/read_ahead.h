@@ -0,0 +1,45 @@
+#ifndef MINISQL_READ_AHEAD_H
+#define MINISQL_READ_AHEAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include "common/config.h"
+
+class BufferPoolManager;
+
+/** Extracts the id of the next page of a page chain from the raw page data. */
+typedef page_id_t (*NextPageFn)(const char *page_data);
+
+/**
+ * ReadAhead detects sequential progress of an iterator along a page chain (the NextPageId chain of a table heap,
+ * the sibling chain of B+ tree leaves) and asks the buffer pool to prefetch the pages ahead of it.
+ * Prefetching starts after READ_AHEAD_TRIGGER consecutive chain steps, with a window of READ_AHEAD_MIN_PAGES
+ * pages that doubles on every refill up to READ_AHEAD_MAX_PAGES. A new window is requested once half of the
+ * previous one has been consumed, so the background reader stays ahead of the iterator.
+ */
+class ReadAhead {
+ public:
+  /**
+   * @param ring_id id of the access strategy the scan uses (0 if none), prefetched pages join its ring
+   */
+  explicit ReadAhead(BufferPoolManager *buffer_pool_manager, NextPageFn next_page_fn, uint32_t ring_id = 0);
+
+  ~ReadAhead() = default;
+
+  /**
+   * Report that the iterator moved to page_id.
+   * @param next_page_id the next page in the chain after page_id
+   */
+  void OnPage(page_id_t page_id, page_id_t next_page_id);
+
+ private:
+  BufferPoolManager *buffer_pool_manager_;
+  NextPageFn next_page_fn_;
+  uint32_t ring_id_;
+  page_id_t expected_page_id_;  // next page of the last reported page
+  size_t sequential_;           // consecutive chain steps seen
+  size_t window_;               // pages requested by the next prefetch
+  size_t remaining_;            // pages requested ahead of the iterator and not consumed yet
+};
+
+#endif  // MINISQL_READ_AHEAD_H
@@ -2,8 +2,10 @@
 #define MINISQL_CATALOG_H
 
 #include <map>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "buffer/buffer_pool_manager.h"
 #include "catalog/indexes.h"
@@ -13,6 +15,7 @@
 #include "transaction/lock_manager.h"
 #include "transaction/log_manager.h"
 #include "transaction/transaction.h"
+#include "transaction/version_manager.h"
 
 class CatalogMeta {
   friend class CatalogManager;
@@ -62,8 +65,8 @@ class CatalogMeta {
  */
 class CatalogManager {
  public:
-  explicit CatalogManager(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                          bool init);
+  explicit CatalogManager(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager,
+                          VersionManager *version_manager, LogManager *log_manager, bool init);
 
   ~CatalogManager();
 
@@ -71,8 +74,14 @@ class CatalogManager {
 
   dberr_t GetTable(const std::string &table_name, TableInfo *&table_info);
 
+  dberr_t GetTable(const table_id_t table_id, TableInfo *&table_info);
+
+  dberr_t GetTableId(const std::string &table_name, table_id_t &table_id);
+
   dberr_t GetTables(std::vector<TableInfo *> &tables);
 
+  dberr_t GetTableNames(std::vector<std::string> &table_names);
+
   dberr_t CreateIndex(const std::string &table_name, const std::string &index_name,
                       const std::vector<std::string> &index_keys, Transaction *txn, IndexInfo *&index_info);
 
@@ -80,26 +89,60 @@ class CatalogManager {
 
   dberr_t GetTableIndexes(const std::string &table_name, std::vector<IndexInfo *> &indexes);
 
-  dberr_t DropTable(const std::string &table_name);
+  // dropped at once without a transaction, else detached and freed when the transaction commits
+  dberr_t DropTable(const std::string &table_name, Transaction *txn = nullptr);
 
-  dberr_t DropIndex(const std::string &table_name, const std::string &index_name);
+  dberr_t DropIndex(const std::string &table_name, const std::string &index_name, Transaction *txn = nullptr);
 
   dberr_t SetRowNum(table_id_t tid, uint32_t row_num);
 
-  dberr_t LoadFromBuffer();//reload information from buffer pool (after rollback/recover)
+  dberr_t AdjustRowNum(table_id_t tid, int32_t delta);//add delta to the row number, atomically for concurrent sessions
+
+  dberr_t LoadFromBuffer();//reload information from buffer pool (after recover)
+
+  //once the commit is durable: delete the marked tuples, free what was dropped. at recovery again for a commit
+  //without its end, freed holds the pages it freed before the crash
+  void CommitWrites(Transaction *txn, const std::unordered_set<page_id_t> *freed = nullptr);
+
+  void RollbackWrites(Transaction *txn);//undo the writes of the transaction in place, the newest first
 
  private:
+  // the private functions run under the latch taken by the public ones
+
   dberr_t FlushCatalogMetaPage();
 
+  dberr_t FlushTableMetaPage(const table_id_t table_id);
+
+  dberr_t RemoveIndex(const std::string &table_name, const std::string &index_name, Transaction *txn);
+
+  // take the table or index out of the maps and the catalog meta, its pages are kept
+  dberr_t DetachTable(const table_id_t table_id, TableInfo *&table_info, page_id_t &meta_page_id);
+
+  dberr_t DetachIndex(const index_id_t index_id, IndexInfo *&index_info, page_id_t &meta_page_id);
+
+  // put back what a rolled back transaction dropped, loaded from its meta page if it is not kept (after recover)
+  dberr_t AttachTable(const table_id_t table_id, const page_id_t meta_page_id);
+
+  dberr_t AttachIndex(const index_id_t index_id, const page_id_t meta_page_id);
+
+  void FreeTable(TableInfo *table_info, const page_id_t meta_page_id);
+
+  void FreeIndex(IndexInfo *index_info, const page_id_t meta_page_id);
+
+  void AddWrite(Transaction *txn, WriteRecord write);  // logged first when there is a log manager
+
+  void Compensate(Transaction *txn, const WriteRecord &write);  // log that a write is undone, recover skips it
+
+  TableInfo *GetTableByHeap(page_id_t first_page_id);  // the table whose heap begins at the page, nullptr if none
+
   dberr_t LoadTable(const table_id_t table_id, const page_id_t page_id);
 
   dberr_t LoadIndex(const index_id_t index_id, const page_id_t page_id);
 
-  dberr_t GetTable(const table_id_t table_id, TableInfo *&table_info);
-
  private:
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
+  VersionManager *version_manager_;
   LogManager *log_manager_;
   CatalogMeta *catalog_meta_;
   std::atomic<table_id_t> next_table_id_;
@@ -110,8 +153,11 @@ class CatalogManager {
   // map for indexes: table_name->index_name->indexes
   std::unordered_map<std::string, std::unordered_map<std::string, index_id_t>> index_names_;
   std::unordered_map<index_id_t, IndexInfo *> indexes_;
+  // dropped by running transactions with their meta pages, their names are not taken again until they end
+  std::unordered_map<table_id_t, std::pair<TableInfo *, page_id_t>> dropped_tables_;
+  std::unordered_map<index_id_t, std::pair<IndexInfo *, page_id_t>> dropped_indexes_;
 
-  std::recursive_mutex latch_;
+  std::shared_mutex latch_;  // shared by the lookups of the statements
   // memory heap
   MemHeap *heap_;
 };
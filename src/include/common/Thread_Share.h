@@ -1,26 +1,37 @@
 #ifndef MINISQL_THREAD_SHARE_H
 #define MINISQL_THREAD_SHARE_H
 
+#include <shared_mutex>
 #include "storage/disk_manager.h"
 #include "buffer/buffer_pool_manager.h"
 #include "transaction/log_manager.h"
 #include "catalog/catalog.h"
 #include "transaction/lock_manager.h"
+#include "transaction/version_manager.h"
+#include "transaction/transaction_manager.h"
 
 class Thread_Share
 {
 public:
   Thread_Share()
-  :diskMgr_(nullptr), BPMgr_(nullptr), logMgr_(nullptr), cataMgr_(nullptr), lockMgr_(nullptr) {}
+  :diskMgr_(nullptr), BPMgr_(nullptr), logMgr_(nullptr), cataMgr_(nullptr), lockMgr_(nullptr), versionMgr_(nullptr),
+   txnMgr_(nullptr), stmtLatch_(nullptr) {}
   Thread_Share(DiskManager* diskMgr, BufferPoolManager* BPMgr, LogManager* logMgr, 
-    CatalogManager* cataMgr, LockManager* lockMgr)
-  :diskMgr_(diskMgr), BPMgr_(BPMgr), logMgr_(logMgr), cataMgr_(cataMgr), lockMgr_(lockMgr) {}
+    CatalogManager* cataMgr, LockManager* lockMgr, VersionManager* versionMgr, TransactionManager* txnMgr,
+    std::shared_mutex* stmtLatch)
+  :diskMgr_(diskMgr), BPMgr_(BPMgr), logMgr_(logMgr), cataMgr_(cataMgr), lockMgr_(lockMgr), versionMgr_(versionMgr),
+   txnMgr_(txnMgr), stmtLatch_(stmtLatch) {}
 public:
   DiskManager* diskMgr_;
   BufferPoolManager* BPMgr_;
   LogManager* logMgr_;
   CatalogManager* cataMgr_;
   LockManager* lockMgr_;
+  VersionManager* versionMgr_;
+  TransactionManager* txnMgr_; //recovers the database once, then checkpoints it for all the sessions
+  //without a lock manager (no log) nothing keeps the statements on the database apart, they take this latch:
+  //shared to read, exclusive to write tuples or change the catalog
+  std::shared_mutex* stmtLatch_;
 };
 
 #endif //MINISQL_THREAD_SHARE_H
@@ -6,6 +6,7 @@
 #include "common/setting.h"
 
 #define DBMETA_FILENAME  "../files/meta/DatabaseMeta.txt"
+#define SERVER_SOCKET_FILENAME  "../files/jetsql.sock"
 
 // add  "reulsts for update tuple" in table_page
 enum UPDATE_RESULT { SLOT_INVALID, TUPLE_DELETED, SPACE_NOT_ENOUGH, UPDATE_SUCCESS };
@@ -27,8 +28,6 @@ static constexpr int DEFAULT_BUFFER_POOL_SIZE = 1024;  // default size of buffer
 static constexpr uint32_t FIELD_NULL_LEN = UINT32_MAX;
 static constexpr uint32_t VARCHAR_MAX_LEN = PAGE_SIZE / 2;  // max length of varchar
 
-static constexpr size_t MAX_RECORD_NUMBER = 1024*1024;
-
 using key_size_t = uint32_t;
 using page_id_t = int32_t;
 using extent_id_t = int32_t;
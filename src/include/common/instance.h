@@ -33,12 +33,18 @@ class DBStorageEngine {
       DiskManager* diskMgr = new DiskManager(db_file_name_, logMgr);
       BufferPoolManager* BPMgr = new BufferPoolManager(DEFAULT_BUFFER_POOL_SIZE, diskMgr, logMgr);
       LockManager* lockMgr = nullptr;
+      if(USING_LOG)
+        lockMgr = new LockManager;
+      if(USING_LOG && ENABLE_DEADLOCK_DETECTION)
+        lockMgr->StartDeadlockDetection();
+      VersionManager* versionMgr = USING_LOG ? new VersionManager : nullptr;
 
       global_shared_latch.lock();
       disk_mgr_ = diskMgr;
       log_mgr_ =logMgr;
       bpm_ = BPMgr;
       lock_mgr_ = lockMgr;
+      version_mgr_ = versionMgr;
       global_shared_latch.unlock();
 
       //initialize meta pages
@@ -59,10 +65,15 @@ class DBStorageEngine {
       // ASSERT(p2 != nullptr && id_iroots == INDEX_ROOTS_PAGE_ID, "Failed to allocate header page.")
 
       global_shared_latch.lock();
-      CatalogManager* cataMgr = new CatalogManager(BPMgr, lockMgr, logMgr, true);
+      CatalogManager* cataMgr = new CatalogManager(BPMgr, lockMgr, versionMgr, logMgr, true);
       catalog_mgr_ = cataMgr;
+      txn_mgr_ = new TransactionManager(bpm_, disk_mgr_, log_mgr_, lock_mgr_, version_mgr_);
+      if(USING_LOG && ENABLE_BG_CHECKPOINT)
+        txn_mgr_->StartBackgroundCheckPoint();
       //insert shared resource map
-      global_SharedMap.insert(make_pair(db_name, Thread_Share(diskMgr, BPMgr, logMgr, catalog_mgr_, lock_mgr_)));
+      stmt_latch_ = new std::shared_mutex;
+      global_SharedMap.insert(make_pair(db_name, Thread_Share(diskMgr, BPMgr, logMgr, catalog_mgr_, lock_mgr_, version_mgr_,
+                                                              txn_mgr_, stmt_latch_)));
       global_shared_latch.unlock();
 
     } else {
@@ -72,22 +83,14 @@ class DBStorageEngine {
       bpm_ = global_SharedMap[db_name_].BPMgr_;
       catalog_mgr_ = global_SharedMap[db_name_].cataMgr_;
       lock_mgr_ = global_SharedMap[db_name_].lockMgr_;
+      version_mgr_ = global_SharedMap[db_name_].versionMgr_;
+      //recovered already, by the creator of the shared components
+      txn_mgr_ = global_SharedMap[db_name_].txnMgr_;
+      stmt_latch_ = global_SharedMap[db_name_].stmtLatch_;
       global_shared_latch.unlock();
       // ASSERT(!bpm_->IsPageFree(CATALOG_META_PAGE_ID), "Invalid catalog meta page.");
       // ASSERT(!bpm_->IsPageFree(INDEX_ROOTS_PAGE_ID), "Invalid header page.");
     }
-
-    // Initialize not-shared components
-    txn_mgr_ = new TransactionManager(bpm_, disk_mgr_, log_mgr_);
-
-    //do recover if exists
-    if(!init)
-    {
-      if(USING_LOG)
-        txn_mgr_->Recover();
-    }
-    if(!init)
-      catalog_mgr_->LoadFromBuffer();
   }
 
   ~DBStorageEngine() {
@@ -100,7 +103,7 @@ class DBStorageEngine {
 
     // delete catalog_mgr_;
     // delete lock_mgr_;
-    delete txn_mgr_;
+    // delete txn_mgr_;
   }
 
  public:
@@ -109,7 +112,9 @@ class DBStorageEngine {
   CatalogManager *catalog_mgr_;
   LogManager *log_mgr_;
   LockManager *lock_mgr_;
+  VersionManager *version_mgr_;
   TransactionManager *txn_mgr_;
+  std::shared_mutex *stmt_latch_;
 
   std::string db_file_name_;
   std::string db_name_;
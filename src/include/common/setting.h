@@ -12,7 +12,7 @@
 enum DBMS_MODE {FAST, SAFE};
 
 //replacer type
-enum REPLACER_TYPE {LRU, CLOCK};
+enum REPLACER_TYPE {LRU, CLOCK, LRU_K};
 
 //index type
 enum INDEX_TYPE {BPTREE, HASH};
@@ -21,12 +21,41 @@ static bool LATER_INDEX_AVAILABLE = true;//if building an index on an non empty
 static DBMS_MODE CUR_DBMS_MODE = FAST;
 static bool USING_LOG = (CUR_DBMS_MODE!=FAST);
 static REPLACER_TYPE CUR_REPLACER_TYPE = LRU;
+static size_t REPLACER_K = 2; //K of the LRU-K replacer
 static INDEX_TYPE DEFAULT_INDEX_TYPE = BPTREE;
 
 
-static constexpr uint32_t THREAD_MAXNUM = 1; //maybe multithread
+static constexpr uint32_t THREAD_MAXNUM = 1; //console sessions reading stdin, concurrent sessions come from the server (--server)
 static constexpr bool DO_PAGE_LATCH = true; 
-static constexpr bool USING_EXE_LATCH = true; //executor latch(low concurrency but safe)
+static constexpr uint32_t BUFFER_POOL_SHARD_NUM = 8; //number of buffer pool shards, each with its own latch
+static constexpr uint32_t BUFFER_POOL_SHARD_MIN_FRAMES = 64; //smaller pools get fewer shards, a full shard fails a fetch
+static constexpr uint32_t SCAN_RING_SIZE = 32; //frames a large full table scan may occupy in the buffer pool
+static constexpr uint32_t SCAN_RING_THRESHOLD = 4; //tables larger than 1/SCAN_RING_THRESHOLD of the pool scan through a ring
+static constexpr bool ENABLE_READ_AHEAD = true; //prefetch pages ahead of sequential heap/leaf chain scans
+static constexpr uint32_t READ_AHEAD_TRIGGER = 2; //consecutive chain steps before prefetching starts
+static constexpr uint32_t READ_AHEAD_MIN_PAGES = 4; //first read-ahead window
+static constexpr uint32_t READ_AHEAD_MAX_PAGES = 32; //largest read-ahead window
+static constexpr bool ENABLE_BG_WRITER = true; //write dirty frames back in the background
+static constexpr double BG_WRITER_DIRTY_RATIO = 0.1; //dirty frames the background writer tolerates (ratio of the pool)
+static constexpr uint32_t BG_WRITER_INTERVAL_MS = 50; //background writer round interval
+static constexpr uint32_t BG_WRITER_MAX_PAGES = 128; //pages written per background writer round at most
+static constexpr uint32_t ALLOCATION_RUN_SIZE = 64; //consecutive pages reserved at a time for the pages of a table heap or an index
+static constexpr bool ENABLE_IO_URING = true; //asynchronous page io for read-ahead and the background writer (falls back to pread/pwrite)
+static constexpr uint32_t IO_QUEUE_DEPTH = 64; //page io requests in flight per io thread
+static constexpr uint32_t LOG_BUFFER_SIZE = 1024 * 1024; //bytes of log records kept in memory before they are appended to the log file
+static constexpr uint32_t LOG_FLUSH_INTERVAL_MS = 10; //the log flusher writes the buffered records at least this often
+static constexpr uint64_t LOG_SEGMENT_SIZE = 16 * 1024 * 1024; //bytes per log segment file
+static constexpr uint32_t LOG_SEGMENT_SPARE_NUM = 2; //segments no longer needed are kept this many for reuse, the others deleted
+static constexpr uint32_t REDO_THREAD_NUM = 4; //recovery replays the records of different pages on this many threads
+static constexpr uint32_t REDO_QUEUE_SIZE = 256; //records queued per redo thread at most
+static constexpr bool ENABLE_BG_CHECKPOINT = true; //take fuzzy checkpoints in the background while sessions run
+static constexpr uint32_t CHECKPOINT_INTERVAL_MS = 30000; //a checkpoint is taken after this long if the log has grown
+static constexpr uint64_t CHECKPOINT_LOG_SIZE = 16 * 1024 * 1024; //or once this many bytes were logged since the last one
+static constexpr bool ENABLE_DEADLOCK_DETECTION = true; //abort the youngest transaction of each cycle in the waits-for graph
+static constexpr uint32_t DEADLOCK_DETECT_INTERVAL_MS = 50; //the waits-for graph is built this often
+static constexpr uint32_t VERSION_COLLECT_THRESHOLD = 1024; //old tuple versions kept before the ones no snapshot needs are dropped
+static constexpr uint32_t SERVER_WORKER_NUM = 16; //sessions the server runs at once, more connections wait for a free worker
+static constexpr uint32_t SERVER_MAX_FRAME_SIZE = 64 * 1024 * 1024; //bytes of a request or response frame at most
 static constexpr bool TEST_CONC = false && (THREAD_MAXNUM > 1);
 
 #endif  // MINISQL_SETTING_H
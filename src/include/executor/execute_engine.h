@@ -1,8 +1,10 @@
 #ifndef MINISQL_EXECUTE_ENGINE_H
 #define MINISQL_EXECUTE_ENGINE_H
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include "common/dberr.h"
 #include "common/instance.h"
 #include "transaction/transaction.h"
@@ -42,9 +44,11 @@ public:
    for (auto it : dbs_) {
      it.second->bpm_->FlushAll();//flush before quit for each database
      it.second->disk_mgr_->FlushAllMeta();//close disk to flush meta pages of disk
+     it.second->disk_mgr_->Sync();
      delete it.second;
    }
    delete heap_;
+   session_num_--;
   }
 
   /**
@@ -52,6 +56,11 @@ public:
    */
   dberr_t Execute(pSyntaxNode ast, ExecuteContext *context);
 
+  /**
+   * the session of context is over, roll back the transaction it left running
+   */
+  void EndSession(ExecuteContext *context);
+
 private:
   dberr_t ExecuteCreateDatabase(pSyntaxNode ast, ExecuteContext *context);
 
@@ -92,7 +101,8 @@ private:
   dberr_t ExecuteQuit(pSyntaxNode ast, ExecuteContext *context);
 
   //my member functions
-  dberr_t SelectTuples(const pSyntaxNode ast, ExecuteContext *context,TableInfo* tinfo, vector<IndexInfo*> iinfos, vector<Row>* row);//select the rows according to the condition node
+  dberr_t SelectTuples(const pSyntaxNode ast, ExecuteContext *context,TableInfo* tinfo, vector<IndexInfo*> iinfos, vector<Row>* row, bool snapshot = false,
+                       std::shared_ptr<BufferAccessStrategy> strategy = nullptr);//select the rows according to the condition node, in the snapshot of the transaction or under the row locks. a full scan reads through strategy if given
   
   bool CompareSuccess(Field* f, pSyntaxNode p_comp, pSyntaxNode p_val, ExecuteContext *context);
 
@@ -100,6 +110,8 @@ private:
 
   bool RowSatisfyCondition(const Row &row, pSyntaxNode cond_root_ast, TableInfo *tinfo, ExecuteContext *context);//judge if a row satisfy the condition generated by the tree
 
+  bool LockTable(ExecuteContext *context, const string &table_name, TableInfo *&tinfo, LockMode mode);//lock the table until the transaction ends, its tinfo is fetched once locked. false if it does not exist
+
 
 public:
 
@@ -114,6 +126,13 @@ public:
   std::fstream engine_meta_io_;  // get meta message about existed databases(their name)
   MemHeap * heap_;
   int thread_id_;
+  static std::atomic<uint32_t> session_num_;//engines alive, one per session
 };
 
+/**
+ * parse a statement under the parser latch, the tree returned is freed by FreeSyntaxTree.
+ * nullptr with the message in error if the statement is invalid
+ */
+pSyntaxNode ParseStatement(const char *sql, std::string *error);
+
 #endif //MINISQL_EXECUTE_ENGINE_H
@@ -4,8 +4,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <queue>
+#include <shared_mutex>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "common/config.h"
@@ -26,6 +29,13 @@
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * Sessions use a tree at the same time, synchronized by latch crabbing: a page is latched before the latch of its
+ * parent (the root latch for the root page) is released. Lookups and iterators go down with read latches. Insert and
+ * Remove first go down the same way and write latch only the leaf, which is enough when the leaf neither splits,
+ * underflows nor changes its first key; otherwise they go down again with write latches, and release the ones above a
+ * page as soon as that page is safe, i.e. the change stops there. Siblings are write latched from left to right, the
+ * order in which lookups cross the leaves.
  */
 
 class BPlusTree {
@@ -43,6 +53,9 @@ class BPlusTree {
   explicit BPlusTree(index_id_t index_id, BufferPoolManager *buffer_pool_manager, KeyComparator cmp,size_t keysize , size_t leaf_max_size_ , size_t internal_max_size_);
 
   void Init(index_id_t index_id, BufferPoolManager *buffer_pool_manager, size_t keysize , size_t leaf_max_size_ , size_t internal_max_size_);
+  // read the root page id from the index roots page
+  void LoadRootPageId();
+
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
 
@@ -65,14 +78,16 @@ class BPlusTree {
 
   BPlusTreeIndexIterator End();
 
-  // expose for test purpose
-  Page *FindLeafPage(const IndexKey &key, bool leftMost = false);
+  // the leaf where key belongs, or the leftmost one: pinned and read latched (write latched if to_write), the caller
+  // unpins it. nullptr if the tree is empty
+  Page *FindLeafPage(const IndexKey *key, bool leftMost = false, bool to_write = false);
 
   // used to check whether all pages are unpinned
   bool Check();
 
-  // destroy the b plus tree
-  void Destroy();
+  // destroy the b plus tree, the pages before the root entry. at recovery freed holds the pages freed already, with
+  // the pages under them
+  void Destroy(const std::unordered_set<page_id_t> *freed = nullptr);
 
   bool CheckIntergrity();
 
@@ -80,12 +95,51 @@ class BPlusTree {
   void PrintTree(std::ostream &out);
 
  private:
+  // the root latch and the pages write latched by a pessimistic insert or remove, from the highest one that may change.
+  // The changes it makes are a structure modification for recovery, which ends with the last page latched
+  struct WritePath {
+    std::unique_lock<std::shared_mutex> root_lock_;
+    std::vector<page_id_t> pages_;
+    std::vector<page_id_t> deleted_;  // unlinked by the change, freed after its end
+    bool ended_ = false;
+  };
+
+  // insert or remove with only the leaf write latched. false if the tree above the leaf may change, nothing is done
+  bool OptimisticInsert(const IndexKey *key, const RowId &value, bool *inserted);
+
+  bool OptimisticRemove(const IndexKey *key);
+
   BPlusTreePage *InternalInsert(BPlusTreePage *destination, const IndexKey *key, const RowId &value, IndexKey **newkey,
-                                bool *found, bool *modified);
+                                bool *found, bool *modified, WritePath *path);
+
+  int InternalRemove(BPlusTreePage *destination, const IndexKey *key, IndexKey **newKey, bool *modified,
+                     WritePath *path);
+
+  // whether the pages above page are left unchanged by inserting or removing key below it
+  bool InsertSafe(BPlusTreePage *page, const IndexKey *key, bool is_root);
+
+  bool RemoveSafe(BPlusTreePage *page, const IndexKey *key, bool is_root);
+
+  // unlatch and unpin the pages of the path, and release the root latch
+  void ReleasePath(WritePath *path);
+
+  // unlatch and unpin a page of the path, unless it was released already
+  void UnpinPathPage(WritePath *path, page_id_t page_id, bool is_dirty);
+
+  // end the structure modification of the path, if its last page did not, and free the pages it unlinked
+  void FinishPath(WritePath *path);
+
+  // the child of an internal page where key belongs
+  int ChildIndex(BPlusTreeInternalPage *page, const IndexKey *key);
+
+  // the iterator at index of a pinned and read latched leaf, or the first entry after it along the leaf chain, which
+  // is latched from left to right. The leaves are unpinned
+  BPlusTreeIndexIterator IteratorAt(Page *page, int index, Schema *key_schema);
 
-  int InternalRemove(BPlusTreePage *destination, const IndexKey *key, IndexKey **newKey, bool *modified);
+  // the iterator at the first key greater than key, for an iterator that is done with its leaf
+  BPlusTreeIndexIterator After(const IndexKey *key, Schema *key_schema);
 
-  void InternalDestory(page_id_t page);
+  void InternalDestory(page_id_t page, const std::unordered_set<page_id_t> *freed);
   // useless function
 
   bool AdjustRoot(BPlusTreePage *node);
@@ -99,12 +153,17 @@ class BPlusTree {
 
   // member variable
   index_id_t index_id_;
+  // protects root_page_id_, latched like the parent of the root page
+  std::shared_mutex root_latch_;
   page_id_t root_page_id_;
   KeyComparator comparator_;
   BufferPoolManager *buffer_pool_manager_;
   key_size_t key_size_;
   int leaf_max_size_;
   int internal_max_size_;
+  // leaves and internal pages are kept apart, so the leaf chain of a range scan is mostly contiguous on disk
+  AllocationHint leaf_alloc_hint_;
+  AllocationHint internal_alloc_hint_;
 };
 
 #endif  // MINISQL_B_PLUS_TREE_H
@@ -2,6 +2,7 @@
 #define MINISQL_B_PLUS_TREE_INDEX_H
 
 #include <cstddef>
+#include <vector>
 #include "common/rowid.h"
 #include "index/b_plus_tree.h"
 #include "index/index.h"
@@ -35,12 +36,12 @@ public:
 
  protected:
 
-  void AdjustBufferFor(const Row& row);
+  // serialize key into a buffer of the caller, sessions use the index at the same time
+  IndexKey *SerializeKey(const Row &key, std::vector<char> &buffer);
   // comparator for key
   // container
   BPlusTree container_;
   key_size_t key_size_;
-  char * serialize_buffer_;
   size_t buffer_size_;
 };
 
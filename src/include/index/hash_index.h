@@ -2,6 +2,7 @@
 #define MINISQL_HASH_INDEX_H
 
 #include <cstddef>
+#include <mutex>
 #include "common/rowid.h"
 #include "index/index_key.h"
 #include "buffer/buffer_pool_manager.h"
@@ -29,6 +30,8 @@ protected:
   key_size_t key_size_;
   char * serialize_buffer_;
   size_t buffer_size_;
+  // the hash table and the key buffer are used by one session at a time
+  std::mutex latch_;
 };
 
 #endif  // MINISQL_HASH_INDEX_H
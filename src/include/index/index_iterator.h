@@ -1,18 +1,26 @@
 #ifndef MINISQL_INDEX_ITERATOR_H
 #define MINISQL_INDEX_ITERATOR_H
 
+#include <memory>
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/read_ahead.h"
 #include "record/row.h"
 
 struct BLeafEntry;
 class BPlusTree;
 class BPlusTreeLeafPage;
 
+/**
+ * BPlusTreeIndexIterator walks the leaves of a B+ tree. It copies the leaf it is at, and holds neither a pin nor a
+ * latch between calls, so a session may keep several iterators while other sessions change the tree. Once done with
+ * the copy, it looks up the key after the last one it returned, and sees the leaves as they are by then.
+ */
 class BPlusTreeIndexIterator {
  public:
   // you may define your own constructor based on your member variables
   explicit BPlusTreeIndexIterator();
-  BPlusTreeIndexIterator(BPlusTree *tree,Schema * key_schema, BPlusTreeLeafPage *node, int offset);
+  // node is copied, the caller keeps it latched meanwhile
+  BPlusTreeIndexIterator(BPlusTree *tree,Schema * key_schema, const BPlusTreeLeafPage *node, int offset);
 
   ~BPlusTreeIndexIterator();
 
@@ -36,9 +44,11 @@ class BPlusTreeIndexIterator {
   // add your own private member variables here
   BPlusTree *tree_;
   // Schema * key_schema_;
+  std::shared_ptr<char[]> leaf_;  // copy of the leaf, shared by copies of the iterator
   BPlusTreeLeafPage *node_;
   int index_offset_;
   Schema * key_schema_;
+  std::shared_ptr<ReadAhead> read_ahead_;  // sequential read-ahead along the leaf chain, shared by copies
 };
 
 #endif  // MINISQL_INDEX_ITERATOR_H
@@ -82,8 +82,8 @@ public:
 
     int column_count = key_schema_->GetColumnCount();
 
-    Row lhs_key(INVALID_ROWID, heap_);
-    Row rhs_key(INVALID_ROWID, heap_);
+    Row lhs_key(INVALID_ROWID, &heap_);
+    Row rhs_key(INVALID_ROWID, &heap_);
 
     lhs->DeserializeToKey(lhs_key, key_schema_);
     rhs->DeserializeToKey(rhs_key, key_schema_);
@@ -102,18 +102,13 @@ public:
     return 0;
   }
 
-  IndexKeyComparator(const IndexKeyComparator& other) {
-    this->key_schema_ = other.key_schema_;
-    heap_ = new UsedHeap;
-  }
-
   // constructor
-  IndexKeyComparator(Schema* key_schema): key_schema_(key_schema) { heap_ = new UsedHeap; }
-  ~IndexKeyComparator() { delete heap_; }
+  IndexKeyComparator(Schema* key_schema): key_schema_(key_schema) {}
 
 private:
   Schema* key_schema_;
-  MemHeap* heap_;
+  // the keys are deserialized in a heap of the calling thread, sessions compare keys of one tree at the same time
+  static inline thread_local UsedHeap heap_;
 };
 
 #endif
\ No newline at end of file
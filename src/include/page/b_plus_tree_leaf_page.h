@@ -66,6 +66,11 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   // helper methods
   page_id_t GetNextPageId() const;
 
+  // next page id read from raw page data, for read-ahead
+  static page_id_t NextPageIdOf(const char *page_data) {
+    return reinterpret_cast<const BPlusTreeLeafPage *>(page_data)->next_page_id_;
+  }
+
   static constexpr size_t GetHeaderSize() { return sizeof(BPlusTreeLeafPage); }
 
   size_t GetEntrySize() const { return sizeof(BLeafEntry) + GetKeySize(); }
@@ -30,6 +30,27 @@ class BitmapPage {
    */
   bool IsPageFree(uint32_t page_offset) const;
 
+  /**
+   * @param page_offset Index in extent of the page to allocate.
+   * @return true if the page was free and is allocated now.
+   */
+  bool AllocatePageAt(uint32_t page_offset);
+
+  /**
+   * @param from Index in extent to start searching at.
+   * @param page_offset Index in extent of the first free page at or after from.
+   * @return false if there is no such page.
+   */
+  bool NextFreePage(uint32_t from, uint32_t &page_offset) const;
+
+  /**
+   * @param run_size Number of pages of the run, the run starts at a multiple of run_size.
+   * @param from Index in extent to start searching at.
+   * @param run_offset Index in extent of the first page of the first free run at or after from.
+   * @return false if there is no such run.
+   */
+  bool FindFreeRun(uint32_t run_size, uint32_t from, uint32_t &run_offset) const;
+
  private:
   /**
    * check a bit(byte_index, bit_index) in bytes is free(value 0).
@@ -15,7 +15,7 @@
  *
  * Bucket page format (keys are stored in order):
  *  ---------------------------------------
- * | key_size_ | SLOT[1] | ...... | SLOT[N]
+ * | key_size_ | LSN | SLOT[1] | ...... | SLOT[N]
  *  ---------------------------------------
  * SLOT[i] = KEY[i] + VALUE[i] + OCCUPIED[i] + READABLE[i]
  * 
@@ -198,7 +198,7 @@ public:
 
   uint32_t GetMaxSlotNum() const
   {
-    return (PAGE_SIZE - sizeof(key_size_)) / GetSlotSize();
+    return (PAGE_SIZE - sizeof(key_size_) - sizeof(lsn_)) / GetSlotSize();
   }
 
   uint32_t GetKeyOffset(uint32_t idx) const
@@ -223,6 +223,7 @@ public:
 
 private:
   key_size_t key_size_;
+  lsn_t lsn_;  // page lsn, maintained by the buffer pool
   char slot_data_[0];
 };
 
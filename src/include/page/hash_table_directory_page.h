@@ -17,7 +17,7 @@
  *
  * Directory format (size in byte):
  * --------------------------------------------------------------------------------------------
- * | PageId(4) | GlobalDepth(4) | LocalDepths(1*512) | BucketPageIds(4*512) | Free(1528)
+ * | PageId(4) | LSN(4) | GlobalDepth(4) | LocalDepths(1*512) | BucketPageIds(4*512) | Free(1524)
  * --------------------------------------------------------------------------------------------
  */
 
@@ -143,6 +143,7 @@ public:
 
 private:
   page_id_t page_id_; 
+  lsn_t lsn_;  // page lsn, maintained by the buffer pool
   uint32_t global_depth_{0};
   uint8_t local_depths_[MAX_HASH_BUCKET_PAGE_NUM];
   page_id_t bucket_page_ids_[MAX_HASH_BUCKET_PAGE_NUM];
@@ -11,7 +11,7 @@
  *
  * Format (size in byte):
  *  -----------------------------------------------------------------
- * | RecordCount (4) | Index_1 id (4) | Index_1 root_id (4) | ... |
+ * | RecordCount (4) | LSN (4) | Index_1 id (4) | Index_1 root_id (4) | ... |
  *  -----------------------------------------------------------------
  */
 class IndexRootsPage {
@@ -29,8 +29,11 @@ class IndexRootsPage {
 
   int GetIndexCount() { return count_; }
 
+  // return the largest index id with a root if there is one
+  bool GetMaxIndexId(index_id_t *index_id);
+
  private:
-  static constexpr int MAX_INDEX_COUNT = (PAGE_SIZE - 4) / 8;
+  static constexpr int MAX_INDEX_COUNT = (PAGE_SIZE - 8) / 8;
 
   int FindIndex(const index_id_t index_id);
 
@@ -39,6 +42,7 @@ class IndexRootsPage {
 
  private:
   int count_;
+  lsn_t lsn_;  // page lsn, maintained by the buffer pool
   std::pair<index_id_t, page_id_t> roots_[0];
 };
 
@@ -45,6 +45,11 @@ class TablePage : public Page {
 
   page_id_t GetNextPageId() { return *reinterpret_cast<page_id_t *>(GetData() + OFFSET_NEXT_PAGE_ID); }
 
+  // next page id read from raw page data, for read-ahead
+  static page_id_t NextPageIdOf(const char *page_data) {
+    return *reinterpret_cast<const page_id_t *>(page_data + OFFSET_NEXT_PAGE_ID);
+  }
+
   void SetPrevPageId(page_id_t prev_page_id) {
     memcpy(GetData() + OFFSET_PREV_PAGE_ID, &prev_page_id, sizeof(page_id_t));
   }
@@ -102,6 +107,9 @@ class TablePage : public Page {
     memcpy(GetData() + OFFSET_TUPLE_SIZE + SIZE_TUPLE * slot_num, &size, sizeof(uint32_t));
   }
 
+  // lock the rid of a slot for a new tuple, without waiting
+  bool LockSlot(uint32_t slot_num, Transaction *txn, LockManager *lock_manager);
+
   bool IsEmpty() {
     RowId new_rid;
     this->GetFirstTupleRid(&new_rid);  // if no first tuple, new_rid will be set to (INVALID_PAGE_ID, 0) in this function
@@ -0,0 +1,27 @@
+#ifndef MINISQL_PROTOCOL_H
+#define MINISQL_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Frames exchanged by the server and its clients over a stream socket: the length of the payload as 4 bytes in
+ * network byte order, then the payload.
+ *
+ * A request carries one statement, ended by ';' as typed in the REPL. Its response starts with a ResponseStatus byte
+ * followed by the output of the statement. Requests are answered in the order they are sent, so a client may send
+ * several of them before reading the responses.
+ */
+enum class ResponseStatus : uint8_t { SUCCESS, FAILURE };
+
+/** Send a frame holding data. false if the peer is gone. */
+bool SendFrame(int fd, const std::string &data);
+
+/** Receive the next frame into data. false at the end of the stream, on an error or on a frame over the size limit. */
+bool RecvFrame(int fd, std::string *data);
+
+bool SendResponse(int fd, ResponseStatus status, const std::string &output);
+
+bool RecvResponse(int fd, ResponseStatus *status, std::string *output);
+
+#endif  // MINISQL_PROTOCOL_H
@@ -0,0 +1,56 @@
+#ifndef MINISQL_SERVER_H
+#define MINISQL_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "common/macros.h"
+
+/**
+ * Server runs the sessions of local clients connected to a Unix domain socket, see server/protocol.h for what they
+ * exchange.
+ *
+ * A connection is a session: it is served by one worker of a fixed pool, with its own ExecuteEngine and
+ * ExecuteContext, until the client quits or disconnects, and the transaction it leaves running is rolled back.
+ * Connections beyond the size of the pool wait for a free worker.
+ */
+class Server {
+ public:
+  Server(std::string socket_path, uint32_t worker_num);
+
+  ~Server();
+
+  DISALLOW_COPY(Server);
+
+  /** Listen on the socket and serve the clients until Stop(). false if the socket can not be set up. */
+  bool Run();
+
+  /**
+   * Make Run() return, after the sessions are over. It only sets a flag and shuts the socket down, so signal handlers
+   * may call it.
+   */
+  void Stop();
+
+ private:
+  void Work(int worker_id);
+
+  void Serve(int fd, int worker_id);
+
+  std::string socket_path_;
+  uint32_t worker_num_;
+  int listen_fd_{-1};
+  std::atomic<bool> stop_{false};
+
+  std::mutex latch_;  // protects pending_ and active_
+  std::condition_variable cv_;
+  std::queue<int> pending_;         // connections waiting for a worker
+  std::unordered_set<int> active_;  // connections being served, shut down by Run() to stop their sessions
+  std::vector<std::thread> workers_;
+};
+
+#endif  // MINISQL_SERVER_H
@@ -6,16 +6,21 @@
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include "buffer/replacer.h"
 #include "buffer/lru_replacer.h"
 #include "buffer/clock_replacer.h"
+#include "buffer/lru_k_replacer.h"
 #include "common/config.h"
 #include "common/macros.h"
 #include "page/bitmap_page.h"
 #include "page/disk_file_meta_page.h"
+#include "storage/page_io_queue.h"
 #include "transaction/log_manager.h"
 
 /**
@@ -40,6 +45,26 @@ public:
   char data_[PAGE_SIZE];
 };
 
+/**
+ * AllocationHint keeps the pages of one table heap or index physically together.
+ * The first allocation through a hint reserves a run of ALLOCATION_RUN_SIZE consecutive free pages, and the following
+ * ones hand out that run in order before the next run is reserved. While the hint lives, no other allocation takes
+ * pages of its run. The reservation is not persistent, after a restart a hint just starts with a new run.
+ */
+class AllocationHint {
+  friend class DiskManager;
+
+public:
+  AllocationHint() : token_(std::make_shared<char>(0)) {}
+  AllocationHint(const AllocationHint &) = delete;
+  AllocationHint &operator=(const AllocationHint &) = delete;
+
+private:
+  page_id_t next_page_id_{INVALID_PAGE_ID};  // next page of the reserved run
+  page_id_t run_end_{INVALID_PAGE_ID};       // first page after the reserved run
+  std::shared_ptr<char> token_;              // the reservation lapses with it
+};
+
 class DiskManager {
 public:
   explicit DiskManager(const std::string &db_file, LogManager* log_manager);
@@ -58,17 +83,50 @@ public:
    */
   void WritePage(page_id_t logical_page_id, const char *page_data);
 
+  /**
+   * Write a batch of pages (logical page id, data). The pages are sorted by their physical position and every run of
+   * adjacent pages goes out with a single pwritev, so flushing many pages is a few large sequential writes.
+   * Like WritePage, free pages are skipped.
+   */
+  void WritePages(const std::vector<std::pair<page_id_t, const char *>> &pages);
+
+  /**
+   * Create a queue for asynchronous page io on the db file (io_uring if ENABLE_IO_URING and the kernel allows it,
+   * pread/pwrite otherwise). The queue belongs to the calling thread and must be deleted before the disk manager.
+   */
+  PageIOQueue *CreateIOQueue(size_t depth = IO_QUEUE_DEPTH);
+
+  /**
+   * Queue a read of a page on io_queue, callback runs when page_data is filled in.
+   * Like ReadPage, a free page completes at once without touching page_data.
+   */
+  void ReadPageAsync(PageIOQueue *io_queue, page_id_t logical_page_id, char *page_data, IOCallback callback);
+
+  /**
+   * Queue a write of a page on io_queue, page_data must stay valid until callback runs.
+   * Like WritePage, a free page completes at once without being written.
+   */
+  void WritePageAsync(PageIOQueue *io_queue, page_id_t logical_page_id, const char *page_data, IOCallback callback);
+
   /**
    * Get next free page from disk
+   * @param hint if given, the page comes from the run reserved by the hint (see AllocationHint)
    * @return logical page id of allocated page
    */
-  page_id_t AllocatePage();
+  page_id_t AllocatePage(AllocationHint *hint = nullptr);
 
   /**
    * Free this page and reset bit map
    */
   void DeAllocatePage(page_id_t logical_page_id);
 
+  /**
+   * Mark a free page allocated in its bitmap page and the disk meta page. Recovery uses it to allocate the very page
+   * a log record refers to.
+   * @return false if the page is not free
+   */
+  bool AllocatePageAt(page_id_t logical_page_id);
+
   /**
    * Return whether specific logical_page_id is free
    */
@@ -79,8 +137,14 @@ public:
    */
   bool FlushAllMeta();
 
+  /**
+   * Force written pages to stable storage (fdatasync). Page writes are plain pwrite calls and only
+   * become durable here, so callers invoke this at checkpoint points.
+   */
+  bool Sync();
+
    /**
-   * Flush abd close the file
+   * Flush, sync and close the file
    */
   void Close();
 
@@ -120,17 +184,31 @@ private:
    */
   void WritePhysicalPage(page_id_t physical_page_id, const char *page_data);
 
+  /**
+   * Write pages given by physical page id, coalescing adjacent ones (see WritePages). Sorts pages in place.
+   */
+  void WritePhysicalPages(std::vector<std::pair<page_id_t, const char *>> &pages);
+
   /**
    * Map logical page id to physical page id
    */
   page_id_t MapPageId(page_id_t logical_page_id);
+
+  /** Allocate the next free page of the run reserved by hint. */
+  bool AllocateFromRun(AllocationHint *hint, page_id_t &logical_page_id);
+
+  /** Reserve a new run of free pages for hint, releasing its current one. */
+  bool ReserveRun(AllocationHint *hint);
+
+  /** Whether the page belongs to a run reserved by a live hint. */
+  bool IsPageReserved(page_id_t logical_page_id);
   
 
 private:
-  // stream to write db file
-  std::fstream db_io_;
+  // descriptor of db file, pages are accessed with positional pread/pwrite so no shared cursor needs a lock
+  int db_fd_{-1};
   std::string file_name_;
-  // with multiple buffer pool instances, need to protect file access
+  // protects open/close and meta flushing, not the page io itself
   std::recursive_mutex db_io_latch_;
   bool closed{false};
 
@@ -141,9 +219,12 @@ private:
   LogManager* log_manager_;
   std::unordered_map<extent_id_t, PageData> old_bitmappage_map_;
   PageData old_diskmeta_data_;
-  Transaction * cur_txn_;
+  static thread_local Transaction * cur_txn_;//transaction of the calling session
   //std::list<frame_id_t> free_list_;  we do not need this free list at all. it is slow. Just use map.
 
+  // first page of reserved run -> token of the hint holding it
+  std::unordered_map<page_id_t, std::weak_ptr<char>> reserved_runs_;
+
   Page* diskmeta_page_;
   Page *bitmap_page_cache_;
   std::recursive_mutex latch_;
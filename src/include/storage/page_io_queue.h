@@ -0,0 +1,87 @@
+#ifndef MINISQL_PAGE_IO_QUEUE_H
+#define MINISQL_PAGE_IO_QUEUE_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+/** Called when an asynchronous page io completes, with whether it succeeded. */
+typedef std::function<void(bool)> IOCallback;
+
+/**
+ * PageIOQueue submits page reads and writes of a file in batches and runs a callback for each of them on completion.
+ * It is backed by an io_uring when the kernel supports it, otherwise Submit() performs the requests synchronously
+ * with pread/pwrite and runs the callbacks right away, so callers are written the same way in both cases.
+ *
+ * A queue is not thread safe, every io thread owns its own. Callbacks run in the owning thread, inside Submit(),
+ * Reap() or WaitAll(), and may prepare new requests.
+ */
+class PageIOQueue {
+ public:
+  /**
+   * @param fd file the pages are read from and written to
+   * @param depth requests in flight at most
+   * @param use_uring try io_uring, fall back to synchronous io if it cannot be set up
+   */
+  PageIOQueue(int fd, size_t depth, bool use_uring);
+
+  /** Waits for the requests in flight. */
+  ~PageIOQueue();
+
+  /** Whether requests are really asynchronous (io_uring is in use). */
+  inline bool IsAsync() const { return ring_ != nullptr; }
+
+  /**
+   * Queue the read of a page at offset into page_data. Nothing is issued until Submit().
+   * A read beyond the end of file zero fills the rest of the page, like DiskManager::ReadPhysicalPage.
+   */
+  void PrepareRead(off_t offset, char *page_data, IOCallback callback);
+
+  /** Queue the write of page_data at offset. page_data must stay valid until the callback runs. */
+  void PrepareWrite(off_t offset, const char *page_data, IOCallback callback);
+
+  /** Issue the prepared requests, as many as the queue depth allows, with a single system call. */
+  void Submit();
+
+  /**
+   * Run the callbacks of completed requests, and submit prepared requests into the room they leave.
+   * @param wait block until at least one request completes, if any is in flight
+   * @return number of requests completed
+   */
+  size_t Reap(bool wait);
+
+  /** Submit everything prepared and wait until all of it (and what the callbacks prepare) has completed. */
+  void WaitAll();
+
+ private:
+  struct Request {
+    bool is_write_;
+    off_t offset_;
+    char *data_;
+    size_t done_;  // bytes transferred so far
+    IOCallback callback_;
+  };
+
+  struct Ring;  // io_uring mappings, only known to the implementation
+
+  bool SetupRing(size_t depth);
+
+  /** io_uring_enter submitting the queued entries, optionally waiting for min_complete completions. */
+  bool Enter(unsigned min_complete);
+
+  /** Transfer the rest of a request with pread/pwrite. */
+  bool SyncTransfer(Request *request);
+
+  /** Handle the result of a transfer, finish a short or failed one synchronously, and run the callback. */
+  void Complete(Request *request, int result);
+
+  int fd_;
+  size_t depth_;
+  Ring *ring_{nullptr};
+  std::deque<Request *> pending_;  // prepared, not handed to the kernel yet
+  size_t in_flight_{0};            // handed to the kernel, not reaped yet
+  unsigned to_submit_{0};          // in the submission ring, not consumed by io_uring_enter yet
+};
+
+#endif  // MINISQL_PAGE_IO_QUEUE_H
@@ -6,22 +6,27 @@
 #include "storage/table_iterator.h" 
 #include "transaction/log_manager.h"
 #include "transaction/lock_manager.h"
+#include "transaction/version_manager.h"
+#include <mutex>
 #include <queue>
+#include <unordered_set>
 
 class TableHeap {
   friend class TableIterator;
 
 public:
   static TableHeap *Create(BufferPoolManager *buffer_pool_manager, Schema *schema, Transaction *txn,
-                           LogManager *log_manager, LockManager *lock_manager, MemHeap *heap) {
+                           LogManager *log_manager, LockManager *lock_manager, VersionManager *version_manager,
+                           MemHeap *heap) {
     void *buf = heap->Allocate(sizeof(TableHeap));
-    return new(buf) TableHeap(buffer_pool_manager, schema, txn, log_manager, lock_manager);
+    return new(buf) TableHeap(buffer_pool_manager, schema, txn, log_manager, lock_manager, version_manager);
   }
 
   static TableHeap *Create(BufferPoolManager *buffer_pool_manager, page_id_t first_page_id, Schema *schema,
-                           LogManager *log_manager, LockManager *lock_manager, MemHeap *heap) {
+                           LogManager *log_manager, LockManager *lock_manager, VersionManager *version_manager,
+                           MemHeap *heap) {
     void *buf = heap->Allocate(sizeof(TableHeap));
-    return new(buf) TableHeap(buffer_pool_manager, first_page_id, schema, log_manager, lock_manager);
+    return new(buf) TableHeap(buffer_pool_manager, first_page_id, schema, log_manager, lock_manager, version_manager);
   }
 
   ~TableHeap() {
@@ -31,6 +36,7 @@ public:
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
+   * The new tuple is locked exclusively for the transaction until it ends, and the insert is added to its writes.
    * @param[in/out] row Tuple Row to insert, the rid of the inserted tuple is wrapped in object row
    * @param[in] txn The transaction performing the insert
    * @return true iff the insert is successful
@@ -38,28 +44,32 @@ public:
   bool InsertTuple(Row &row, Transaction *txn);
 
   /**
-   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
+   * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called, at the commit of the
+   * transaction, which keeps the slot of the tuple until then. Waits for the exclusive lock of the tuple first.
    * @param[in] rid Resource id of the tuple of delete
    * @param[in] txn Transaction performing the delete
+   * @param[in] strategy access strategy of the scan that selected the tuple, if any
    * @return true iff the delete is successful (i.e the tuple exists)
    */
-  bool MarkDelete(const RowId &rid, Transaction *txn);
+  bool MarkDelete(const RowId &rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   /**
-   * if the new tuple is too large to fit in the old page, return false (will delete and insert)
-   * @param[in] row Tuple of new row
+   * Update the tuple in place, or delete it and insert the new one if it does not fit in the page any more.
+   * Waits for the exclusive lock of the tuple first.
+   * @param[in/out] row Tuple of new row, the rid of the updated tuple is wrapped in object row
    * @param[in] rid Rid of the old tuple
    * @param[in] txn Transaction performing the update
    * @return true is update is successful.
    */
-  bool UpdateTuple(const Row &row, const RowId &rid, Transaction *txn);
+  bool UpdateTuple(Row &row, const RowId &rid, Transaction *txn);
 
   /**
    * Called on Commit/Abort to actually delete a tuple or rollback an insert.
    * @param rid Rid of the tuple to delete
    * @param txn Transaction performing the delete.
+   * @param strategy access strategy of the scan that selected the tuple, if any
    */
-  void ApplyDelete(const RowId &rid, Transaction *txn);
+  void ApplyDelete(const RowId &rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   /**
    * Called on abort to rollback a delete.
@@ -69,12 +79,36 @@ public:
   void RollbackDelete(const RowId &rid, Transaction *txn);
 
   /**
-   * Read a tuple from the table.
+   * Called on abort to put back the tuple from before an update. It moves if it does not fit in its page any more,
+   * the other transactions may have taken the space it had: its older versions move along.
+   * @param[in/out] row The tuple before the update, the rid of the tuple is wrapped in object row
+   * @param[in] txn Transaction performing the rollback
+   */
+  void RollbackUpdate(Row &row, Transaction *txn);
+
+  /**
+   * Read a tuple from the table, under the shared lock of the tuple if there is a transaction.
    * @param[in/out] row Output variable for the tuple, row id of the tuple is wrapped in row
    * @param[in] txn transaction performing the read
+   * @param[in] strategy access strategy of the scan reading the tuple, if any
    * @return true if the read was successful (i.e. the tuple exists)
    */
-  bool GetTuple(Row *row, Transaction *txn);
+  bool GetTuple(Row *row, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
+
+  /**
+   * Read the version of a tuple in the snapshot of the transaction, without locking it.
+   * @param[in/out] row Output variable for the tuple, row id of the tuple is wrapped in row
+   * @param[in] txn transaction performing the read, the newest version is read without one
+   * @param[in] strategy access strategy of the scan reading the tuple, if any
+   * @return true if the tuple exists in the snapshot
+   */
+  bool GetVisibleTuple(Row *row, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
+
+  /**
+   * @return the tuples with older versions kept for snapshots. A tuple deleted since a snapshot is not found by
+   * the scans or the indexes any more, only here
+   */
+  std::vector<RowId> GetVersionedRows();
 
   /**
    * Free table heap and release storage in disk file
@@ -82,9 +116,28 @@ public:
   void FreeHeap();
 
   /**
-   * @return the begin iterator of this table
+   * Free the pages of a heap from the last one, a crash in between leaves the others linked from the first page.
+   * The walk stops at a page in freed (freed already, maybe in use again), at recovery
+   */
+  static void FreePages(BufferPoolManager *buffer_pool_manager, page_id_t first_page_id,
+                        const std::unordered_set<page_id_t> *freed = nullptr);
+
+  /**
+   * @return the begin iterator of this table. A table larger than 1/SCAN_RING_THRESHOLD of the buffer pool
+   * is scanned through a ring of SCAN_RING_SIZE frames, so a full scan does not evict other pages
+   * @param[in] txn transaction performing the scan, each tuple is read under its shared lock then
+   * @param[in] snapshot read the tuples in the snapshot of txn instead, without locks
+   * @param[in] heap memory heap of the session for the rows read, the heap of the table without one
+   * @param[in] strategy ring to scan through instead, shared with the statement changing the tuples scanned
    */
-  TableIterator Begin();
+  TableIterator Begin(Transaction *txn = nullptr, bool snapshot = false, MemHeap *heap = nullptr,
+                      std::shared_ptr<BufferAccessStrategy> strategy = nullptr);
+
+  /**
+   * @return the ring of frames a full scan of this table reads through, nullptr if the table is small enough to
+   * stay cached
+   */
+  std::shared_ptr<BufferAccessStrategy> MakeScanStrategy();
 
   /**
    * @return the end iterator of this table
@@ -120,15 +173,42 @@ public:
   TableIterator Find(RowId rid);
 
  private:
+  /**
+   * Put the tuple into the page with the most free space, or a new one. Under latch_
+   */
+  bool InsertIntoPage(Row &row, Transaction *txn);
+
+  /**
+   * Walk the pages from first_page_id_ into page_heap_ and last_page_id_. Under latch_ once the heap is shared
+   */
+  void LoadPages();
+
+  /**
+   * Lock a tuple for the transaction until it ends, true without a lock manager or transaction
+   */
+  bool LockRow(const RowId &rid, Transaction *txn, LockMode mode);
+
+  /**
+   * Keep the image of a tuple before the transaction changes it, for the snapshots not seeing the change
+   * @param page the page of the tuple, nullptr for a tuple just inserted; a tuple just marked deleted keeps its image
+   */
+  void KeepVersion(const RowId &rid, Transaction *txn, TablePage *page);
+
+  /**
+   * Add a write to the transaction, logged first when there is a log manager, before the page is unpinned
+   */
+  void AddWrite(Transaction *txn, WriteRecord write);
+
   /**
    * create table heap and initialize first page
    */
   explicit TableHeap(BufferPoolManager *buffer_pool_manager, Schema *schema, Transaction *txn,
-                     LogManager *log_manager, LockManager *lock_manager) :
+                     LogManager *log_manager, LockManager *lock_manager, VersionManager *version_manager) :
           buffer_pool_manager_(buffer_pool_manager),
           schema_(schema),
           log_manager_(log_manager),
-          lock_manager_(lock_manager) {
+          lock_manager_(lock_manager),
+          version_manager_(version_manager) {
     //add my code
     first_page_id_ = INVALID_PAGE_ID;
     heap_ = new UsedHeap;
@@ -138,27 +218,15 @@ public:
    * load existing table heap by first_page_id
    */
   explicit TableHeap(BufferPoolManager *buffer_pool_manager, page_id_t first_page_id, Schema *schema,
-                     LogManager *log_manager, LockManager *lock_manager)
+                     LogManager *log_manager, LockManager *lock_manager, VersionManager *version_manager)
           : buffer_pool_manager_(buffer_pool_manager),
             first_page_id_(first_page_id),
             schema_(schema),
             log_manager_(log_manager),
-            lock_manager_(lock_manager) {
+            lock_manager_(lock_manager),
+            version_manager_(version_manager) {
     heap_ = new UsedHeap;
-    if(first_page_id != INVALID_PAGE_ID){
-      last_page_id_ = first_page_id;
-
-      page_id_t cur_pid = first_page_id;
-      //initialize page heap (cost time?) (potential pin problem)
-      while(cur_pid!=INVALID_PAGE_ID)
-      {
-        page_heap_.push(make_pair(this, cur_pid));
-        Page * p = buffer_pool_manager_->FetchPage(cur_pid, false);
-        auto page = reinterpret_cast<TablePage *>(p);
-        cur_pid = page->GetNextPageId();
-        buffer_pool_manager_->UnpinPage(p->GetPageId(), false);
-      }
-    }
+    LoadPages();
   }
 
 class cmp
@@ -181,11 +249,14 @@ private:
   Schema *schema_;
   LogManager *log_manager_;
   LockManager *lock_manager_;
+  VersionManager *version_manager_;  // older versions of the tuples, keyed by first_page_id_
 
   //add max heap for the remaining size of pages
   priority_queue<pair<TableHeap*, page_id_t>, vector<pair<TableHeap*, page_id_t>>, cmp> page_heap_;
   page_id_t last_page_id_;
+  std::mutex latch_;  // protects page_heap_ and last_page_id_, the sessions inserting into the table share them
   MemHeap * heap_;
+  AllocationHint alloc_hint_;  // keeps the pages of the heap physically together
 };
 
 #endif  // MINISQL_TABLE_HEAP_H
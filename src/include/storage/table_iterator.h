@@ -1,8 +1,12 @@
 #ifndef MINISQL_TABLE_ITERATOR_H
 #define MINISQL_TABLE_ITERATOR_H
 
+#include <memory>
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/read_ahead.h"
 #include "common/rowid.h"
 #include "record/row.h"
+#include "transaction/transaction.h"
 #include "utils/mem_heap.h"
 
 
@@ -14,7 +18,8 @@ public:
   // you ma y  define your own constructor based on your member variables
   explicit TableIterator();
 
-  explicit TableIterator(TableHeap* tbp,const RowId& rid);
+  explicit TableIterator(TableHeap* tbp,const RowId& rid, std::shared_ptr<BufferAccessStrategy> strategy = nullptr,
+                         Transaction *txn = nullptr, bool snapshot = false, MemHeap *heap = nullptr);
 
   TableIterator(const TableIterator &other);
 
@@ -33,11 +38,25 @@ public:
   TableIterator operator++(int);
 
 private:
+  // move rid to the next tuple in the heap
+  void Advance();
+
+  // read the tuple at rid, false if the transaction can not read it: deleted while waiting for its lock, or not in
+  // its snapshot
+  bool ReadRow();
+
+  // report the move to a new page of the heap to the read-ahead of this scan
+  void OnNextPage(page_id_t page_id, page_id_t next_page_id);
+
   // add your own private member variables here
   TableHeap *tbp;
   RowId rid;
-  MemHeap *heap_;
+  MemHeap *heap_;//of the session scanning, the rows of the table heap are not read by one session only
   Row *row;//allocate space for row while do * and ->, based on RowId. (temporary pointer)
+  std::shared_ptr<BufferAccessStrategy> strategy_;//ring of frames for a large scan, shared by copies of the iterator
+  std::shared_ptr<ReadAhead> read_ahead_;//sequential read-ahead state of the scan, shared by copies of the iterator
+  Transaction *txn_;//tuples are read under their shared locks for it, the ones deleted while waiting are skipped
+  bool snapshot_;//tuples are read in the snapshot of txn_ instead, the ones not in it are skipped
 };
 
 #endif //MINISQL_TABLE_ITERATOR_H
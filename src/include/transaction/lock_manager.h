@@ -1,19 +1,100 @@
 #ifndef MINISQL_LOCK_MANAGER_H
 #define MINISQL_LOCK_MANAGER_H
 
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "common/config.h"
+#include "common/macros.h"
+#include "common/rowid.h"
 #include "transaction/transaction.h"
+
+//intention modes are taken on tables before the rows in them are locked
+enum class LockMode { INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED, SHARED_INTENTION_EXCLUSIVE, EXCLUSIVE };
+
 /**
- * LockManager handles transactions asking for locks on pages.
+ * LockManager handles transactions asking for locks on tables and rows.
+ *
+ * Strict two-phase locking: locks are only taken while a transaction is growing and are all released together
+ * when it commits or aborts. A request waits in the FIFO queue of its table or row until it is compatible with the
+ * granted locks and the requests ahead of it. A transaction asking again for a stronger mode upgrades its lock,
+ * ahead of the waiting requests.
  *
+ * Deadlocks are broken in the background: the waits-for graph is built from the lock table periodically and the
+ * youngest transaction of each cycle is marked aborted. Its lock request fails, and its session rolls it back
+ * through TransactionManager::Abort, which releases its locks.
  */
-class LockManager 
+class LockManager
 {
 public:
-    void SLock(page_id_t pid, Transaction* txn);
-    void SUnlock(page_id_t pid, Transaction* txn);
-    void Xlock(page_id_t pid, Transaction* txn);
-    void XUnlock(page_id_t pid, Transaction* txn);
+    LockManager() = default;
+    ~LockManager()
+    {
+        StopDeadlockDetection();
+    }
+
+    bool LockTable(Transaction* txn, table_id_t table_id, LockMode mode);//false if the transaction can not lock
+    bool LockRow(Transaction* txn, const RowId& rid, LockMode mode);//SHARED or EXCLUSIVE
+    //without waiting: false at once if the lock is not grantable now, e.g. under a page latch
+    bool TryLockRow(Transaction* txn, const RowId& rid, LockMode mode);
+    void UnlockAll(Transaction* txn);//at commit or abort
+
+    void StartDeadlockDetection();
+    void StopDeadlockDetection();
+    //abort the youngest transaction of each cycle of waiting transactions, returns the victims
+    std::vector<txn_id_t> DetectDeadlock();
+
 private:
+    struct LockKey
+    {
+        bool is_table_;
+        int64_t id_;//table id or RowId::Get()
+        bool operator==(const LockKey& other) const { return is_table_ == other.is_table_ && id_ == other.id_; }
+    };
+    struct LockKeyHash
+    {
+        size_t operator()(const LockKey& key) const { return std::hash<int64_t>()(key.id_) ^ key.is_table_; }
+    };
+    struct LockRequest
+    {
+        Transaction* txn_;
+        txn_id_t tid_;
+        LockMode mode_;//granted mode, or the one waited for
+        LockMode upgrade_mode_;//mode waited for by a granted request being upgraded
+        bool granted_;
+        bool upgrading_;
+    };
+    struct LockRequestQueue
+    {
+        std::list<LockRequest> requests_;
+        std::condition_variable cv_;
+    };
+
+    bool Lock(Transaction* txn, const LockKey& key, LockMode mode, bool wait = true);
+    bool Grantable(LockRequestQueue& queue, const LockRequest& request);
+    static bool Compatible(LockMode mode1, LockMode mode2);
+    static bool Covers(LockMode held, LockMode mode);//holding held, mode needs no other lock
+    static LockMode Combine(LockMode held, LockMode mode);//the weakest mode covering both
+    //whether waiting is blocked by other, which is another request in the queue of waiting
+    static bool Blocks(const LockRequest& waiting, const LockRequest& other, bool other_ahead);
+    //depth first search from tid for a cycle, which is put into cycle
+    static bool FindCycle(txn_id_t tid, const std::map<txn_id_t, std::set<txn_id_t>>& waits_for,
+                          std::vector<txn_id_t>& path, std::set<txn_id_t>& visited, std::vector<txn_id_t>& cycle);
+    void DeadlockDetector();
+
+    std::mutex latch_;//protects the lock table
+    std::unordered_map<LockKey, LockRequestQueue, LockKeyHash> lock_table_;
+    std::unordered_map<txn_id_t, std::vector<LockKey>> txn_locks_;//keys locked by each transaction
+
+    std::thread detector_thread_;
+    std::mutex detector_latch_;
+    std::condition_variable detector_cv_;
+    bool detector_stop_{false};
 };
 
 #endif //MINISQL_LOCK_MANAGER_H
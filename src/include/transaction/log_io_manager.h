@@ -1,12 +1,23 @@
 #ifndef MINISQL_LOG_IO_MANAGER_H
 #define MINISQL_LOG_IO_MANAGER_H
 
+#include <sys/types.h>
+#include <atomic>
 #include <iostream>
-#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "common/macros.h"
+#include "common/setting.h"
 using namespace std;
-typedef uint32_t ofs_t;
+typedef uint64_t ofs_t;
 
+//sequential io on the log: the log is only ever appended to, and read back by offset.
+//it is stored in segment files of LOG_SEGMENT_SIZE bytes, <log file name>.<segment number>, segment n holding the
+//offsets [n * LOG_SEGMENT_SIZE, (n + 1) * LOG_SEGMENT_SIZE) of the log. records may cross segment boundaries.
+//segments before the part of the log still needed are recycled: renamed to a segment after the end of the log,
+//to be written over later without growing a file. bytes past the end of the log may be left over from before.
 class LogIOManager
 {
 public:
@@ -14,12 +25,33 @@ public:
     ~LogIOManager();
 
     string GetLogFileName(){ return log_file_name_; }
-    void ReadData(char* buf, ofs_t ofs, size_t size); //disk[ofs->ofs+size-1] -> buf[0->size-1]
-    void WriteData(char* buf, ofs_t ofs, size_t size); //buf[0->size-1] -> disk[ofs->ofs+size-1]
+    ofs_t GetFileSize(){ return file_size_; } //the end of the log
+    ofs_t GetStartOffset(){ return start_ofs_; } //offsets before it are in recycled segments
+    bool ReadData(char* buf, ofs_t ofs, size_t size); //disk[ofs->ofs+size-1] -> buf[0->size-1], false if not in the log
+    bool AppendData(const char* buf, size_t size); //buf[0->size-1] -> end of log
+    bool Sync(); //make the appended data durable
+    bool Truncate(ofs_t size); //cut off a torn tail of the log
+    void RecycleBefore(ofs_t ofs); //the log before ofs is not needed any more
+    bool RemoveFiles(); //delete all segments, the log is not used afterwards
 
 private:
+    struct Segment
+    {
+        explicit Segment(int fd): fd_(fd){}
+        ~Segment();
+        int fd_;
+    };
+
+    string GetSegmentFileName(uint64_t seg_no);
+    std::shared_ptr<Segment> GetSegment(uint64_t seg_no, bool create);
+
     string log_file_name_;
-    fstream log_io_;
+    std::atomic<ofs_t> start_ofs_; //start of the first segment in use
+    std::atomic<ofs_t> file_size_; //offset of the next append
+    std::mutex latch_; //protects the segment tables, the data itself is appended by one thread at a time
+    std::map<uint64_t, std::shared_ptr<Segment>> segments_; //open segments in use
+    std::vector<uint64_t> spare_segments_; //recycled segment files after the end of the log
+    std::map<uint64_t, std::shared_ptr<Segment>> unsynced_segments_; //appended to since the last sync
 };
 
-#endif //MINISQL_LOG_IO_MANAGER_H
\ No newline at end of file
+#endif //MINISQL_LOG_IO_MANAGER_H
@@ -0,0 +1,41 @@
+#ifndef MINISQL_LOG_ITERATOR_H
+#define MINISQL_LOG_ITERATOR_H
+
+#include <vector>
+#include "transaction/log_record.h"
+#include "transaction/log_io_manager.h"
+
+class LogManager;
+
+//streams the records of the log forwards or backwards from start_lsn, up to the end of the log as of its creation
+//or down to the first record kept. the log is read in windows of LOG_BUFFER_SIZE bytes, each record is decoded from
+//the window into the same LogRecord, so visiting a record costs neither a read nor an allocation of its own
+class LogIterator
+{
+public:
+    explicit LogIterator(LogManager* log_mgr, lsn_t start_lsn, bool forward = true);
+    ~LogIterator();
+
+    bool Valid() const { return record_ != nullptr && cur_lsn_ >= min_lsn_ && cur_lsn_ <= max_lsn_; }
+    lsn_t GetLSN() const { return cur_lsn_; }
+    LogRecord* operator->() const { return record_; }
+    LogRecord& operator*() const { return *record_; }
+    //the caller takes over the current record, the next ones are decoded into a new one
+    LogRecord* Release();
+    LogIterator& operator++();//to the next record in the direction of the iterator
+
+private:
+    void Load();//decode the record at cur_lsn_, reading the window it is in if needed
+
+    LogManager* log_mgr_;
+    bool forward_;
+    lsn_t cur_lsn_;
+    lsn_t min_lsn_;
+    lsn_t max_lsn_;
+    LogRecord* record_;//nullptr once a read failed
+    std::vector<char> window_;
+    ofs_t window_ofs_;//offset of the window in the log
+    size_t window_size_;
+};
+
+#endif //MINISQL_LOG_ITERATOR_H
@@ -1,7 +1,18 @@
 #ifndef MINISQL_LOG_MANAGER_H
 #define MINISQL_LOG_MANAGER_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "common/dberr.h"
+#include "common/setting.h"
 #include "transaction/log_record.h"
 #include "transaction/log_io_manager.h"
 #include "transaction/transaction.h"
@@ -11,39 +22,88 @@ using namespace std;
 class LogManager {
 public:
     explicit LogManager(string db_name);
-    ~LogManager()
-    {
-        delete log_io_mgr_;
-    }
+    ~LogManager();
 
-    void AddRecord(LogRecord* record);//add a record into stable storage(disk) directly
+    lsn_t AddRecord(LogRecord* record);//assign the next lsn to the record and append it to the log buffer
+    //log a write of the transaction (TXN_WRITE) and add it to the write set of the transaction
+    void AddWrite(Transaction* txn, WriteRecord write);
+    //log that the write of the transaction logged at undone_lsn was undone (COMPENSATE)
+    void AddCompensation(Transaction* txn, lsn_t undone_lsn);
+    dberr_t Flush();//return once all records added so far are durable
+    //return once the log is durable up to lsn. the flusher writes everything buffered when it is asked,
+    //so the waiting committers share one write and one fsync (group commit).
+    //DB_FAILED if a write of the flusher failed meanwhile, the records are kept and written again by the next one
+    dberr_t WaitForFlushed(lsn_t lsn);
+    lsn_t GetPersistentLSN();//the log is durable up to this lsn
+    bool NeedFullImage(page_id_t pid);//whether a write to the page is its first since the last checkpoint, it is logged with full images then
     string GetLogFileName(){ return log_io_mgr_->GetLogFileName(); }
-    void GetRecord(LogRecord* log_rec, lsn_t lsn);
-    lsn_t GetMaxLSN();  
+    bool GetRecord(LogRecord* log_rec, lsn_t lsn);//a single record, use a LogIterator to visit many. false if it is not in the log
+    //where the record starts in the log, lsn one past the last record gives the end of the log.
+    //false if the record was discarded or does not exist yet
+    bool GetRecordOffset(lsn_t lsn, ofs_t* ofs);
+    //log[ofs->ofs+size-1] -> buf[0->size-1], from the file and the records not written yet
+    bool ReadLog(char* buf, ofs_t ofs, size_t size);
+    lsn_t GetMaxLSN();
+    lsn_t GetMinLSN();//the first record still in the log, the ones before were discarded
+    //begin record of the oldest transaction running or committed with its writes not applied yet, INVALID_LSN if
+    //there is none
+    lsn_t GetOldestActiveLSN();
     void ShowAllRecords();
     void ShowRecord(lsn_t lsn);
-    
+
     void ReplacePid(pid_t old_pid, pid_t new_pid);
 
-    // static lsn_t next_lsn_;//initialized to be 0
-
-    //log structure in disk (assume MAX_RECORD_NUMBER = 4096):
-    //| LOG NUM(MAXLSN) | OFS0 | SIZE0 | OFS1 | SIZE1 | ... | OFS4096 | SIZE4096 | LOG0 |     LOG 1    | ... | LOG 4096 |
-    //                  |                                                        |
-    //              META_OFFSET                                              DATA_OFFSET
-    //OFS+SIZE is of fixed length; LOG is of variant length 
-    static constexpr size_t LOG_NUM_OFFSET = 0;
-    static constexpr size_t LOG_NUM_SIZE = sizeof(lsn_t);
-    static constexpr size_t META_OFFSET = LOG_NUM_SIZE;
-    static constexpr size_t OFS_SIZE = sizeof(ofs_t);
-    static constexpr size_t SIZE_SIZE = sizeof(size_t);
-    static constexpr size_t MAX_REC_NUM = MAX_RECORD_NUMBER;
-    static constexpr size_t DATA_OFFSET = META_OFFSET + MAX_REC_NUM * (OFS_SIZE + SIZE_SIZE);
+    //transaction ids, unique among the sessions sharing the log
+    txn_id_t NewTid(){ return next_tid_++; }
+    txn_id_t GetNextTid(){ return next_tid_; }
+    void SetNextTid(txn_id_t tid);//ids from tid on are given out, the ones in the log are not given again
+
+    //bytes in the log, file and buffer
+    uint64_t GetLogSize();
+    //the master record keeps the lsn of the latest checkpoint and where the log needed from then on starts,
+    //it is replaced atomically once the checkpoint is durable
+    void WriteMasterRecord(lsn_t checkpoint_lsn, lsn_t keep_lsn);
+    lsn_t ReadMasterRecord(lsn_t* keep_lsn = nullptr, ofs_t* keep_ofs = nullptr);//INVALID_LSN if there is none
+    //the records before lsn are not needed any more, their segments are recycled
+    void DiscardBefore(lsn_t lsn);
+    //delete the log files, for dropping the database
+    bool RemoveFiles();
+
+    //log structure in disk, a sequential stream of length prefixed records in lsn order (lsn starts at 1):
+    //| SIZE1 | LOG 1 | SIZE2 | LOG 2 | ... | SIZEn | LOG n |
+    //records are appended to the in-memory log buffer, only the flusher thread writes the file: it swaps the log buffer
+    //with the flush buffer and appends that one, every LOG_FLUSH_INTERVAL_MS, when the buffer fills up or when asked to.
+    //the stream is stored in segment files (see LogIOManager), its beginning is discarded after checkpoints
+    static constexpr size_t SIZE_SIZE = sizeof(uint32_t);
 
 private:
-    char log_buf[3*PAGE_SIZE];//buffer for interaction with disk
-    char meta_buf[1024];//meta buffer
+    void FlushThread();//body of the flusher thread
+    void LoadRecordOffsets(ofs_t start_ofs);//scan the log file for the records from start_ofs, cut off a torn tail
+
+    std::recursive_mutex latch_;
+    lsn_t next_lsn_;
+    std::atomic<txn_id_t> next_tid_{0};
+    lsn_t persistent_lsn_;//records up to this lsn are durable
+    std::thread flush_thread_;
+    bool flush_stop_;
+    bool flush_requested_;//someone waits for the buffered records, the flusher goes on without waiting for its interval
+    bool flushing_;//the flusher is writing the flush buffer, latch_ not held
+    std::condition_variable_any flush_cv_;//wakes the flusher
+    std::condition_variable_any flushed_cv_;//a write of the flusher is done: persistent_lsn_ moved and the log buffer has room
+    uint64_t flush_failures_;//writes of the flusher that failed, their records went back to the log buffer
+    std::unordered_set<page_id_t> imaged_pages_;//pages logged with full images since the last checkpoint
+    lsn_t first_lsn_;//lsn of the first record kept
+    std::deque<ofs_t> record_ofs_;//record_ofs_[lsn-first_lsn_] is the offset of the record in the log (file, flush buffer, log buffer)
+    std::unordered_map<txn_id_t, lsn_t> active_txns_;//transactions without an abort or end, and their begin lsns
+    std::vector<char> log_buf_;//the log buffer, LOG_BUFFER_SIZE bytes, grows for a larger record
+    size_t buf_size_;//bytes used in the log buffer
+    ofs_t buf_ofs_;//offset of the log buffer in the log
+    std::vector<char> flush_buf_;//records being written by the flusher
+    size_t flush_size_;
+    ofs_t flush_ofs_;
+    std::vector<char> read_buf_;//buffer for the scan of the log when it is opened
     LogIOManager* log_io_mgr_;
+    string master_file_name_;
 };
 
 #endif //MINISQL_LOG_MANAGER_H
@@ -2,7 +2,9 @@
 #define MINISQL_LOG_RECORD_H
 
 #include <iostream>
+#include <algorithm>
 #include <fstream>
+#include <cstring>
 #include <vector>
 #include <unordered_set>
 #include "common/macros.h"
@@ -15,10 +17,13 @@ class DPT_Record
 {
 public:
     explicit DPT_Record(page_id_t pid, lsn_t page_lsn, lsn_t rec_lsn):pid_(pid),page_lsn_(page_lsn),rec_lsn_(rec_lsn){}
+    page_id_t GetPid() const { return pid_; }
+    lsn_t GetPageLSN() const { return page_lsn_; }
+    lsn_t GetRecLSN() const { return rec_lsn_; }
 private:
     page_id_t pid_;
     lsn_t page_lsn_;
-    lsn_t rec_lsn_;
+    lsn_t rec_lsn_;//the first record that may not be on disk for the page
 };
 class DirtyPageTable
 {
@@ -27,8 +32,20 @@ public:
     {
         dpt_records_.push_back(DPT_Record(pid, page_lsn, rec_lsn));
     }
+    std::vector<DPT_Record>& GetRecords(){ return dpt_records_; }
+    //records from begin_lsn on may have dirtied pages after the table was taken, redo starts at the smallest
+    //of it and the rec lsns
+    void SetBeginLSN(lsn_t begin_lsn){ begin_lsn_ = begin_lsn; }
+    lsn_t GetRedoLSN() const
+    {
+        lsn_t redo_lsn = begin_lsn_;
+        for(auto &rec : dpt_records_)
+            redo_lsn = std::min(redo_lsn, rec.GetRecLSN());
+        return redo_lsn;
+    }
 private:
     std::vector<DPT_Record> dpt_records_;
+    lsn_t begin_lsn_{INVALID_LSN};
 };
 
 class ActiveTransactionTable
@@ -49,15 +66,32 @@ private:
     std::unordered_set<txn_id_t> tids_;
 };
 
+//a changed byte range of a page, for delta records
+struct PageDelta
+{
+    uint32_t offset_;
+    uint32_t size_;
+};
+
 /*
 WRITE: old_data_ != nullptr, new_data_ != nullptr
+WRITE_DELTA: old_data_ == nullptr, new_data_ == nullptr, only the changed ranges in deltas_ (old bytes, new bytes)
 NEW: old_data_ == nullptr, new_data_ != nullptr
 DELETE: old_data_ != nullptr, new_data_ == nullptr
 BEGIN/COMMIT/ABORT/CHECKPOINT: old_data_ == nullptr, new_data_ == nullptr
 dpt_ != nullptr if and only if type_ = CHECK_POINT
+CHECK_POINT: tid_ is the next transaction id, so that ids stay unique when the records before it are discarded
+TXN_WRITE: a write of the transaction (write_), logged before the pages it changed. redo replays the pages, the write
+           is undone in place like at runtime if the transaction does not finish
+COMPENSATE: the write logged at undone_lsn_ was undone, logged after the pages the undo changed
+SMO_BEGIN/SMO_END: enclose the page records of a structure modification of an index (a split or a merge) by the
+           session, the pages are only consistent once all of them are changed. recovery undoes the page records of
+           a modification without its end
+TXN_END: the writes of a committed transaction are applied (its deletes and drops), logged before its locks are
+           released. recovery applies the writes again for a commit without its end
 */
 enum LogRecordType{INVALID_RECORD_TYPE, WRITE, NEW, DELETE, BEGIN, COMMIT, ABORT, CHECK_POINT, 
-                    BITMAP_WRITE, DISKMETA_WRITE};
+                    BITMAP_WRITE, DISKMETA_WRITE, WRITE_DELTA, TXN_WRITE, COMPENSATE, SMO_BEGIN, SMO_END, TXN_END};
 
 class LogRecord {
 public:
@@ -116,11 +150,16 @@ public:
     page_id_t GetPid() { return pid_; }
     extent_id_t GetEid() { return extent_id_; }
     void SetPid(page_id_t pid) { pid_ = pid; }
+    void SetLSN(lsn_t lsn) { lsn_ = lsn; }
     char* GetOldData() { return old_data_; }
     char* GetNewData() { return new_data_; }
     ActiveTransactionTable* GetATT() { return att_; }
     DirtyPageTable* GetDPT() { return dpt_; }
     LogRecordType GetType() {return type_;}
+    void SetWrite(const WriteRecord& write) { write_ = write; }
+    const WriteRecord& GetWrite() { return write_; }
+    void SetUndoneLSN(lsn_t lsn) { undone_lsn_ = lsn; }
+    lsn_t GetUndoneLSN() { return undone_lsn_; }
     static std::string GetTypeStr(LogRecordType t)
     {
         std::string type = "unknwon";
@@ -138,12 +177,33 @@ public:
             type = "write";
         else if(t==DELETE)
             type = "delete";
+        else if(t==WRITE_DELTA)
+            type = "delta";
+        else if(t==TXN_WRITE)
+            type = "txn write";
+        else if(t==COMPENSATE)
+            type = "compensate";
+        else if(t==SMO_BEGIN)
+            type = "smo begin";
+        else if(t==SMO_END)
+            type = "smo end";
+        else if(t==TXN_END)
+            type = "txn end";
         return type;
     }
  
+    //WRITE_DELTA records: keep the byte ranges that differ between the two images, false if nothing changed
+    bool SetDelta(const char* old_data, const char* new_data);
+    //WRITE_DELTA records: write the new (redo) or old (undo) bytes of the changed ranges into a page
+    void ApplyDelta(char* page_data, bool redo) const;
+    //WRITE and WRITE_DELTA records: put the old value back into the bytes the record changed, the other bytes of
+    //the page are left as later changes made them
+    void UndoWrite(char* page_data) const;
+
     uint32_t SerializeTo(char* buf) const;
     uint32_t GetSerializedSize() const;
     uint32_t DeSerializeFrom(char* buf);
+    static bool IsRecordAt(const char* buf) { return MACH_READ_FROM(uint32_t, buf) == LOG_MAGIC_NUM; }
 
 private:
     LogRecordType type_;
@@ -155,6 +215,10 @@ private:
     extent_id_t extent_id_; //used for bitmap page
     ActiveTransactionTable* att_;//null if not a check point
     DirtyPageTable* dpt_;//null if not a check point
+    std::vector<PageDelta> deltas_;//changed ranges of a WRITE_DELTA record
+    std::vector<char> delta_data_;//old bytes of all ranges, then their new bytes, in the order of deltas_
+    WriteRecord write_;//the write of a TXN_WRITE record
+    lsn_t undone_lsn_{INVALID_LSN};//the record undone by a COMPENSATE record
 
     static constexpr uint32_t LOG_MAGIC_NUM = 37182;
 };
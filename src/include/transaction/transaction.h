@@ -1,7 +1,10 @@
 #ifndef MINISQL_TRANSACTION_H
 #define MINISQL_TRANSACTION_H
 
+#include "common/rowid.h"
 #include "page/page.h"
+#include <memory>
+#include <utility>
 #include <vector>
 
 /**
@@ -14,10 +17,38 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 //class TransactionManager;
 
+//how the versions written by a transaction are seen, they may outlive the transaction
+struct CommitStamp
+{
+    uint64_t commit_ts_ = 0;//0 while running
+    bool aborted_ = false;
+};
+
+//a change of a transaction, undone in place if it rolls back: the pages it changed may hold the changes of other
+//transactions by then. the changes of the catalog are undone by dropping what was created and attaching again what
+//was dropped, the dropped tables and indexes are only freed at commit
+struct WriteRecord
+{
+    enum class Type { INSERT, DELETE, UPDATE, CREATE_TABLE, DROP_TABLE, CREATE_INDEX, DROP_INDEX };
+
+    WriteRecord() = default;
+    explicit WriteRecord(Type type):type_(type){}
+    WriteRecord(Type type, page_id_t table, RowId rid, std::vector<char> image = {})
+        :type_(type), table_(table), rid_(rid), image_(std::move(image)){}
+
+    Type type_ = Type::INSERT;
+    page_id_t table_ = INVALID_PAGE_ID;//first page of the table heap
+    RowId rid_;
+    std::vector<char> image_;//the tuple before an update
+    uint32_t object_id_ = 0;//the table or index created or dropped
+    page_id_t meta_page_ = INVALID_PAGE_ID;//meta page of the table or index dropped
+    lsn_t lsn_ = INVALID_LSN;//its log record, recovery undoes the writes of the unfinished transactions from them
+};
+
 class Transaction {
 public:
     explicit Transaction(txn_id_t txn_id = 0)
-        :txn_id_(txn_id), state_(TransactionState::GROWING){}
+        :txn_id_(txn_id), state_(TransactionState::GROWING), read_ts_(0), stamp_(std::make_shared<CommitStamp>()){}
     ~Transaction()
     {
         //std::cout<<"~transaction"<<std::endl;
@@ -28,10 +59,19 @@ public:
     txn_id_t GetTid(){return txn_id_;}
     void SetState(TransactionState st){state_ = st;}
     TransactionState GetState(){return state_;}
-    
+    uint64_t GetReadTs(){return read_ts_;}
+    void SetReadTs(uint64_t ts){read_ts_ = ts;}
+    const std::shared_ptr<CommitStamp>& GetCommitStamp(){return stamp_;}
+    void AddWrite(WriteRecord record){writes_.push_back(std::move(record));}
+    std::vector<WriteRecord>& GetWrites(){return writes_;}
+    void ClearWrites(){std::vector<WriteRecord>().swap(writes_);}//once committed or rolled back
+
 private:
     txn_id_t txn_id_;
     TransactionState state_;
+    uint64_t read_ts_;//the snapshot read sees the transactions committed up to it
+    std::shared_ptr<CommitStamp> stamp_;
+    std::vector<WriteRecord> writes_;//oldest first
 };
 
 #endif  // MINISQL_TRANSACTION_H
@@ -1,23 +1,41 @@
 #ifndef MINISQL_TRANSACTION_MANAGER_H
 #define MINISQL_TRANSACTION_MANAGER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "transaction/transaction.h"
 #include "buffer/buffer_pool_manager.h"
 #include "transaction/log_manager.h"
+#include "transaction/lock_manager.h"
+#include "transaction/version_manager.h"
 #include "storage/disk_manager.h"
 
+//a transaction committed before the crash, its writes were not all applied
+struct UnappliedCommit
+{
+    Transaction* txn_;
+    std::unordered_set<page_id_t> freed_;//the pages applying its writes freed before the crash
+};
+
 class TransactionManager {
 public:
-    explicit TransactionManager(BufferPoolManager* buf_mgr, DiskManager* disk_mgr, LogManager* log_mgr):
-        next_tid_(0),buf_mgr_(buf_mgr), disk_mgr_(disk_mgr), log_mgr_(log_mgr)
+    explicit TransactionManager(BufferPoolManager* buf_mgr, DiskManager* disk_mgr, LogManager* log_mgr,
+                                LockManager* lock_mgr = nullptr, VersionManager* version_mgr = nullptr):
+        buf_mgr_(buf_mgr), disk_mgr_(disk_mgr), log_mgr_(log_mgr), lock_mgr_(lock_mgr),
+        version_mgr_(version_mgr)
         {
             att_ = new ActiveTransactionTable;
         }
 
     ~TransactionManager()
     {
+        StopBackgroundCheckPoint();
         // for(auto txn : this->txn_map_)
         // {
         //     delete txn.second;
@@ -25,35 +43,71 @@ public:
         delete att_;
     }
 
-    //do recover
+    //do recover, the unfinished transactions are left to roll back once the catalog is loaded
     void Recover();
 
+    //the transactions unfinished at the crash, with the writes to roll back (CatalogManager::RollbackWrites),
+    //the caller aborts and deletes them
+    std::vector<Transaction*> TakeUnfinished();
+
+    //the transactions committed before the crash without an end, the caller applies their writes again
+    //(CatalogManager::CommitWrites, skipping the pages freed already), ends them with EndCommit and deletes them
+    std::vector<UnappliedCommit> TakeUnapplied();
+
     //begin a transaction
     Transaction *Begin(Transaction *txn = nullptr);
     
-    //Commit a transaction.
-    void Commit(Transaction *txn);
+    //Commit a transaction, apply_writes applies its writes once the commit is logged, before its locks are released
+    //(CatalogManager::CommitWrites). DB_FAILED if the commit record could not be made durable, the outcome is not
+    //known then: the record stays in the log buffer and reaches the log before anything logged after it
+    dberr_t Commit(Transaction *txn, const std::function<void(Transaction *)> &apply_writes = nullptr);
 
-    //Abort a transaction
+    //log that the writes of a committed transaction are applied, the log is kept for recovery to apply them until then
+    void EndCommit(Transaction *txn);
+
+    //Abort a transaction, its writes are undone by the caller before (CatalogManager::RollbackWrites)
     void Abort(Transaction *txn);
 
-    //undo a record
-    void Undo(LogRecord* rec);
-    
-    //redo a record
+    //redo a record, records of different pages may be redone concurrently
     void Redo(LogRecord* rec);
 
-    //checkpoint
+    //undo the change of a page record (WRITE, WRITE_DELTA, NEW, DELETE), the undo is logged like any change
+    void Undo(LogRecord* rec);
+
+    //fuzzy checkpoint: log the active transactions and the dirty pages without flushing or blocking anything,
+    //then point the master record to it
     void CheckPoint();
 
+    //take checkpoints in the background, triggered by log volume or time
+    void StartBackgroundCheckPoint();
+    void StopBackgroundCheckPoint();
+
 private:
-    txn_id_t next_tid_;
     ActiveTransactionTable* att_;
     //The transaction map is a global list of all the running transactions in the system
     //std::unordered_map<txn_id_t, Transaction *> txn_map_;
     BufferPoolManager* buf_mgr_;
     DiskManager* disk_mgr_;
     LogManager* log_mgr_;
+    LockManager* lock_mgr_;//locks of a transaction are released once its end is durable
+    VersionManager* version_mgr_;//snapshots of the transactions
+    std::vector<Transaction*> unfinished_;//left by Recover
+    std::vector<UnappliedCommit> unapplied_;//left by Recover
+
+    void BackgroundCheckPoint();
+
+    //undo the page records of the structure modifications cut off by the crash, the newest first, and log their ends.
+    //open_smos maps a session to the lsn of its modification without an end
+    void UndoStructureChanges(const std::unordered_map<txn_id_t, lsn_t>& open_smos);
+
+    std::mutex att_latch_;//a checkpoint sees a transaction in att_ if and only if its begin is logged and its end is not
+    std::mutex checkpoint_latch_;//one checkpoint at a time
+    std::atomic<uint64_t> last_cp_log_size_{0};//log size at the last checkpoint
+    lsn_t last_cp_begin_lsn_{INVALID_LSN};//the first lsn after the dirty page table of the last checkpoint was taken
+    std::thread checkpoint_thread_;
+    std::mutex checkpoint_thread_latch_;
+    std::condition_variable checkpoint_cv_;
+    bool checkpoint_stop_{false};
 };
 
 
@@ -0,0 +1,63 @@
+#ifndef MINISQL_VERSION_MANAGER_H
+#define MINISQL_VERSION_MANAGER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "common/config.h"
+#include "common/rowid.h"
+#include "transaction/transaction.h"
+
+/**
+ * VersionManager keeps the older versions of the tuples for snapshot reads.
+ *
+ * A transaction gets its snapshot when it begins: it sees the transactions committed before, and its own changes.
+ * Before a transaction changes a tuple the first time, the image of the tuple is kept in the version chain of the
+ * tuple, with the commit stamp of the writer. Reading through a snapshot walks the chain from the newest write back
+ * to the first one the snapshot sees, so readers take no row locks and never wait for writers. The pages hold the
+ * newest versions only, the chains live in memory and are dropped once every running snapshot sees their writers.
+ */
+class VersionManager
+{
+public:
+    enum class ReadResult { CURRENT, OLDER, NONE };
+
+    void Begin(Transaction* txn);//take the snapshot of the transaction
+    void Commit(Transaction* txn);//its changes are seen by the snapshots taken later
+    void Abort(Transaction* txn);//once its changes are undone
+
+    //keep the image of a tuple of table before txn changes it, data is nullptr for a new tuple
+    void AddVersion(page_id_t table, const RowId& rid, Transaction* txn, const char* data, uint32_t size);
+    //the version of a tuple seen by txn: the one in the page, an older one copied to data, or none
+    ReadResult ReadVersion(page_id_t table, const RowId& rid, Transaction* txn, std::vector<char>* data);
+    //tuples of table with older versions kept, the ones deleted since a snapshot are only found here
+    std::vector<RowId> GetVersionedRows(page_id_t table);
+    //the tuple moved from one slot to another as txn rolled back its write, the versions kept by txn are dropped
+    void MoveVersions(page_id_t table, const RowId& from, const RowId& to, Transaction* txn);
+    void DropTable(page_id_t table);
+
+private:
+    struct Version
+    {
+        std::shared_ptr<CommitStamp> writer_;
+        bool existed_;//whether the tuple existed before the write
+        std::vector<char> data_;//image before the write
+    };
+
+    bool Visible(const Version& version, Transaction* txn) const;
+    void EndSnapshot(Transaction* txn);
+    void Collect();//drop the versions no running snapshot needs
+
+    std::mutex latch_;
+    uint64_t last_commit_ts_{0};
+    std::multiset<uint64_t> snapshots_;//read timestamps of the running transactions
+    //table (first page id) -> tuple -> versions, oldest first
+    std::unordered_map<page_id_t, std::unordered_map<int64_t, std::vector<Version>>> tables_;
+    std::atomic<size_t> version_num_{0};
+    size_t collect_threshold_{VERSION_COLLECT_THRESHOLD};
+};
+
+#endif //MINISQL_VERSION_MANAGER_H
@@ -1,4 +1,5 @@
 #include "index/b_plus_tree.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <exception>
@@ -35,16 +36,21 @@ void BPlusTree::Init(index_id_t index_id, BufferPoolManager *buffer_pool_manager
                      size_t internal_max_size) {
   index_id_ = index_id;
   buffer_pool_manager_ = buffer_pool_manager;
-  Page *p = buffer_pool_manager->FetchPage(INDEX_ROOTS_PAGE_ID, false);
+  LoadRootPageId();
+  this->leaf_max_size_ = leaf_max_size;
+  this->internal_max_size_ = internal_max_size;
+  this->key_size_ = keysize;
+}
+
+void BPlusTree::LoadRootPageId() {
+  std::unique_lock<std::shared_mutex> root_lock(root_latch_);
+  Page *p = buffer_pool_manager_->FetchPage(INDEX_ROOTS_PAGE_ID, false);
   root_page_id_ = INVALID_PAGE_ID;
   if (p) {
     IndexRootsPage *root_page = reinterpret_cast<IndexRootsPage *>(p->GetData());
-    root_page->GetRootId(index_id, &root_page_id_);
+    root_page->GetRootId(index_id_, &root_page_id_);
   }
-  buffer_pool_manager->UnpinPage(INDEX_ROOTS_PAGE_ID, false);
-  this->leaf_max_size_ = leaf_max_size;
-  this->internal_max_size_ = internal_max_size;
-  this->key_size_ = keysize;
+  buffer_pool_manager_->UnpinPage(INDEX_ROOTS_PAGE_ID, false);
 }
 
 void BPlusTree::PrintTree(std::ostream &out) {
@@ -126,14 +132,17 @@ bool BPlusTree::CheckIntergrity() {
   return true;
 }
 
-void BPlusTree::Destroy() {
-  UpdateRootPageId(-1);
+void BPlusTree::Destroy(const std::unordered_set<page_id_t> *freed) {
+  std::unique_lock<std::shared_mutex> root_lock(root_latch_);
+  // children before their parents, what a crash leaves is still reached from the root
   if (root_page_id_ != INVALID_PAGE_ID) {
-    InternalDestory(root_page_id_);
+    InternalDestory(root_page_id_, freed);
   }
+  UpdateRootPageId(-1);
 }
 
-void BPlusTree::InternalDestory(page_id_t pid) {
+void BPlusTree::InternalDestory(page_id_t pid, const std::unordered_set<page_id_t> *freed) {
+  if (freed != nullptr && freed->count(pid) > 0) return;
   Page *p = buffer_pool_manager_->FetchPage(pid, false);
   if (p == nullptr) return;
   BPlusTreePage *bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
@@ -141,7 +150,7 @@ void BPlusTree::InternalDestory(page_id_t pid) {
     BPlusTreeInternalPage *ip = reinterpret_cast<BPlusTreeInternalPage *>(bp);
     for (int i = 0; i < ip->GetSize(); i++) {
       page_id_t pid_child = ip->ValueAt(i);
-      InternalDestory(pid_child);
+      InternalDestory(pid_child, freed);
     }
   }
   buffer_pool_manager_->UnpinPage(pid, false);
@@ -163,26 +172,9 @@ bool BPlusTree::IsEmpty() const { return false; }
  */
 
 bool BPlusTree::GetValue(const IndexKey *key, std::vector<RowId> &result, Transaction *transaction) {
-  if (root_page_id_ == INVALID_PAGE_ID) return false;
-  Page *p = buffer_pool_manager_->FetchPage(root_page_id_, false);
+  Page *p = FindLeafPage(key);
   if (p == nullptr) return false;
   BPlusTreePage *bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  while (!bp->IsLeafPage()) {
-    auto ibp = reinterpret_cast<BPlusTreeInternalPage *>(bp);
-    // auto data = ibp->GetData();
-    int l = 0, r = ibp->GetSize() - 1;
-    while (l < r) {
-      int mid = (l + r + 1) / 2;
-      if (comparator_(ibp->KeyAt(mid), key) > 0)
-        r = mid - 1;
-      else
-        l = mid;
-    }
-    page_id_t next = ibp->ValueAt(r);
-    buffer_pool_manager_->UnpinPage(bp->GetPageId(), false);
-    p = buffer_pool_manager_->FetchPage(next, false);
-    bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  }
   auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(bp);
   int l = 0, r = c_lp->GetSize();
   while (l < r) {
@@ -213,7 +205,7 @@ bool BPlusTree::GetValue(const IndexKey *key, std::vector<RowId> &result, Transa
  */
 
 BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const IndexKey *key, const RowId &value,
-                                         IndexKey **newKey, bool *found, bool *modified) {
+                                         IndexKey **newKey, bool *found, bool *modified, WritePath *path) {
   // a leaf node is met
   BPlusTreePage *splitted_page = nullptr;
   *found = false;
@@ -240,7 +232,7 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
     if (c_lp->GetSize() == c_lp->GetMaxSize()) {
       // the leaf page is full , split it
       page_id_t split_page_id = INVALID_PAGE_ID;
-      Page *split_page = buffer_pool_manager_->NewPage(split_page_id);
+      Page *split_page = buffer_pool_manager_->NewPage(split_page_id, &leaf_alloc_hint_);
       // cout << "Leaf page split." << endl;
       auto s_lp = reinterpret_cast<BPlusTreeLeafPage *>(split_page->GetData());
       s_lp->Init(split_page_id, c_lp->GetParentPageId(), key_size_, leaf_max_size_);
@@ -316,16 +308,7 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
     // perform the binary search here.
 
     // pair<IndexKey,page_id_t> *current_data = c_ip->GetData();
-    int l = 0, r = c_ip->GetSize() - 1;
-    // find the last index whose key is smaller than or equal to key
-    while (l < r) {
-      int mid = (l + r + 1) / 2;
-      if (comparator_(c_ip->KeyAt(mid), key) > 0)
-        r = mid - 1;
-      else
-        l = mid;
-    }
-    int target_page_index = r;
+    int target_page_index = ChildIndex(c_ip, key);
     target_page_id = c_ip->EntryAt(target_page_index)->value;
     if (target_page_id == INVALID_PAGE_ID) {
       *found = false;
@@ -342,13 +325,22 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
     bool child_modified = false;
     IndexKey *nk;
 
-    BPlusTreePage *new_page = InternalInsert(target_bplus_page, key, value, &nk, &child_found, &child_modified);
+    // the change stops at the child, the pages above it are released. This page may be unpinned on return
+    page_id_t page_id = c_ip->GetPageId();
+    if (InsertSafe(target_bplus_page, key, false)) ReleasePath(path);
+    path->pages_.push_back(target_page_id);
+    BPlusTreePage *new_page = InternalInsert(target_bplus_page, key, value, &nk, &child_found, &child_modified, path);
 
     if (child_found) {
-      buffer_pool_manager_->UnpinPage(target_page_id, modified, false);
+      UnpinPathPage(path, target_page_id, false);
       *found = true;
       return nullptr;
     }
+    if (std::find(path->pages_.begin(), path->pages_.end(), page_id) == path->pages_.end()) {
+      // this page was released, it is left as it is
+      UnpinPathPage(path, target_page_id, child_modified);
+      return nullptr;
+    }
     if (new_page != nullptr) {  // a split happens !
       *modified = true;
       IndexKey *new_key;
@@ -366,7 +358,7 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
         // continue splitting
         // create a new internal page
         page_id_t split_page_id = INVALID_PAGE_ID;
-        Page *split_page = buffer_pool_manager_->NewPage(split_page_id);
+        Page *split_page = buffer_pool_manager_->NewPage(split_page_id, &internal_alloc_hint_);
         child_modified = true;
         if (split_page == nullptr) {
           ASSERT(0, "New BPlustree page failed!");
@@ -421,11 +413,12 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
       }
       buffer_pool_manager_->UnpinPage(new_page_id, true);
     }
-    buffer_pool_manager_->UnpinPage(target_page_id, modified, false);
+    // nk is in the child, which may be evicted once unpinned
     if (!(*nk == *c_ip->KeyAt(target_page_index))) {
       c_ip->EntryAt(target_page_index)->SetKey(nk);
       *modified = true;
     }
+    UnpinPathPage(path, target_page_id, child_modified);
     *newKey = &c_ip->EntryAt(0)->key;
   }
   return splitted_page;
@@ -443,6 +436,12 @@ BPlusTreePage *BPlusTree::InternalInsert(BPlusTreePage *destination, const Index
  */
 
 bool BPlusTree::Insert(const IndexKey *key, const RowId &value, Transaction *transaction) {
+  bool inserted = false;
+  if (OptimisticInsert(key, value, &inserted)) return inserted;
+  // the leaf splits or gets a new first key: write latch the pages from the root, down to the leaf
+  WritePath path;
+  path.root_lock_ = std::unique_lock<std::shared_mutex>(root_latch_);
+  buffer_pool_manager_->BeginStructureChange();
   if (root_page_id_ == INVALID_PAGE_ID) {
     StartNewTree(key, value);
     UpdateRootPageId(true);
@@ -451,15 +450,20 @@ bool BPlusTree::Insert(const IndexKey *key, const RowId &value, Transaction *tra
     page_id_t old_root_page_id = root_page_id_;
     if (root_page == nullptr) {
       ASSERT(0, "Bplustree fetch root page failed");
+      FinishPath(&path);
       return false;
     }
     BPlusTreePage *root_general_page = reinterpret_cast<BPlusTreePage *>(root_page->GetData());
     bool found = false;
     bool modified = false;
     IndexKey *nk;
-    BPlusTreePage *new_page = InternalInsert(root_general_page, key, value, &nk, &found, &modified);
+    // the root page does not split, it stays the root
+    if (InsertSafe(root_general_page, key, true)) path.root_lock_.unlock();
+    path.pages_.push_back(old_root_page_id);
+    BPlusTreePage *new_page = InternalInsert(root_general_page, key, value, &nk, &found, &modified, &path);
     if (found) {
-      buffer_pool_manager_->UnpinPage(old_root_page_id, true);
+      UnpinPathPage(&path, old_root_page_id, false);
+      FinishPath(&path);
       return false;
     }
     if (new_page != nullptr) {
@@ -493,9 +497,10 @@ bool BPlusTree::Insert(const IndexKey *key, const RowId &value, Transaction *tra
       }
       BPlusTreeInternalPage *new_root;
       page_id_t new_root_page_id;
-      Page *new_root_page = buffer_pool_manager_->NewPage(new_root_page_id);
+      Page *new_root_page = buffer_pool_manager_->NewPage(new_root_page_id, &internal_alloc_hint_);
       if (new_root_page == nullptr) {
         ASSERT(0, "BPlustree new root page failed!");
+        FinishPath(&path);
         return false;
       }
       root_page_id_ = new_root_page_id;
@@ -519,10 +524,91 @@ bool BPlusTree::Insert(const IndexKey *key, const RowId &value, Transaction *tra
       buffer_pool_manager_->UnpinPage(new_root_page_id, true);
       buffer_pool_manager_->UnpinPage(new_page->GetPageId(), true);
     }
-    buffer_pool_manager_->UnpinPage(old_root_page_id, true);
+    UnpinPathPage(&path, old_root_page_id, modified);
   }
+  FinishPath(&path);
   return true;
 }
+
+bool BPlusTree::OptimisticInsert(const IndexKey *key, const RowId &value, bool *inserted) {
+  Page *p = FindLeafPage(key, false, true);
+  if (p == nullptr) return false;
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
+  page_id_t page_id = c_lp->GetPageId();
+  // find the first index whose key is greater than or equal to key
+  int l = 0, r = c_lp->GetSize();
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (comparator_(c_lp->KeyAt(mid), key) < 0)
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  if (r < c_lp->GetSize() && comparator_(c_lp->KeyAt(r), key) == 0) {
+    buffer_pool_manager_->UnpinPage(page_id, false, false);
+    *inserted = false;
+    return true;
+  }
+  // a split or a new first key changes the parent
+  if (r == 0 || c_lp->GetSize() >= c_lp->GetMaxSize()) {
+    buffer_pool_manager_->UnpinPage(page_id, false, false);
+    return false;
+  }
+  bool found = false;
+  bool modified = false;
+  IndexKey *nk;
+  InternalInsert(c_lp, key, value, &nk, &found, &modified, nullptr);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  *inserted = true;
+  return true;
+}
+
+bool BPlusTree::InsertSafe(BPlusTreePage *page, const IndexKey *key, bool is_root) {
+  // it neither splits nor gets a new first key, which only matters to a parent
+  if (page->GetSize() >= page->GetMaxSize()) return false;
+  if (is_root) return true;
+  if (page->GetSize() == 0) return false;
+  IndexKey *first = page->IsLeafPage() ? reinterpret_cast<BPlusTreeLeafPage *>(page)->KeyAt(0)
+                                       : reinterpret_cast<BPlusTreeInternalPage *>(page)->KeyAt(0);
+  return comparator_(key, first) >= 0;
+}
+
+bool BPlusTree::RemoveSafe(BPlusTreePage *page, const IndexKey *key, bool is_root) {
+  // it is neither merged nor given entries by a sibling, and does not lose its first key. The root is only replaced
+  // by its child when one entry is left
+  if (is_root) return page->IsLeafPage() || page->GetSize() > 2;
+  if (page->GetSize() <= page->GetMaxSize() / 2) return false;
+  IndexKey *first = page->IsLeafPage() ? reinterpret_cast<BPlusTreeLeafPage *>(page)->KeyAt(0)
+                                       : reinterpret_cast<BPlusTreeInternalPage *>(page)->KeyAt(0);
+  return comparator_(key, first) != 0;
+}
+
+void BPlusTree::ReleasePath(WritePath *path) {
+  for (page_id_t page_id : path->pages_) buffer_pool_manager_->UnpinPage(page_id, false, false);
+  path->pages_.clear();
+  if (path->root_lock_.owns_lock()) path->root_lock_.unlock();
+}
+
+void BPlusTree::UnpinPathPage(WritePath *path, page_id_t page_id, bool is_dirty) {
+  auto it = std::find(path->pages_.begin(), path->pages_.end(), page_id);
+  if (it == path->pages_.end()) return;
+  path->pages_.erase(it);
+  // the last latch held by the change, nobody else gets to the pages it changed before it is released
+  if (path->pages_.empty() && !path->root_lock_.owns_lock()) {
+    buffer_pool_manager_->EndStructureChange(page_id);
+    path->ended_ = true;
+  }
+  buffer_pool_manager_->UnpinPage(page_id, is_dirty, false);
+}
+
+void BPlusTree::FinishPath(WritePath *path) {
+  if (!path->ended_) buffer_pool_manager_->EndStructureChange();
+  path->ended_ = true;
+  // freed before the end, a page could be taken by others and then be brought back by the undo of the change. a crash
+  // in between leaks it
+  for (page_id_t page_id : path->deleted_) buffer_pool_manager_->DeletePage(page_id);
+  path->deleted_.clear();
+}
 /*
  * Insert constant key & value pair into an empty tree
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
@@ -532,7 +618,7 @@ bool BPlusTree::Insert(const IndexKey *key, const RowId &value, Transaction *tra
 
 void BPlusTree::StartNewTree(const IndexKey *key, const RowId &value) {
   page_id_t root_page_id = INVALID_PAGE_ID;
-  Page *p = buffer_pool_manager_->NewPage(root_page_id);
+  Page *p = buffer_pool_manager_->NewPage(root_page_id, &leaf_alloc_hint_);
   if (p == nullptr) {
     ASSERT(0, "Start new tree allocate page failed.");
     return;
@@ -552,13 +638,27 @@ void BPlusTree::StartNewTree(const IndexKey *key, const RowId &value) {
 void BPlusTree::Remove(const IndexKey *key, Transaction *transaction) {
   // stringstream ss;
   // PrintTree(ss);
-
+  if (OptimisticRemove(key)) return;
+  // the leaf underflows or loses its first key: write latch the pages from the root, down to the leaf
+  WritePath path;
+  path.root_lock_ = std::unique_lock<std::shared_mutex>(root_latch_);
+  if (root_page_id_ == INVALID_PAGE_ID) return;
+  buffer_pool_manager_->BeginStructureChange();
+  page_id_t old_root_page_id = root_page_id_;
   Page *root_page = buffer_pool_manager_->FetchPage(root_page_id_, true);
   BPlusTreePage *root_bplus_page = reinterpret_cast<BPlusTreePage *>(root_page->GetData());
   bool modified = false;
   bool shrink = false;
   IndexKey *nk;
-  InternalRemove(root_bplus_page, key, &nk, &modified);
+  // the root page is not replaced by its child
+  if (RemoveSafe(root_bplus_page, key, true)) path.root_lock_.unlock();
+  path.pages_.push_back(old_root_page_id);
+  int size = InternalRemove(root_bplus_page, key, &nk, &modified, &path);
+  if (size == -1) {
+    UnpinPathPage(&path, old_root_page_id, false);
+    FinishPath(&path);
+    return;
+  }
   if (!root_bplus_page->IsLeafPage()) {
     auto *ip = reinterpret_cast<BPlusTreeInternalPage *>(root_bplus_page);
     ip->EntryAt(0)->SetKey(nk);  // key = nk;
@@ -567,14 +667,15 @@ void BPlusTree::Remove(const IndexKey *key, Transaction *transaction) {
       Page *new_root_page = buffer_pool_manager_->FetchPage(ip->ValueAt(0), true);
       BPlusTreePage *np = reinterpret_cast<BPlusTreePage *>(new_root_page->GetData());
       np->SetParentPageId(INVALID_PAGE_ID);
-      buffer_pool_manager_->UnpinPage(root_page_id_, true);
-      buffer_pool_manager_->DeletePage(root_page_id_);
+      UnpinPathPage(&path, root_page_id_, true);
+      path.deleted_.push_back(root_page_id_);
       root_page_id_ = new_root_page->GetPageId();
       UpdateRootPageId();
       buffer_pool_manager_->UnpinPage(new_root_page->GetPageId(), true);
     }
   }
-  if (!shrink) buffer_pool_manager_->UnpinPage(root_page_id_, modified, false);
+  if (!shrink) UnpinPathPage(&path, old_root_page_id, modified);
+  FinishPath(&path);
 
   // if(!CheckIntergrity()){
   //   cout << "Intergrity check failed !" << endl;
@@ -585,6 +686,36 @@ void BPlusTree::Remove(const IndexKey *key, Transaction *transaction) {
   // }
 }
 
+bool BPlusTree::OptimisticRemove(const IndexKey *key) {
+  Page *p = FindLeafPage(key, false, true);
+  if (p == nullptr) return true;
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
+  page_id_t page_id = c_lp->GetPageId();
+  // find the first index whose key is greater than or equal to key
+  int l = 0, r = c_lp->GetSize();
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (comparator_(c_lp->KeyAt(mid), key) < 0)
+      l = mid + 1;
+    else
+      r = mid;
+  }
+  if (r == c_lp->GetSize() || comparator_(c_lp->KeyAt(r), key) != 0) {
+    buffer_pool_manager_->UnpinPage(page_id, false, false);
+    return true;
+  }
+  // an underflow or a new first key changes the parent
+  if (r == 0 || c_lp->GetSize() <= c_lp->GetMaxSize() / 2) {
+    buffer_pool_manager_->UnpinPage(page_id, false, false);
+    return false;
+  }
+  bool modified = false;
+  IndexKey *nk;
+  InternalRemove(c_lp, key, &nk, &modified, nullptr);
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  return true;
+}
+
 /**
  * @brief Recursively delete a key-value pair from destination node.If destination is an internal node, keep searching.
  *
@@ -593,7 +724,8 @@ void BPlusTree::Remove(const IndexKey *key, Transaction *transaction) {
  * @return int if the key is not found, return -1. Otherwise, return the new size of modified node.
  */
 
-int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, IndexKey **newKey, bool *modified) {
+int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, IndexKey **newKey, bool *modified,
+                              WritePath *path) {
   if (destination->IsLeafPage()) {
     auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(destination);
     // BLeafEntry *current_data = c_lp->GetData();
@@ -638,16 +770,7 @@ int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, I
     // we should not use the Lookup method since some useful information is hidden
     // perform the binary search here.
     // pair<IndexKey,page_id_t> *current_data = c_ip->GetData();
-    int l = 0, r = c_ip->GetSize() - 1;
-    // find the last index whose key value is smaller than or equal key
-    while (l < r) {
-      int mid = (l + r + 1) / 2;
-      if (comparator_(c_ip->KeyAt(mid), key) > 0)
-        r = mid - 1;
-      else
-        l = mid;
-    }
-    int target_page_index = r;
+    int target_page_index = ChildIndex(c_ip, key);
     target_page_id = c_ip->ValueAt(target_page_index);
     if (target_page_id == INVALID_PAGE_ID) return -1;
     Page *target_page = buffer_pool_manager_->FetchPage(target_page_id, true);
@@ -658,10 +781,29 @@ int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, I
     BPlusTreePage *target_bplus_page = reinterpret_cast<BPlusTreePage *>(target_page->GetData());
     bool child_modified = false;
     IndexKey *nk;
-    int child_size = InternalRemove(target_bplus_page, key, &nk, &child_modified);
-    if (child_size == -1) return -1;
     Page *p_left = nullptr;
     Page *p_right = nullptr;
+    // this page may be unpinned on return
+    page_id_t page_id = c_ip->GetPageId();
+    if (RemoveSafe(target_bplus_page, key, false)) {
+      // the change stops at the child, the pages above it are released
+      ReleasePath(path);
+    } else if (target_page_index > 0 && target_bplus_page->GetSize() <= target_bplus_page->GetMaxSize() / 2) {
+      // it may be merged with its left sibling or borrow from it, which is latched first, as by the lookups crossing
+      // the leaves from left to right
+      buffer_pool_manager_->UnpinPage(target_page_id, false, false);
+      p_left = buffer_pool_manager_->FetchPage(c_ip->ValueAt(target_page_index - 1), true);
+      target_page = buffer_pool_manager_->FetchPage(target_page_id, true);
+      target_bplus_page = reinterpret_cast<BPlusTreePage *>(target_page->GetData());
+    }
+    path->pages_.push_back(target_page_id);
+    int child_size = InternalRemove(target_bplus_page, key, &nk, &child_modified, path);
+    if (child_size == -1 || std::find(path->pages_.begin(), path->pages_.end(), page_id) == path->pages_.end()) {
+      // not found, or this page was released and is left as it is
+      if (p_left) buffer_pool_manager_->UnpinPage(p_left->GetPageId(), false, false);
+      UnpinPathPage(path, target_page_id, child_modified);
+      return -1;
+    }
     bool left_dirty = false;
     bool right_dirty = false;
     bool can_merge = false;
@@ -676,7 +818,7 @@ int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, I
       child_modified = true;
       // need to do some redistribution
       if (target_page_index > 0) {  // probably can be merged with left sib
-        p_left = buffer_pool_manager_->FetchPage(c_ip->ValueAt(target_page_index - 1), true);
+        if (p_left == nullptr) p_left = buffer_pool_manager_->FetchPage(c_ip->ValueAt(target_page_index - 1), true);
         ASSERT(p_left, "Fetch BPlustree page failed!");
         BPlusTreePage *left = reinterpret_cast<BPlusTreePage *>(p_left->GetData());
         if (left->GetSize() + child_size <= target_max_size) {
@@ -762,9 +904,13 @@ int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, I
         c_ip->SetSize(c_ip->GetSize() - 1);
         // after merge , delete a page
         if (p_right && page_to_delete == p_right->GetPageId()) p_right = nullptr;
-        if (target_page && page_to_delete == target_page->GetPageId()) target_page = nullptr;
-        buffer_pool_manager_->UnpinPage(page_to_delete, true);
-        buffer_pool_manager_->DeletePage(page_to_delete);
+        if (target_page && page_to_delete == target_page->GetPageId()) {
+          target_page = nullptr;
+          UnpinPathPage(path, page_to_delete, true);
+        } else {
+          buffer_pool_manager_->UnpinPage(page_to_delete, true);
+        }
+        path->deleted_.push_back(page_to_delete);
       } else if (can_borrow) {
         // simply borrow 1 from source to target , no further modification
         if (target_bplus_page->IsLeafPage()) {
@@ -827,31 +973,16 @@ int BPlusTree::InternalRemove(BPlusTreePage *destination, const IndexKey *key, I
     }
     if (p_left) buffer_pool_manager_->UnpinPage(p_left->GetPageId(), left_dirty, false);
     if (p_right) buffer_pool_manager_->UnpinPage(p_right->GetPageId(), right_dirty, false);
-    if (target_page) buffer_pool_manager_->UnpinPage(target_page->GetPageId(), child_modified, false);
+    if (target_page) UnpinPathPage(path, target_page_id, child_modified);
     *newKey = &c_ip->EntryAt(0)->key;
     return c_ip->GetSize();
   }
 }
 
 BPlusTreeIndexIterator BPlusTree::Begin(Schema *key_schema) {
-  page_id_t next_page_id = root_page_id_;
-  if (next_page_id == INVALID_PAGE_ID) return End();
-  Page *p = buffer_pool_manager_->FetchPage(root_page_id_, false);
-  BPlusTreePage *page = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  while (!page->IsLeafPage()) {
-    BPlusTreeInternalPage *internal_page = reinterpret_cast<BPlusTreeInternalPage *>(page);
-    if (!internal_page->GetSize()) {
-      buffer_pool_manager_->UnpinPage(next_page_id, false);
-      return End();
-    }
-    buffer_pool_manager_->UnpinPage(next_page_id, false);
-    next_page_id = internal_page->EntryAt(0)->value;
-    p = buffer_pool_manager_->FetchPage(next_page_id, false);
-    page = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  }
-  BPlusTreeLeafPage *page_leaf = reinterpret_cast<BPlusTreeLeafPage *>(page);
-  buffer_pool_manager_->UnpinPage(next_page_id, false);
-  return BPlusTreeIndexIterator(this, key_schema, page_leaf, 0);
+  Page *p = FindLeafPage(nullptr, true);
+  if (p == nullptr) return End();
+  return IteratorAt(p, 0, key_schema);
 }
 
 /*
@@ -861,29 +992,9 @@ BPlusTreeIndexIterator BPlusTree::Begin(Schema *key_schema) {
  */
 
 BPlusTreeIndexIterator BPlusTree::Begin(const IndexKey *key, Schema *scm) {
-  if (root_page_id_ == INVALID_PAGE_ID) return End();
-  Page *p = buffer_pool_manager_->FetchPage(root_page_id_, false);
-  if (p == nullptr) {
-    return End();
-  }
-  BPlusTreePage *bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  while (!bp->IsLeafPage()) {
-    auto ibp = reinterpret_cast<BPlusTreeInternalPage *>(bp);
-    // auto data = ibp->GetData();
-    int l = 0, r = ibp->GetSize() - 1;
-    while (l < r) {
-      int mid = (l + r + 1) / 2;
-      if (comparator_(ibp->KeyAt(mid), key) > 0)
-        r = mid - 1;
-      else
-        l = mid;
-    }
-    page_id_t next = ibp->ValueAt(r);
-    buffer_pool_manager_->UnpinPage(bp->GetPageId(), false);
-    p = buffer_pool_manager_->FetchPage(next, false);
-    bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  }
-  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(bp);
+  Page *p = FindLeafPage(key);
+  if (p == nullptr) return End();
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
   // auto leaf_data = c_lp->GetData();
   int l = 0, r = c_lp->GetSize() - 1;
   int mid = (l + r) / 2;
@@ -898,32 +1009,15 @@ BPlusTreeIndexIterator BPlusTree::Begin(const IndexKey *key, Schema *scm) {
       break;
   }
   mid = (l + r) / 2;
-  buffer_pool_manager_->UnpinPage(bp->GetPageId(), false);
-  if (*c_lp->KeyAt(mid) == *key) return BPlusTreeIndexIterator{this, scm, c_lp, mid};
+  if (c_lp->GetSize() > 0 && *c_lp->KeyAt(mid) == *key) return IteratorAt(p, mid, scm);
+  buffer_pool_manager_->UnpinPage(c_lp->GetPageId(), false);
   return End();
 }
 
 BPlusTreeIndexIterator BPlusTree::FindLastSmallerOrEqual(const IndexKey *key, Schema *scm) {
-  Page *p = buffer_pool_manager_->FetchPage(root_page_id_, false);
+  Page *p = FindLeafPage(key);
   if (p == nullptr) return End();
-  BPlusTreePage *bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  while (!bp->IsLeafPage()) {
-    auto ibp = reinterpret_cast<BPlusTreeInternalPage *>(bp);
-    // auto data = ibp->GetData();
-    int l = 0, r = ibp->GetSize() - 1;
-    while (l < r) {
-      int mid = (l + r + 1) / 2;
-      if (comparator_(ibp->KeyAt(mid), key) > 0)
-        r = mid - 1;
-      else
-        l = mid;
-    }
-    page_id_t next = ibp->ValueAt(r);
-    buffer_pool_manager_->UnpinPage(bp->GetPageId(), false);
-    p = buffer_pool_manager_->FetchPage(next, false);
-    bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
-  }
-  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(bp);
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
   // auto leaf_data = c_lp->GetData();
   int l = -1, r = c_lp->GetSize() - 1;
   int mid = (l + r) / 2;
@@ -935,12 +1029,48 @@ BPlusTreeIndexIterator BPlusTree::FindLastSmallerOrEqual(const IndexKey *key, Sc
     else
       l = mid;
   }
- 
-  buffer_pool_manager_->UnpinPage(bp->GetPageId(), false);
+
   if (r < 0) {
+    buffer_pool_manager_->UnpinPage(c_lp->GetPageId(), false);
     return this->End();
   }
-  return BPlusTreeIndexIterator{this, scm, c_lp, r};
+  return IteratorAt(p, r, scm);
+}
+
+BPlusTreeIndexIterator BPlusTree::After(const IndexKey *key, Schema *key_schema) {
+  Page *p = FindLeafPage(key);
+  if (p == nullptr) return End();
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
+  // find the first index whose key is greater than key
+  int l = 0, r = c_lp->GetSize();
+  while (l < r) {
+    int mid = (l + r) / 2;
+    if (comparator_(c_lp->KeyAt(mid), key) > 0)
+      r = mid;
+    else
+      l = mid + 1;
+  }
+  return IteratorAt(p, r, key_schema);
+}
+
+BPlusTreeIndexIterator BPlusTree::IteratorAt(Page *page, int index, Schema *key_schema) {
+  auto *c_lp = reinterpret_cast<BPlusTreeLeafPage *>(page->GetData());
+  // the entry is in a next leaf, some leaves may be empty
+  while (index >= c_lp->GetSize()) {
+    page_id_t next_page_id = c_lp->GetNextPageId();
+    if (next_page_id == INVALID_PAGE_ID) {
+      buffer_pool_manager_->UnpinPage(c_lp->GetPageId(), false);
+      return End();
+    }
+    Page *next_page = buffer_pool_manager_->FetchPage(next_page_id, false);
+    buffer_pool_manager_->UnpinPage(c_lp->GetPageId(), false);
+    c_lp = reinterpret_cast<BPlusTreeLeafPage *>(next_page->GetData());
+    index = 0;
+  }
+  // the iterator copies the leaf, it holds no latch
+  BPlusTreeIndexIterator it(this, key_schema, c_lp, index);
+  buffer_pool_manager_->UnpinPage(c_lp->GetPageId(), false);
+  return it;
 }
 
 /*
@@ -951,7 +1081,44 @@ BPlusTreeIndexIterator BPlusTree::FindLastSmallerOrEqual(const IndexKey *key, Sc
 
 BPlusTreeIndexIterator BPlusTree::End() { return BPlusTreeIndexIterator{this, nullptr, nullptr, -1}; }
 
-Page *BPlusTree::FindLeafPage(const IndexKey &key, bool leftMost) { return nullptr; }
+int BPlusTree::ChildIndex(BPlusTreeInternalPage *page, const IndexKey *key) {
+  // find the last index whose key is smaller than or equal to key
+  int l = 0, r = page->GetSize() - 1;
+  while (l < r) {
+    int mid = (l + r + 1) / 2;
+    if (comparator_(page->KeyAt(mid), key) > 0)
+      r = mid - 1;
+    else
+      l = mid;
+  }
+  return r;
+}
+
+Page *BPlusTree::FindLeafPage(const IndexKey *key, bool leftMost, bool to_write) {
+  std::shared_lock<std::shared_mutex> root_lock(root_latch_);
+  if (root_page_id_ == INVALID_PAGE_ID) return nullptr;
+  page_id_t page_id = root_page_id_;
+  page_id_t parent_page_id = INVALID_PAGE_ID;
+  Page *p = buffer_pool_manager_->FetchPage(page_id, false);
+  while (true) {
+    BPlusTreePage *bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
+    if (bp->IsLeafPage() && to_write) {
+      // latched again for write while the parent is still latched, so it is still the leaf of key
+      buffer_pool_manager_->UnpinPage(page_id, false);
+      p = buffer_pool_manager_->FetchPage(page_id, true);
+      bp = reinterpret_cast<BPlusTreePage *>(p->GetData());
+    }
+    if (parent_page_id == INVALID_PAGE_ID)
+      root_lock.unlock();
+    else
+      buffer_pool_manager_->UnpinPage(parent_page_id, false);
+    if (bp->IsLeafPage()) return p;
+    auto *ibp = reinterpret_cast<BPlusTreeInternalPage *>(bp);
+    parent_page_id = page_id;
+    page_id = leftMost ? ibp->ValueAt(0) : ibp->ValueAt(ChildIndex(ibp, key));
+    p = buffer_pool_manager_->FetchPage(page_id, false);
+  }
+}
 
 /*
  * Update/Insert root page id in header page(where page_id = 0, header_page is
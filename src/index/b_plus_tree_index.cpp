@@ -1,4 +1,5 @@
 #include "index/b_plus_tree_index.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include "index/index_iterator.h"
@@ -15,11 +16,7 @@ BPlusTreeIndex::BPlusTreeIndex(index_id_t index_id, IndexSchema *key_schema, Buf
     if(it->GetType() == kTypeChar)col_size += 1;
   }
   uint32_t tot_size = byte_num + col_size;  // not good for char(128)
-  serialize_buffer_ = nullptr;
   buffer_size_ = tot_size + 1;
-  if(serialize_buffer_)delete [] serialize_buffer_;
-  serialize_buffer_ = new char[buffer_size_];
-  memset(serialize_buffer_,0,buffer_size_);
   int leaf_size = (PAGE_SIZE - BPlusTreeLeafPage::GetHeaderSize()) / (sizeof(BLeafEntry) + tot_size); 
   int internal_size = (PAGE_SIZE - BPlusTreeInternalPage::GetHeaderSize()) / (sizeof(BInternalEntry) + tot_size); 
   container_.Init(index_id, buffer_pool_manager, tot_size ,leaf_size ,internal_size);
@@ -27,26 +24,20 @@ BPlusTreeIndex::BPlusTreeIndex(index_id_t index_id, IndexSchema *key_schema, Buf
   index_type_ = BPTREE;
 }
 
-BPlusTreeIndex::~BPlusTreeIndex(){
-  if(serialize_buffer_)delete [] serialize_buffer_;
-}
+BPlusTreeIndex::~BPlusTreeIndex(){}
 
-void BPlusTreeIndex::AdjustBufferFor(const Row& row){
-  size_t rowsize = row.GetSerializedSize(this->key_schema_);
-  size_t keysize = sizeof(IndexKey) + rowsize;
-  if(keysize > buffer_size_){
-    if(serialize_buffer_)delete[] serialize_buffer_;
-    serialize_buffer_ = new char[2 * keysize];
-    buffer_size_ = keysize * 2;
-  }
+IndexKey *BPlusTreeIndex::SerializeKey(const Row &key, std::vector<char> &buffer) {
+  size_t keysize = sizeof(IndexKey) + key.GetSerializedSize(this->key_schema_);
+  buffer.resize(std::max(keysize, buffer_size_));
+  return IndexKey::SerializeFromKey(buffer.data(), key, key_schema_, key_size_);
 }
 
 void BPlusTreeIndex::PrintTree() { container_.PrintTree(cout); }
 
 dberr_t BPlusTreeIndex::InsertEntry(const Row &key, RowId row_id, Transaction *txn) {
   ASSERT(row_id.Get() != INVALID_ROWID.Get(), "Invalid row id for index insert.");
-  AdjustBufferFor(key);
-  IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
+  std::vector<char> buffer;
+  IndexKey *index_key = SerializeKey(key, buffer);
   bool status = container_.Insert(index_key, row_id, txn);
   if (!status) {
     return DB_FAILED;
@@ -55,15 +46,15 @@ dberr_t BPlusTreeIndex::InsertEntry(const Row &key, RowId row_id, Transaction *t
 }
 
 dberr_t BPlusTreeIndex::RemoveEntry(const Row &key, RowId row_id, Transaction *txn) {
-  AdjustBufferFor(key);
-  IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
+  std::vector<char> buffer;
+  IndexKey *index_key = SerializeKey(key, buffer);
   container_.Remove(index_key, txn);
   return DB_SUCCESS;
 }
 
 dberr_t BPlusTreeIndex::ScanKey(const Row &key, vector<RowId> &result, Transaction *txn) {
-  AdjustBufferFor(key);
-  IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
+  std::vector<char> buffer;
+  IndexKey *index_key = SerializeKey(key, buffer);
   if (container_.GetValue(index_key, result, txn)) {
     return DB_SUCCESS;
   }
@@ -78,14 +69,14 @@ dberr_t BPlusTreeIndex::Destroy() {
 BPlusTreeIndexIterator BPlusTreeIndex::GetBeginIterator() { return container_.Begin(key_schema_); }
 
 BPlusTreeIndexIterator BPlusTreeIndex::GetBeginIterator(const Row &key) {
-  AdjustBufferFor(key);
-  IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
+  std::vector<char> buffer;
+  IndexKey *index_key = SerializeKey(key, buffer);
   return container_.Begin(index_key,key_schema_); 
 }
 
 BPlusTreeIndexIterator BPlusTreeIndex::FindLastSmallerOrEqual(const Row &key) {
-  AdjustBufferFor(key);
-  IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
+  std::vector<char> buffer;
+  IndexKey *index_key = SerializeKey(key, buffer);
   return container_.FindLastSmallerOrEqual(index_key,key_schema_); 
 }
 
@@ -43,6 +43,7 @@ void HashIndex::AdjustBufferFor(const Row& row){
 dberr_t HashIndex::InsertEntry(const Row &key, RowId row_id, Transaction *txn)
 {
         ASSERT(row_id.Get() != INVALID_ROWID.Get(), "Invalid row id for index insert.");
+        std::scoped_lock<std::mutex> lock(latch_);
         AdjustBufferFor(key);
         //generate the index key
         IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
@@ -56,6 +57,7 @@ dberr_t HashIndex::InsertEntry(const Row &key, RowId row_id, Transaction *txn)
 
 dberr_t HashIndex::RemoveEntry(const Row &key, RowId row_id, Transaction *txn)
 {
+        std::scoped_lock<std::mutex> lock(latch_);
         AdjustBufferFor(key);
         IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
         container_.Remove(index_key, row_id, txn);
@@ -64,6 +66,7 @@ dberr_t HashIndex::RemoveEntry(const Row &key, RowId row_id, Transaction *txn)
 
 dberr_t HashIndex::ScanKey(const Row &key, std::vector<RowId> &result, Transaction *txn)
 {
+        std::scoped_lock<std::mutex> lock(latch_);
         AdjustBufferFor(key);
         IndexKey *index_key = IndexKey::SerializeFromKey(serialize_buffer_,key, key_schema_, key_size_);
         if (container_.GetValue(index_key, result, txn)) {
@@ -1,4 +1,5 @@
 #include "index/index_iterator.h"
+#include <cstring>
 #include "index/b_plus_tree.h"
 #include "index/basic_comparator.h"
 #include "page/b_plus_tree_leaf_page.h"
@@ -7,15 +8,18 @@ BPlusTreeIndexIterator::BPlusTreeIndexIterator() : tree_(nullptr), node_(nullptr
   // this is an invalid iterator
 }
 
-BPlusTreeIndexIterator::BPlusTreeIndexIterator(BPlusTree *tree, Schema *key_schema, BPlusTreeLeafPage *node, int offset)
-    : tree_(tree), node_(node), index_offset_(offset), key_schema_(key_schema) {
+BPlusTreeIndexIterator::BPlusTreeIndexIterator(BPlusTree *tree, Schema *key_schema, const BPlusTreeLeafPage *node,
+                                               int offset)
+    : tree_(tree), node_(nullptr), index_offset_(offset), key_schema_(key_schema) {
   // this is a valid iterator
+  if (node != nullptr) {
+    leaf_.reset(new char[PAGE_SIZE]);
+    memcpy(leaf_.get(), node, PAGE_SIZE);
+    node_ = reinterpret_cast<BPlusTreeLeafPage *>(leaf_.get());
+  }
 }
 
-BPlusTreeIndexIterator::~BPlusTreeIndexIterator() {
-  // just unpin the page
-  //if (tree_ && node_) tree_->buffer_pool_manager_->UnpinPage(node_->GetPageId(), false);
-}
+BPlusTreeIndexIterator::~BPlusTreeIndexIterator() {}
 BLeafEntry *BPlusTreeIndexIterator::operator->() { return node_->EntryAt(index_offset_); }
 
 BLeafEntry &BPlusTreeIndexIterator::operator*() { return *node_->EntryAt(index_offset_); }
@@ -41,20 +45,15 @@ BPlusTreeIndexIterator &BPlusTreeIndexIterator::operator++() {
   if (index_offset_ < node_->GetSize() - 1) {
     this->index_offset_ += 1;
   } else {
-    // need to fetch a new page
-    this->index_offset_ = 0;
-    page_id_t next = node_->GetNextPageId();
-    if (next == INVALID_PAGE_ID) {
-      //tree_->buffer_pool_manager_->UnpinPage(node_->GetPageId(), false);
-      this->node_ = nullptr;
-      this->index_offset_ = -1;
-      return *this;
+    // the copy is done: look up the next key, the leaf may have been split or merged since
+    std::shared_ptr<ReadAhead> read_ahead = std::move(read_ahead_);
+    *this = tree_->After(node_->KeyAt(index_offset_), key_schema_);
+    if (node_ != nullptr) {
+      if (read_ahead == nullptr)
+        read_ahead = std::make_shared<ReadAhead>(tree_->buffer_pool_manager_, BPlusTreeLeafPage::NextPageIdOf);
+      read_ahead->OnPage(node_->GetPageId(), node_->GetNextPageId());
     }
-    // how to detect whether the pair is dirty
-    //tree_->buffer_pool_manager_->UnpinPage(node_->GetPageId(), false);
-    Page *p = tree_->buffer_pool_manager_->FetchPage(next, false);
-    tree_->buffer_pool_manager_->UnpinPage(p->GetPageId(), false);
-    this->node_ = reinterpret_cast<BPlusTreeLeafPage *>(p->GetData());
+    read_ahead_ = std::move(read_ahead);
   }
   return *this;
 }
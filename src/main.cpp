@@ -7,6 +7,7 @@
 #include "common/Thread_Share.h"
 #include "glog/logging.h"
 #include "parser/syntax_tree_printer.h"
+#include "server/server.h"
 #include "utils/tree_file_mgr.h"
 
 //#define ENABLE_PARSER_DEBUG
@@ -23,7 +24,6 @@ vector<string> cmd_history;
 extern std::unordered_map<std::string, Thread_Share> global_SharedMap;
 extern std::recursive_mutex global_parsetree_latch;
 extern std::recursive_mutex global_shared_latch;
-extern std::recursive_mutex global_exe_latch;
 
 void generate_shared(); //generate shared sources among threads (buffer pool, disk manager, log manager)
 void execption_handle(int sig_num);
@@ -31,12 +31,17 @@ void InitGoogleLog(char* argv);
 void InputCommand(char* input, const int len);
 CommandType PreTreat(char* input);
 int run(int&);
+int RunServer(const char* socket_path);
 
 int main(int argc, char** argv)
 {
   cout << "\nJetSQL initializing shared resources..." << endl;
   generate_shared();
 
+  //main --server [socket path]: serve the clients connected to the socket instead of stdin
+  if (argc > 1 && string(argv[1]) == "--server")
+    return RunServer(argc > 2 ? argv[2] : SERVER_SOCKET_FILENAME);
+
   vector<thread> thread_pool;
   vector<int> tids;
   for (int i = 0; i < THREAD_MAXNUM; i++)
@@ -109,42 +114,23 @@ int run(int& thread_id) {
     if (PreTreat(cmd) != SQL)
       continue;
 
-    global_parsetree_latch.lock(); //lock parse tree
-    // create buffer for sql input
-    YY_BUFFER_STATE bp = yy_scan_string(cmd);
-    if (bp == nullptr) {
-      LOG(ERROR) << "Failed to create yy buffer state." << std::endl;
-      exit(1);
-    }
-    yy_switch_to_buffer(bp);
-
-    // init parser module
-    MinisqlParserInit();
-
     // parse
-    yyparse();
+    string parse_error;
+    pSyntaxNode root_node = ParseStatement(cmd, &parse_error);
 
     // parse result handle
-    if (MinisqlParserGetError()) {
+    if (root_node == nullptr) {
       // error
-      printf("[Parse Error]: %s\n", MinisqlParserGetErrorMessage());
+      printf("[Parse Error]: %s\n", parse_error.c_str());
     }
     else {
 #ifdef ENABLE_PARSER_DEBUG
       printf("[INFO] Sql syntax parse ok!\n");
-      SyntaxTreePrinter printer(MinisqlGetParserRootNode());
+      SyntaxTreePrinter printer(root_node);
       printer.PrintTree(syntax_tree_file_mgr[0]);
 #endif
     }
 
-    pSyntaxNode root_node = CopySyntaxTree(MinisqlGetParserRootNode());
-
-    // clean memory after parse
-    MinisqlParserFinish();
-    yy_delete_buffer(bp);
-    yylex_destroy();
-    global_parsetree_latch.unlock(); //unlock parse tree
-
     context.input_ = cmd;
     clock_t stm_start = clock();
     if (engine->Execute(root_node, &context) != DB_SUCCESS)
@@ -178,6 +164,27 @@ int run(int& thread_id) {
   return 0;
 }
 
+Server* server = nullptr;
+
+void stop_server(int sig_num)
+{
+  server->Stop();
+}
+
+int RunServer(const char* socket_path)
+{
+  server = new Server(socket_path, SERVER_WORKER_NUM);
+  //the sessions end and flush their databases on the way out
+  signal(SIGINT, stop_server);
+  signal(SIGTERM, stop_server);
+  signal(SIGHUP, stop_server);
+  signal(SIGPIPE, SIG_IGN);
+  bool ok = server->Run();
+  delete server;
+  server = nullptr;
+  return ok ? 0 : 1;
+}
+
 void generate_shared()
 {
   std::fstream engine_meta_io;
@@ -200,8 +207,38 @@ void generate_shared()
       DiskManager* diskMgr = new DiskManager(db_file_name, logMgr);
       BufferPoolManager* BPMgr = new BufferPoolManager(DEFAULT_BUFFER_POOL_SIZE, diskMgr, logMgr);
       LockManager* lockMgr = nullptr;
-      CatalogManager* cataMgr = new CatalogManager(BPMgr, lockMgr, logMgr, false);
-      global_SharedMap.insert(make_pair(db_name, Thread_Share(diskMgr, BPMgr, logMgr, cataMgr, lockMgr)));
+      if(USING_LOG)
+        lockMgr = new LockManager;
+      if(USING_LOG && ENABLE_DEADLOCK_DETECTION)
+        lockMgr->StartDeadlockDetection();
+      VersionManager* versionMgr = USING_LOG ? new VersionManager : nullptr;
+      CatalogManager* cataMgr = new CatalogManager(BPMgr, lockMgr, versionMgr, logMgr, false);
+      TransactionManager* txnMgr = new TransactionManager(BPMgr, diskMgr, logMgr, lockMgr, versionMgr);
+      //recover before any session uses the database
+      if (USING_LOG)
+        txnMgr->Recover();
+      cataMgr->LoadFromBuffer();
+      //apply what the transactions committed before the crash left unapplied, and roll back what the transactions
+      //unfinished at the crash wrote, like a rollback at runtime
+      if (USING_LOG) {
+        for (auto &commit : txnMgr->TakeUnapplied()) {
+          BPMgr->SetTxn(commit.txn_);
+          cataMgr->CommitWrites(commit.txn_, &commit.freed_);
+          txnMgr->EndCommit(commit.txn_);
+          delete commit.txn_;
+        }
+        for (auto txn : txnMgr->TakeUnfinished()) {
+          BPMgr->SetTxn(txn);
+          cataMgr->RollbackWrites(txn);
+          txnMgr->Abort(txn);
+          delete txn;
+        }
+        BPMgr->SetTxn(nullptr);
+      }
+      if (USING_LOG && ENABLE_BG_CHECKPOINT)
+        txnMgr->StartBackgroundCheckPoint();
+      global_SharedMap.insert(make_pair(db_name, Thread_Share(diskMgr, BPMgr, logMgr, cataMgr, lockMgr, versionMgr,
+        txnMgr, new std::shared_mutex)));
       // } catch (int) {
       //   cout << "[Exception]: Can not initialize databases meta!\n"
       //           "(Meta file not consistent with db file. May be caused by for forced quit.)"
@@ -237,6 +274,9 @@ void InitGoogleLog(char* argv)
 
 void InputCommand(char* input, const int len)
 {
+  //the sessions share stdin, each statement is read by one of them
+  static std::mutex input_latch;
+  std::scoped_lock<std::mutex> lock(input_latch);
   memset(input, 0, len);
   int i = 0;
   char ch;
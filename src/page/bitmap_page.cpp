@@ -1,4 +1,5 @@
 #include "page/bitmap_page.h"
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 using namespace std;
@@ -41,6 +42,59 @@ bool BitmapPage<PageSize>::IsPageFree(uint32_t page_offset) const {
   return IsPageFreeLow(page_offset >> 3, page_offset & 7);
 }
 
+template<size_t PageSize>
+bool BitmapPage<PageSize>::AllocatePageAt(uint32_t page_offset) {
+  if(page_offset >= MAX_CHARS * 8)return false;
+  uint8_t &current_byte = bytes[page_offset >> 3];
+  if(current_byte & (1 << (page_offset & 7)))return false;
+  current_byte |= (1 << (page_offset & 7));
+  page_allocated_ += 1;
+  //pages before next_free_page_ are all allocated, keep it that way
+  if(page_offset == next_free_page_){
+    for(uint32_t i = page_offset;i < MAX_CHARS * 8;i++){
+      if((bytes[i >> 3] & (1 << (i & 7))) == 0){
+        next_free_page_ = i;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+template<size_t PageSize>
+bool BitmapPage<PageSize>::NextFreePage(uint32_t from, uint32_t &page_offset) const {
+  if(page_allocated_ >= MAX_CHARS * 8)return false;
+  for(uint32_t i = std::max(from, next_free_page_);i < MAX_CHARS * 8;i++){
+    //skip full bytes at once
+    if((i & 7) == 0 && bytes[i >> 3] == 0xff){
+      i += 7;
+      continue;
+    }
+    if(IsPageFreeLow(i >> 3, i & 7)){
+      page_offset = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+template<size_t PageSize>
+bool BitmapPage<PageSize>::FindFreeRun(uint32_t run_size, uint32_t from, uint32_t &run_offset) const {
+  if(run_size == 0 || page_allocated_ + run_size > MAX_CHARS * 8)return false;
+  //a run cannot start before next_free_page_, all pages before it are allocated
+  uint32_t start = std::max(from, next_free_page_);
+  start = (start + run_size - 1) / run_size * run_size;
+  for(;start + run_size <= MAX_CHARS * 8;start += run_size){
+    uint32_t i = start;
+    while(i < start + run_size && IsPageFreeLow(i >> 3, i & 7))i++;
+    if(i == start + run_size){
+      run_offset = start;
+      return true;
+    }
+  }
+  return false;
+}
+
 template<size_t PageSize>
 bool BitmapPage<PageSize>::IsPageFreeLow(uint32_t byte_index, uint8_t bit_index) const {
   if(bytes[byte_index] & ( 1 << bit_index))return false;
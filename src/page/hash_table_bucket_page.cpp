@@ -3,7 +3,7 @@
 void HashTableBucketPage::Init(key_size_t key_size)
 {
   key_size_ = key_size;
-  memset(slot_data_, 0, PAGE_SIZE - sizeof(key_size_t));
+  memset(slot_data_, 0, PAGE_SIZE - sizeof(key_size_t) - sizeof(lsn_t));
 }
 
 bool HashTableBucketPage::GetValue(const IndexKey* key, IndexKeyComparator cmp, std::vector<RowId> *result)
@@ -42,6 +42,11 @@ bool IndexRootsPage::GetRootId(const index_id_t index_id, page_id_t *root_id) {
   return true;
 }
 
+bool IndexRootsPage::GetMaxIndexId(index_id_t *index_id) {
+  if (count_ == 0) return false;
+  *index_id = roots_[count_ - 1].first;  // kept sorted by index id
+  return true;
+}
 
 int IndexRootsPage::FindPosition(const index_id_t index_id){
   int l = 0,r = count_;
@@ -15,16 +15,19 @@ bool TablePage::InsertTuple(Row &row, Schema *schema, Transaction *txn,
   if (GetFreeSpaceRemaining() < serialized_size + SIZE_TUPLE) {
     return false;
   }
-  // Try to find a free slot to reuse.
+  // Try to find a free slot to reuse. The new tuple is locked before the page latch is released, a slot whose lock
+  // is still held (by the transaction which deleted its tuple, until it ends) is not reused, it is not waited for
+  // under the latch.
   uint32_t i;
   for (i = 0; i < GetTupleCount(); i++) {
     // If the slot is empty, i.e. its tuple has size 0,
-    if (GetTupleSize(i) == 0) {
+    if (GetTupleSize(i) == 0 && LockSlot(i, txn, lock_manager)) {
       // Then we break out of the loop at index i.
       break;
     }
   }
-  if (i == GetTupleCount() && GetFreeSpaceRemaining() < serialized_size + SIZE_TUPLE) {
+  if (i == GetTupleCount() &&
+      (GetFreeSpaceRemaining() < serialized_size + SIZE_TUPLE || !LockSlot(i, txn, lock_manager))) {
     return false;
   }
   // Otherwise we claim available free space..
@@ -45,6 +48,11 @@ bool TablePage::InsertTuple(Row &row, Schema *schema, Transaction *txn,
   return true;
 }
 
+bool TablePage::LockSlot(uint32_t slot_num, Transaction *txn, LockManager *lock_manager) {
+  return lock_manager == nullptr || txn == nullptr ||
+         lock_manager->TryLockRow(txn, RowId(GetTablePageId(), slot_num), LockMode::EXCLUSIVE);
+}
+
 bool TablePage::MarkDelete(const RowId &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager) {
   uint32_t slot_num = rid.GetSlotNum();
   // If the slot number is invalid, abort.
@@ -111,6 +119,10 @@ void TablePage::ApplyDelete(const RowId &rid, Transaction *txn, LogManager *log_
 
   uint32_t tuple_offset = GetTupleOffsetAtSlot(slot_num);
   uint32_t tuple_size = GetTupleSize(slot_num);
+  // Applied already, a commit is applied again at recovery if its end did not reach the log.
+  if (tuple_size == 0) {
+    return;
+  }
   // Check if this is a delete operation, i.e. commit a delete.
   if (IsDeleted(tuple_size)) {
     tuple_size = UnsetDeletedFlag(tuple_size);
@@ -0,0 +1,63 @@
+#include "server/protocol.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include "common/config.h"
+
+namespace {
+
+bool SendAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    // a client gone away must not kill the server with SIGPIPE
+    ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+bool RecvAll(int fd, char *data, size_t size) {
+  while (size > 0) {
+    ssize_t received = recv(fd, data, size, 0);
+    if (received < 0 && errno == EINTR) continue;
+    if (received <= 0) return false;
+    data += received;
+    size -= received;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool SendFrame(int fd, const std::string &data) {
+  uint32_t length = htonl(static_cast<uint32_t>(data.size()));
+  return SendAll(fd, reinterpret_cast<const char *>(&length), sizeof(length)) &&
+         SendAll(fd, data.data(), data.size());
+}
+
+bool RecvFrame(int fd, std::string *data) {
+  uint32_t length;
+  if (!RecvAll(fd, reinterpret_cast<char *>(&length), sizeof(length))) return false;
+  length = ntohl(length);
+  if (length > SERVER_MAX_FRAME_SIZE) return false;
+  data->resize(length);
+  return RecvAll(fd, data->data(), length);
+}
+
+bool SendResponse(int fd, ResponseStatus status, const std::string &output) {
+  std::string frame;
+  frame.reserve(output.size() + 1);
+  frame.push_back(static_cast<char>(status));
+  frame += output;
+  return SendFrame(fd, frame);
+}
+
+bool RecvResponse(int fd, ResponseStatus *status, std::string *output) {
+  if (!RecvFrame(fd, output) || output->empty()) return false;
+  *status = static_cast<ResponseStatus>((*output)[0]);
+  output->erase(0, 1);
+  return true;
+}
@@ -0,0 +1,122 @@
+#include "server/server.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "executor/execute_engine.h"
+#include "server/protocol.h"
+
+Server::Server(std::string socket_path, uint32_t worker_num)
+    : socket_path_(std::move(socket_path)), worker_num_(worker_num) {}
+
+Server::~Server() {
+  if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+bool Server::Run() {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    std::cout << "[Exception]: Socket path \"" << socket_path_ << "\" is too long!" << std::endl;
+    return false;
+  }
+  strcpy(addr.sun_path, socket_path_.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    std::cout << "[Exception]: Can not create socket: " << strerror(errno) << std::endl;
+    return false;
+  }
+  // the socket file of a server that was killed is still there
+  unlink(socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+    std::cout << "[Exception]: Can not listen on \"" << socket_path_ << "\": " << strerror(errno) << std::endl;
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  for (uint32_t i = 0; i < worker_num_; i++) workers_.emplace_back(&Server::Work, this, i);
+  std::cout << "\n[Server]: Listening on \"" << socket_path_ << "\" with " << worker_num_ << " workers" << std::endl;
+
+  while (!stop_) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      // Stop() shut the socket down
+      if (!stop_) std::cout << "[Exception]: Failed to accept a connection: " << strerror(errno) << std::endl;
+      break;
+    }
+    {
+      std::scoped_lock<std::mutex> lock(latch_);
+      pending_.push(fd);
+    }
+    cv_.notify_one();
+  }
+
+  // the waiting connections are closed, the ones being served shut down: their workers end the sessions
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    stop_ = true;
+    while (!pending_.empty()) {
+      close(pending_.front());
+      pending_.pop();
+    }
+    for (int fd : active_) shutdown(fd, SHUT_RDWR);
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) worker.join();
+  workers_.clear();
+  close(listen_fd_);
+  listen_fd_ = -1;
+  unlink(socket_path_.c_str());
+  std::cout << "[Server]: Stopped" << std::endl;
+  return true;
+}
+
+void Server::Stop() {
+  stop_ = true;
+  if (listen_fd_ >= 0) shutdown(listen_fd_, SHUT_RDWR);
+}
+
+void Server::Work(int worker_id) {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    cv_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+    if (stop_) return;
+    int fd = pending_.front();
+    pending_.pop();
+    active_.insert(fd);
+    lock.unlock();
+    Serve(fd, worker_id);
+    lock.lock();
+    // closed under the latch, Run() may not shut down a number reused by another connection
+    active_.erase(fd);
+    close(fd);
+  }
+}
+
+void Server::Serve(int fd, int worker_id) {
+  ExecuteEngine engine(DBMETA_FILENAME, worker_id);
+  ExecuteContext context;
+  std::string request;
+  while (!context.flag_quit_ && RecvFrame(fd, &request)) {
+    context.output_.clear();
+    context.input_ = request;
+    std::string parse_error;
+    dberr_t ret = DB_FAILED;
+    pSyntaxNode root_node = ParseStatement(request.c_str(), &parse_error);
+    if (root_node == nullptr) {
+      context.output_ = "[Parse Error]: " + parse_error + "\n";
+    } else {
+      ret = engine.Execute(root_node, &context);
+      FreeSyntaxTree(root_node);
+    }
+    if (!SendResponse(fd, ret == DB_SUCCESS ? ResponseStatus::SUCCESS : ResponseStatus::FAILURE, context.output_)) {
+      break;
+    }
+  }
+  engine.EndSession(&context);
+}
@@ -1,4 +1,10 @@
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -22,22 +28,16 @@ inline page_id_t getLogicalPageId(extent_id_t extent_id, uint32_t page_offset) {
   return extent_id * bitmap_capacity + page_offset;
 }
 
+thread_local Transaction *DiskManager::cur_txn_ = nullptr;
+
 
 DiskManager::DiskManager(const std::string &db_file, LogManager* log_manager) : 
 file_name_(db_file), log_manager_(log_manager){
   std::scoped_lock<std::recursive_mutex> lock(db_io_latch_);
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-    if (!db_io_.is_open()) {
-      throw std::exception();
-    }
+  // create the file if it does not exist
+  db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (db_fd_ < 0) {
+    throw std::exception();
   }
   closed = false;
   diskmeta_page_ = new Page();
@@ -46,17 +46,31 @@ file_name_(db_file), log_manager_(log_manager){
     replacer_ = new LRUReplacer(BUFFER_SIZE);
   else if(CUR_REPLACER_TYPE == CLOCK)
     replacer_ = new ClockReplacer(BUFFER_SIZE);
+  else if(CUR_REPLACER_TYPE == LRU_K)
+    replacer_ = new LRUKReplacer(BUFFER_SIZE, REPLACER_K);
   for (size_t i = 0; i < BUFFER_SIZE; i++) free_list_.emplace_back(i);
 
   bitmap_page_cache_ = new Page[BUFFER_SIZE];
-  cur_txn_ = nullptr;
 }
 
 bool DiskManager::FlushAllMeta() {
-  std::scoped_lock<std::recursive_mutex> lock(db_io_latch_);
+  std::scoped_lock lock(latch_, db_io_latch_);
   if (!closed) {
-    for (auto it : page_table_) WritePhysicalPage(getSectionMetaPageId(it.first), bitmap_page_cache_[it.second].GetData());
-    WritePhysicalPage(META_PAGE_ID, this->diskmeta_page_->GetData());
+    std::vector<std::pair<page_id_t, const char *>> pages;
+    pages.reserve(page_table_.size() + 1);
+    for (auto it : page_table_) pages.emplace_back(getSectionMetaPageId(it.first), bitmap_page_cache_[it.second].GetData());
+    pages.emplace_back(META_PAGE_ID, this->diskmeta_page_->GetData());
+    WritePhysicalPages(pages);
+  }
+  return true;
+}
+
+bool DiskManager::Sync() {
+  std::scoped_lock<std::recursive_mutex> lock(db_io_latch_);
+  if (closed) return false;
+  if (fdatasync(db_fd_) != 0) {
+    LOG(ERROR) << "fdatasync failed: " << strerror(errno);
+    return false;
   }
   return true;
 }
@@ -64,7 +78,9 @@ bool DiskManager::FlushAllMeta() {
 void DiskManager::Close() {
   std::scoped_lock<std::recursive_mutex> lock(db_io_latch_);
   FlushAllMeta();
-  db_io_.close();
+  Sync();
+  close(db_fd_);
+  db_fd_ = -1;
   closed = true;
 }
 
@@ -80,69 +96,215 @@ void DiskManager::WritePage(page_id_t logical_page_id, const char *page_data) {
   WritePhysicalPage(MapPageId(logical_page_id), page_data);
 }
 
-page_id_t DiskManager::AllocatePage() {
-  //special condition: target pid while redo new or undo delete
-  // if(target_pid!=INVALID_PAGE_ID)
-  // {
-  //   extent_id_t extent_id = getSectionId(target_pid);
-  //   uint32_t page_offset = getPageOffset(target_pid);
-  // }
+void DiskManager::WritePages(const std::vector<std::pair<page_id_t, const char *>> &pages) {
+  std::vector<std::pair<page_id_t, const char *>> physical_pages;
+  physical_pages.reserve(pages.size());
+  for (auto &page : pages) {
+    ASSERT(page.first >= 0, "Invalid page id.");
+    if (IsPageFree(page.first)) continue;
+    physical_pages.emplace_back(MapPageId(page.first), page.second);
+  }
+  WritePhysicalPages(physical_pages);
+}
 
-  // find a free section
-  Page* mp = FetchDiskMetaPage(true);
+void DiskManager::WritePhysicalPages(std::vector<std::pair<page_id_t, const char *>> &pages) {
+  if (db_fd_ == -1) {
+    LOG(ERROR) << "Write to a closed database file dropped " << pages.size() << " pages";
+    return;
+  }
+  std::sort(pages.begin(), pages.end(),
+            [](const std::pair<page_id_t, const char *> &a, const std::pair<page_id_t, const char *> &b) {
+              return a.first < b.first;
+            });
+  std::vector<iovec> iov;
+  size_t run_begin = 0;
+  while (run_begin < pages.size()) {
+    // extend the run while the next page is physically adjacent
+    size_t run_end = run_begin + 1;
+    while (run_end < pages.size() && run_end - run_begin < IOV_MAX &&
+           pages[run_end].first == pages[run_end - 1].first + 1) {
+      run_end++;
+    }
+    iov.clear();
+    for (size_t i = run_begin; i < run_end; i++) iov.push_back({const_cast<char *>(pages[i].second), PAGE_SIZE});
+    off_t offset = static_cast<off_t>(pages[run_begin].first) * PAGE_SIZE;
+    ssize_t expected = static_cast<ssize_t>(iov.size()) * PAGE_SIZE;
+    ssize_t ret;
+    do {
+      ret = pwritev(db_fd_, iov.data(), iov.size(), offset);
+    } while (ret < 0 && errno == EINTR);
+    if (ret != expected) {
+      // short or failed vectored write, write the run page by page (WritePhysicalPage reports errors)
+      for (size_t i = run_begin; i < run_end; i++) WritePhysicalPage(pages[i].first, pages[i].second);
+    }
+    run_begin = run_end;
+  }
+}
+
+PageIOQueue *DiskManager::CreateIOQueue(size_t depth) {
+  return new PageIOQueue(db_fd_, depth, ENABLE_IO_URING);
+}
+
+void DiskManager::ReadPageAsync(PageIOQueue *io_queue, page_id_t logical_page_id, char *page_data,
+                                IOCallback callback) {
+  ASSERT(logical_page_id >= 0, "Invalid page id.");
+  if (IsPageFree(logical_page_id)) {
+    callback(true);
+    return;
+  }
+  off_t offset = static_cast<off_t>(MapPageId(logical_page_id)) * PAGE_SIZE;
+  io_queue->PrepareRead(offset, page_data, std::move(callback));
+}
+
+void DiskManager::WritePageAsync(PageIOQueue *io_queue, page_id_t logical_page_id, const char *page_data,
+                                 IOCallback callback) {
+  ASSERT(logical_page_id >= 0, "Invalid page id.");
+  if (IsPageFree(logical_page_id)) {
+    callback(true);
+    return;
+  }
+  off_t offset = static_cast<off_t>(MapPageId(logical_page_id)) * PAGE_SIZE;
+  io_queue->PrepareWrite(offset, page_data, std::move(callback));
+}
+
+page_id_t DiskManager::AllocatePage(AllocationHint *hint) {
+  // bitmap and meta page updates must be atomic now that buffer pool shards call in concurrently
+  std::scoped_lock<std::recursive_mutex> lock(latch_);
+  page_id_t allocated_id;
+  // a hinted page comes from the run of the hint, a new run is reserved once it is used up
+  if (hint != nullptr) {
+    if (AllocateFromRun(hint, allocated_id)) return allocated_id;
+    if (ReserveRun(hint) && AllocateFromRun(hint, allocated_id)) return allocated_id;
+  }
+
+  // otherwise take the first free page that is not in a reserved run, starting at the first unfull extent
+  Page* mp = FetchDiskMetaPage(false);
   DiskFileMetaPage *disk_meta = reinterpret_cast<DiskFileMetaPage *>(mp);
-  extent_id_t extent_id = disk_meta->next_unfull_extent;
-  page_id_t allocated_id = 0;
-  ASSERT(extent_id < DiskFileMetaPage::GetMaxNumExtents(), "Invalid next_unfull_extent in DiskMetaPage.");
-  if (extent_id < disk_meta->num_extents_) {  // this next_free_section is not full indeed
-    // find a free page in this section
-    // load the page meta data
-    Page *p = FetchBitmapPage(extent_id, true);
-    BitmapPage<PAGE_SIZE> *bmp_meta = reinterpret_cast<BitmapPage<PAGE_SIZE> *>(p->data_);
+  ASSERT(disk_meta->next_unfull_extent < DiskFileMetaPage::GetMaxNumExtents(), "Invalid next_unfull_extent in DiskMetaPage.");
+  allocated_id = INVALID_PAGE_ID;
+  for (extent_id_t extent_id = disk_meta->next_unfull_extent;
+       static_cast<uint32_t>(extent_id) < disk_meta->num_extents_ && allocated_id == INVALID_PAGE_ID; extent_id++) {
+    if (disk_meta->extent_used_page_[extent_id] == bitmap_capacity) continue;
+    Page *p = FetchBitmapPage(extent_id, false);
+    BitmapPage<PAGE_SIZE> *bmp_meta = reinterpret_cast<BitmapPage<PAGE_SIZE> *>(p->GetData());
     uint32_t page_offset = 0;
-    if (bmp_meta->AllocatePage(page_offset)) {
-      allocated_id = getLogicalPageId(extent_id, page_offset);
-      disk_meta->extent_used_page_[extent_id] += 1;
-      disk_meta->num_allocated_pages_ += 1;
-      if (disk_meta->extent_used_page_[extent_id] == bitmap_capacity) {
-        // this extent is full. Find a new unfull extent.
-        disk_meta->next_unfull_extent = disk_meta->num_extents_;
-        for (uint32_t i = 0; i < disk_meta->GetExtentNums(); i++) {
-          if (disk_meta->extent_used_page_[i] < bitmap_capacity) {
-            disk_meta->next_unfull_extent = i;
-            break;
-          }
-        }
+    while (bmp_meta->NextFreePage(page_offset, page_offset)) {
+      if (!IsPageReserved(getLogicalPageId(extent_id, page_offset))) {
+        allocated_id = getLogicalPageId(extent_id, page_offset);
+        break;
       }
-      p->is_dirty_ = 1;
-      UnpinBitmapPage(extent_id, true);
-      UnpinDiskMetaPage(true);
-    } else {
-      ASSERT(0, "Allocate Extent page failed.");
+      // skip the rest of the reserved run
+      page_offset = (page_offset / ALLOCATION_RUN_SIZE + 1) * ALLOCATION_RUN_SIZE;
     }
-  } else {  // the next_free_section is full, indicates that all allocated sections are full
-            // allocate a new section
+    UnpinBitmapPage(extent_id, false);
+  }
+  if (allocated_id == INVALID_PAGE_ID) {
+    // all allocated extents are full (or reserved), allocate a new extent
     ASSERT(disk_meta->num_extents_ < DiskFileMetaPage::GetMaxNumExtents(), "All Extents are full.");
-    extent_id = disk_meta->num_extents_;
-    Page *p = FetchBitmapPage(extent_id, true);
-    BitmapPage<PAGE_SIZE> *ext_meta = reinterpret_cast<BitmapPage<PAGE_SIZE> *>(p->data_);
-    uint32_t page_offset;
-    if (ext_meta->AllocatePage(page_offset)) {
-      disk_meta->num_extents_ += 1;
-      disk_meta->extent_used_page_[extent_id] = 1;
-      disk_meta->num_allocated_pages_ += 1;
-      allocated_id = getLogicalPageId(extent_id, page_offset);
-      p->is_dirty_ = 1;
-      UnpinBitmapPage(extent_id, true);
-      UnpinDiskMetaPage(true);
-    } else {
-      ASSERT(0, "Allocate Extent page failed.");
-    }
+    allocated_id = getLogicalPageId(disk_meta->num_extents_, 0);
+  }
+  UnpinDiskMetaPage(false);
+  if (!AllocatePageAt(allocated_id)) {
+    ASSERT(0, "Allocate Extent page failed.");
   }
   return allocated_id;
 }
 
+bool DiskManager::AllocatePageAt(page_id_t logical_page_id) {
+  std::scoped_lock<std::recursive_mutex> lock(latch_);
+  if (!IsPageFree(logical_page_id)) return false;
+  extent_id_t extent_id = getSectionId(logical_page_id);
+  Page* mp = FetchDiskMetaPage(true);
+  DiskFileMetaPage *disk_meta = reinterpret_cast<DiskFileMetaPage *>(mp);
+  Page *p = FetchBitmapPage(extent_id, true);
+  BitmapPage<PAGE_SIZE> *bmp_meta = reinterpret_cast<BitmapPage<PAGE_SIZE> *>(p->GetData());
+  if (!bmp_meta->AllocatePageAt(getPageOffset(logical_page_id))) {
+    ASSERT(0, "Allocate Extent page failed.");
+  }
+  while (extent_id >= static_cast<extent_id_t>(disk_meta->num_extents_)) {
+    // the first page of a new extent (recovery may also skip extents whose allocation was lost)
+    disk_meta->extent_used_page_[disk_meta->num_extents_] = 0;
+    disk_meta->num_extents_ += 1;
+  }
+  disk_meta->extent_used_page_[extent_id] += 1;
+  disk_meta->num_allocated_pages_ += 1;
+  if (disk_meta->extent_used_page_[extent_id] == bitmap_capacity &&
+      static_cast<uint32_t>(extent_id) == disk_meta->next_unfull_extent) {
+    // this extent is full. Find a new unfull extent.
+    disk_meta->next_unfull_extent = disk_meta->num_extents_;
+    for (uint32_t i = 0; i < disk_meta->GetExtentNums(); i++) {
+      if (disk_meta->extent_used_page_[i] < bitmap_capacity) {
+        disk_meta->next_unfull_extent = i;
+        break;
+      }
+    }
+  }
+  p->is_dirty_ = 1;
+  UnpinBitmapPage(extent_id, true);
+  UnpinDiskMetaPage(true);
+  return true;
+}
+
+bool DiskManager::AllocateFromRun(AllocationHint *hint, page_id_t &logical_page_id) {
+  // pages of the run may have been taken before it was reserved (e.g. by an earlier run of the same hint)
+  while (hint->next_page_id_ != INVALID_PAGE_ID && hint->next_page_id_ < hint->run_end_) {
+    page_id_t page_id = hint->next_page_id_++;
+    if (AllocatePageAt(page_id)) {
+      logical_page_id = page_id;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DiskManager::ReserveRun(AllocationHint *hint) {
+  Page* mp = FetchDiskMetaPage(false);
+  DiskFileMetaPage *disk_meta = reinterpret_cast<DiskFileMetaPage *>(mp);
+  page_id_t run = INVALID_PAGE_ID;
+  for (extent_id_t extent_id = 0;
+       static_cast<uint32_t>(extent_id) < disk_meta->num_extents_ && run == INVALID_PAGE_ID; extent_id++) {
+    if (bitmap_capacity - disk_meta->extent_used_page_[extent_id] < ALLOCATION_RUN_SIZE) continue;
+    Page *p = FetchBitmapPage(extent_id, false);
+    BitmapPage<PAGE_SIZE> *bmp_meta = reinterpret_cast<BitmapPage<PAGE_SIZE> *>(p->GetData());
+    uint32_t run_offset = 0;
+    while (bmp_meta->FindFreeRun(ALLOCATION_RUN_SIZE, run_offset, run_offset)) {
+      if (!IsPageReserved(getLogicalPageId(extent_id, run_offset))) {
+        run = getLogicalPageId(extent_id, run_offset);
+        break;
+      }
+      run_offset += ALLOCATION_RUN_SIZE;
+    }
+    UnpinBitmapPage(extent_id, false);
+  }
+  if (run == INVALID_PAGE_ID && disk_meta->num_extents_ < DiskFileMetaPage::GetMaxNumExtents()) {
+    // start the next extent with this run
+    run = getLogicalPageId(disk_meta->num_extents_, 0);
+  }
+  UnpinDiskMetaPage(false);
+  if (run == INVALID_PAGE_ID) return false;
+  // what is left of the current run goes back to everybody
+  if (hint->run_end_ != INVALID_PAGE_ID) reserved_runs_.erase(hint->run_end_ - ALLOCATION_RUN_SIZE);
+  reserved_runs_[run] = hint->token_;
+  hint->next_page_id_ = run;
+  hint->run_end_ = run + ALLOCATION_RUN_SIZE;
+  return true;
+}
+
+bool DiskManager::IsPageReserved(page_id_t logical_page_id) {
+  uint32_t page_offset = getPageOffset(logical_page_id);
+  page_id_t run = logical_page_id - page_offset % ALLOCATION_RUN_SIZE;
+  auto it = reserved_runs_.find(run);
+  if (it == reserved_runs_.end()) return false;
+  if (it->second.expired()) {
+    // the hint is gone (table or index dropped)
+    reserved_runs_.erase(it);
+    return false;
+  }
+  return true;
+}
+
 void DiskManager::DeAllocatePage(page_id_t logical_page_id) {
+  std::scoped_lock<std::recursive_mutex> lock(latch_);
   // firstly check if this page is allocated
   extent_id_t extId = getSectionId(logical_page_id);
   // ReadPhysicalPage(0, DiskMetaPage);
@@ -156,6 +318,7 @@ void DiskManager::DeAllocatePage(page_id_t logical_page_id) {
     if (ext_meta->DeAllocatePage(page_offset) && disk_meta->extent_used_page_[extId]) {
       disk_meta->num_allocated_pages_ -= 1;
       disk_meta->extent_used_page_[extId] -= 1;
+      if (static_cast<uint32_t>(extId) < disk_meta->next_unfull_extent) disk_meta->next_unfull_extent = extId;
       p->is_dirty_ = 1;
     }else{
       ASSERT(0,"dealloc page failed.");
@@ -168,6 +331,7 @@ void DiskManager::DeAllocatePage(page_id_t logical_page_id) {
 }
 
 bool DiskManager::IsPageFree(page_id_t logical_page_id) {
+  std::scoped_lock<std::recursive_mutex> lock(latch_);
   Page* mp = FetchDiskMetaPage(false);
   DiskFileMetaPage *disk_meta = reinterpret_cast<DiskFileMetaPage *>(mp);
   extent_id_t ext_id = getSectionId(logical_page_id);
@@ -201,40 +365,46 @@ int DiskManager::GetFileSize(const std::string &file_name) {
 }
 
 void DiskManager::ReadPhysicalPage(page_id_t physical_page_id, char *page_data) {
-  int offset = physical_page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset >= GetFileSize(file_name_)) {
+  off_t offset = static_cast<off_t>(physical_page_id) * PAGE_SIZE;
+  size_t read_count = 0;
+  while (read_count < PAGE_SIZE) {
+    ssize_t ret = pread(db_fd_, page_data + read_count, PAGE_SIZE - read_count, offset + read_count);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret < 0) {
+      LOG(ERROR) << "I/O error while reading: " << strerror(errno);
+      break;
+    }
+    // reached end of file
+    if (ret == 0) break;
+    read_count += ret;
+  }
+  // if file ends before reading PAGE_SIZE
+  if (read_count < PAGE_SIZE) {
 #ifdef ENABLE_BPM_DEBUG
     LOG(INFO) << "Read less than a page" << std::endl;
 #endif
-    memset(page_data, 0, PAGE_SIZE);
-  } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-#ifdef ENABLE_BPM_DEBUG
-      LOG(INFO) << "Read less than a page" << std::endl;
-#endif
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
-    }
+    memset(page_data + read_count, 0, PAGE_SIZE - read_count);
   }
 }
 
 void DiskManager::WritePhysicalPage(page_id_t physical_page_id, const char *page_data) {
-  size_t offset = static_cast<size_t>(physical_page_id) * PAGE_SIZE;
-  // set write cursor to offset
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
-    LOG(ERROR) << "I/O error while writing";
+  if (db_fd_ == -1) {
+    LOG(ERROR) << "Write to a closed database file dropped page " << physical_page_id;
     return;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+  off_t offset = static_cast<off_t>(physical_page_id) * PAGE_SIZE;
+  size_t write_count = 0;
+  while (write_count < PAGE_SIZE) {
+    ssize_t ret = pwrite(db_fd_, page_data + write_count, PAGE_SIZE - write_count, offset + write_count);
+    if (ret < 0 && errno == EINTR) continue;
+    // check for I/O error
+    if (ret <= 0) {
+      LOG(ERROR) << "I/O error while writing: " << strerror(errno);
+      return;
+    }
+    write_count += ret;
+  }
+  // no flush here, durability is provided by Sync() at checkpoint
 }
 
 Page *DiskManager::FetchBitmapPage(extent_id_t extent_id, bool to_write) {
@@ -320,22 +490,15 @@ bool DiskManager::UnpinBitmapPage(extent_id_t extent_id, bool is_dirty) {
   }
   frame_id_t fid = it->second;
   Page &p = bitmap_page_cache_[fid];
-  p.is_dirty_ |= is_dirty;
+  if (is_dirty) p.is_dirty_ = true;
   if (p.pin_count_) p.pin_count_--;
   if (p.pin_count_ == 0) replacer_->Unpin(fid);
 
   if(USING_LOG && is_dirty)
   {
     ASSERT(old_bitmappage_map_.find(extent_id)!=old_bitmappage_map_.end(), "Unpin not matched!");
-    char *old_data = old_bitmappage_map_[extent_id].data_;
+    // bitmap pages are not logged, allocations are redone from the records of the pages themselves
     old_bitmappage_map_.erase(extent_id);
-
-    txn_id_t tid = cur_txn_==nullptr?INVALID_TXN_ID:cur_txn_->GetTid();
-    LogRecordType type = BITMAP_WRITE;
-    LogRecord* append_rec = new LogRecord(type, log_manager_->GetMaxLSN()+1, tid, INVALID_PAGE_ID, 
-        old_data, p.GetData(), extent_id, nullptr, nullptr);
-    //log_manager_->AddRecord(append_rec);
-    //std::cout<<"adding bitmap record"<<std::endl;
   }
 
   if(is_dirty)
@@ -364,16 +527,6 @@ Page *DiskManager::FetchDiskMetaPage(bool to_write) {
 
 bool DiskManager::UnpinDiskMetaPage(bool is_dirty){
   latch_.lock();
-  if(USING_LOG && is_dirty)
-  {
-      char *old_data = old_diskmeta_data_.data_;
-      txn_id_t tid = cur_txn_==nullptr?INVALID_TXN_ID:cur_txn_->GetTid();
-      LogRecordType type = DISKMETA_WRITE;
-      LogRecord* append_rec = new LogRecord(type, log_manager_->GetMaxLSN()+1, tid, INVALID_PAGE_ID, 
-          old_data, diskmeta_page_->GetData(), INVALID_FRAME_ID, nullptr, nullptr);
-      //log_manager_->AddRecord(append_rec);
-      //std::cout<<"adding diskmeta record"<<std::endl;
-  }
   latch_.unlock();
   return true;
 }
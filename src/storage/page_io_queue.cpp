@@ -0,0 +1,240 @@
+#include "storage/page_io_queue.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "common/config.h"
+#include "glog/logging.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define PAGE_IO_HAS_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef PAGE_IO_HAS_URING
+// liburing is not required, the ring is set up and driven with the raw system calls
+struct PageIOQueue::Ring {
+  int ring_fd_{-1};
+  void *sq_ptr_{MAP_FAILED};
+  size_t sq_size_{0};
+  void *cq_ptr_{MAP_FAILED};
+  size_t cq_size_{0};
+  io_uring_sqe *sqes_{static_cast<io_uring_sqe *>(MAP_FAILED)};
+  size_t sqes_size_{0};
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  io_uring_cqe *cqes_;
+
+  ~Ring() {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+    if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+  }
+};
+#else
+struct PageIOQueue::Ring {};
+#endif
+
+PageIOQueue::PageIOQueue(int fd, size_t depth, bool use_uring) : fd_(fd), depth_(depth) {
+  if (use_uring && !SetupRing(depth)) {
+    LOG(WARNING) << "io_uring is not available, page io falls back to pread/pwrite";
+  }
+}
+
+PageIOQueue::~PageIOQueue() {
+  WaitAll();
+  delete ring_;
+}
+
+bool PageIOQueue::SetupRing(size_t depth) {
+#ifdef PAGE_IO_HAS_URING
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (ring_fd < 0) return false;
+  Ring *ring = new Ring();
+  ring->ring_fd_ = ring_fd;
+  ring->sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) ring->sq_size_ = ring->cq_size_ = std::max(ring->sq_size_, ring->cq_size_);
+  ring->sq_ptr_ = mmap(nullptr, ring->sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_SQ_RING);
+  if (ring->sq_ptr_ != MAP_FAILED) {
+    ring->cq_ptr_ = single_mmap ? ring->sq_ptr_
+                                : mmap(nullptr, ring->cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                       ring_fd, IORING_OFF_CQ_RING);
+  }
+  if (ring->cq_ptr_ != MAP_FAILED) {
+    ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+  }
+  if (ring->sqes_ == MAP_FAILED) {
+    delete ring;
+    return false;
+  }
+  char *sq = static_cast<char *>(ring->sq_ptr_);
+  char *cq = static_cast<char *>(ring->cq_ptr_);
+  ring->sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  ring->sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  ring->sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  ring->cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  ring->cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  ring->cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  ring->cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  // the completion ring is at least as large as the submission ring, so in-flight requests never overflow it
+  depth_ = std::min<size_t>(depth_, params.sq_entries);
+  ring_ = ring;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PageIOQueue::PrepareRead(off_t offset, char *page_data, IOCallback callback) {
+  pending_.push_back(new Request{false, offset, page_data, 0, std::move(callback)});
+}
+
+void PageIOQueue::PrepareWrite(off_t offset, const char *page_data, IOCallback callback) {
+  // the buffer is only read from for a write
+  pending_.push_back(new Request{true, offset, const_cast<char *>(page_data), 0, std::move(callback)});
+}
+
+bool PageIOQueue::Enter(unsigned min_complete) {
+#ifdef PAGE_IO_HAS_URING
+  unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    int ret = syscall(__NR_io_uring_enter, ring_->ring_fd_, to_submit_, min_complete, flags, nullptr, 0);
+    if (ret >= 0) {
+      to_submit_ -= std::min<unsigned>(ret, to_submit_);
+      return true;
+    }
+    if (errno == EINTR) continue;
+    // EAGAIN/EBUSY: the kernel is short of resources, the entries stay queued and go with the next call
+    if (errno != EAGAIN && errno != EBUSY) LOG(ERROR) << "io_uring_enter failed: " << strerror(errno);
+    return false;
+  }
+#else
+  return false;
+#endif
+}
+
+void PageIOQueue::Submit() {
+  if (ring_ == nullptr) {
+    // synchronous fallback: every request completes here
+    while (!pending_.empty()) {
+      Request *request = pending_.front();
+      pending_.pop_front();
+      Complete(request, -1);
+    }
+    return;
+  }
+#ifdef PAGE_IO_HAS_URING
+  // only this thread produces entries, the kernel only reads the tail
+  unsigned tail = *ring_->sq_tail_;
+  unsigned mask = *ring_->sq_mask_;
+  while (!pending_.empty() && in_flight_ < depth_) {
+    Request *request = pending_.front();
+    pending_.pop_front();
+    unsigned index = tail & mask;
+    io_uring_sqe *sqe = &ring_->sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->is_write_ ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(request->data_);
+    sqe->len = PAGE_SIZE;
+    sqe->off = request->offset_;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+    ring_->sq_array_[index] = index;
+    tail++;
+    to_submit_++;
+    in_flight_++;
+  }
+  __atomic_store_n(ring_->sq_tail_, tail, __ATOMIC_RELEASE);
+  if (to_submit_ > 0) Enter(0);
+#endif
+}
+
+size_t PageIOQueue::Reap(bool wait) {
+  if (ring_ == nullptr) return 0;
+  size_t reaped = 0;
+#ifdef PAGE_IO_HAS_URING
+  while (true) {
+    unsigned head = *ring_->cq_head_;
+    unsigned tail = __atomic_load_n(ring_->cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      io_uring_cqe *cqe = &ring_->cqes_[head & *ring_->cq_mask_];
+      Request *request = reinterpret_cast<Request *>(cqe->user_data);
+      int result = cqe->res;
+      head++;
+      // hand the entry back before the callback, which may prepare more requests
+      __atomic_store_n(ring_->cq_head_, head, __ATOMIC_RELEASE);
+      in_flight_--;
+      reaped++;
+      Complete(request, result);
+    }
+    // completions freed room for the prepared requests that did not fit
+    if (reaped > 0 && !pending_.empty()) Submit();
+    if (reaped > 0 || !wait || in_flight_ == 0) break;
+    if (!Enter(1) && to_submit_ == 0) {
+      // the wait itself failed, do not spin on it
+      LOG(ERROR) << "io_uring wait failed with " << in_flight_ << " requests in flight";
+      break;
+    }
+  }
+#endif
+  return reaped;
+}
+
+void PageIOQueue::WaitAll() {
+  while (!pending_.empty() || in_flight_ > 0) {
+    Submit();
+    Reap(true);
+  }
+}
+
+bool PageIOQueue::SyncTransfer(Request *request) {
+  while (request->done_ < PAGE_SIZE) {
+    size_t left = PAGE_SIZE - request->done_;
+    off_t offset = request->offset_ + request->done_;
+    ssize_t ret = request->is_write_ ? pwrite(fd_, request->data_ + request->done_, left, offset)
+                                     : pread(fd_, request->data_ + request->done_, left, offset);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret < 0) {
+      LOG(ERROR) << "I/O error while " << (request->is_write_ ? "writing: " : "reading: ") << strerror(errno);
+      return false;
+    }
+    // a read reached end of file
+    if (ret == 0 && !request->is_write_) break;
+    if (ret == 0) return false;
+    request->done_ += ret;
+  }
+  return true;
+}
+
+void PageIOQueue::Complete(Request *request, int result) {
+  bool ok;
+  if (result > 0) request->done_ += result;
+  if (request->done_ == PAGE_SIZE || (result == 0 && !request->is_write_)) {
+    ok = true;
+  } else {
+    // failed (e.g. an opcode the kernel does not know) or short transfer: finish it the synchronous way
+    ok = SyncTransfer(request);
+  }
+  if (ok && !request->is_write_ && request->done_ < PAGE_SIZE) {
+    memset(request->data_ + request->done_, 0, PAGE_SIZE - request->done_);
+  }
+  request->callback_(ok);
+  delete request;
+}
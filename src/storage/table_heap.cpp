@@ -2,20 +2,30 @@
 #include <iostream>
 #include "common/config.h"
 bool TableHeap::InsertTuple(Row &row, Transaction *txn) {
+  // the page locks the new tuple for the transaction before it is unlatched, no other session sees the tuple unlocked
+  std::scoped_lock<std::mutex> lock(latch_);
+  return InsertIntoPage(row, txn);
+}
+
+bool TableHeap::InsertIntoPage(Row &row, Transaction *txn) {
   page_id_t pid=INVALID_PAGE_ID;
   //find the page to insert
   if(first_page_id_==INVALID_PAGE_ID)
   {
-    auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(pid));  // first tuple, get a new page from buffer pool
+    auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(pid, &alloc_hint_));  // first tuple, get a new page from buffer pool
     if(pid==INVALID_PAGE_ID)//can't even create a new page
       return false;
     first_page_id_ = pid;
     last_page_id_ = pid;
     page->Init(pid,INVALID_PAGE_ID,log_manager_,txn);//initialize the new page
-    page->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);//single tuple must be able to insert (assumption)
+    bool inserted = page->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);//fails only if the lock is held
+    if (inserted) {
+      KeepVersion(row.GetRowId(), txn, nullptr);
+      AddWrite(txn, {WriteRecord::Type::INSERT, first_page_id_, row.GetRowId()});
+    }
     buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
     page_heap_.push(make_pair(this,page->GetPageId()));
-    return true;
+    return inserted;
   }
   else// not first tuple
   {
@@ -30,48 +40,62 @@ bool TableHeap::InsertTuple(Row &row, Transaction *txn) {
     {
       auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_heap_.top().second, true));
       page_heap_.pop();
-      page->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);
-      // ASSERT(, "logic error: enough space but insert failed!");
-      buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);      
+      // enough space, it fails only if no free slot can be locked, the page is left as it was then
+      bool inserted = page->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);
+      if (inserted) {
+        KeepVersion(row.GetRowId(), txn, nullptr);
+        AddWrite(txn, {WriteRecord::Type::INSERT, first_page_id_, row.GetRowId()});
+      }
+      buffer_pool_manager_->UnpinPage(page->GetTablePageId(), inserted, false);
       page_heap_.push(make_pair(this,page->GetPageId()));
-      return true;
+      return inserted;
     }
     else//create a new page to insert
     {
       auto last_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(last_page_id_, true));
       page_id_t next_pid = INVALID_PAGE_ID;
-      auto page_next = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(next_pid));
+      auto page_next = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(next_pid, &alloc_hint_));
       if(next_pid==INVALID_PAGE_ID)
         return false;
       last_page->SetNextPageId(next_pid);
       page_next->Init(next_pid,last_page_id_,log_manager_,txn);//initialize the new page
-      page_next->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);//single tuple must be able to insert (assumption)
+      bool inserted = page_next->InsertTuple(row, schema_, txn, lock_manager_, log_manager_);//fails only if the lock is held
+      if (inserted) {
+        KeepVersion(row.GetRowId(), txn, nullptr);
+        AddWrite(txn, {WriteRecord::Type::INSERT, first_page_id_, row.GetRowId()});
+      }
       buffer_pool_manager_->UnpinPage(last_page_id_, true);
       last_page_id_ = next_pid;
 
       buffer_pool_manager_->UnpinPage(page_next->GetPageId(), true);    
       page_heap_.push(make_pair(this,page_next->GetPageId()));  
-      return true;
+      return inserted;
     }
   }
 }
 
 //implemented already
-bool TableHeap::MarkDelete(const RowId &rid, Transaction *txn) {
+bool TableHeap::MarkDelete(const RowId &rid, Transaction *txn, BufferAccessStrategy *strategy) {
+  if (!LockRow(rid, txn, LockMode::EXCLUSIVE)) return false;
   // Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true, strategy));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     return false;
   }
   // Otherwise, mark the tuple as deleted.
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  if (!page->MarkDelete(rid, txn, lock_manager_, log_manager_)) {
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false, false);
+    return false;
+  }
+  KeepVersion(rid, txn, page);
+  AddWrite(txn, {WriteRecord::Type::DELETE, first_page_id_, rid});
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   return true;
 }
 
-bool TableHeap::UpdateTuple(const Row &row, const RowId &rid, Transaction *txn) {
-  //difficult--------------------(not well yet!)
+bool TableHeap::UpdateTuple(Row &row, const RowId &rid, Transaction *txn) {
+  if (!LockRow(rid, txn, LockMode::EXCLUSIVE)) return false;
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true));//find the original page
   if(page==nullptr)
     return false;
@@ -79,36 +103,38 @@ bool TableHeap::UpdateTuple(const Row &row, const RowId &rid, Transaction *txn)
   old_row.SetRowId(rid);
   if(!page->GetTuple(&old_row, schema_, txn, lock_manager_))
   {
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false, false);
     return false;
   }
+  KeepVersion(rid, txn, page);
+  std::vector<char> image;
+  if (txn != nullptr) {
+    char *tuple = page->GetData() + page->GetTupleOffsetAtSlot(rid.GetSlotNum());
+    image.assign(tuple, tuple + page->GetTupleSize(rid.GetSlotNum()));
+  }
   UPDATE_RESULT res = page->UpdateTuple(row, &old_row, schema_, txn, lock_manager_, log_manager_);
-  if(res==SLOT_INVALID||res==TUPLE_DELETED)
-    return false;
-  else if(res==UPDATE_SUCCESS)
+  if(res==UPDATE_SUCCESS)
   {
+    AddWrite(txn, {WriteRecord::Type::UPDATE, first_page_id_, rid, std::move(image)});
     buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+    row.SetRowId(rid);
     return true;
   }
-  else if(res==SPACE_NOT_ENOUGH)//space not enough for new tuple. new method to update
-  {
-    //not sure!
-    if(!this->MarkDelete(rid, txn))
-      return false;
-    //copy row to new row
-    Row new_row(row);
-    RowId null_rid(INVALID_PAGE_ID, 0);
-    new_row.SetRowId(null_rid);  // position is not determined
-    if(!this->InsertTuple(new_row, txn))
-      return false;
-    buffer_pool_manager_->UnpinPage(new_row.GetRowId().GetPageId(), true);
-    return true;
-  }
-  return false;//won't come here
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false, false);
+  if(res!=SPACE_NOT_ENOUGH)
+    return false;
+  //space not enough for new tuple: it is deleted and inserted somewhere else
+  if(!this->MarkDelete(rid, txn))
+    return false;
+  if(txn==nullptr)
+    ApplyDelete(rid, txn);
+  row.SetRowId(RowId(INVALID_PAGE_ID, 0));  // position is not determined
+  return this->InsertTuple(row, txn);
 }
 
-void TableHeap::ApplyDelete(const RowId &rid, Transaction *txn) {
+void TableHeap::ApplyDelete(const RowId &rid, Transaction *txn, BufferAccessStrategy *strategy) {
   // Step1: Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true, strategy));
   if(page==NULL)
     return;
   // Step2: Delete the tuple from the page.
@@ -126,21 +152,50 @@ void TableHeap::RollbackDelete(const RowId &rid, Transaction *txn) {
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
-void TableHeap::FreeHeap() {
-  page_id_t pid= this->GetFirstPageId();
-  while(pid!=INVALID_PAGE_ID)
+void TableHeap::RollbackUpdate(Row &row, Transaction *txn) {
+  RowId rid = row.GetRowId();
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), true));
+  assert(page != nullptr);
+  Row new_row(row);
+  if (page->UpdateTuple(row, &new_row, schema_, txn, lock_manager_, log_manager_) == UPDATE_SUCCESS) {
+    buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
+    return;
+  }
+  // the space the update freed was taken meanwhile, the tuple moves to another page
+  page->ApplyDelete(rid, txn, log_manager_);
+  buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   {
-    auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(pid, false));
-    page_id_t next_pid = page->GetNextPageId();
-    buffer_pool_manager_->UnpinPage(pid, false);
-    buffer_pool_manager_->DeletePage(pid);
-    pid = next_pid;
+    std::scoped_lock<std::mutex> lock(latch_);
+    // without the transaction: the tuple is as old as the versions it takes along, not a new one of it
+    bool __attribute__((unused)) inserted = InsertIntoPage(row, nullptr);
+    ASSERT(inserted, "The tuple fitted in a page before.");
   }
+  if (version_manager_ != nullptr) version_manager_->MoveVersions(first_page_id_, rid, row.GetRowId(), txn);
 }
 
-bool TableHeap::GetTuple(Row *row, Transaction *txn) {
+void TableHeap::FreeHeap() {
+  if (version_manager_ != nullptr) version_manager_->DropTable(first_page_id_);
+  FreePages(buffer_pool_manager_, first_page_id_);
+}
+
+void TableHeap::FreePages(BufferPoolManager *buffer_pool_manager, page_id_t first_page_id,
+                          const std::unordered_set<page_id_t> *freed) {
+  std::vector<page_id_t> pids;
+  page_id_t pid = first_page_id;
+  while (pid != INVALID_PAGE_ID && (freed == nullptr || freed->count(pid) == 0)) {
+    auto page = reinterpret_cast<TablePage *>(buffer_pool_manager->FetchPage(pid, false));
+    if (page == nullptr) break;
+    pids.push_back(pid);
+    pid = page->GetNextPageId();
+    buffer_pool_manager->UnpinPage(pids.back(), false);
+  }
+  for (auto it = pids.rbegin(); it != pids.rend(); ++it) buffer_pool_manager->DeletePage(*it);
+}
+
+bool TableHeap::GetTuple(Row *row, Transaction *txn, BufferAccessStrategy *strategy) {
   if(row->GetRowId().GetPageId() == INVALID_PAGE_ID)return false;
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(row->GetRowId().GetPageId(), false));
+  if (txn != nullptr && !LockRow(row->GetRowId(), txn, LockMode::SHARED)) return false;
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(row->GetRowId().GetPageId(), false, strategy));
   if(page==nullptr)
   {
     return false;
@@ -150,7 +205,41 @@ bool TableHeap::GetTuple(Row *row, Transaction *txn) {
   return ret;
 }
 
-TableIterator TableHeap::Begin() {
+bool TableHeap::GetVisibleTuple(Row *row, Transaction *txn, BufferAccessStrategy *strategy) {
+  if (version_manager_ == nullptr || txn == nullptr) return GetTuple(row, nullptr, strategy);
+  // the page first: a writer keeps the version before it changes the page
+  bool in_page = GetTuple(row, nullptr, strategy);
+  std::vector<char> image;
+  switch (version_manager_->ReadVersion(first_page_id_, row->GetRowId(), txn, &image)) {
+    case VersionManager::ReadResult::CURRENT:
+      return in_page;
+    case VersionManager::ReadResult::OLDER:
+      row->DeserializeFrom(image.data(), schema_);
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::vector<RowId> TableHeap::GetVersionedRows() {
+  if (version_manager_ == nullptr) return {};
+  return version_manager_->GetVersionedRows(first_page_id_);
+}
+
+std::shared_ptr<BufferAccessStrategy> TableHeap::MakeScanStrategy() {
+  // only a table that would take a good part of the pool gets a ring, a small one stays cached
+  size_t page_num;
+  {
+    std::scoped_lock<std::mutex> lock(latch_);
+    page_num = page_heap_.size();
+  }
+  if(page_num > buffer_pool_manager_->GetPoolSize() / SCAN_RING_THRESHOLD)
+    return std::make_shared<BufferAccessStrategy>(buffer_pool_manager_, SCAN_RING_SIZE);
+  return nullptr;
+}
+
+TableIterator TableHeap::Begin(Transaction *txn, bool snapshot, MemHeap *heap,
+                               std::shared_ptr<BufferAccessStrategy> strategy) {
   page_id_t fpid = GetFirstNotEmptyPageId();
   if(fpid==INVALID_PAGE_ID)
   {
@@ -158,11 +247,13 @@ TableIterator TableHeap::Begin() {
     TableIterator ret(this, rid);
     return ret;
   }
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(fpid, false));
+  if(strategy == nullptr)
+    strategy = MakeScanStrategy();
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(fpid, false, strategy.get()));
   buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
   RowId rid;
   page->GetFirstTupleRid(&rid);
-  TableIterator ret(this, rid);
+  TableIterator ret(this, rid, strategy, txn, snapshot, heap);
   return ret;
 }
 
@@ -172,6 +263,48 @@ TableIterator TableHeap::End() {
   return ret;
 }
 
+void TableHeap::LoadPages() {
+  if (first_page_id_ == INVALID_PAGE_ID) return;
+  last_page_id_ = first_page_id_;
+  page_id_t cur_pid = first_page_id_;
+  //initialize page heap (cost time?) (potential pin problem)
+  while (cur_pid != INVALID_PAGE_ID) {
+    page_heap_.push(make_pair(this, cur_pid));
+    Page *p = buffer_pool_manager_->FetchPage(cur_pid, false);
+    auto page = reinterpret_cast<TablePage *>(p);
+    last_page_id_ = cur_pid;
+    cur_pid = page->GetNextPageId();
+    buffer_pool_manager_->UnpinPage(p->GetPageId(), false);
+  }
+}
+
+bool TableHeap::LockRow(const RowId &rid, Transaction *txn, LockMode mode) {
+  return lock_manager_ == nullptr || txn == nullptr || lock_manager_->LockRow(txn, rid, mode);
+}
+
+void TableHeap::AddWrite(Transaction *txn, WriteRecord write) {
+  if (txn == nullptr) return;
+  if (log_manager_ != nullptr)
+    log_manager_->AddWrite(txn, std::move(write));
+  else
+    txn->AddWrite(std::move(write));
+}
+
+void TableHeap::KeepVersion(const RowId &rid, Transaction *txn, TablePage *page) {
+  if (version_manager_ == nullptr || txn == nullptr) return;
+  if (page == nullptr) {
+    version_manager_->AddVersion(first_page_id_, rid, txn, nullptr, 0);
+    return;
+  }
+  uint32_t slot_num = rid.GetSlotNum();
+  if (slot_num >= page->GetTupleCount()) return;
+  // a tuple just marked deleted still has its image in place
+  uint32_t tuple_size = TablePage::UnsetDeletedFlag(page->GetTupleSize(slot_num));
+  if (tuple_size == 0) return;
+  version_manager_->AddVersion(first_page_id_, rid, txn, page->GetData() + page->GetTupleOffsetAtSlot(slot_num),
+                               tuple_size);
+}
+
 //added
 TableIterator TableHeap::Find(RowId rid)
 {
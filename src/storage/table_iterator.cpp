@@ -9,22 +9,31 @@ TableIterator::TableIterator() {
   tbp = nullptr;
   rid.Set(INVALID_PAGE_ID, 0);
   row = nullptr;
+  txn_ = nullptr;
+  snapshot_ = false;
 }
 
-TableIterator::TableIterator(TableHeap *tbp, const RowId &rid) {
+TableIterator::TableIterator(TableHeap *tbp, const RowId &rid, std::shared_ptr<BufferAccessStrategy> strategy,
+                             Transaction *txn, bool snapshot, MemHeap *heap) {
   this->tbp = tbp;
   this->rid = rid;
+  this->strategy_ = strategy;
+  this->txn_ = txn;
+  this->snapshot_ = snapshot;
   if (rid.GetPageId() == INVALID_PAGE_ID || tbp == nullptr) {
     this->row = nullptr;
     this->heap_ = nullptr;
     return;
   }
-  this->heap_ = tbp->heap_;
+  this->heap_ = heap != nullptr ? heap : tbp->heap_;
   this->row = ALLOC_P(heap_, Row)(rid, heap_);
-  tbp->GetTuple(this->row, nullptr);
+  if (!ReadRow()) ++(*this);
 }
 
-TableIterator::TableIterator(const TableIterator &other) : TableIterator(other.tbp, other.rid) {}
+TableIterator::TableIterator(const TableIterator &other)
+    : TableIterator(other.tbp, other.rid, other.strategy_, other.txn_, other.snapshot_, other.heap_) {
+  this->read_ahead_ = other.read_ahead_;
+}
 
 TableIterator::~TableIterator() {
   if(this->row){
@@ -60,8 +69,14 @@ Row *TableIterator::operator->() {
 
 TableIterator &TableIterator::operator++() {
   ASSERT(rid.GetPageId() != INVALID_PAGE_ID, "++ for invalid rowid");
-  if (this->row) this->row->~Row();
-  auto page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(rid.GetPageId(), false));
+  do {
+    Advance();
+  } while (!ReadRow());
+  return *this;
+}
+
+void TableIterator::Advance() {
+  auto page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(rid.GetPageId(), false, strategy_.get()));
   if (page->GetNextTupleRid(rid, &rid)) {
     // do not forget to unpin the page
     tbp->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
@@ -81,7 +96,8 @@ TableIterator &TableIterator::operator++() {
       else  // return the first iterator to the first tuple in the next page
       {
         tbp->buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
-        cur_page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(cur_page->GetNextPageId(), false));
+        cur_page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(cur_page->GetNextPageId(), false, strategy_.get()));
+        OnNextPage(cur_page->GetPageId(), cur_page->GetNextPageId());
         RowId new_rid;
         if(!cur_page->GetFirstTupleRid(&new_rid))  // if no first tuple, check next page
         {
@@ -94,49 +110,26 @@ TableIterator &TableIterator::operator++() {
       }
     }
   }
+}
+
+bool TableIterator::ReadRow() {
+  this->row->~Row();
   *(this->row) = Row(rid, heap_);
-  tbp->GetTuple(this->row, nullptr);
-  return *this;
+  bool found = snapshot_ ? tbp->GetVisibleTuple(this->row, txn_, strategy_.get())
+                         : tbp->GetTuple(this->row, txn_, strategy_.get());
+  return found || txn_ == nullptr || rid.GetPageId() == INVALID_PAGE_ID;
+}
+
+void TableIterator::OnNextPage(page_id_t page_id, page_id_t next_page_id) {
+  if (read_ahead_ == nullptr)
+    read_ahead_ = std::make_shared<ReadAhead>(tbp->buffer_pool_manager_, TablePage::NextPageIdOf,
+                                              strategy_ ? strategy_->GetId() : 0);
+  read_ahead_->OnPage(page_id, next_page_id);
 }
 
 TableIterator TableIterator::operator++(int) {
   ASSERT(rid.GetPageId() != INVALID_PAGE_ID, "++ for invalid rowid");
   TableIterator it_temp(*this);
-  if (this->row) this->row->~Row();
-  auto page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(rid.GetPageId(), false));
-  if (page->GetNextTupleRid(rid, &rid)) {
-    // do not forget to unpin the page
-    tbp->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
-  } 
-  else  // no next tuple in this page, check the first tuple of next page, next if empty
-  {
-    auto cur_page = page;
-    while(true)
-    {
-      if (cur_page->GetNextPageId() == INVALID_PAGE_ID)  // no more page too
-      {
-        tbp->buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
-        RowId new_rid(INVALID_PAGE_ID, 0);
-        this->rid = new_rid;
-        break;
-      } 
-      else  // return the first iterator to the first tuple in the next page
-      {
-        tbp->buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
-        cur_page = reinterpret_cast<TablePage *>(tbp->buffer_pool_manager_->FetchPage(cur_page->GetNextPageId(), false));
-        RowId new_rid;
-        if(!cur_page->GetFirstTupleRid(&new_rid))  // if no first tuple, check next page
-        {
-          continue;
-        }
-        // get the first iterator to the first tuple in the next page
-        this->rid = new_rid;
-        tbp->buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
-        break;
-      }
-    }
-  }
-  *(this->row) = Row(rid, heap_);
-  tbp->GetTuple(this->row, nullptr);
-  return *this;
+  ++(*this);
+  return it_temp;
 }
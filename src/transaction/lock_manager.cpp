@@ -1,21 +1,278 @@
 #include "transaction/lock_manager.h"
+#include <algorithm>
+#include <chrono>
 
-void LockManager::SLock(page_id_t pid, Transaction* txn)
+bool LockManager::LockTable(Transaction* txn, table_id_t table_id, LockMode mode)
 {
+    return Lock(txn, LockKey{true, table_id}, mode);
+}
 
+bool LockManager::LockRow(Transaction* txn, const RowId& rid, LockMode mode)
+{
+    ASSERT(mode == LockMode::SHARED || mode == LockMode::EXCLUSIVE, "Rows are locked shared or exclusive!");
+    return Lock(txn, LockKey{false, rid.Get()}, mode);
 }
 
-void LockManager::SUnlock(page_id_t pid, Transaction* txn)
+bool LockManager::TryLockRow(Transaction* txn, const RowId& rid, LockMode mode)
 {
+    ASSERT(mode == LockMode::SHARED || mode == LockMode::EXCLUSIVE, "Rows are locked shared or exclusive!");
+    return Lock(txn, LockKey{false, rid.Get()}, mode, false);
+}
 
+bool LockManager::Lock(Transaction* txn, const LockKey& key, LockMode mode, bool wait)
+{
+    std::unique_lock<std::mutex> lock(latch_);
+    if(txn->GetState() != TransactionState::GROWING)
+        return false;
+    LockRequestQueue& queue = lock_table_[key];
+    auto req = std::find_if(queue.requests_.begin(), queue.requests_.end(),
+                            [&](const LockRequest& request){ return request.tid_ == txn->GetTid(); });
+    bool upgrade = (req != queue.requests_.end());
+    if(upgrade)
+    {
+        if(Covers(req->mode_, mode))
+            return true;
+        req->upgrade_mode_ = Combine(req->mode_, mode);
+        req->upgrading_ = true;
+    }
+    else
+        req = queue.requests_.insert(queue.requests_.end(), LockRequest{txn, txn->GetTid(), mode, mode, false, false});
+    if(!Grantable(queue, *req))
+    {
+        if(wait)
+            queue.cv_.wait(lock, [&]{ return txn->GetState() == TransactionState::ABORTED || Grantable(queue, *req); });
+        if(!wait || txn->GetState() == TransactionState::ABORTED)
+        {
+            //not waited for, or chosen as a deadlock victim. the locks granted before are released by the rollback
+            if(upgrade)
+            {
+                req->upgrade_mode_ = req->mode_;
+                req->upgrading_ = false;
+            }
+            else
+                queue.requests_.erase(req);
+            if(queue.requests_.empty())
+                lock_table_.erase(key);
+            else
+                queue.cv_.notify_all();
+            return false;
+        }
+    }
+    if(upgrade)
+    {
+        req->mode_ = req->upgrade_mode_;
+        req->upgrading_ = false;
+    }
+    else
+    {
+        req->granted_ = true;
+        txn_locks_[txn->GetTid()].push_back(key);
+    }
+    //the requests behind it may be compatible as well
+    queue.cv_.notify_all();
+    return true;
 }
 
-void LockManager::Xlock(page_id_t pid, Transaction* txn)
+void LockManager::UnlockAll(Transaction* txn)
 {
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto locks = txn_locks_.find(txn->GetTid());
+    if(locks == txn_locks_.end())
+        return;
+    for(auto &key : locks->second)
+    {
+        auto queue = lock_table_.find(key);
+        if(queue == lock_table_.end())
+            continue;
+        queue->second.requests_.remove_if([&](const LockRequest& request){ return request.tid_ == txn->GetTid(); });
+        if(queue->second.requests_.empty())
+            lock_table_.erase(queue);
+        else
+            queue->second.cv_.notify_all();
+    }
+    txn_locks_.erase(locks);
+}
 
+bool LockManager::Grantable(LockRequestQueue& queue, const LockRequest& request)
+{
+    //an upgrade only waits for the other granted locks. a new request waits for them, for the requests
+    //ahead of it (FIFO) and for the pending upgrades
+    bool ahead = true;
+    for(auto &other : queue.requests_)
+    {
+        if(&other == &request)
+        {
+            ahead = false;
+            continue;
+        }
+        if(Blocks(request, other, ahead))
+            return false;
+    }
+    return true;
+}
+
+bool LockManager::Blocks(const LockRequest& waiting, const LockRequest& other, bool other_ahead)
+{
+    LockMode mode = waiting.upgrading_ ? waiting.upgrade_mode_ : waiting.mode_;
+    if(other.granted_ && !Compatible(mode, other.mode_))
+        return true;
+    if(waiting.upgrading_)
+        return false;
+    if(other.upgrading_ && !Compatible(mode, other.upgrade_mode_))
+        return true;
+    return other_ahead && !other.granted_;
+}
+
+std::vector<txn_id_t> LockManager::DetectDeadlock()
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    //an edge for each request blocking a waiting one. victims not woken yet are left out, they wait for nothing
+    std::map<txn_id_t, std::set<txn_id_t>> waits_for;
+    std::unordered_map<txn_id_t, std::pair<Transaction*, LockRequestQueue*>> waiting;
+    for(auto &entry : lock_table_)
+    {
+        LockRequestQueue& queue = entry.second;
+        for(auto &request : queue.requests_)
+        {
+            if((request.granted_ && !request.upgrading_) || request.txn_->GetState() == TransactionState::ABORTED)
+                continue;
+            waiting[request.tid_] = std::make_pair(request.txn_, &queue);
+            bool ahead = true;
+            for(auto &other : queue.requests_)
+            {
+                if(&other == &request)
+                {
+                    ahead = false;
+                    continue;
+                }
+                if(Blocks(request, other, ahead))
+                    waits_for[request.tid_].insert(other.tid_);
+            }
+        }
+    }
+
+    //the youngest transaction of a cycle is the victim, then look for the cycles left without it
+    std::vector<txn_id_t> victims;
+    while(true)
+    {
+        std::vector<txn_id_t> path, cycle;
+        std::set<txn_id_t> visited;
+        for(auto &edges : waits_for)
+        {
+            if(visited.count(edges.first) == 0 && FindCycle(edges.first, waits_for, path, visited, cycle))
+                break;
+        }
+        if(cycle.empty())
+            break;
+        txn_id_t victim = *std::max_element(cycle.begin(), cycle.end());
+        victims.push_back(victim);
+        waits_for.erase(victim);
+        for(auto &edges : waits_for)
+            edges.second.erase(victim);
+    }
+
+    for(auto victim : victims)
+    {
+        auto &wait = waiting[victim];
+        wait.first->SetState(TransactionState::ABORTED);
+        wait.second->cv_.notify_all();
+    }
+    return victims;
+}
+
+bool LockManager::FindCycle(txn_id_t tid, const std::map<txn_id_t, std::set<txn_id_t>>& waits_for,
+                            std::vector<txn_id_t>& path, std::set<txn_id_t>& visited, std::vector<txn_id_t>& cycle)
+{
+    visited.insert(tid);
+    path.push_back(tid);
+    auto edges = waits_for.find(tid);
+    if(edges != waits_for.end())
+    {
+        for(auto next : edges->second)
+        {
+            auto pos = std::find(path.begin(), path.end(), next);
+            if(pos != path.end())
+            {
+                cycle.assign(pos, path.end());
+                return true;
+            }
+            //a node searched before leads to no cycle
+            if(visited.count(next) == 0 && FindCycle(next, waits_for, path, visited, cycle))
+                return true;
+        }
+    }
+    path.pop_back();
+    return false;
 }
 
-void LockManager::XUnlock(page_id_t pid, Transaction* txn)
+void LockManager::StartDeadlockDetection()
 {
-    
-}
\ No newline at end of file
+    detector_stop_ = false;
+    detector_thread_ = std::thread(&LockManager::DeadlockDetector, this);
+}
+
+void LockManager::StopDeadlockDetection()
+{
+    if(!detector_thread_.joinable())
+        return;
+    {
+        std::scoped_lock<std::mutex> lock(detector_latch_);
+        detector_stop_ = true;
+    }
+    detector_cv_.notify_all();
+    detector_thread_.join();
+}
+
+void LockManager::DeadlockDetector()
+{
+    std::unique_lock<std::mutex> lock(detector_latch_);
+    while(!detector_stop_)
+    {
+        detector_cv_.wait_for(lock, std::chrono::milliseconds(DEADLOCK_DETECT_INTERVAL_MS));
+        if(detector_stop_)
+            break;
+        DetectDeadlock();
+    }
+}
+
+bool LockManager::Compatible(LockMode mode1, LockMode mode2)
+{
+    //                    IS     IX     S      SIX    X
+    static const bool matrix[5][5] = {{true,  true,  true,  true,  false},   //IS
+                                      {true,  true,  false, false, false},   //IX
+                                      {true,  false, true,  false, false},   //S
+                                      {true,  false, false, false, false},   //SIX
+                                      {false, false, false, false, false}};  //X
+    return matrix[static_cast<int>(mode1)][static_cast<int>(mode2)];
+}
+
+bool LockManager::Covers(LockMode held, LockMode mode)
+{
+    switch(held)
+    {
+        case LockMode::EXCLUSIVE:
+            return true;
+        case LockMode::SHARED_INTENTION_EXCLUSIVE:
+            return mode != LockMode::EXCLUSIVE;
+        case LockMode::SHARED:
+            return mode == LockMode::SHARED || mode == LockMode::INTENTION_SHARED;
+        case LockMode::INTENTION_EXCLUSIVE:
+            return mode == LockMode::INTENTION_EXCLUSIVE || mode == LockMode::INTENTION_SHARED;
+        case LockMode::INTENTION_SHARED:
+            return mode == LockMode::INTENTION_SHARED;
+    }
+    return false;
+}
+
+LockMode LockManager::Combine(LockMode held, LockMode mode)
+{
+    if(Covers(held, mode))
+        return held;
+    if(Covers(mode, held))
+        return mode;
+    //shared and intention exclusive, in either order
+    if((held == LockMode::SHARED && mode == LockMode::INTENTION_EXCLUSIVE)
+        || (held == LockMode::INTENTION_EXCLUSIVE && mode == LockMode::SHARED))
+        return LockMode::SHARED_INTENTION_EXCLUSIVE;
+    return LockMode::EXCLUSIVE;
+}
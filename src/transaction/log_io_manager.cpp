@@ -1,58 +1,193 @@
 #include "transaction/log_io_manager.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "glog/logging.h"
+
+LogIOManager::Segment::~Segment()
+{
+    close(fd_);
+}
 
 LogIOManager::LogIOManager(string log_file_name, bool* exists_file)
 {
     log_file_name_ = log_file_name;
-    log_io_.open(log_file_name_, std::ios::binary | std::ios::in | std::ios::out);
-    // directory or file does not exist
-    if (!log_io_.is_open()) {
-        log_io_.clear();
-        // create a new file
-        log_io_.open(log_file_name_, std::ios::binary | std::ios::trunc | std::ios::out);
-        log_io_.close();
-        // reopen with original mode
-        log_io_.open(log_file_name_, std::ios::binary | std::ios::in | std::ios::out);
-        if (!log_io_.is_open()) {
-            throw std::exception();
+    //find the segments, numbered from the start of the log to its end, followed by the spare ones
+    size_t slash = log_file_name_.find_last_of('/');
+    string dir_name = (slash == string::npos) ? "." : log_file_name_.substr(0, slash);
+    string prefix = log_file_name_.substr(slash == string::npos ? 0 : slash + 1) + ".";
+    std::vector<uint64_t> seg_nos;
+    DIR* dir = opendir(dir_name.c_str());
+    if (dir != nullptr) {
+        while (struct dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+            string suffix = name.substr(prefix.size());
+            if (suffix.find_first_not_of("0123456789") != string::npos) continue;
+            seg_nos.push_back(strtoull(suffix.c_str(), nullptr, 10));
         }
-        *exists_file = false;
+        closedir(dir);
     }
-    else
-        *exists_file = true;
+    std::sort(seg_nos.begin(), seg_nos.end());
+    *exists_file = !seg_nos.empty();
+    //until the log manager finds the end of the log (Truncate), all of them may hold records
+    start_ofs_ = seg_nos.empty() ? 0 : seg_nos.front() * LOG_SEGMENT_SIZE;
+    file_size_ = seg_nos.empty() ? 0 : (seg_nos.back() + 1) * LOG_SEGMENT_SIZE;
 }
 
 LogIOManager::~LogIOManager()
 {
-    if(log_io_.is_open())
-        log_io_.close();
+    Sync();
+}
+
+string LogIOManager::GetSegmentFileName(uint64_t seg_no)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08llu", static_cast<unsigned long long>(seg_no));
+    return log_file_name_ + suffix;
 }
 
-void LogIOManager::ReadData(char* buf, ofs_t ofs, size_t size) //disk[ofs->ofs+size-1] -> buf[0->size-1]
+std::shared_ptr<LogIOManager::Segment> LogIOManager::GetSegment(uint64_t seg_no, bool create)
 {
-    ASSERT(log_io_.is_open(), "log file not open!");
-    // set read cursor to offset
-    log_io_.seekp(ofs);
-    log_io_.read(buf, size);
-    // if file ends before reading PAGE_SIZE
-    int read_count = log_io_.gcount();
-    //cout<<"readcount = "<< read_count <<" readsize = "<<size<<endl;
-    ASSERT(read_count==size ,"Log readcount not equal to readsize!\n");
-    memset(buf + read_count, 0, size - read_count);
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto it = segments_.find(seg_no);
+    if (it != segments_.end()) return it->second;
+    if (seg_no < start_ofs_ / LOG_SEGMENT_SIZE) return nullptr;
+    //a spare segment is written over, its size stays
+    int fd = open(GetSegmentFileName(seg_no).c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) {
+        if (create) LOG(ERROR) << "opening log segment failed: " << strerror(errno);
+        return nullptr;
+    }
+    spare_segments_.erase(std::remove(spare_segments_.begin(), spare_segments_.end(), seg_no), spare_segments_.end());
+    auto seg = std::make_shared<Segment>(fd);
+    segments_.emplace(seg_no, seg);
+    return seg;
 }
 
-void LogIOManager::WriteData(char* buf, ofs_t ofs, size_t size) //buf[0->size-1] -> disk[ofs->ofs+size-1]
+bool LogIOManager::ReadData(char* buf, ofs_t ofs, size_t size) //disk[ofs->ofs+size-1] -> buf[0->size-1]
 {
-    ASSERT(log_io_.is_open(), "log file not open!");
-    // set write cursor to offset
-    log_io_.seekp(ofs);
-    log_io_.write(buf, size);
-    //check for I/O error
-    if (log_io_.bad()) {
-        cout<<"[Exception]: Log readcount not equal to readsize!"<<endl;
-        return;
+    if (ofs < start_ofs_ || ofs + size > file_size_) return false;
+    size_t read_count = 0;
+    while(read_count < size)
+    {
+        ofs_t cur_ofs = ofs + read_count;
+        std::shared_ptr<Segment> seg = GetSegment(cur_ofs / LOG_SEGMENT_SIZE, false);
+        if (seg == nullptr) return false;
+        size_t seg_left = LOG_SEGMENT_SIZE - cur_ofs % LOG_SEGMENT_SIZE;
+        ssize_t ret = pread(seg->fd_, buf + read_count, std::min(size - read_count, seg_left), cur_ofs % LOG_SEGMENT_SIZE);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret < 0) {
+            LOG(ERROR) << "I/O error while reading log: " << strerror(errno);
+            return false;
+        }
+        //the segment ends before size bytes
+        if (ret == 0) return false;
+        read_count += ret;
     }
+    return true;
+}
 
-    // needs to flush to keep disk file in sync
-    log_io_.flush();
+bool LogIOManager::AppendData(const char* buf, size_t size) //buf[0->size-1] -> end of log
+{
+    size_t write_count = 0;
+    while(write_count < size)
+    {
+        ofs_t cur_ofs = file_size_ + write_count;
+        uint64_t seg_no = cur_ofs / LOG_SEGMENT_SIZE;
+        std::shared_ptr<Segment> seg = GetSegment(seg_no, true);
+        if (seg == nullptr) return false;
+        size_t seg_left = LOG_SEGMENT_SIZE - cur_ofs % LOG_SEGMENT_SIZE;
+        ssize_t ret = pwrite(seg->fd_, buf + write_count, std::min(size - write_count, seg_left), cur_ofs % LOG_SEGMENT_SIZE);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+            LOG(ERROR) << "I/O error while writing log: " << strerror(errno);
+            return false;
+        }
+        {
+            std::scoped_lock<std::mutex> lock(latch_);
+            unsynced_segments_.emplace(seg_no, seg);
+        }
+        write_count += ret;
+    }
+    file_size_ += size;
+    return true;
 }
 
+bool LogIOManager::Sync()
+{
+    //the segments are synced without the latch, appends to the next ones go on meanwhile
+    std::map<uint64_t, std::shared_ptr<Segment>> to_sync;
+    {
+        std::scoped_lock<std::mutex> lock(latch_);
+        to_sync.swap(unsynced_segments_);
+    }
+    bool ok = true;
+    for (auto &seg : to_sync) {
+        if (fdatasync(seg.second->fd_) != 0) {
+            LOG(ERROR) << "fdatasync of log failed: " << strerror(errno);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool LogIOManager::Truncate(ofs_t size)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    //the segments after the end become spares, left over bytes after the end are written over by the next appends
+    uint64_t end_seg_no = size / LOG_SEGMENT_SIZE;
+    uint64_t last_seg_no = (file_size_ + LOG_SEGMENT_SIZE - 1) / LOG_SEGMENT_SIZE;
+    for (uint64_t seg_no = end_seg_no + 1; seg_no < last_seg_no; seg_no++) {
+        segments_.erase(seg_no);
+        unsynced_segments_.erase(seg_no);
+        if (access(GetSegmentFileName(seg_no).c_str(), F_OK) == 0) spare_segments_.push_back(seg_no);
+    }
+    file_size_ = size;
+    return true;
+}
+
+void LogIOManager::RecycleBefore(ofs_t ofs)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    uint64_t next_spare_no = (file_size_ + LOG_SEGMENT_SIZE - 1) / LOG_SEGMENT_SIZE;
+    for (auto spare_no : spare_segments_) next_spare_no = std::max(next_spare_no, spare_no + 1);
+    for (uint64_t seg_no = start_ofs_ / LOG_SEGMENT_SIZE; seg_no < ofs / LOG_SEGMENT_SIZE; seg_no++) {
+        //readers still holding the segment keep its file open
+        segments_.erase(seg_no);
+        unsynced_segments_.erase(seg_no);
+        string seg_file_name = GetSegmentFileName(seg_no);
+        if (spare_segments_.size() < LOG_SEGMENT_SPARE_NUM) {
+            if (rename(seg_file_name.c_str(), GetSegmentFileName(next_spare_no).c_str()) == 0) {
+                spare_segments_.push_back(next_spare_no++);
+                continue;
+            }
+        }
+        if (remove(seg_file_name.c_str()) != 0 && errno != ENOENT)
+            LOG(ERROR) << "removing log segment failed: " << strerror(errno);
+    }
+    start_ofs_ = std::max<ofs_t>(start_ofs_, ofs / LOG_SEGMENT_SIZE * LOG_SEGMENT_SIZE);
+}
+
+bool LogIOManager::RemoveFiles()
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    bool ok = true;
+    uint64_t last_seg_no = (file_size_ + LOG_SEGMENT_SIZE - 1) / LOG_SEGMENT_SIZE;
+    for (auto spare_no : spare_segments_) last_seg_no = std::max(last_seg_no, spare_no + 1);
+    for (uint64_t seg_no = start_ofs_ / LOG_SEGMENT_SIZE; seg_no < last_seg_no; seg_no++) {
+        if (remove(GetSegmentFileName(seg_no).c_str()) != 0 && errno != ENOENT) ok = false;
+    }
+    segments_.clear();
+    unsynced_segments_.clear();
+    spare_segments_.clear();
+    start_ofs_ = 0;
+    file_size_ = 0;
+    return ok;
+}
@@ -0,0 +1,76 @@
+#include "transaction/log_iterator.h"
+#include <algorithm>
+#include "transaction/log_manager.h"
+
+LogIterator::LogIterator(LogManager* log_mgr, lsn_t start_lsn, bool forward)
+    : log_mgr_(log_mgr), forward_(forward), cur_lsn_(start_lsn), window_ofs_(0), window_size_(0)
+{
+    min_lsn_ = log_mgr_->GetMinLSN();
+    max_lsn_ = log_mgr_->GetMaxLSN();
+    record_ = new LogRecord;
+    if(Valid())
+        Load();
+}
+
+LogIterator::~LogIterator()
+{
+    delete record_;
+}
+
+LogRecord* LogIterator::Release()
+{
+    LogRecord* rec = record_;
+    record_ = new LogRecord;
+    return rec;
+}
+
+LogIterator& LogIterator::operator++()
+{
+    cur_lsn_ += forward_ ? 1 : -1;
+    if(Valid())
+        Load();
+    return *this;
+}
+
+void LogIterator::Load()
+{
+    ofs_t rec_ofs, rec_end;
+    if(!log_mgr_->GetRecordOffset(cur_lsn_, &rec_ofs) || !log_mgr_->GetRecordOffset(cur_lsn_ + 1, &rec_end))
+    {
+        //discarded meanwhile
+        delete record_;
+        record_ = nullptr;
+        return;
+    }
+    if(rec_ofs < window_ofs_ || rec_end > window_ofs_ + window_size_)
+    {
+        //read ahead in the direction of the iterator, a record larger than the window is read as a whole
+        size_t size = std::max<size_t>(rec_end - rec_ofs, LOG_BUFFER_SIZE);
+        ofs_t start_ofs = rec_ofs;
+        if(forward_)
+        {
+            ofs_t log_end;
+            if(log_mgr_->GetRecordOffset(max_lsn_ + 1, &log_end))
+                size = std::min<size_t>(size, log_end - rec_ofs);
+        }
+        else
+        {
+            ofs_t log_start;
+            if(log_mgr_->GetRecordOffset(min_lsn_, &log_start))
+                size = std::min<size_t>(size, rec_end - log_start);
+            size = std::max<size_t>(size, rec_end - rec_ofs);
+            start_ofs = rec_end - size;
+        }
+        window_.resize(size);
+        window_ofs_ = start_ofs;
+        window_size_ = size;
+        if(!log_mgr_->ReadLog(window_.data(), window_ofs_, window_size_))
+        {
+            window_size_ = 0;
+            delete record_;
+            record_ = nullptr;
+            return;
+        }
+    }
+    record_->DeSerializeFrom(window_.data() + (rec_ofs - window_ofs_) + LogManager::SIZE_SIZE);
+}
@@ -1,126 +1,417 @@
 #include "transaction/log_manager.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "glog/logging.h"
+#include "transaction/log_iterator.h"
 
 LogManager::LogManager(string db_name)
 {
     string log_file_name = "../files/log/"+db_name + ".log";
+    master_file_name_ = "../files/log/"+db_name + ".master";
     bool exists_file = false;
     log_io_mgr_ = new LogIOManager(log_file_name, &exists_file);
-    //initialize the log file
-    if(!exists_file)
+    log_buf_.resize(LOG_BUFFER_SIZE);
+    flush_buf_.resize(LOG_BUFFER_SIZE);
+    buf_size_ = 0;
+    flush_size_ = 0;
+    next_lsn_ = 1;
+    flush_stop_ = false;
+    flush_requested_ = false;
+    flushing_ = false;
+    flush_failures_ = 0;
+    if(exists_file)
     {
-        lsn_t log_num = 0;
-        MACH_WRITE_TO(lsn_t, meta_buf, log_num);
-        log_io_mgr_->WriteData(meta_buf, 0, LOG_NUM_SIZE);
+        //the log starts where the latest checkpoint says, a crash may have left older segments behind
+        lsn_t keep_lsn = INVALID_LSN;
+        ofs_t keep_ofs = 0;
+        if(ReadMasterRecord(&keep_lsn, &keep_ofs) != INVALID_LSN && keep_lsn != INVALID_LSN)
+            next_lsn_ = keep_lsn;
+        else
+            keep_ofs = 0;
+        first_lsn_ = next_lsn_;
+        LoadRecordOffsets(keep_ofs);
+        log_io_mgr_->RecycleBefore(keep_ofs);
     }
+    first_lsn_ = next_lsn_ - record_ofs_.size();
+    persistent_lsn_ = next_lsn_ - 1;
+    buf_ofs_ = log_io_mgr_->GetFileSize();
+    flush_ofs_ = buf_ofs_;
+    flush_thread_ = std::thread(&LogManager::FlushThread, this);
 }
 
-void LogManager::AddRecord(LogRecord* record)
+LogManager::~LogManager()
 {
-    //serialize to buf
-    record->SerializeTo(log_buf);
-    size_t new_record_size = record->GetSerializedSize();
-
-    //get the log_num(max lsn)
-    log_io_mgr_->ReadData(meta_buf, 0, LOG_NUM_SIZE);
-    lsn_t log_num = *reinterpret_cast<lsn_t*> (meta_buf);
-    //get the ofs for new log record
-    ofs_t cur_ofs = DATA_OFFSET;
-    if(log_num >= 1)
     {
-        log_io_mgr_->ReadData(meta_buf, META_OFFSET+(log_num-1)*(OFS_SIZE+SIZE_SIZE), OFS_SIZE);
-        ofs_t last_ofs = *reinterpret_cast<ofs_t*> (meta_buf);
-        log_io_mgr_->ReadData(meta_buf, META_OFFSET+(log_num-1)*(OFS_SIZE+SIZE_SIZE)+OFS_SIZE, SIZE_SIZE);
-        ofs_t last_size = *reinterpret_cast<size_t*> (meta_buf);
-        cur_ofs = last_ofs + last_size;
+        std::scoped_lock<std::recursive_mutex> lock(latch_);
+        flush_stop_ = true;
     }
-    //write ofs,size message
-    MACH_WRITE_TO(ofs_t, meta_buf, cur_ofs);
-    MACH_WRITE_TO(size_t, meta_buf+sizeof(ofs_t), new_record_size);
-    log_io_mgr_->WriteData(meta_buf, META_OFFSET+log_num*(OFS_SIZE+SIZE_SIZE), OFS_SIZE+SIZE_SIZE);
+    //the flusher writes what is left before it stops
+    flush_cv_.notify_all();
+    flush_thread_.join();
+    delete log_io_mgr_;
+}
 
-    //write log
-    log_io_mgr_->WriteData(log_buf, cur_ofs, new_record_size);
+void LogManager::LoadRecordOffsets(ofs_t start_ofs)
+{
+    //scan the records sequentially, the log ends at the first record that is not complete.
+    //recycled segments hold older records after the end, they do not continue the lsns
+    ofs_t file_size = log_io_mgr_->GetFileSize();
+    ofs_t cur_ofs = start_ofs;
+    LogRecord rec;
+    char size_buf[SIZE_SIZE];
+    while(cur_ofs + SIZE_SIZE <= file_size)
+    {
+        if(!log_io_mgr_->ReadData(size_buf, cur_ofs, SIZE_SIZE))
+            break;
+        uint32_t rec_size = MACH_READ_FROM(uint32_t, size_buf);
+        if(rec_size < sizeof(uint32_t) || cur_ofs + SIZE_SIZE + rec_size > file_size)
+            break;
+        //zeroed slack, so that a corrupted record can not make deserialization read past the buffer
+        read_buf_.assign(rec_size + 2 * PAGE_SIZE, 0);
+        if(!log_io_mgr_->ReadData(read_buf_.data(), cur_ofs + SIZE_SIZE, rec_size) || !LogRecord::IsRecordAt(read_buf_.data()))
+            break;
+        if(rec.DeSerializeFrom(read_buf_.data()) != rec_size || rec.GetLSN() != next_lsn_)
+            break;
+        record_ofs_.push_back(cur_ofs);
+        next_lsn_++;
+        cur_ofs += SIZE_SIZE + rec_size;
+    }
+    if(cur_ofs < file_size)
+        log_io_mgr_->Truncate(cur_ofs);
+}
 
-    //increase lsn
-    log_num++;
-    MACH_WRITE_TO(lsn_t, meta_buf, log_num);
-    log_io_mgr_->WriteData(meta_buf, 0, LOG_NUM_SIZE);
+lsn_t LogManager::AddRecord(LogRecord* record)
+{
+    std::unique_lock<std::recursive_mutex> lock(latch_);
+    uint32_t rec_size = record->GetSerializedSize();
+    size_t total_size = SIZE_SIZE + rec_size;
+    //a full buffer is handed to the flusher, the record waits for the swap
+    while(buf_size_ > 0 && buf_size_ + total_size > log_buf_.size())
+    {
+        flush_requested_ = true;
+        flush_cv_.notify_one();
+        flushed_cv_.wait(lock);
+    }
+    if(total_size > log_buf_.size())
+        log_buf_.resize(total_size);
+    lsn_t lsn = next_lsn_++;
+    record->SetLSN(lsn);
+    //redo starts from the checkpoint, so pages need a full image again after it
+    if(record->GetRecordType() == CHECK_POINT)
+        imaged_pages_.clear();
+    if(record->GetRecordType() == BEGIN)
+        active_txns_.emplace(record->GetTid(), lsn);
+    else if(record->GetRecordType() == TXN_END || record->GetRecordType() == ABORT)
+        active_txns_.erase(record->GetTid());
+    record_ofs_.push_back(buf_ofs_ + buf_size_);
+    //serialize to buf
+    MACH_WRITE_TO(uint32_t, log_buf_.data() + buf_size_, rec_size);
+    record->SerializeTo(log_buf_.data() + buf_size_ + SIZE_SIZE);
+    buf_size_ += total_size;
 
     //output
-    string type = "unknwon";
-    LogRecordType t = record->GetRecordType();
     //cout<<"Add log record: < lsn = "<<record->GetLSN()<<",  tid = "<<record->GetTid()<<",  pid = "<<record->GetPid()
-    //<<",  type = "<<LogRecord::GetTypeStr(t)<<" >"<<endl;
-    return;
+    //<<",  type = "<<LogRecord::GetTypeStr(record->GetRecordType())<<" >"<<endl;
+    return lsn;
+}
+
+void LogManager::FlushThread()
+{
+    std::unique_lock<std::recursive_mutex> lock(latch_);
+    while(true)
+    {
+        flush_cv_.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS),
+                           [this]{ return flush_stop_ || flush_requested_; });
+        if(buf_size_ == 0)
+        {
+            flush_requested_ = false;
+            if(flush_stop_)
+                break;
+            continue;
+        }
+        //take the buffered records, producers go on with the other buffer meanwhile
+        std::swap(log_buf_, flush_buf_);
+        if(log_buf_.size() < LOG_BUFFER_SIZE)
+            log_buf_.resize(LOG_BUFFER_SIZE);
+        flush_size_ = buf_size_;
+        flush_ofs_ = buf_ofs_;
+        buf_ofs_ += buf_size_;
+        buf_size_ = 0;
+        lsn_t target_lsn = next_lsn_ - 1;
+        flush_requested_ = false;
+        flushing_ = true;
+        flushed_cv_.notify_all();
+        lock.unlock();
+        bool ok = log_io_mgr_->AppendData(flush_buf_.data(), flush_size_) && log_io_mgr_->Sync();
+        lock.lock();
+        flushing_ = false;
+        if(!ok)
+        {
+            //the records are not durable: the file ends before them again and they go back in front of the log buffer,
+            //the next write takes them along. the waiters are told, nothing may count on them meanwhile
+            LOG(ERROR) << "Failed to write log records " << persistent_lsn_ + 1 << " to " << target_lsn;
+            log_io_mgr_->Truncate(flush_ofs_);
+            flush_buf_.resize(std::max<size_t>(flush_size_ + buf_size_, LOG_BUFFER_SIZE));
+            memcpy(flush_buf_.data() + flush_size_, log_buf_.data(), buf_size_);
+            std::swap(log_buf_, flush_buf_);
+            buf_ofs_ = flush_ofs_;
+            buf_size_ += flush_size_;
+            flush_size_ = 0;
+            flush_failures_++;
+            flushed_cv_.notify_all();
+            //retried after the interval, or dropped if the log manager is closing
+            if(flush_stop_)
+            {
+                LOG(ERROR) << "Log records " << persistent_lsn_ + 1 << " to " << next_lsn_ - 1 << " are lost";
+                break;
+            }
+            continue;
+        }
+        flush_size_ = 0;
+        flush_ofs_ = buf_ofs_;
+        persistent_lsn_ = target_lsn;
+        flushed_cv_.notify_all();
+    }
+}
+
+void LogManager::AddWrite(Transaction* txn, WriteRecord write)
+{
+    LogRecord rec(INVALID_LSN, txn->GetTid(), TXN_WRITE);
+    rec.SetWrite(write);
+    write.lsn_ = AddRecord(&rec);
+    txn->AddWrite(std::move(write));
+}
+
+void LogManager::AddCompensation(Transaction* txn, lsn_t undone_lsn)
+{
+    LogRecord rec(INVALID_LSN, txn->GetTid(), COMPENSATE);
+    rec.SetUndoneLSN(undone_lsn);
+    AddRecord(&rec);
+}
+
+dberr_t LogManager::Flush()
+{
+    return WaitForFlushed(GetMaxLSN());
+}
+
+dberr_t LogManager::WaitForFlushed(lsn_t lsn)
+{
+    std::unique_lock<std::recursive_mutex> lock(latch_);
+    //a page never written with log on may carry any value as its lsn
+    lsn = std::min(lsn, next_lsn_ - 1);
+    uint64_t failures = flush_failures_;
+    while(persistent_lsn_ < lsn)
+    {
+        if(flush_failures_ != failures)
+            return DB_FAILED;
+        //the write in progress may not cover lsn, the request makes the flusher go on right after it
+        flush_requested_ = true;
+        flush_cv_.notify_one();
+        flushed_cv_.wait(lock);
+    }
+    return DB_SUCCESS;
+}
+
+bool LogManager::NeedFullImage(page_id_t pid)
+{
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    return imaged_pages_.insert(pid).second;
+}
+
+lsn_t LogManager::GetPersistentLSN()
+{
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    return persistent_lsn_;
+}
+
+bool LogManager::GetRecord(LogRecord* log_rec, lsn_t lsn)
+{
+    ofs_t log_ofs, log_end;
+    if(!GetRecordOffset(lsn, &log_ofs) || !GetRecordOffset(lsn + 1, &log_end))
+        return false;
+    std::vector<char> rec_buf(log_end - log_ofs);
+    if(!ReadLog(rec_buf.data(), log_ofs, rec_buf.size()))
+        return false;
+    log_rec->DeSerializeFrom(rec_buf.data() + SIZE_SIZE);
+    return true;
 }
 
-void LogManager::GetRecord(LogRecord* log_rec, lsn_t lsn)
+bool LogManager::GetRecordOffset(lsn_t lsn, ofs_t* ofs)
 {
-    //get log offset and size
-    log_io_mgr_->ReadData(meta_buf, META_OFFSET+(lsn-1)*(OFS_SIZE+SIZE_SIZE), OFS_SIZE);
-    ofs_t log_ofs = MACH_READ_FROM(ofs_t, meta_buf);
-    log_io_mgr_->ReadData(meta_buf, META_OFFSET+(lsn-1)*(OFS_SIZE+SIZE_SIZE)+OFS_SIZE, SIZE_SIZE);
-    size_t log_size = MACH_READ_FROM(size_t, meta_buf);
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    if(lsn < first_lsn_ || lsn > next_lsn_)
+        return false;
+    *ofs = (lsn == next_lsn_) ? buf_ofs_ + buf_size_ : record_ofs_[lsn-first_lsn_];
+    return true;
+}
 
-    //read the log record
-    log_io_mgr_->ReadData(log_buf, log_ofs, log_size);
-    log_rec->DeSerializeFrom(log_buf);
+bool LogManager::ReadLog(char* buf, ofs_t ofs, size_t size)
+{
+    ofs_t file_end;
+    {
+        std::scoped_lock<std::recursive_mutex> lock(latch_);
+        if(ofs + size > buf_ofs_ + buf_size_)
+            return false;
+        //the parts in the log buffer and in the flush buffer are copied under the latch,
+        //the part in the file does not change any more
+        if(ofs + size > buf_ofs_)
+        {
+            ofs_t from = std::max(ofs, buf_ofs_);
+            memcpy(buf + (from - ofs), log_buf_.data() + (from - buf_ofs_), ofs + size - from);
+        }
+        file_end = std::min(ofs + size, buf_ofs_);
+        if(flushing_ && file_end > flush_ofs_)
+        {
+            ofs_t from = std::max(ofs, flush_ofs_);
+            memcpy(buf + (from - ofs), flush_buf_.data() + (from - flush_ofs_), file_end - from);
+            file_end = from;
+        }
+    }
+    if(ofs >= file_end)
+        return true;
+    return log_io_mgr_->ReadData(buf, ofs, file_end - ofs);
 }
 
 void LogManager::ShowRecord(lsn_t lsn)
 {
     LogRecord* log_rec = new LogRecord;
-    //get log offset and size
-    log_io_mgr_->ReadData(meta_buf, META_OFFSET+(lsn-1)*(OFS_SIZE+SIZE_SIZE), OFS_SIZE);
-    ofs_t log_ofs = MACH_READ_FROM(ofs_t, meta_buf);
-    log_io_mgr_->ReadData(meta_buf, META_OFFSET+(lsn-1)*(OFS_SIZE+SIZE_SIZE)+OFS_SIZE, SIZE_SIZE);
-    size_t log_size = MACH_READ_FROM(size_t, meta_buf);
-
-    //read the log record
-    log_io_mgr_->ReadData(log_buf, log_ofs, log_size);
-    log_rec->DeSerializeFrom(log_buf);
+    GetRecord(log_rec, lsn);
 
     //output
-    string type = "unknwon";
-    LogRecordType t = log_rec->GetRecordType();
     //cout<<"Add log record: < lsn = "<<log_rec->GetLSN()<<",  tid = "<<log_rec->GetTid()<<",  pid = "<<log_rec->GetPid()
-    //<<",  type = "<<LogRecord::GetTypeStr(t)<<" >"<<endl;
+    //<<",  type = "<<LogRecord::GetTypeStr(log_rec->GetRecordType())<<" >"<<endl;
     delete log_rec;
 }
 
 lsn_t LogManager::GetMaxLSN()
 {
-    log_io_mgr_->ReadData(meta_buf, 0, LOG_NUM_SIZE);
-    lsn_t log_num = MACH_READ_FROM(lsn_t, meta_buf);
-    return log_num;
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    return next_lsn_ - 1;
+}
+
+lsn_t LogManager::GetMinLSN()
+{
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    return first_lsn_;
+}
+
+lsn_t LogManager::GetOldestActiveLSN()
+{
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    lsn_t oldest_lsn = INVALID_LSN;
+    for(auto &txn : active_txns_)
+        if(oldest_lsn == INVALID_LSN || txn.second < oldest_lsn)
+            oldest_lsn = txn.second;
+    return oldest_lsn;
 }
 
 void LogManager::ShowAllRecords()
 {
     cout<<"All records in log:"<<endl;
-    lsn_t cur_lsn = 1;
-    LogRecord* rec = new LogRecord;
-    while(cur_lsn<=GetMaxLSN())
+    for(LogIterator it(this, GetMinLSN()); it.Valid(); ++it)
     {
-        ShowRecord(cur_lsn);
-        cur_lsn++;
+        cout<<"< lsn = "<<it->GetLSN()<<",  tid = "<<it->GetTid()<<",  pid = "<<it->GetPid()
+        <<",  type = "<<LogRecord::GetTypeStr(it->GetRecordType())<<" >"<<endl;
     }
     cout<<endl;
-    delete rec;
+}
+
+void LogManager::SetNextTid(txn_id_t tid)
+{
+    //every session recovers on its own, a later one must not hand out the ids given since
+    txn_id_t cur = next_tid_;
+    while(cur < tid && !next_tid_.compare_exchange_weak(cur, tid))
+        ;
 }
 
 void LogManager::ReplacePid(pid_t old_pid, pid_t new_pid)
 {
-    lsn_t cur_lsn = 1;
-    LogRecord* rec = new LogRecord;
-    while(cur_lsn<=GetMaxLSN())
+    for(LogIterator it(this, GetMinLSN()); it.Valid(); ++it)
     {
-        GetRecord(rec, cur_lsn);
-        page_id_t pid = rec->GetPid();
+        page_id_t pid = it->GetPid();
         //ASSERT(pid!=new_pid, "replacing pid exists in log!");
         if(pid==old_pid)
-            rec->SetPid(new_pid);
-        cur_lsn++;
+            it->SetPid(new_pid);
     }
-    delete rec;
-}
\ No newline at end of file
+}
+
+uint64_t LogManager::GetLogSize()
+{
+    std::scoped_lock<std::recursive_mutex> lock(latch_);
+    return buf_ofs_ + buf_size_;
+}
+
+void LogManager::WriteMasterRecord(lsn_t checkpoint_lsn, lsn_t keep_lsn)
+{
+    ofs_t keep_ofs;
+    {
+        std::scoped_lock<std::recursive_mutex> lock(latch_);
+        keep_lsn = std::max(keep_lsn, first_lsn_);
+        keep_ofs = record_ofs_[keep_lsn - first_lsn_];
+    }
+    char buf[2 * sizeof(lsn_t) + sizeof(ofs_t)];
+    MACH_WRITE_TO(lsn_t, buf, checkpoint_lsn);
+    MACH_WRITE_TO(lsn_t, buf + sizeof(lsn_t), keep_lsn);
+    MACH_WRITE_TO(ofs_t, buf + 2 * sizeof(lsn_t), keep_ofs);
+    //write a new file and rename it over the old one, a crash leaves either of them
+    string tmp_file_name = master_file_name_ + ".tmp";
+    int fd = open(tmp_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        cout<<"[Exception]: Failed to write master record!"<<endl;
+        return;
+    }
+    bool ok = write(fd, buf, sizeof(buf)) == sizeof(buf) && fdatasync(fd) == 0;
+    close(fd);
+    if(!ok || rename(tmp_file_name.c_str(), master_file_name_.c_str()) != 0)
+        cout<<"[Exception]: Failed to write master record!"<<endl;
+}
+
+lsn_t LogManager::ReadMasterRecord(lsn_t* keep_lsn, ofs_t* keep_ofs)
+{
+    int fd = open(master_file_name_.c_str(), O_RDONLY);
+    if(fd < 0)
+        return INVALID_LSN;
+    char buf[2 * sizeof(lsn_t) + sizeof(ofs_t)];
+    bool ok = read(fd, buf, sizeof(buf)) == sizeof(buf);
+    close(fd);
+    if(!ok)
+        return INVALID_LSN;
+    if(keep_lsn != nullptr)
+        *keep_lsn = MACH_READ_FROM(lsn_t, buf + sizeof(lsn_t));
+    if(keep_ofs != nullptr)
+        *keep_ofs = MACH_READ_FROM(ofs_t, buf + 2 * sizeof(lsn_t));
+    return MACH_READ_FROM(lsn_t, buf);
+}
+
+void LogManager::DiscardBefore(lsn_t lsn)
+{
+    ofs_t discard_ofs;
+    {
+        std::scoped_lock<std::recursive_mutex> lock(latch_);
+        //only what reached the file, the rest is still read from the buffers
+        lsn = std::min(lsn, persistent_lsn_);
+        if(lsn <= first_lsn_)
+            return;
+        discard_ofs = record_ofs_[lsn - first_lsn_];
+        record_ofs_.erase(record_ofs_.begin(), record_ofs_.begin() + (lsn - first_lsn_));
+        first_lsn_ = lsn;
+    }
+    log_io_mgr_->RecycleBefore(discard_ofs);
+}
+
+bool LogManager::RemoveFiles()
+{
+    std::unique_lock<std::recursive_mutex> lock(latch_);
+    while(flushing_)
+        flushed_cv_.wait(lock);
+    buf_size_ = 0;
+    bool ok = log_io_mgr_->RemoveFiles();
+    buf_ofs_ = 0;
+    flush_ofs_ = 0;
+    persistent_lsn_ = next_lsn_ - 1;
+    return (remove(master_file_name_.c_str()) == 0 || errno == ENOENT) && ok;
+}
@@ -76,7 +76,89 @@ uint32_t LogRecord::SerializeTo(char* buf) const
         }
     }
 
-    //dpt not concerned yet
+    //information about dirty page table
+    bool dpt_exists = false;
+    if(dpt_!=nullptr)
+        dpt_exists = true;
+    MACH_WRITE_TO(bool, buf, dpt_exists);
+    ofs += sizeof(bool);
+    buf = buf_head + ofs;
+
+    if(dpt_exists)
+    {
+        MACH_WRITE_TO(lsn_t, buf, dpt_->GetRedoLSN());
+        ofs += sizeof(lsn_t);
+        buf = buf_head + ofs;
+
+        uint32_t page_num = dpt_->GetRecords().size();
+        MACH_WRITE_TO(uint32_t, buf, page_num);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+
+        for(auto &rec : dpt_->GetRecords())
+        {
+            MACH_WRITE_TO(page_id_t, buf, rec.GetPid());
+            ofs += sizeof(page_id_t);
+            buf = buf_head + ofs;
+            MACH_WRITE_TO(lsn_t, buf, rec.GetPageLSN());
+            ofs += sizeof(lsn_t);
+            buf = buf_head + ofs;
+            MACH_WRITE_TO(lsn_t, buf, rec.GetRecLSN());
+            ofs += sizeof(lsn_t);
+            buf = buf_head + ofs;
+        }
+    }
+
+    //changed ranges, only a WRITE_DELTA record has them
+    if(type_ == WRITE_DELTA)
+    {
+        MACH_WRITE_TO(uint32_t, buf, static_cast<uint32_t>(deltas_.size()));
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        for(auto &delta : deltas_)
+        {
+            MACH_WRITE_TO(PageDelta, buf, delta);
+            ofs += sizeof(PageDelta);
+            buf = buf_head + ofs;
+        }
+        memcpy(buf, delta_data_.data(), delta_data_.size());
+        ofs += delta_data_.size();
+        buf = buf_head + ofs;
+    }
+
+    //the write of a transaction, the tuple image of an update last
+    if(type_ == TXN_WRITE)
+    {
+        MACH_WRITE_TO(WriteRecord::Type, buf, write_.type_);
+        ofs += sizeof(WriteRecord::Type);
+        buf = buf_head + ofs;
+        MACH_WRITE_TO(page_id_t, buf, write_.table_);
+        ofs += sizeof(page_id_t);
+        buf = buf_head + ofs;
+        MACH_WRITE_TO(int64_t, buf, write_.rid_.Get());
+        ofs += sizeof(int64_t);
+        buf = buf_head + ofs;
+        MACH_WRITE_TO(uint32_t, buf, write_.object_id_);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        MACH_WRITE_TO(page_id_t, buf, write_.meta_page_);
+        ofs += sizeof(page_id_t);
+        buf = buf_head + ofs;
+        MACH_WRITE_TO(uint32_t, buf, static_cast<uint32_t>(write_.image_.size()));
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        memcpy(buf, write_.image_.data(), write_.image_.size());
+        ofs += write_.image_.size();
+        buf = buf_head + ofs;
+    }
+
+    if(type_ == COMPENSATE)
+    {
+        MACH_WRITE_TO(lsn_t, buf, undone_lsn_);
+        ofs += sizeof(lsn_t);
+        buf = buf_head + ofs;
+    }
+
     return ofs;
 }
 
@@ -98,6 +180,16 @@ uint32_t LogRecord::GetSerializedSize() const
     
     if(att_!=nullptr)
         ofs += sizeof(uint32_t) + att_->GetTable().size()*sizeof(txn_id_t);
+    ofs += sizeof(bool);
+    if(dpt_!=nullptr)
+        ofs += sizeof(lsn_t) + sizeof(uint32_t) + dpt_->GetRecords().size()*(sizeof(page_id_t) + 2*sizeof(lsn_t));
+    if(type_ == WRITE_DELTA)
+        ofs += sizeof(uint32_t) + deltas_.size()*sizeof(PageDelta) + delta_data_.size();
+    if(type_ == TXN_WRITE)
+        ofs += sizeof(WriteRecord::Type) + 2*sizeof(page_id_t) + sizeof(int64_t) + 2*sizeof(uint32_t)
+            + write_.image_.size();
+    if(type_ == COMPENSATE)
+        ofs += sizeof(lsn_t);
     return ofs;
 }
 
@@ -107,7 +199,7 @@ uint32_t LogRecord::DeSerializeFrom(char* buf)
     uint32_t ofs = 0;
     char* buf_head = buf;
 
-    uint32_t mag_num = MACH_READ_FROM(uint32_t, buf);
+    [[maybe_unused]] uint32_t mag_num = MACH_READ_FROM(uint32_t, buf);
     ASSERT(mag_num == LOG_MAGIC_NUM, "Deserialize at incorrect position!");
     ofs += sizeof(uint32_t);
     buf = buf_head + ofs;
@@ -132,15 +224,20 @@ uint32_t LogRecord::DeSerializeFrom(char* buf)
     ofs += sizeof(bool);
     buf = buf_head + ofs;
 
+    //a record decoded into again keeps its page buffers
     if(old_data_exist)
     {
-        old_data_ = new char[PAGE_SIZE];
+        if(old_data_ == nullptr)
+            old_data_ = new char[PAGE_SIZE];
         memcpy(old_data_, buf, PAGE_SIZE);
         ofs += PAGE_SIZE;
         buf = buf_head + ofs;
     }
     else
+    {
+        delete[] old_data_;
         old_data_ = nullptr;
+    }
 
     bool new_data_exist = MACH_READ_FROM(bool, buf);
     ofs += sizeof(bool);
@@ -148,13 +245,17 @@ uint32_t LogRecord::DeSerializeFrom(char* buf)
 
     if(new_data_exist)
     {
-        new_data_ = new char[PAGE_SIZE];
+        if(new_data_ == nullptr)
+            new_data_ = new char[PAGE_SIZE];
         memcpy(new_data_, buf, PAGE_SIZE);
         ofs += PAGE_SIZE;
         buf = buf_head + ofs;
     }
     else
+    {
+        delete[] new_data_;
         new_data_ = nullptr;
+    }
 
     bool att_exists = MACH_READ_FROM(bool, buf);
     ofs += sizeof(bool);
@@ -166,9 +267,10 @@ uint32_t LogRecord::DeSerializeFrom(char* buf)
         ofs += sizeof(uint32_t);
         buf = buf_head + ofs;
         
+        delete att_;
         att_ = new ActiveTransactionTable;
 
-        for(int i = 0;i<txn_num;i++)
+        for(uint32_t i = 0;i<txn_num;i++)
         {
             txn_id_t tid = INVALID_TXN_ID;
             tid = MACH_READ_FROM(txn_id_t, buf);
@@ -183,6 +285,172 @@ uint32_t LogRecord::DeSerializeFrom(char* buf)
         att_ = nullptr;
     }
 
+    bool dpt_exists = MACH_READ_FROM(bool, buf);
+    ofs += sizeof(bool);
+    buf = buf_head + ofs;
+
+    delete dpt_;
+    dpt_ = nullptr;
+    if(dpt_exists)
+    {
+        dpt_ = new DirtyPageTable;
+        //stored as the redo lsn, it stands for the begin lsn as well
+        dpt_->SetBeginLSN(MACH_READ_FROM(lsn_t, buf));
+        ofs += sizeof(lsn_t);
+        buf = buf_head + ofs;
+
+        uint32_t page_num = MACH_READ_FROM(uint32_t, buf);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+
+        for(uint32_t i = 0;i<page_num;i++)
+        {
+            page_id_t pid = MACH_READ_FROM(page_id_t, buf);
+            ofs += sizeof(page_id_t);
+            buf = buf_head + ofs;
+            lsn_t page_lsn = MACH_READ_FROM(lsn_t, buf);
+            ofs += sizeof(lsn_t);
+            buf = buf_head + ofs;
+            lsn_t rec_lsn = MACH_READ_FROM(lsn_t, buf);
+            ofs += sizeof(lsn_t);
+            buf = buf_head + ofs;
+            dpt_->AddRecord(pid, page_lsn, rec_lsn);
+        }
+    }
+
+    deltas_.clear();
+    delta_data_.clear();
+    if(type_ == WRITE_DELTA)
+    {
+        uint32_t delta_num = MACH_READ_FROM(uint32_t, buf);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        size_t data_size = 0;
+        for(uint32_t i = 0;i<delta_num;i++)
+        {
+            PageDelta delta = MACH_READ_FROM(PageDelta, buf);
+            deltas_.push_back(delta);
+            data_size += 2 * delta.size_;
+            ofs += sizeof(PageDelta);
+            buf = buf_head + ofs;
+        }
+        delta_data_.assign(buf, buf + data_size);
+        ofs += data_size;
+        buf = buf_head + ofs;
+    }
+
+    write_ = WriteRecord();
+    if(type_ == TXN_WRITE)
+    {
+        write_.type_ = MACH_READ_FROM(WriteRecord::Type, buf);
+        ofs += sizeof(WriteRecord::Type);
+        buf = buf_head + ofs;
+        write_.table_ = MACH_READ_FROM(page_id_t, buf);
+        ofs += sizeof(page_id_t);
+        buf = buf_head + ofs;
+        write_.rid_ = RowId(MACH_READ_FROM(int64_t, buf));
+        ofs += sizeof(int64_t);
+        buf = buf_head + ofs;
+        write_.object_id_ = MACH_READ_FROM(uint32_t, buf);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        write_.meta_page_ = MACH_READ_FROM(page_id_t, buf);
+        ofs += sizeof(page_id_t);
+        buf = buf_head + ofs;
+        uint32_t image_size = MACH_READ_FROM(uint32_t, buf);
+        ofs += sizeof(uint32_t);
+        buf = buf_head + ofs;
+        write_.image_.assign(buf, buf + image_size);
+        write_.lsn_ = lsn_;
+        ofs += image_size;
+        buf = buf_head + ofs;
+    }
+
+    undone_lsn_ = INVALID_LSN;
+    if(type_ == COMPENSATE)
+    {
+        undone_lsn_ = MACH_READ_FROM(lsn_t, buf);
+        ofs += sizeof(lsn_t);
+        buf = buf_head + ofs;
+    }
+
     //dpt not concerned yet
     return ofs;
-}
\ No newline at end of file
+}
+
+bool LogRecord::SetDelta(const char* old_data, const char* new_data)
+{
+    //ranges closer than this are merged, a range header costs more than the bytes in between
+    static constexpr uint32_t MERGE_GAP = 2 * sizeof(PageDelta);
+    static constexpr uint32_t WORD = sizeof(uint64_t);
+    deltas_.clear();
+    delta_data_.clear();
+    uint32_t i = 0;
+    while(i < PAGE_SIZE)
+    {
+        //skip equal words, the common case
+        if(i % WORD == 0 && i + WORD <= PAGE_SIZE && memcmp(old_data + i, new_data + i, WORD) == 0)
+        {
+            i += WORD;
+            continue;
+        }
+        if(old_data[i] == new_data[i])
+        {
+            i++;
+            continue;
+        }
+        uint32_t end = i + 1;
+        uint32_t last_diff = i;
+        while(end < PAGE_SIZE && end - last_diff <= MERGE_GAP)
+        {
+            if(old_data[end] != new_data[end])
+                last_diff = end;
+            end++;
+        }
+        deltas_.push_back(PageDelta{i, last_diff + 1 - i});
+        i = last_diff + 1;
+    }
+    for(auto &delta : deltas_)
+        delta_data_.insert(delta_data_.end(), old_data + delta.offset_, old_data + delta.offset_ + delta.size_);
+    for(auto &delta : deltas_)
+        delta_data_.insert(delta_data_.end(), new_data + delta.offset_, new_data + delta.offset_ + delta.size_);
+    return !deltas_.empty();
+}
+
+void LogRecord::ApplyDelta(char* page_data, bool redo) const
+{
+    //old bytes of all ranges come first, then the new bytes
+    size_t data_ofs = 0;
+    if(redo)
+        data_ofs = delta_data_.size() / 2;
+    for(auto &delta : deltas_)
+    {
+        memcpy(page_data + delta.offset_, delta_data_.data() + data_ofs, delta.size_);
+        data_ofs += delta.size_;
+    }
+}
+void LogRecord::UndoWrite(char* page_data) const
+{
+    if(type_ == WRITE)
+    {
+        for(uint32_t i = 0;i<PAGE_SIZE;i++)
+        {
+            if(old_data_[i] != new_data_[i])
+                page_data[i] = old_data_[i];
+        }
+        return;
+    }
+    //the ranges take along unchanged bytes in between, they may have been changed later
+    size_t old_ofs = 0;
+    size_t new_ofs = delta_data_.size() / 2;
+    for(auto &delta : deltas_)
+    {
+        for(uint32_t i = 0;i<delta.size_;i++)
+        {
+            if(delta_data_[old_ofs + i] != delta_data_[new_ofs + i])
+                page_data[delta.offset_ + i] = delta_data_[old_ofs + i];
+        }
+        old_ofs += delta.size_;
+        new_ofs += delta.size_;
+    }
+}
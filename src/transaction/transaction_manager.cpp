@@ -1,168 +1,274 @@
 #include "transaction/transaction_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "transaction/log_iterator.h"
+
+namespace {
+
+//replays records on a pool of threads, the pages are partitioned among them by page id,
+//so the records of a page are replayed in log order and different pages in parallel
+class ParallelRedo
+{
+public:
+    explicit ParallelRedo(TransactionManager* txn_mgr, uint32_t thread_num): txn_mgr_(txn_mgr), workers_(thread_num)
+    {
+        for(auto& worker : workers_)
+            worker.thread_ = std::thread(&ParallelRedo::Work, this, &worker);
+    }
+
+    ~ParallelRedo()
+    {
+        for(auto& worker : workers_)
+        {
+            {
+                std::scoped_lock<std::mutex> lock(worker.latch_);
+                worker.stop_ = true;
+            }
+            worker.cv_.notify_all();
+        }
+        for(auto& worker : workers_)
+            worker.thread_.join();
+    }
+
+    //queue a record changing a single page, the worker of the page deletes it after the replay
+    void Dispatch(LogRecord* rec)
+    {
+        Worker& worker = workers_[static_cast<uint32_t>(rec->GetPid()) % workers_.size()];
+        std::unique_lock<std::mutex> lock(worker.latch_);
+        worker.cv_.wait(lock, [&]{ return worker.queue_.size() < REDO_QUEUE_SIZE; });
+        worker.queue_.push_back(rec);
+        worker.pending_++;
+        worker.cv_.notify_all();
+    }
+
+    //wait until every queued record is replayed
+    void Drain()
+    {
+        for(auto& worker : workers_)
+        {
+            std::unique_lock<std::mutex> lock(worker.latch_);
+            worker.cv_.wait(lock, [&]{ return worker.pending_ == 0; });
+        }
+    }
+
+private:
+    struct Worker
+    {
+        std::mutex latch_;
+        std::condition_variable cv_;
+        std::deque<LogRecord*> queue_;
+        size_t pending_{0};//queued or being replayed
+        bool stop_{false};
+        std::thread thread_;
+    };
+
+    void Work(Worker* worker)
+    {
+        std::unique_lock<std::mutex> lock(worker->latch_);
+        while(true)
+        {
+            worker->cv_.wait(lock, [&]{ return worker->stop_ || !worker->queue_.empty(); });
+            if(worker->queue_.empty())
+                return;
+            LogRecord* rec = worker->queue_.front();
+            worker->queue_.pop_front();
+            worker->cv_.notify_all();
+            lock.unlock();
+            txn_mgr_->Redo(rec);
+            delete rec;
+            lock.lock();
+            worker->pending_--;
+            worker->cv_.notify_all();
+        }
+    }
+
+    TransactionManager* txn_mgr_;
+    std::vector<Worker> workers_;
+};
+
+}  // namespace
 
 void TransactionManager::Recover()
 {
-    log_mgr_->ShowAllRecords();
     cout<<"---------Doing recover using log----------"<<endl;
-    //find lsn of the last checkpoint
+    //find lsn of the last checkpoint, the master record points to it. without one, search the log backwards
     lsn_t last_cp_lsn = INVALID_LSN;
     lsn_t max_lsn = log_mgr_->GetMaxLSN();
     txn_id_t max_tid = INVALID_TXN_ID;
-    LogRecord* rec = new LogRecord;
-    lsn_t cur_lsn = max_lsn;
-    while(cur_lsn!=0)
+    LogRecord* cp_rec = new LogRecord;
+    lsn_t min_lsn = log_mgr_->GetMinLSN();
+    lsn_t master_lsn = log_mgr_->ReadMasterRecord();
+    if(master_lsn >= min_lsn && master_lsn <= max_lsn)
+    {
+        if(log_mgr_->GetRecord(cp_rec, master_lsn) && cp_rec->GetRecordType()==CHECK_POINT)
+            last_cp_lsn = master_lsn;
+    }
+    if(last_cp_lsn==INVALID_LSN)
     {
-        log_mgr_->GetRecord(rec, cur_lsn);
-        if(rec->GetRecordType()==CHECK_POINT)
+        for(LogIterator it(log_mgr_, max_lsn, false); it.Valid(); ++it)
         {
-            last_cp_lsn = cur_lsn;
-            break;
+            if(it->GetRecordType()==CHECK_POINT)
+            {
+                last_cp_lsn = it.GetLSN();
+                delete cp_rec;
+                cp_rec = it.Release();
+                break;
+            }
         }
-        cur_lsn--;
     }
-    ASSERT(rec->GetRecordType()==CHECK_POINT, "not get the checkpoint record!");
-    ASSERT(rec->GetATT()!=nullptr, "check point without active transaction table!");
+    if(last_cp_lsn==INVALID_LSN)
+    {
+        //nothing to recover from, e.g. the log was lost or cut off before its first checkpoint
+        cout<<"[Warning]: No checkpoint in log, recover skipped."<<endl;
+        for(LogIterator it(log_mgr_, min_lsn); it.Valid(); ++it)
+            max_tid = std::max(max_tid, it->GetTid());
+        log_mgr_->SetNextTid(max_tid + 1);
+        delete cp_rec;
+        return;
+    }
+    ASSERT(cp_rec->GetRecordType()==CHECK_POINT, "not get the checkpoint record!");
+    ASSERT(cp_rec->GetATT()!=nullptr, "check point without active transaction table!");
 
-    att_ = new ActiveTransactionTable(*rec->GetATT());
+    delete att_;
+    att_ = new ActiveTransactionTable(*cp_rec->GetATT());
+    //pages dirty at the checkpoint may miss changes from before it, redo starts at the oldest of them
+    lsn_t redo_lsn = last_cp_lsn;
+    if(cp_rec->GetDPT()!=nullptr)
+        redo_lsn = std::max(1, std::min(redo_lsn, cp_rec->GetDPT()->GetRedoLSN()));
+    delete cp_rec;
 
     cout<<"----Analysis Pass----"<<endl;
-    //generate undo list and redo list
+    //generate undo list: the transactions active at the checkpoint or begun after it, without a commit or abort in
+    //the log. the committed ones without an end go to the apply list, their writes were not all applied.
+    //the writes of a transaction active at the checkpoint are collected from its first record on.
+    //a structure modification without an end was cut off by the crash
     unordered_set<txn_id_t> undo_list(att_->GetTable());
-    unordered_set<txn_id_t> redo_list;
-    cur_lsn = last_cp_lsn;
-    while(cur_lsn<=max_lsn)
-    {  
-        log_mgr_->GetRecord(rec, cur_lsn);
-        if(rec->GetRecordType()!=COMMIT&&rec->GetRecordType()!=CHECK_POINT
-            &&undo_list.find(rec->GetTid())==undo_list.end()&&rec->GetTid()!=INVALID_TXN_ID)
-        {
-            undo_list.insert(rec->GetTid());
-        }
-        if(rec->GetRecordType()==COMMIT)
+    unordered_set<txn_id_t> apply_list;
+    lsn_t min_undo_lsn = last_cp_lsn;
+    std::unordered_map<txn_id_t, lsn_t> open_smos;
+    for(LogIterator it(log_mgr_, min_lsn); it.Valid(); ++it)
+    {
+        LogRecordType type = it->GetRecordType();
+        if(it.GetLSN() < last_cp_lsn)
         {
-            if(undo_list.find(rec->GetTid())!=undo_list.end())
-                undo_list.erase(rec->GetTid());
-            redo_list.insert(rec->GetTid());
+            if(min_undo_lsn==last_cp_lsn && att_->GetTable().count(it->GetTid()) > 0)
+                min_undo_lsn = it.GetLSN();
         }
-        if(rec->GetTid()>max_tid)
-            max_tid = rec->GetTid();
-        cur_lsn++;
+        else if(type==BEGIN)
+            undo_list.insert(it->GetTid());
+        //a transaction in the checkpoint may have committed before it
+        if(type==COMMIT && undo_list.erase(it->GetTid()) > 0)
+            apply_list.insert(it->GetTid());
+        else if(type==ABORT)
+            undo_list.erase(it->GetTid());
+        else if(type==TXN_END)
+            apply_list.erase(it->GetTid());
+        if(type==SMO_BEGIN)
+            open_smos[it->GetTid()] = it.GetLSN();
+        else if(type==SMO_END)
+            open_smos.erase(it->GetTid());
+        max_tid = std::max(max_tid, it->GetTid());
     }
+    att_->GetTable() = undo_list;
+    att_->GetTable().insert(apply_list.begin(), apply_list.end());
     //show 
     cout<<"[Undo list(tid)]: ";
     for(auto tid : undo_list)
         cout<<tid<<" ";
     cout<<endl;
-    cout<<"[Redo list(tid)]: ";
-    for(auto tid : redo_list)
+    cout<<"[Apply list(tid)]: ";
+    for(auto tid : apply_list)
         cout<<tid<<" ";
     cout<<endl;
-    //scan the log before checkpoint and get the minimum lsn of the record whose tid is in undolist
-    //get the maximum tid at the same time
-    lsn_t min_undo_lsn = last_cp_lsn;
-    cur_lsn = last_cp_lsn - 1;
-    //txn_id_t max_tid = 0;
-    while(cur_lsn >= 1)
-    {
-        log_mgr_->GetRecord(rec, cur_lsn);
-        if(undo_list.find(rec->GetTid())!=undo_list.end())
-            min_undo_lsn = rec->GetLSN();
-        if(rec->GetTid()>max_tid)
-            max_tid = rec->GetTid();
-        cur_lsn--;
-    }
     cout<<"min undo lsn = "<<min_undo_lsn<<endl;
     
-    //do undo
-    cout<<"----Undo Pass----"<<endl;
-    cur_lsn = max_lsn;
-    while(cur_lsn>=min_undo_lsn)
+    //do redo first, repeating history: the records of every transaction, the unfinished ones too, are replayed,
+    //pages then hold what they held at the crash (or later)
+    //the log is read once from the redo start on, page records go to the thread of their page. the other records
+    //change the allocation state shared by all pages, they are replayed in between, once the queued records are done
+    cout<<"----Redo Pass-----"<<endl;
+    buf_mgr_->SetLogChanges(false);
     {
-        log_mgr_->GetRecord(rec, cur_lsn);
-        if(undo_list.find(rec->GetTid())!=undo_list.end())
-            Undo(rec);
-        cur_lsn--;
+        ParallelRedo redo(this, REDO_THREAD_NUM);
+        for(LogIterator it(log_mgr_, std::max(redo_lsn, min_lsn)); it.Valid(); ++it)
+        {
+            LogRecordType type = it->GetType();
+            if(type==WRITE || type==WRITE_DELTA || type==NEW)
+                redo.Dispatch(it.Release());
+            else if(type==DELETE || type==BITMAP_WRITE || type==DISKMETA_WRITE)
+            {
+                redo.Drain();
+                Redo(&*it);
+            }
+        }
+        redo.Drain();
     }
-    //add abort record for each transaction in undo list
+    buf_mgr_->SetLogChanges(true);
+    if(!open_smos.empty())
+        UndoStructureChanges(open_smos);
+
+    //the undo is logical: the writes of the unfinished transactions not compensated yet are rolled back
+    //through the catalog, like at runtime, once it is loaded (TakeUnfinished). the writes of the committed
+    //transactions without an end are applied again (TakeUnapplied), but for the pages freed after the commit
+    cout<<"----Undo Pass----"<<endl;
+    std::unordered_map<txn_id_t, Transaction*> unfinished;
+    std::unordered_set<lsn_t> compensated;
+    std::unordered_map<txn_id_t, UnappliedCommit> unapplied;
+    std::unordered_set<txn_id_t> applying;
     for(auto tid : undo_list)
+        unfinished[tid] = new Transaction(tid);
+    for(auto tid : apply_list)
+        unapplied[tid] = UnappliedCommit{new Transaction(tid), {}};
+    for(LogIterator it(log_mgr_, std::max(min_undo_lsn, min_lsn)); it.Valid(); ++it)
     {
-        LogRecord* append_rec = new LogRecord(log_mgr_->GetMaxLSN()+1, tid, ABORT);
-        log_mgr_->AddRecord(append_rec);
-        delete append_rec;
-        att_->GetTable().erase(tid);
+        auto commit = unapplied.find(it->GetTid());
+        if(commit!=unapplied.end())
+        {
+            LogRecordType type = it->GetRecordType();
+            if(type==TXN_WRITE)
+                commit->second.txn_->AddWrite(it->GetWrite());
+            else if(type==COMMIT)
+                applying.insert(it->GetTid());
+            else if(type==DELETE && applying.count(it->GetTid()) > 0)
+                commit->second.freed_.insert(it->GetPid());
+            continue;
+        }
+        auto txn = unfinished.find(it->GetTid());
+        if(txn==unfinished.end())
+            continue;
+        if(it->GetRecordType()==TXN_WRITE)
+            txn->second->AddWrite(it->GetWrite());
+        else if(it->GetRecordType()==COMPENSATE)
+            compensated.insert(it->GetUndoneLSN());
     }
-
-    //do redo
-    cout<<"----Redo Pass-----"<<endl;
-    cur_lsn = last_cp_lsn;
-    while(cur_lsn<=max_lsn)
+    for(auto& txn : unfinished)
     {
-        log_mgr_->GetRecord(rec, cur_lsn);
-        if(redo_list.find(rec->GetTid())!=redo_list.end())
-            Redo(rec);
-        cur_lsn++;
+        auto& writes = txn.second->GetWrites();
+        writes.erase(std::remove_if(writes.begin(), writes.end(),
+                                    [&](const WriteRecord& write){ return compensated.count(write.lsn_) > 0; }),
+                     writes.end());
+        unfinished_.push_back(txn.second);
     }
+    for(auto& commit : unapplied)
+        unapplied_.push_back(std::move(commit.second));
 
     //assign next_tid
-    next_tid_ = max_tid + 1;
+    log_mgr_->SetNextTid(max_tid + 1);
     cout<<"-------------Recover success--------------"<<endl;
-    delete rec;
 }
 
-//undo a record
-void TransactionManager::Undo(LogRecord* rec)
+std::vector<Transaction*> TransactionManager::TakeUnfinished()
 {
-    ASSERT(rec!=nullptr, "Null parameter for Undo!");
-
-    //std::cout<<"Undo: ";
-    log_mgr_->ShowRecord(rec->GetLSN());
+    return std::move(unfinished_);
+}
 
-    if(rec->GetType()==WRITE)//undo modification on page
-    {
-        Page *p = buf_mgr_->FetchPage(rec->GetPid(), true);
-        if(p!=nullptr)
-        {
-            p->CopyBy(rec->GetOldData());
-            buf_mgr_->UnpinPage(rec->GetPid(), true);
-        }
-    }
-    else if(rec->GetType()==NEW)//undo new page (delete page)
-    {
-        buf_mgr_->DeletePage(rec->GetPid());
-    }
-    else if(rec->GetType()==DELETE)//undo deletion of a page (recreate)
-    {
-        page_id_t pid = INVALID_PAGE_ID;
-        Page *p = buf_mgr_->NewPage(pid);//pid might be different with rec->GetPid(). Will this cause problem?
-        if(pid!=rec->GetPid())
-        {
-            cout<<"[Danger] Different pid after undo deletion of page, new = "<<pid<<" !"<<endl;
-            //reset pid after this record!
-            log_mgr_->ReplacePid(rec->GetPid(), pid);
-        }
-        p->CopyBy(rec->GetOldData());
-        buf_mgr_->UnpinPage(p->GetPageId(), true);
-    }
-    else if(rec->GetType()==BITMAP_WRITE) //undo bitmap page write of disk
-    {
-        Page *p = disk_mgr_->FetchBitmapPage(rec->GetEid(), true);
-        if(p!=nullptr)
-        {
-            p->CopyBy(rec->GetOldData());
-            disk_mgr_->UnpinBitmapPage(rec->GetEid(), true);
-            //std::cout<<"undo bitmap record"<<std::endl;
-        }
-    }
-    else if(rec->GetType()==DISKMETA_WRITE) //undo diskmeta page write of disk
-    {
-        Page *p = disk_mgr_->FetchDiskMetaPage(true);
-        if(p!=nullptr)
-        {
-            p->CopyBy(rec->GetOldData());
-            disk_mgr_->UnpinDiskMetaPage(true);
-            //std::cout<<"undo diskmeta record"<<std::endl;
-        }
-    }
+std::vector<UnappliedCommit> TransactionManager::TakeUnapplied()
+{
+    return std::move(unapplied_);
 }
 
 //redo a record
@@ -170,44 +276,32 @@ void TransactionManager::Redo(LogRecord* rec)
 {
     ASSERT(rec!=nullptr, "Null parameter for Redo!");
 
-    //std::cout<<"Redo: ";
-    log_mgr_->ShowRecord(rec->GetLSN());
-    if(rec->GetType()==WRITE)//redo modification on page
+    if(rec->GetType()==WRITE || rec->GetType()==WRITE_DELTA || rec->GetType()==NEW)//redo modification/creation of page
     {
         Page *p = buf_mgr_->FetchPage(rec->GetPid(), true);
-        if(p!=nullptr)
-        {
-            p->CopyBy(rec->GetNewData());
-            buf_mgr_->UnpinPage(rec->GetPid(), true);
-        }
-    }
-    else if(rec->GetType()==NEW)//redo new page (check and recreate if not exists)
-    {
-        Page *p = buf_mgr_->FetchPage(rec->GetPid(), true);
-        if(p==nullptr)//need to recreate
+        if(p==nullptr && rec->GetType()==NEW)//the allocation did not reach the disk, allocate the same page again
+            p = buf_mgr_->NewPageAt(rec->GetPid());
+        if(p==nullptr)
+            return;
+        if(p->GetLSN() >= rec->GetLSN())
         {
-            page_id_t pid = INVALID_PAGE_ID;
-            Page *p = buf_mgr_->NewPage(pid);//pid might be different with rec->GetPid(). Will this cause problem?
-            if(pid!=rec->GetPid())
-            {
-                cout<<"[Danger] Different pid after redo new of page, new = "<<pid<<" !"<<endl;
-                //reset pid after this record!
-                log_mgr_->ReplacePid(rec->GetPid(), pid);
-            }
-            p->CopyBy(rec->GetNewData());
-            buf_mgr_->UnpinPage(p->GetPageId(), true);
+            //the change reached the disk before the crash
+            buf_mgr_->UnpinPage(rec->GetPid(), false, false);
+            return;
         }
+        if(rec->GetType()==WRITE_DELTA)
+            rec->ApplyDelta(p->GetData(), true);
         else
-        {
-            buf_mgr_->UnpinPage(p->GetPageId(), true);
-        }
+            p->CopyBy(rec->GetNewData());
+        p->SetLSN(rec->GetLSN());
+        buf_mgr_->UnpinPage(rec->GetPid(), true);
     }
     else if(rec->GetType()==DELETE)//redo deletion of a page (check and redelete if exists)
     {
         Page *p = buf_mgr_->FetchPage(rec->GetPid(), false);
         if(p!=nullptr)//need to redelete
         {
-            buf_mgr_->UnpinPage(p->GetPageId(), true);
+            buf_mgr_->UnpinPage(p->GetPageId(), false);//fetched for read
             buf_mgr_->DeletePage(p->GetPageId());
         }
     }
@@ -233,34 +327,127 @@ void TransactionManager::Redo(LogRecord* rec)
     }
 }
 
+//undo a record
+void TransactionManager::Undo(LogRecord* rec)
+{
+    ASSERT(rec!=nullptr, "Null parameter for Undo!");
+
+    if(rec->GetType()==WRITE || rec->GetType()==WRITE_DELTA)
+    {
+        Page *p = buf_mgr_->FetchPage(rec->GetPid(), true);
+        if(p==nullptr)
+            return;
+        rec->UndoWrite(p->GetData());
+        buf_mgr_->UnpinPage(rec->GetPid(), true);
+    }
+    else if(rec->GetType()==NEW)//free the page again
+        buf_mgr_->DeletePage(rec->GetPid());
+    else if(rec->GetType()==DELETE)//allocate the page again, with its content
+    {
+        Page *p = buf_mgr_->NewPageAt(rec->GetPid());
+        if(p==nullptr)
+            return;
+        p->CopyBy(rec->GetOldData());
+        buf_mgr_->UnpinPage(rec->GetPid(), true);
+    }
+}
+
+void TransactionManager::UndoStructureChanges(const std::unordered_map<txn_id_t, lsn_t>& open_smos)
+{
+    cout<<"----Structure Modification Undo----"<<endl;
+    //the pages hold what they held at the crash: the other sessions did not get to the pages of a modification
+    //before its end
+    lsn_t begin_lsn = INVALID_LSN;
+    for(auto& smo : open_smos)
+    {
+        if(begin_lsn==INVALID_LSN || smo.second < begin_lsn)
+            begin_lsn = smo.second;
+    }
+    std::vector<LogRecord*> records;
+    for(LogIterator it(log_mgr_, begin_lsn); it.Valid(); ++it)
+    {
+        auto smo = open_smos.find(it->GetTid());
+        if(smo==open_smos.end() || it.GetLSN() < smo->second)
+            continue;
+        LogRecordType type = it->GetType();
+        if(type==WRITE || type==WRITE_DELTA || type==NEW || type==DELETE)
+            records.push_back(it.Release());
+    }
+    //the undo is logged by the session of the modification, which is complete with its end then
+    for(auto rec = records.rbegin(); rec != records.rend(); ++rec)
+    {
+        Transaction txn((*rec)->GetTid());
+        buf_mgr_->SetTxn(&txn);
+        Undo(*rec);
+        delete *rec;
+    }
+    for(auto& smo : open_smos)
+    {
+        Transaction txn(smo.first);
+        buf_mgr_->SetTxn(&txn);
+        buf_mgr_->EndStructureChange();
+    }
+    buf_mgr_->SetTxn(nullptr);
+    cout<<"structure modifications undone: "<<open_smos.size()<<endl;
+}
+
 //begin a transaction
 Transaction* TransactionManager::Begin(Transaction *txn)
 {
+    std::scoped_lock<std::mutex> lock(att_latch_);
     if(txn==nullptr)
     {
-        std::cout<<"txn "<<next_tid_<<" begin"<<std::endl;
-        txn = new Transaction(next_tid_++);
+        txn = new Transaction(log_mgr_->NewTid());
+        std::cout<<"txn "<<txn->GetTid()<<" begin"<<std::endl;
         //txn_map_.insert(std::make_pair(next_tid_-1, txn));
     }
 
-    LogRecord* append_rec = new LogRecord(log_mgr_->GetMaxLSN()+1, txn->GetTid(), BEGIN);
+    LogRecord* append_rec = new LogRecord(INVALID_LSN, txn->GetTid(), BEGIN);
     log_mgr_->AddRecord(append_rec);
     delete append_rec;
 
     att_->AddTxn(txn);
+    if(version_mgr_ != nullptr)
+        version_mgr_->Begin(txn);
     return txn;
 }
 
 //Commit a transaction.
-void TransactionManager::Commit(Transaction *txn)
+dberr_t TransactionManager::Commit(Transaction *txn, const std::function<void(Transaction *)> &apply_writes)
 {
     std::cout<<"txn "<<txn->GetTid()<<" commit"<<std::endl;
     txn->SetState(TransactionState::COMMITTED);
 
-    LogRecord* append_rec = new LogRecord(log_mgr_->GetMaxLSN()+1, txn->GetTid(), COMMIT);
+    lsn_t commit_lsn;
+    {
+        std::scoped_lock<std::mutex> lock(att_latch_);
+        LogRecord* append_rec = new LogRecord(INVALID_LSN, txn->GetTid(), COMMIT);
+        commit_lsn = log_mgr_->AddRecord(append_rec);
+        delete append_rec;
+    }
+    //the commit record must be durable before the commit is reported,
+    //concurrent commits share the sync (group commit)
+    dberr_t ret = log_mgr_->WaitForFlushed(commit_lsn);
+    //visible to the snapshots taken from now on, before the rows are unlocked for other writers.
+    //also if the log failed: whatever depends on the changes is logged after the commit record, so it is never durable without it
+    if(version_mgr_ != nullptr)
+        version_mgr_->Commit(txn);
+    //under the locks, no other session drops the tables meanwhile, or reuses the slots of the deleted tuples
+    if(apply_writes)
+        apply_writes(txn);
+    EndCommit(txn);
+    if(lock_mgr_ != nullptr)
+        lock_mgr_->UnlockAll(txn);
+    return ret;
+}
+
+void TransactionManager::EndCommit(Transaction *txn)
+{
+    //not waited for: what is logged after it is only durable with it, without it the writes are applied again
+    std::scoped_lock<std::mutex> lock(att_latch_);
+    LogRecord* append_rec = new LogRecord(INVALID_LSN, txn->GetTid(), TXN_END);
     log_mgr_->AddRecord(append_rec);
     delete append_rec;
-    
     att_->DelTxn(txn);
 }
 
@@ -270,32 +457,97 @@ void TransactionManager::Abort(Transaction *txn)
     std::cout<<"txn "<<txn->GetTid()<<" abort"<<std::endl;
     txn->SetState(TransactionState::ABORTED);
 
-    //use log to rollback
-    lsn_t cur_lsn = log_mgr_->GetMaxLSN();
-    cout<<"abort txn "<<txn->GetTid()<<endl;
-    LogRecord* rec = new LogRecord;
-    while(cur_lsn!=0)//scan until the first log record
+    lsn_t abort_lsn;
     {
-        log_mgr_->GetRecord(rec, cur_lsn);
-        //cout<<"cur_lsn = "<<cur_lsn<<" record tid = "<<rec->GetTid()<<" transaction tid = "<<txn->GetTid()<<endl;
-        if(rec->GetTid() == txn->GetTid())//record belongs to transaction txn
-        {
-            Undo(rec);
-        }
-        cur_lsn--;
+        std::scoped_lock<std::mutex> lock(att_latch_);
+        LogRecord* append_rec = new LogRecord(INVALID_LSN, txn->GetTid(), ABORT);
+        abort_lsn = log_mgr_->AddRecord(append_rec);
+        delete append_rec;
+        att_->DelTxn(txn);
     }
-    delete rec;
+    //the changes are undone already, recovery rolls the transaction back as well if the record is lost
+    log_mgr_->WaitForFlushed(abort_lsn);
+    if(version_mgr_ != nullptr)
+        version_mgr_->Abort(txn);
+    if(lock_mgr_ != nullptr)
+        lock_mgr_->UnlockAll(txn);
+}
 
-    LogRecord* append_rec = new LogRecord(log_mgr_->GetMaxLSN()+1, txn->GetTid(), ABORT);
-    log_mgr_->AddRecord(append_rec);
-    delete append_rec;
+void TransactionManager::CheckPoint()
+{
+    std::scoped_lock<std::mutex> cp_lock(checkpoint_latch_);
+    //pages are not flushed: the dirty page table tells recovery where to start redo. only the pages dirty since
+    //before the previous checkpoint are written, so that redo never starts further back than that
+    if(last_cp_begin_lsn_!=INVALID_LSN)
+        buf_mgr_->FlushOldPages(last_cp_begin_lsn_);
+    DirtyPageTable dpt;
+    last_cp_begin_lsn_ = log_mgr_->GetMaxLSN() + 1;
+    dpt.SetBeginLSN(last_cp_begin_lsn_);
+    buf_mgr_->GetDirtyPageTable(&dpt);
+    //the allocation state has no lsn, it is written as of now, after its log
+    if(log_mgr_->Flush() != DB_SUCCESS)
+        return;
+    disk_mgr_->FlushAllMeta();
+    //pages written before the table was taken must be on stable storage before the record claims so
+    disk_mgr_->Sync();
+    lsn_t cp_lsn;
+    {
+        std::scoped_lock<std::mutex> lock(att_latch_);
+        //with the tid of the next transaction, recovery goes on after it even if the older records were discarded
+        LogRecord* append_rec = new LogRecord(CHECK_POINT, INVALID_LSN, log_mgr_->GetNextTid(), INVALID_PAGE_ID, nullptr, nullptr, INVALID_EXTENT_ID, att_, &dpt);
+        cp_lsn = log_mgr_->AddRecord(append_rec);
+        delete append_rec;
+    }
+    if(log_mgr_->WaitForFlushed(cp_lsn) != DB_SUCCESS)
+        return;
+    //the log is needed from the redo start on, and for the rollback of the running transactions
+    lsn_t keep_lsn = dpt.GetRedoLSN();
+    lsn_t oldest_active_lsn = log_mgr_->GetOldestActiveLSN();
+    if(oldest_active_lsn != INVALID_LSN)
+        keep_lsn = std::min(keep_lsn, oldest_active_lsn);
+    log_mgr_->WriteMasterRecord(cp_lsn, keep_lsn);
+    log_mgr_->DiscardBefore(keep_lsn);
+    last_cp_log_size_ = log_mgr_->GetLogSize();
+}
 
-    att_->DelTxn(txn);    
+void TransactionManager::StartBackgroundCheckPoint()
+{
+    last_cp_log_size_ = log_mgr_->GetLogSize();
+    checkpoint_stop_ = false;
+    checkpoint_thread_ = std::thread(&TransactionManager::BackgroundCheckPoint, this);
 }
 
-void TransactionManager::CheckPoint()
+void TransactionManager::StopBackgroundCheckPoint()
 {
-    LogRecord* append_rec = new LogRecord(CHECK_POINT, log_mgr_->GetMaxLSN()+1, INVALID_TXN_ID, INVALID_PAGE_ID, nullptr, nullptr, INVALID_EXTENT_ID, att_, nullptr);
-    log_mgr_->AddRecord(append_rec);
-    delete append_rec;
-}
\ No newline at end of file
+    if(!checkpoint_thread_.joinable())
+        return;
+    {
+        std::scoped_lock<std::mutex> lock(checkpoint_thread_latch_);
+        checkpoint_stop_ = true;
+    }
+    checkpoint_cv_.notify_all();
+    checkpoint_thread_.join();
+}
+
+void TransactionManager::BackgroundCheckPoint()
+{
+    //the triggers are checked every second, or more often for a short interval
+    const auto poll_interval = std::chrono::milliseconds(std::min<uint32_t>(CHECKPOINT_INTERVAL_MS, 1000));
+    auto last_cp_time = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(checkpoint_thread_latch_);
+    while(!checkpoint_stop_)
+    {
+        checkpoint_cv_.wait_for(lock, poll_interval);
+        if(checkpoint_stop_)
+            break;
+        uint64_t logged = log_mgr_->GetLogSize() - last_cp_log_size_;
+        auto now = std::chrono::steady_clock::now();
+        bool by_time = (now - last_cp_time >= std::chrono::milliseconds(CHECKPOINT_INTERVAL_MS)) && logged > 0;
+        if(!by_time && logged < CHECKPOINT_LOG_SIZE)
+            continue;
+        lock.unlock();
+        CheckPoint();
+        lock.lock();
+        last_cp_time = std::chrono::steady_clock::now();
+    }
+}
@@ -0,0 +1,162 @@
+#include "transaction/version_manager.h"
+#include <algorithm>
+
+void VersionManager::Begin(Transaction* txn)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    txn->SetReadTs(last_commit_ts_);
+    snapshots_.insert(last_commit_ts_);
+}
+
+void VersionManager::Commit(Transaction* txn)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    txn->GetCommitStamp()->commit_ts_ = ++last_commit_ts_;
+    EndSnapshot(txn);
+}
+
+void VersionManager::Abort(Transaction* txn)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    //the pages hold the images from before its writes again
+    txn->GetCommitStamp()->aborted_ = true;
+    EndSnapshot(txn);
+}
+
+void VersionManager::EndSnapshot(Transaction* txn)
+{
+    auto snapshot = snapshots_.find(txn->GetReadTs());
+    if(snapshot != snapshots_.end())
+        snapshots_.erase(snapshot);
+    if(version_num_ >= collect_threshold_)
+    {
+        Collect();
+        collect_threshold_ = std::max<size_t>(VERSION_COLLECT_THRESHOLD, 2 * version_num_);
+    }
+}
+
+void VersionManager::AddVersion(page_id_t table, const RowId& rid, Transaction* txn, const char* data, uint32_t size)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto& chain = tables_[table][rid.Get()];
+    //the image before the first write of the transaction is the one others may need
+    if(!chain.empty() && chain.back().writer_ == txn->GetCommitStamp())
+        return;
+    Version version{txn->GetCommitStamp(), data != nullptr, {}};
+    if(data != nullptr)
+        version.data_.assign(data, data + size);
+    chain.push_back(std::move(version));
+    version_num_++;
+}
+
+VersionManager::ReadResult VersionManager::ReadVersion(page_id_t table, const RowId& rid, Transaction* txn,
+                                                       std::vector<char>* data)
+{
+    if(version_num_ == 0)
+        return ReadResult::CURRENT;
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto versions = tables_.find(table);
+    if(versions == tables_.end())
+        return ReadResult::CURRENT;
+    auto chain = versions->second.find(rid.Get());
+    if(chain == versions->second.end())
+        return ReadResult::CURRENT;
+    //the newest write seen by txn made the visible version, which is the image kept by the write after it
+    auto& chain_versions = chain->second;
+    size_t next = chain_versions.size();
+    while(next > 0 && !Visible(chain_versions[next - 1], txn))
+        next--;
+    if(next == chain_versions.size())
+        return ReadResult::CURRENT;
+    const Version& version = chain_versions[next];
+    if(!version.existed_)
+        return ReadResult::NONE;
+    *data = version.data_;
+    return ReadResult::OLDER;
+}
+
+std::vector<RowId> VersionManager::GetVersionedRows(page_id_t table)
+{
+    std::vector<RowId> rids;
+    if(version_num_ == 0)
+        return rids;
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto versions = tables_.find(table);
+    if(versions == tables_.end())
+        return rids;
+    for(auto& chain : versions->second)
+        rids.emplace_back(chain.first);
+    return rids;
+}
+
+void VersionManager::MoveVersions(page_id_t table, const RowId& from, const RowId& to, Transaction* txn)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto versions = tables_.find(table);
+    if(versions == tables_.end())
+        return;
+    auto chain = versions->second.find(from.Get());
+    if(chain == versions->second.end())
+        return;
+    std::vector<Version> moved = std::move(chain->second);
+    versions->second.erase(chain);
+    size_t size = moved.size();
+    moved.erase(std::remove_if(moved.begin(), moved.end(),
+                               [&](const Version& version) { return version.writer_ == txn->GetCommitStamp(); }),
+                moved.end());
+    version_num_ -= size - moved.size();
+    if(moved.empty())
+        return;
+    auto& to_chain = versions->second[to.Get()];
+    to_chain.insert(to_chain.end(), std::make_move_iterator(moved.begin()), std::make_move_iterator(moved.end()));
+}
+
+void VersionManager::DropTable(page_id_t table)
+{
+    std::scoped_lock<std::mutex> lock(latch_);
+    auto versions = tables_.find(table);
+    if(versions == tables_.end())
+        return;
+    for(auto& chain : versions->second)
+        version_num_ -= chain.second.size();
+    tables_.erase(versions);
+}
+
+bool VersionManager::Visible(const Version& version, Transaction* txn) const
+{
+    if(version.writer_ == txn->GetCommitStamp())
+        return true;
+    const CommitStamp& writer = *version.writer_;
+    return !writer.aborted_ && writer.commit_ts_ != 0 && writer.commit_ts_ <= txn->GetReadTs();
+}
+
+void VersionManager::Collect()
+{
+    //a write seen by every running snapshot, and the ones before, are seen by all the later snapshots as well
+    uint64_t min_read_ts = snapshots_.empty() ? last_commit_ts_ : *snapshots_.begin();
+    for(auto table = tables_.begin(); table != tables_.end();)
+    {
+        for(auto chain = table->second.begin(); chain != table->second.end();)
+        {
+            auto& versions = chain->second;
+            size_t size = versions.size();
+            auto seen = std::find_if(versions.rbegin(), versions.rend(), [&](const Version& version) {
+                return version.writer_->commit_ts_ != 0 && version.writer_->commit_ts_ <= min_read_ts;
+            });
+            versions.erase(versions.begin(), seen.base());
+            //the images of aborted writes are in the pages again
+            versions.erase(std::remove_if(versions.begin(), versions.end(),
+                                          [](const Version& version) { return version.writer_->aborted_; }),
+                           versions.end());
+            version_num_ -= size - versions.size();
+            if(versions.empty())
+                chain = table->second.erase(chain);
+            else
+                ++chain;
+        }
+        if(table->second.empty())
+            table = tables_.erase(table);
+        else
+            ++table;
+    }
+}
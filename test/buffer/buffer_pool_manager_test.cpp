@@ -50,6 +50,7 @@ TEST(BufferPoolManagerTest, BinaryDataTest) {
   }
 
   // Scenario: After unpinning pages {0, 1, 2, 3, 4} we should be able to create 5 new pages
+  // (a pool this small is a single shard, so any unpinned frame can take a new page)
   for (int i = 0; i < 5; ++i) {
     EXPECT_EQ(true, bpm->UnpinPage(i, true));
     EXPECT_TRUE(bpm->FlushPage(i));
@@ -59,7 +60,8 @@ TEST(BufferPoolManagerTest, BinaryDataTest) {
   for (int i = 0; i < 5; ++i) {
     EXPECT_NE(nullptr, bpm->NewPage(page_id_temp));
     EXPECT_EQ(buffer_pool_size + i, page_id_temp);
-    bpm->UnpinPage(page_id_temp, false);
+    // a new page is write latched, so it is unpinned as a written one
+    bpm->UnpinPage(page_id_temp, true);
   }
   // EXPECT_EQ(0, memcmp(page0->GetData(), random_binary_data, PAGE_SIZE));
   // Scenario: We should be able to fetch the data we wrote a while ago.
@@ -67,10 +69,45 @@ TEST(BufferPoolManagerTest, BinaryDataTest) {
   EXPECT_EQ(0, memcmp(page0->GetData(), random_binary_data, PAGE_SIZE));
   EXPECT_EQ(true, bpm->UnpinPage(0, true));
 
-  // Shutdown the disk manager and remove the temporary file we created.
+  // the pool flushes dirty pages under their latch when it is destroyed, so the pages still pinned are released first
+  for (size_t i = 5; i < buffer_pool_size; ++i) {
+    EXPECT_EQ(true, bpm->UnpinPage(i, true));
+  }
+
+  // The pool writes its dirty pages back when destroyed, so it goes before the disk manager is closed.
+  delete bpm;
   disk_manager->Close();
   remove(db_name.c_str());
+  delete disk_manager;
+}
+
+TEST(BufferPoolManagerTest, ReplacerSeesAccessOrder) {
+  const std::string db_name = "bpm_order_test.db";
+  remove(db_name.c_str());
+  auto *disk_manager = new DiskManager(db_name, nullptr);
+  auto *bpm = new BufferPoolManager(3, disk_manager, nullptr, LRU);
+
+  page_id_t page_id_temp;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_NE(nullptr, bpm->NewPage(page_id_temp));
+  }
+  // the frames are taken from the back of the free list, so this order is neither frame order nor its reverse.
+  // page 0 is the least recently used one
+  EXPECT_TRUE(bpm->UnpinPage(0, true));
+  EXPECT_TRUE(bpm->UnpinPage(2, true));
+  EXPECT_TRUE(bpm->UnpinPage(1, true));
+
+  ASSERT_NE(nullptr, bpm->NewPage(page_id_temp));
+  EXPECT_TRUE(bpm->UnpinPage(page_id_temp, true));
+  bpm->ResetCounter();
+  for (page_id_t i = 1; i < 3; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(i, false));
+    EXPECT_TRUE(bpm->UnpinPage(i, false));
+  }
+  EXPECT_EQ(1.0, bpm->get_hit_rate());
 
   delete bpm;
+  disk_manager->Close();
+  remove(db_name.c_str());
   delete disk_manager;
 }
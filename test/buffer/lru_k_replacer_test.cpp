@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/lru_k_replacer.h"
+#include "gtest/gtest.h"
+
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer lru_k_replacer(7, 2);
+
+  // Scenario: unpin six frames. Frame 1 is accessed twice, the others once.
+  lru_k_replacer.Unpin(1);
+  lru_k_replacer.Unpin(2);
+  lru_k_replacer.Unpin(3);
+  lru_k_replacer.Unpin(4);
+  lru_k_replacer.Unpin(5);
+  lru_k_replacer.Unpin(6);
+  lru_k_replacer.Unpin(1);
+  EXPECT_EQ(6, lru_k_replacer.Size());
+
+  // Scenario: frames with less than k accesses go first, by their earliest access.
+  int value;
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(2, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(3, value);
+
+  // Scenario: pinned frames cannot be victimized, a second access gives frame 5 a finite distance.
+  lru_k_replacer.Pin(4);
+  lru_k_replacer.Pin(5);
+  lru_k_replacer.Unpin(5);
+  EXPECT_EQ(3, lru_k_replacer.Size());
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(6, value);
+
+  // Scenario: both remaining frames have two accesses, frame 1 has the older second-to-last access.
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(1, value);
+  lru_k_replacer.Victim(&value);
+  EXPECT_EQ(5, value);
+  EXPECT_FALSE(lru_k_replacer.Victim(&value));
+}
+
+static double RunMixedWorkload(REPLACER_TYPE replacer_type) {
+  const std::string db_name = "lru_k_test.db";
+  const size_t buffer_pool_size = 64;
+  const size_t hot_pages = 24;
+  const size_t scan_pages = 600;
+
+  remove(db_name.c_str());
+  auto *disk_manager = new DiskManager(db_name, nullptr);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager, nullptr, replacer_type);
+
+  std::vector<page_id_t> hot(hot_pages), scan(scan_pages);
+  for (auto &page_id : hot) {
+    EXPECT_NE(nullptr, bpm->NewPage(page_id));
+    bpm->UnpinPage(page_id, true);
+  }
+  for (auto &page_id : scan) {
+    EXPECT_NE(nullptr, bpm->NewPage(page_id));
+    bpm->UnpinPage(page_id, true);
+  }
+
+  // point lookups hit a small set of (index) pages, a full scan goes through every table page once
+  bpm->ResetCounter();
+  for (int round = 0; round < 20; round++) {
+    for (int lookup = 0; lookup < 10; lookup++) {
+      for (auto page_id : hot) {
+        EXPECT_NE(nullptr, bpm->FetchPage(page_id, false));
+        bpm->UnpinPage(page_id, false);
+      }
+    }
+    for (auto page_id : scan) {
+      EXPECT_NE(nullptr, bpm->FetchPage(page_id, false));
+      bpm->UnpinPage(page_id, false);
+    }
+  }
+  double hit_rate = bpm->get_hit_rate();
+
+  delete bpm;
+  disk_manager->Close();
+  delete disk_manager;
+  remove(db_name.c_str());
+  return hit_rate;
+}
+
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  double lru_hit_rate = RunMixedWorkload(LRU);
+  double lru_k_hit_rate = RunMixedWorkload(LRU_K);
+  // a scan flushes the hot pages out of LRU, but not out of LRU-K
+  EXPECT_GT(lru_k_hit_rate, lru_hit_rate);
+}
@@ -135,4 +135,49 @@ TEST(CatalogTest, CatalogIndexTest) {
     ASSERT_EQ(rid.Get(), ret_02[i].Get());
   }
   delete db_02;
-}
\ No newline at end of file
+}
+TEST(CatalogTest, CatalogRollbackTest) {
+  UsedHeap heap;
+  /** Stage 1: Testing drops and creates of transactions */
+  auto db_01 = new DBStorageEngine("catalog_rollback_test.db", true);
+  auto &catalog_01 = db_01->catalog_mgr_;
+  std::vector<Column *> columns = {
+          ALLOC_COLUMN(heap)("id", TypeId::kTypeInt, 0, false, false),
+          ALLOC_COLUMN(heap)("name", TypeId::kTypeChar, 64, 1, true, false)
+  };
+  auto schema = std::make_shared<Schema>(columns);
+  std::vector<std::string> index_keys{"id"};
+  TableInfo *table_info = nullptr;
+  IndexInfo *index_info = nullptr;
+  ASSERT_EQ(DB_SUCCESS, catalog_01->CreateTable("table-1", schema.get(), nullptr, table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->CreateIndex("table-1", "index-1", index_keys, nullptr, index_info));
+  // a dropped table keeps its name until the transaction ends, the rollback puts it back with its index
+  Transaction txn_01;
+  ASSERT_EQ(DB_SUCCESS, catalog_01->DropTable("table-1", &txn_01));
+  ASSERT_EQ(DB_TABLE_NOT_EXIST, catalog_01->GetTable("table-1", table_info));
+  ASSERT_EQ(DB_TABLE_ALREADY_EXIST, catalog_01->CreateTable("table-1", schema.get(), nullptr, table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->CreateTable("table-2", schema.get(), &txn_01, table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->CreateTable("table-3", schema.get(), nullptr, table_info));
+  catalog_01->RollbackWrites(&txn_01);
+  ASSERT_EQ(DB_SUCCESS, catalog_01->GetTable("table-1", table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->GetIndex("table-1", "index-1", index_info));
+  ASSERT_EQ(DB_TABLE_NOT_EXIST, catalog_01->GetTable("table-2", table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->GetTable("table-3", table_info));
+  // a dropped index is freed at commit
+  Transaction txn_02;
+  ASSERT_EQ(DB_SUCCESS, catalog_01->DropIndex("table-1", "index-1", &txn_02));
+  ASSERT_EQ(DB_INDEX_ALREADY_EXIST, catalog_01->CreateIndex("table-1", "index-1", index_keys, nullptr, index_info));
+  catalog_01->CommitWrites(&txn_02);
+  ASSERT_EQ(DB_INDEX_NOT_FOUND, catalog_01->GetIndex("table-1", "index-1", index_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_01->CreateIndex("table-1", "index-2", index_keys, nullptr, index_info));
+  delete db_01;
+  /** Stage 2: Testing catalog loading */
+  auto db_02 = new DBStorageEngine("catalog_rollback_test.db", false);
+  auto &catalog_02 = db_02->catalog_mgr_;
+  ASSERT_EQ(DB_SUCCESS, catalog_02->GetTable("table-1", table_info));
+  ASSERT_EQ(DB_TABLE_NOT_EXIST, catalog_02->GetTable("table-2", table_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_02->GetTable("table-3", table_info));
+  ASSERT_EQ(DB_INDEX_NOT_FOUND, catalog_02->GetIndex("table-1", "index-1", index_info));
+  ASSERT_EQ(DB_SUCCESS, catalog_02->GetIndex("table-1", "index-2", index_info));
+  delete db_02;
+}
@@ -0,0 +1,91 @@
+#include "common/instance.h"
+#include "gtest/gtest.h"
+#include "index/b_plus_tree.h"
+#include "index/basic_comparator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+using namespace std;
+static const std::string db_name = "bp_tree_concurrent_test.db";
+
+// the keys an iterator goes through, which must be increasing
+static int ScanTree(BPlusTree &tree) {
+  int count = 0;
+  uint32_t last = 0;
+  for (auto it = tree.Begin(nullptr); it != tree.End(); ++it) {
+    uint32_t current;
+    memcpy(&current, it->key.value, sizeof(current));
+    if (count > 0) EXPECT_LT(last, current);
+    last = current;
+    count++;
+  }
+  return count;
+}
+
+TEST(BPlusTreeTests, ConcurrentTest) {
+  // Init engine
+  DBStorageEngine engine(db_name);
+  key_size_t key_size = 4;
+  // small pages, so that the threads split and merge them all the time
+  int leaf_size = 8;
+  int internal_size = 8;
+  IndexKeyComparator cmp(nullptr);
+  BPlusTree tree(0, engine.bpm_, cmp, key_size, leaf_size, internal_size);
+  const int thread_num = 8;
+  const int n = thread_num * 5000;
+
+  // thread t inserts the keys equal to t modulo thread_num, and scans the tree now and then
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t] {
+      int v = 0;
+      IndexKey *key = IndexKey::Create(key_size, v);
+      for (int i = t; i < n; i += thread_num) {
+        key->SetValue(i);
+        EXPECT_TRUE(tree.Insert(key, RowId(i)));
+        if (i % 1000 == t) ScanTree(tree);
+      }
+      delete key;
+    });
+  }
+  for (auto &th : threads) th.join();
+  threads.clear();
+  ASSERT_TRUE(tree.Check());
+  ASSERT_TRUE(tree.CheckIntergrity());
+  ASSERT_EQ(n, ScanTree(tree));
+
+  // then it removes the even ones of its keys, and finds the odd ones meanwhile
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t] {
+      int v = 0;
+      IndexKey *key = IndexKey::Create(key_size, v);
+      vector<RowId> result;
+      for (int i = t; i < n; i += thread_num) {
+        key->SetValue(i);
+        if (i / thread_num % 2 == 0) {
+          tree.Remove(key);
+        } else {
+          result.clear();
+          EXPECT_TRUE(tree.GetValue(key, result));
+        }
+        if (i % 1000 == t) ScanTree(tree);
+      }
+      delete key;
+    });
+  }
+  for (auto &th : threads) th.join();
+  ASSERT_TRUE(tree.Check());
+  ASSERT_TRUE(tree.CheckIntergrity());
+  ASSERT_EQ(n / 2, ScanTree(tree));
+  int v = 0;
+  IndexKey *key = IndexKey::Create(key_size, v);
+  vector<RowId> result;
+  for (int i = 0; i < n; i++) {
+    key->SetValue(i);
+    result.clear();
+    ASSERT_EQ(i / thread_num % 2 == 1, tree.GetValue(key, result));
+  }
+  delete key;
+}
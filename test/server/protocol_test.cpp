@@ -0,0 +1,35 @@
+#include "server/protocol.h"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+TEST(ProtocolTest, PipelinedFrames) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  // several requests are sent before any is read, and come out whole and in order
+  std::string big(100000, 'x');
+  ASSERT_TRUE(SendFrame(fds[0], "use db0;"));
+  ASSERT_TRUE(SendFrame(fds[0], ""));
+  ASSERT_TRUE(SendResponse(fds[0], ResponseStatus::FAILURE, big));
+  std::string request;
+  ASSERT_TRUE(RecvFrame(fds[1], &request));
+  EXPECT_EQ("use db0;", request);
+  ASSERT_TRUE(RecvFrame(fds[1], &request));
+  EXPECT_TRUE(request.empty());
+  ResponseStatus status;
+  std::string output;
+  ASSERT_TRUE(RecvResponse(fds[1], &status, &output));
+  EXPECT_EQ(ResponseStatus::FAILURE, status);
+  EXPECT_EQ(big, output);
+
+  // the end of the stream, and a frame cut short by it
+  uint32_t length = htonl(10);
+  ASSERT_EQ(sizeof(length), write(fds[0], &length, sizeof(length)));
+  close(fds[0]);
+  EXPECT_FALSE(RecvFrame(fds[1], &request));
+  EXPECT_FALSE(RecvFrame(fds[1], &request));
+  close(fds[1]);
+}
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "storage/disk_manager.h"
+
+TEST(AllocationHintTest, RunsAreContiguous) {
+  std::string db_name = "allocation_hint_test.db";
+  remove(db_name.c_str());
+  DiskManager *disk_mgr = new DiskManager(db_name, nullptr);
+  AllocationHint heap_hint;
+  AllocationHint index_hint;
+
+  // Scenario: a table heap and an index allocate alternately, with some unhinted allocations in between.
+  std::vector<page_id_t> heap_pages, index_pages, other_pages;
+  for (uint32_t i = 0; i < 2 * ALLOCATION_RUN_SIZE; i++) {
+    heap_pages.push_back(disk_mgr->AllocatePage(&heap_hint));
+    index_pages.push_back(disk_mgr->AllocatePage(&index_hint));
+    if (i % 16 == 0) other_pages.push_back(disk_mgr->AllocatePage());
+  }
+
+  // Scenario: the pages of each hint are consecutive within a run, and runs start at run boundaries.
+  for (auto *pages : {&heap_pages, &index_pages}) {
+    for (size_t i = 0; i < pages->size(); i++) {
+      if (i % ALLOCATION_RUN_SIZE == 0) {
+        EXPECT_EQ(0, (*pages)[i] % ALLOCATION_RUN_SIZE);
+      } else {
+        EXPECT_EQ((*pages)[i - 1] + 1, (*pages)[i]);
+      }
+    }
+  }
+
+  // Scenario: unhinted pages never land in a reserved run.
+  for (auto page_id : other_pages) {
+    page_id_t run = page_id / ALLOCATION_RUN_SIZE * ALLOCATION_RUN_SIZE;
+    for (auto *pages : {&heap_pages, &index_pages}) {
+      for (size_t i = 0; i < pages->size(); i += ALLOCATION_RUN_SIZE) EXPECT_NE(run, (*pages)[i]);
+    }
+  }
+
+  // Scenario: a freed page in the middle of the current run is not handed out to the hint again.
+  page_id_t freed = heap_pages[heap_pages.size() - 10];
+  disk_mgr->DeAllocatePage(freed);
+  page_id_t next = disk_mgr->AllocatePage(&heap_hint);
+  EXPECT_NE(freed, next);
+  EXPECT_TRUE(disk_mgr->IsPageFree(freed));
+
+  delete disk_mgr;
+  remove(db_name.c_str());
+}
+
+TEST(AllocationHintTest, ReservationEndsWithHint) {
+  std::string db_name = "allocation_hint_test.db";
+  remove(db_name.c_str());
+  DiskManager *disk_mgr = new DiskManager(db_name, nullptr);
+  page_id_t first;
+  {
+    AllocationHint hint;
+    first = disk_mgr->AllocatePage(&hint);
+  }
+  // Scenario: once the hint is gone, the rest of its run is free for everybody again.
+  EXPECT_EQ(first + 1, disk_mgr->AllocatePage());
+  delete disk_mgr;
+  remove(db_name.c_str());
+}
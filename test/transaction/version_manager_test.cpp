@@ -0,0 +1,76 @@
+#include "transaction/version_manager.h"
+
+#include "gtest/gtest.h"
+
+TEST(VersionManagerTest, SnapshotSeesCommittedVersions) {
+  VersionManager version_mgr;
+  Transaction reader(0), writer(1), late_reader(2);
+  RowId rid(1, 0);
+  std::vector<char> image;
+  const char old_data[] = "old";
+  version_mgr.Begin(&reader);
+  version_mgr.Begin(&writer);
+
+  // no versions kept, everyone reads the page
+  EXPECT_EQ(VersionManager::ReadResult::CURRENT, version_mgr.ReadVersion(1, rid, &reader, &image));
+
+  // the writer sees its change, the reader the image before it, even after the commit
+  version_mgr.AddVersion(1, rid, &writer, old_data, sizeof(old_data));
+  EXPECT_EQ(VersionManager::ReadResult::CURRENT, version_mgr.ReadVersion(1, rid, &writer, &image));
+  ASSERT_EQ(VersionManager::ReadResult::OLDER, version_mgr.ReadVersion(1, rid, &reader, &image));
+  EXPECT_STREQ(old_data, image.data());
+  version_mgr.Commit(&writer);
+  EXPECT_EQ(VersionManager::ReadResult::OLDER, version_mgr.ReadVersion(1, rid, &reader, &image));
+
+  // a snapshot taken after the commit reads the page
+  version_mgr.Begin(&late_reader);
+  EXPECT_EQ(VersionManager::ReadResult::CURRENT, version_mgr.ReadVersion(1, rid, &late_reader, &image));
+  version_mgr.Commit(&reader);
+  version_mgr.Commit(&late_reader);
+}
+
+TEST(VersionManagerTest, InsertedAndAbortedVersions) {
+  VersionManager version_mgr;
+  Transaction reader(0), writer(1);
+  RowId rid(1, 0);
+  std::vector<char> image;
+  version_mgr.Begin(&reader);
+  version_mgr.Begin(&writer);
+
+  // a tuple inserted after the snapshot is not in it
+  version_mgr.AddVersion(1, rid, &writer, nullptr, 0);
+  EXPECT_EQ(VersionManager::ReadResult::NONE, version_mgr.ReadVersion(1, rid, &reader, &image));
+  ASSERT_EQ(1, version_mgr.GetVersionedRows(1).size());
+  EXPECT_EQ(rid, version_mgr.GetVersionedRows(1)[0]);
+
+  // nor once the insert is rolled back
+  version_mgr.Abort(&writer);
+  EXPECT_EQ(VersionManager::ReadResult::NONE, version_mgr.ReadVersion(1, rid, &reader, &image));
+  version_mgr.DropTable(1);
+  EXPECT_TRUE(version_mgr.GetVersionedRows(1).empty());
+  version_mgr.Commit(&reader);
+}
+
+TEST(VersionManagerTest, MovedVersions) {
+  VersionManager version_mgr;
+  Transaction reader(0), writer(1), rollbacker(2);
+  RowId from(1, 0), to(2, 3);
+  std::vector<char> image;
+  const char old_data[] = "old", new_data[] = "new";
+  version_mgr.Begin(&reader);
+  version_mgr.Begin(&writer);
+  version_mgr.AddVersion(1, from, &writer, old_data, sizeof(old_data));
+  version_mgr.Commit(&writer);
+  version_mgr.Begin(&rollbacker);
+  version_mgr.AddVersion(1, from, &rollbacker, new_data, sizeof(new_data));
+
+  // the tuple put back somewhere else takes the committed versions along, not the ones of the rollback
+  version_mgr.MoveVersions(1, from, to, &rollbacker);
+  EXPECT_EQ(VersionManager::ReadResult::CURRENT, version_mgr.ReadVersion(1, from, &reader, &image));
+  ASSERT_EQ(VersionManager::ReadResult::OLDER, version_mgr.ReadVersion(1, to, &reader, &image));
+  EXPECT_STREQ(old_data, image.data());
+  ASSERT_EQ(1, version_mgr.GetVersionedRows(1).size());
+  EXPECT_EQ(to, version_mgr.GetVersionedRows(1)[0]);
+  version_mgr.Abort(&rollbacker);
+  version_mgr.Commit(&reader);
+}